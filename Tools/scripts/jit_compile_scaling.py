@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Copyright (c) Meta Platforms, Inc. and affiliates.
+
+"""Measure how batch JIT compilation scales with the number of workers.
+
+Imports every module in Tools/benchmarks, then batch compiles every function
+the JIT has seen, once for each worker count, and reports the wall time of the
+batch compile along with the speedup over a single worker.
+
+    ./python Tools/scripts/jit_compile_scaling.py
+    ./python Tools/scripts/jit_compile_scaling.py --workers 1 8 32 --repeat 5
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+
+BENCHMARKS_DIR = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "..", "benchmarks"
+)
+
+CHILD_CODE = """
+import importlib
+import os
+import sys
+import time
+
+import cinderjit
+
+benchmarks_dir = sys.argv[1]
+sys.path.insert(0, benchmarks_dir)
+for filename in sorted(os.listdir(benchmarks_dir)):
+    if filename.endswith(".py"):
+        importlib.import_module(filename[:-3])
+
+cinderjit.clear_compile_phase_stats()
+start = time.perf_counter()
+cinderjit.multithreaded_compile_test()
+elapsed = time.perf_counter() - start
+print(cinderjit.get_compile_phase_stats()["compiles"], elapsed)
+"""
+
+
+def run_once(python, workers):
+    proc = subprocess.run(
+        [
+            python,
+            "-X",
+            "jit",
+            "-X",
+            "jit-multithreaded-compile-test",
+            "-X",
+            f"jit-batch-compile-workers={workers}",
+            "-X",
+            "install-strict-loader",
+            "-c",
+            CHILD_CODE,
+            BENCHMARKS_DIR,
+        ],
+        capture_output=True,
+        encoding="utf-8",
+    )
+    if proc.returncode != 0:
+        sys.exit(
+            f"Compile with {workers} workers failed with exit code "
+            f"{proc.returncode}:\n{proc.stderr}"
+        )
+    compiles, elapsed = proc.stdout.split()
+    return int(compiles), float(elapsed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "--python",
+        default=sys.executable,
+        help="Python binary to run, defaulting to this one",
+    )
+    parser.add_argument(
+        "--workers",
+        type=int,
+        nargs="+",
+        default=[1, 2, 4, 8, 16, 32],
+        help="Worker counts to measure",
+    )
+    parser.add_argument(
+        "--repeat",
+        type=int,
+        default=3,
+        help="Runs per worker count; the median time is reported",
+    )
+    args = parser.parse_args()
+
+    print(f"{'workers':>8} {'compiles':>9} {'time (ms)':>10} {'speedup':>8}")
+    baseline = None
+    for workers in args.workers:
+        results = [run_once(args.python, workers) for _ in range(args.repeat)]
+        compiles = results[0][0]
+        elapsed = statistics.median(elapsed for _, elapsed in results)
+        if baseline is None:
+            baseline = elapsed
+        print(
+            f"{workers:>8} {compiles:>9} {elapsed * 1000:>10.1f} "
+            f"{baseline / elapsed:>7.2f}x"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# Copyright (c) Meta Platforms, Inc. and affiliates.
+
+"""Compare the JIT's register allocation modes on Tools/benchmarks.
+
+Runs each benchmark with every function JIT-compiled, once for each register
+allocation mode, and reports the number of functions with spilled values, the
+total spill space of all compiled functions, and the run time along with the
+speedup over the first mode.
+
+    ./python Tools/scripts/jit_regalloc_stats.py
+    ./python Tools/scripts/jit_regalloc_stats.py nbody richards --repeat 5
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+
+BENCHMARKS_DIR = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "..", "benchmarks"
+)
+
+MODES = {
+    "next-use": ["jit-regalloc-spill-costs=0"],
+    "spill-costs": ["jit-regalloc-spill-costs=1"],
+    "split-loops": [
+        "jit-regalloc-spill-costs=1",
+        "jit-regalloc-split-outside-loops=1",
+    ],
+}
+
+CHILD_CODE = """
+import gc
+import runpy
+import sys
+import time
+import types
+
+import cinderjit
+
+path = sys.argv[1]
+sys.argv = [path]
+start = time.perf_counter()
+runpy.run_path(path, run_name="__main__")
+elapsed = time.perf_counter() - start
+
+spilling = 0
+spill_bytes = 0
+for obj in gc.get_objects():
+    if isinstance(obj, types.FunctionType) and cinderjit.is_jit_compiled(obj):
+        size = cinderjit.get_compiled_spill_stack_size(obj)
+        spilling += size > 0
+        spill_bytes += size
+print(spilling, spill_bytes, elapsed)
+"""
+
+
+def run_once(python, benchmark, flags):
+    args = [python, "-X", "jit"]
+    for flag in flags:
+        args += ["-X", flag]
+    args += ["-c", CHILD_CODE, os.path.join(BENCHMARKS_DIR, benchmark + ".py")]
+    proc = subprocess.run(args, capture_output=True, encoding="utf-8")
+    if proc.returncode != 0:
+        sys.exit(
+            f"{benchmark} with {' '.join(flags)} failed with exit code "
+            f"{proc.returncode}:\n{proc.stderr}"
+        )
+    spilling, spill_bytes, elapsed = proc.stdout.split()[-3:]
+    return int(spilling), int(spill_bytes), float(elapsed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "benchmarks",
+        nargs="*",
+        default=["fannkuch", "nbody", "nqueens", "richards", "deltablue"],
+        help="Benchmarks in Tools/benchmarks to run, without the .py",
+    )
+    parser.add_argument(
+        "--python",
+        default=sys.executable,
+        help="Python binary to run, defaulting to this one",
+    )
+    parser.add_argument(
+        "--repeat",
+        type=int,
+        default=3,
+        help="Runs per benchmark and mode; the median time is reported",
+    )
+    args = parser.parse_args()
+
+    print(
+        f"{'benchmark':<12} {'mode':<12} {'spilling':>9} {'spill bytes':>12} "
+        f"{'time (ms)':>10} {'speedup':>8}"
+    )
+    for benchmark in args.benchmarks:
+        baseline = None
+        for mode, flags in MODES.items():
+            results = [
+                run_once(args.python, benchmark, flags)
+                for _ in range(args.repeat)
+            ]
+            spilling, spill_bytes, _ = results[0]
+            elapsed = statistics.median(elapsed for _, _, elapsed in results)
+            if baseline is None:
+                baseline = elapsed
+            print(
+                f"{benchmark:<12} {mode:<12} {spilling:>9} {spill_bytes:>12} "
+                f"{elapsed * 1000:>10.1f} {baseline / elapsed:>7.2f}x"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -16,6 +16,19 @@
 
 #define PYSHADOW_INIT_THRESHOLD 50
 
+/* Jump to instruction index x, counting backward jumps as loop back-edges and
+   transferring into JIT code once the frame is hot enough for OSR. */
+#define OSR_JUMPTO(x)                                              \
+    do {                                                           \
+        int osr_from = INSTR_OFFSET();                             \
+        JUMPTO(x);                                                 \
+        if (osr_threshold != 0 && (x) < osr_from &&                \
+            (x) != osr_failed_header &&                            \
+            ++osr_backedges >= osr_threshold) {                    \
+            goto osr_enter;                                        \
+        }                                                          \
+    } while (0)
+
 PyObject *Ci_GetAIter(PyThreadState *tstate, PyObject *obj) {
     unaryfunc getter = NULL;
     PyObject *iter = NULL;
@@ -403,6 +416,14 @@ Ci_EvalFrame(PyThreadState *tstate, PyFrameObject *f, int throwflag)
     }
     /* facebook end t39538061 */
 
+    /* Only fresh, non-generator frames count loop back-edges for OSR. Frames
+       resumed after a deopt never re-enter OSR code, so a loop that keeps
+       deopting can't nest interpreter and JIT frames without bound. */
+    unsigned int osr_threshold =
+        (f->f_gen == NULL && f->f_lasti < 0) ? _PyJIT_OSRThreshold() : 0;
+    unsigned int osr_backedges = 0;
+    int osr_failed_header = -1;
+
     int profiling_candidate = 0;
     if (tstate->profile_interp) {
       profiling_candidate = _PyJIT_IsProfilingCandidate(co);
@@ -2303,7 +2324,7 @@ f->lazy_imports_cache_seq = -1;
             }
             if (Py_IsFalse(cond)) {
                 Py_DECREF(cond);
-                JUMPTO(oparg);
+                OSR_JUMPTO(oparg);
                 CHECK_EVAL_BREAKER();
                 DISPATCH();
             }
@@ -2312,7 +2333,7 @@ f->lazy_imports_cache_seq = -1;
             if (err > 0)
                 ;
             else if (err == 0) {
-                JUMPTO(oparg);
+                OSR_JUMPTO(oparg);
                 CHECK_EVAL_BREAKER();
             }
             else
@@ -2330,14 +2351,14 @@ f->lazy_imports_cache_seq = -1;
             }
             if (Py_IsTrue(cond)) {
                 Py_DECREF(cond);
-                JUMPTO(oparg);
+                OSR_JUMPTO(oparg);
                 CHECK_EVAL_BREAKER();
                 DISPATCH();
             }
             err = PyObject_IsTrue(cond);
             Py_DECREF(cond);
             if (err > 0) {
-                JUMPTO(oparg);
+                OSR_JUMPTO(oparg);
                 CHECK_EVAL_BREAKER();
             }
             else if (err == 0)
@@ -2398,7 +2419,7 @@ f->lazy_imports_cache_seq = -1;
 
         case TARGET(JUMP_ABSOLUTE): {
             PREDICTED(JUMP_ABSOLUTE);
-            JUMPTO(oparg);
+            OSR_JUMPTO(oparg);
             CHECK_EVAL_BREAKER();
             DISPATCH();
         }
@@ -4871,6 +4892,47 @@ f->lazy_imports_cache_seq = -1;
            or goto error. */
         Py_UNREACHABLE();
 
+osr_enter:
+        {
+            /* The frame just took osr_threshold loop back-edges. Try to
+               finish running it in an OSR entry compiled for the loop header
+               we jumped to. The entry borrows f's variables and value stack,
+               which f keeps owning until it exits below. */
+            vectorcallfunc osr_entry = NULL;
+            if (f->f_iblock == 0 && !trace_info.cframe.use_tracing) {
+                osr_entry = _PyJIT_CompileOSREntry(
+                    f,
+                    INSTR_OFFSET() * (int)sizeof(_Py_CODEUNIT),
+                    (int)STACK_LEVEL());
+            }
+            if (osr_entry == NULL) {
+                /* Stop counting this loop, but try again from the next hot
+                   back-edge to a different header, e.g. an outer loop. */
+                osr_failed_header = INSTR_OFFSET();
+                CHECK_EVAL_BREAKER();
+                DISPATCH();
+            }
+
+            /* The JIT links its own frame in place of f. */
+            _PyShadowFrame_Pop(tstate, &shadow_frame);
+            tstate->frame = f->f_back;
+            retval = osr_entry(
+                NULL,
+                f->f_localsplus,
+                stack_pointer - f->f_localsplus,
+                NULL);
+            tstate->frame = f;
+            _PyShadowFrame_PushInterp(tstate, &shadow_frame, f);
+
+            while (!EMPTY()) {
+                PyObject *o = POP();
+                Py_XDECREF(o);
+            }
+            f->f_stackdepth = 0;
+            f->f_state = retval != NULL ? FRAME_RETURNED : FRAME_RAISED;
+            goto exiting;
+        }
+
 error:
         /* Double-check exception status. */
 #ifdef NDEBUG
@@ -5231,7 +5293,7 @@ Ci_StaticFunction_Vectorcall(PyObject *func, PyObject* const* stack,
     }
 }
 
-static void
+void
 PyEntry_initnow(PyFunctionObject *func)
 {
     // Check that func hasn't already been initialized.
@@ -5276,6 +5338,17 @@ static unsigned int count_calls(PyCodeObject* code) {
   return ncalls;
 }
 
+// Entry point for a function waiting in the compile queue. Runs it in the
+// interpreter without counting the call or trying to queue it again; the
+// compile queue replaces it once the function has been compiled or dropped.
+PyObject*
+PyEntry_AutoJITPending(PyFunctionObject *func,
+                       PyObject **stack,
+                       Py_ssize_t nargsf,
+                       PyObject *kwnames) {
+  return _PyFunction_Vectorcall((PyObject *)func, stack, nargsf, kwnames);
+}
+
 static PyObject*
 PyEntry_AutoJIT(PyFunctionObject *func,
                 PyObject **stack,
@@ -5287,6 +5360,9 @@ PyEntry_AutoJIT(PyFunctionObject *func,
     unsigned hot_threshold = _PyJIT_AutoJITThreshold();
     unsigned jit_threshold = hot_threshold + _PyJIT_AutoJITProfileThreshold();
 
+    // Code that a previous run compiled is compiled on its first call.
+    int warm_start = ncalls == 0 && _PyJIT_IsWarmStartCode(code);
+
     // If the function is found to be hot then register it to be profiled, and
     // enable interpreter profiling if it's not already enabled.
     if (ncalls == hot_threshold && hot_threshold != jit_threshold) {
@@ -5298,7 +5374,7 @@ PyEntry_AutoJIT(PyFunctionObject *func,
       }
     }
 
-    if (ncalls <= jit_threshold) {
+    if (ncalls <= jit_threshold && !warm_start) {
       return _PyFunction_Vectorcall((PyObject *)func, stack, nargsf, kwnames);
     }
 
@@ -5316,7 +5392,18 @@ PyEntry_AutoJIT(PyFunctionObject *func,
       }
     }
 
-    _PyJIT_Result result = _PyJIT_CompileFunction(func);
+    _PyJIT_Result result;
+    if (_PyJIT_IsAsyncCompileEnabled()) {
+      // Keep running in the interpreter until a background worker has
+      // compiled the function and installed its JIT entry point.
+      result = _PyJIT_EnqueueCompile(func);
+      if (result == PYJIT_RESULT_OK) {
+        func->vectorcall = (vectorcallfunc)PyEntry_AutoJITPending;
+        return _PyFunction_Vectorcall((PyObject *)func, stack, nargsf, kwnames);
+      }
+    } else {
+      result = _PyJIT_CompileFunction(func);
+    }
     if (result == PYJIT_RESULT_PYTHON_EXCEPTION) {
         return NULL;
     } else if (result != PYJIT_RESULT_OK) {
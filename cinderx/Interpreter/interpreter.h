@@ -10,6 +10,10 @@ extern "C" {
 CiAPI_FUNC(PyObject *) Ci_GetAIter(PyThreadState *tstate, PyObject *obj);
 CiAPI_FUNC(PyObject *) Ci_GetANext(PyThreadState *tstate, PyObject *aiter);
 CiAPI_FUNC(void) PyEntry_init(PyFunctionObject *func);
+// Switch a function whose vectorcall is PyEntry_LazyInit to the interpreter.
+CiAPI_FUNC(void) PyEntry_initnow(PyFunctionObject *func);
+// Entry point of a function waiting to be compiled in the background.
+CiAPI_FUNC(PyObject *) PyEntry_AutoJITPending(PyFunctionObject *func, PyObject **stack, Py_ssize_t nargsf, PyObject *kwnames);
 CiAPI_FUNC(PyObject*) _Py_HOT_FUNCTION Ci_EvalFrame(PyThreadState *tstate, PyFrameObject *f, int throwflag);
 
 #ifdef __cplusplus
@@ -3,11 +3,13 @@
 #include "cinderx/Jit/code_allocator.h"
 
 #include "cinderx/Jit/config.h"
-#include "cinderx/Jit/threaded_compile.h"
 
 #include <sys/mman.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
+#include <iterator>
 
 namespace jit {
 
@@ -19,6 +21,14 @@ namespace {
 // 2MiB to match Linux's huge-page size.
 constexpr size_t kAllocSize = 1024 * 1024 * 2;
 
+// Free blocks smaller than this are counted as lost rather than kept for
+// reuse.
+constexpr size_t kMinFreeBlockSize = 64;
+
+// Alignment of the start of each function with code placement enabled, so
+// that aligning loop heads inside it lines them up with cache lines.
+constexpr size_t kPlacementAlignment = 64;
+
 // Allocate memory for JIT'd code.
 uint8_t* allocPages(size_t size) {
   void* res = mmap(
@@ -50,9 +60,19 @@ CodeAllocator* CodeAllocator::s_global_code_allocator_ = nullptr;
 
 CodeAllocator::~CodeAllocator() {}
 
+void CodeAllocator::releaseCode(void* code, size_t) noexcept {
+  runtime_->release(code);
+}
+
 void CodeAllocator::makeGlobalCodeAllocator() {
   JIT_CHECK(
       s_global_code_allocator_ == nullptr, "Global allocator already set");
+  if (getConfig().seal_code_before_fork &&
+      (getConfig().multiple_code_sections || !getConfig().use_huge_pages)) {
+    JIT_LOG(
+        "Warning: code is only sealed before fork() when huge pages are "
+        "enabled and multiple code sections are disabled");
+  }
   if (getConfig().multiple_code_sections) {
     s_global_code_allocator_ = new MultipleSectionCodeAllocator;
   } else if (getConfig().use_huge_pages) {
@@ -69,38 +89,54 @@ void CodeAllocator::freeGlobalCodeAllocator() {
 }
 
 CodeAllocatorCinder::~CodeAllocatorCinder() {
-  for (void* alloc : allocations_) {
-    JIT_CHECK(munmap(alloc, kAllocSize) == 0, "Freeing code memory failed");
+  for (const Chunk& chunk : allocations_) {
+    JIT_CHECK(
+        munmap(chunk.base, chunk.size) == 0, "Freeing code memory failed");
+  }
+}
+
+void CodeAllocatorCinder::seal() {
+  std::lock_guard<std::mutex> lock{mutex_};
+
+  // Start the next function on a new chunk, since writing it into the rest of
+  // the current one would copy the page it starts on.
+  lost_bytes_ += current_alloc_free_;
+  current_alloc_free_ = 0;
+
+  for (; num_sealed_ < allocations_.size(); num_sealed_++) {
+    const Chunk& chunk = allocations_[num_sealed_];
+    JIT_CHECK(
+        mprotect(chunk.base, chunk.size, PROT_EXEC | PROT_READ) == 0,
+        "Failed to seal code memory at {}",
+        chunk.base);
+    sealed_bytes_ += chunk.size;
   }
 }
 
 asmjit::Error CodeAllocatorCinder::addCode(
     void** dst,
-    asmjit::CodeHolder* code) noexcept {
-  ThreadedCompileSerialize guard;
-
+    asmjit::CodeHolder* code,
+    const void* near) noexcept {
   *dst = nullptr;
 
   ASMJIT_PROPAGATE(code->flatten());
   ASMJIT_PROPAGATE(code->resolveUnresolvedLinks());
 
   size_t max_code_size = code->codeSize();
-  size_t alloc_size = ((max_code_size / kAllocSize) + 1) * kAllocSize;
-  if (current_alloc_free_ < max_code_size) {
-    lost_bytes_ += current_alloc_free_;
-
-    uint8_t* res = allocPages(alloc_size);
-    if (!setHugePages(res, alloc_size)) {
-      fragmented_allocs_++;
-    } else {
-      huge_allocs_++;
-    }
-    current_alloc_ = static_cast<uint8_t*>(res);
-    allocations_.emplace_back(res);
-    current_alloc_free_ = alloc_size;
+  uint8_t* dst_alloc;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    dst_alloc = reserve(max_code_size, near);
   }
 
-  ASMJIT_PROPAGATE(code->relocateToBase(uintptr_t(current_alloc_)));
+  // Nothing else can touch the reserved memory, so relocate and copy the code
+  // into it without holding the lock.
+  asmjit::Error err = code->relocateToBase(uintptr_t(dst_alloc));
+  if (err != asmjit::kErrorOk) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    unreserve(dst_alloc, max_code_size);
+    return err;
+  }
 
   size_t actual_code_size = code->codeSize();
   JIT_CHECK(actual_code_size <= max_code_size, "Code grew during relocation");
@@ -112,25 +148,213 @@ asmjit::Error CodeAllocatorCinder::addCode(
 
     JIT_CHECK(
         offset + buffer_size <= actual_code_size, "Inconsistent code size");
-    std::memcpy(current_alloc_ + offset, section->data(), buffer_size);
+    std::memcpy(dst_alloc + offset, section->data(), buffer_size);
 
     if (virtual_size > buffer_size) {
       JIT_CHECK(
           offset + virtual_size <= actual_code_size, "Inconsistent code size");
       std::memset(
-          current_alloc_ + offset + buffer_size, 0, virtual_size - buffer_size);
+          dst_alloc + offset + buffer_size, 0, virtual_size - buffer_size);
     }
   }
 
-  *dst = current_alloc_;
-
-  current_alloc_ += actual_code_size;
-  current_alloc_free_ -= actual_code_size;
-  used_bytes_ += actual_code_size;
+  if (actual_code_size < max_code_size) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    unreserve(
+        dst_alloc + actual_code_size, max_code_size - actual_code_size);
+  }
 
+  *dst = dst_alloc;
   return asmjit::kErrorOk;
 }
 
+uint8_t* CodeAllocatorCinder::reserve(size_t size, const void* near) {
+  bool placement = getConfig().code_placement;
+  // Leave room to align the start of the code.
+  size_t align = placement ? kPlacementAlignment : 1;
+  size_t needed = size + align - 1;
+
+  uint8_t* block = nullptr;
+  size_t free_block_size = 0;
+  bool near_current = placement && near != nullptr && inCurrentChunk(near);
+  if (placement && near != nullptr && !near_current) {
+    block = takeFreeBlockNear(near, needed, &free_block_size);
+  }
+  // Code that should be near the current chunk goes at its end if it fits.
+  if (block == nullptr && !(near_current && current_alloc_free_ >= needed)) {
+    block = takeFreeBlock(needed, &free_block_size);
+  }
+  if (block == nullptr) {
+    size_t alloc_size = ((needed / kAllocSize) + 1) * kAllocSize;
+    if (current_alloc_free_ < needed) {
+      // With placement, keep the rest of the chunk for code that wants to be
+      // near the code already in it.
+      if (placement) {
+        addFreeBlock(current_alloc_, current_alloc_free_);
+      } else {
+        lost_bytes_ += current_alloc_free_;
+      }
+
+      uint8_t* res = allocPages(alloc_size);
+      if (!setHugePages(res, alloc_size)) {
+        fragmented_allocs_++;
+      } else {
+        huge_allocs_++;
+      }
+      current_alloc_ = static_cast<uint8_t*>(res);
+      allocations_.push_back(Chunk{res, alloc_size});
+      current_alloc_free_ = alloc_size;
+    }
+    block = current_alloc_;
+  } else {
+    // The block may be on a page that was sealed before a fork().
+    makeCodeWritable(block, needed);
+  }
+  auto dst_alloc = reinterpret_cast<uint8_t*>(
+      asmjit::Support::alignUp(reinterpret_cast<uintptr_t>(block), align));
+  lost_bytes_ += dst_alloc - block;
+
+  size_t used_size = (dst_alloc - block) + size;
+  if (free_block_size > 0) {
+    addFreeBlock(block + used_size, free_block_size - used_size);
+  } else {
+    current_alloc_ += used_size;
+    current_alloc_free_ -= used_size;
+  }
+  used_bytes_ += size;
+  return dst_alloc;
+}
+
+void CodeAllocatorCinder::unreserve(uint8_t* start, size_t size) {
+  used_bytes_ -= size;
+  if (start + size == current_alloc_) {
+    current_alloc_ = start;
+    current_alloc_free_ += size;
+  } else {
+    addFreeBlock(start, size);
+  }
+}
+
+void CodeAllocatorCinder::releaseCode(void* code, size_t size) noexcept {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto block = static_cast<uint8_t*>(code);
+  // Fill the block with int3 so anything that still jumps into it traps
+  // instead of running whatever is put there next.
+  makeCodeWritable(block, size);
+  std::memset(block, 0xcc, size);
+  used_bytes_ -= size;
+  reclaimed_bytes_ += size;
+
+  auto next = free_blocks_.lower_bound(block);
+  if (next != free_blocks_.end() && block + size == next->first) {
+    size += next->second;
+    next = std::next(next);
+    removeFreeBlock(std::prev(next));
+  }
+  if (next != free_blocks_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == block) {
+      block = prev->first;
+      size += prev->second;
+      removeFreeBlock(prev);
+    }
+  }
+  addFreeBlock(block, size);
+}
+
+uint8_t* CodeAllocatorCinder::takeFreeBlock(size_t size, size_t* block_size) {
+  auto it = free_blocks_by_size_.lower_bound(size);
+  if (it == free_blocks_by_size_.end()) {
+    return nullptr;
+  }
+  uint8_t* block = it->second;
+  *block_size = it->first;
+  removeFreeBlock(free_blocks_.find(block));
+  return block;
+}
+
+uint8_t* CodeAllocatorCinder::takeFreeBlockNear(
+    const void* near,
+    size_t size,
+    size_t* block_size) {
+  auto addr = static_cast<const uint8_t*>(near);
+  auto chunk = std::find_if(
+      allocations_.begin(), allocations_.end(), [&](const Chunk& c) {
+        auto base = static_cast<const uint8_t*>(c.base);
+        return addr >= base && addr < base + c.size;
+      });
+  if (chunk == allocations_.end()) {
+    return nullptr;
+  }
+  auto chunk_base = static_cast<uint8_t*>(chunk->base);
+  auto best = free_blocks_.end();
+  for (auto it = free_blocks_.lower_bound(chunk_base);
+       it != free_blocks_.end() && it->first < chunk_base + chunk->size;
+       ++it) {
+    if (it->second >= size &&
+        (best == free_blocks_.end() || it->second < best->second)) {
+      best = it;
+    }
+  }
+  if (best == free_blocks_.end()) {
+    return nullptr;
+  }
+  uint8_t* block = best->first;
+  *block_size = best->second;
+  removeFreeBlock(best);
+  return block;
+}
+
+bool CodeAllocatorCinder::inCurrentChunk(const void* addr) const {
+  if (allocations_.empty()) {
+    return false;
+  }
+  auto p = static_cast<const uint8_t*>(addr);
+  auto base = static_cast<const uint8_t*>(allocations_.back().base);
+  return p >= base && p < base + allocations_.back().size;
+}
+
+void CodeAllocatorCinder::addFreeBlock(uint8_t* block, size_t size) {
+  // Slivers too small for any function aren't worth tracking.
+  if (size < kMinFreeBlockSize) {
+    lost_bytes_ += size;
+    return;
+  }
+  free_blocks_.emplace(block, size);
+  free_blocks_by_size_.emplace(size, block);
+  free_bytes_ += size;
+}
+
+void CodeAllocatorCinder::removeFreeBlock(
+    std::map<uint8_t*, size_t>::iterator it) {
+  auto [begin, end] = free_blocks_by_size_.equal_range(it->second);
+  for (auto by_size = begin; by_size != end; ++by_size) {
+    if (by_size->second == it->first) {
+      free_blocks_by_size_.erase(by_size);
+      break;
+    }
+  }
+  free_bytes_ -= it->second;
+  free_blocks_.erase(it);
+}
+
+void makeCodeWritable(void* addr, size_t size) {
+  if (!getConfig().seal_code_before_fork) {
+    return;
+  }
+  auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  auto start = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t page_start = start & ~(page_size - 1);
+  uintptr_t page_end = (start + size + page_size - 1) & ~(page_size - 1);
+  JIT_CHECK(
+      mprotect(
+          reinterpret_cast<void*>(page_start),
+          page_end - page_start,
+          PROT_EXEC | PROT_READ | PROT_WRITE) == 0,
+      "Failed to make code at {} writable",
+      addr);
+}
+
 MultipleSectionCodeAllocator::~MultipleSectionCodeAllocator() {
   if (code_alloc_ == nullptr) {
     return;
@@ -140,6 +364,17 @@ MultipleSectionCodeAllocator::~MultipleSectionCodeAllocator() {
       "Freeing code sections failed");
 }
 
+void MultipleSectionCodeAllocator::releaseCode(
+    void* code,
+    size_t size) noexcept {
+  auto addr = static_cast<uint8_t*>(code);
+  if (addr >= code_alloc_ && addr < code_alloc_ + total_allocation_size_) {
+    JIT_DLOG("Leaking {} bytes of code at {}", size, code);
+    return;
+  }
+  runtime_->release(code);
+}
+
 /*
  * At startup, we allocate a contiguous chunk of memory for all code sections
  * equal to the sum of individual section sizes and subdivide internally. The
@@ -174,8 +409,9 @@ void MultipleSectionCodeAllocator::createSlabs() noexcept {
 
 asmjit::Error MultipleSectionCodeAllocator::addCode(
     void** dst,
-    asmjit::CodeHolder* code) noexcept {
-  ThreadedCompileSerialize guard;
+    asmjit::CodeHolder* code,
+    const void* /* near */) noexcept {
+  std::lock_guard<std::mutex> lock{mutex_};
 
   if (code_sections_.empty()) {
     createSlabs();
@@ -193,6 +429,20 @@ asmjit::Error MultipleSectionCodeAllocator::addCode(
         "normal allocation.");
     return runtime_->add(dst, code);
   }
+  if (getConfig().code_placement) {
+    // Start the hot part of the function on a cache line, so that loop heads
+    // aligned inside it are aligned in memory too. The hot section is a
+    // single bump-allocated region, so near isn't used here.
+    uint8_t*& hot = code_sections_[CodeSection::kHot];
+    size_t& hot_free = code_section_free_sizes_[CodeSection::kHot];
+    auto aligned = reinterpret_cast<uint8_t*>(asmjit::Support::alignUp(
+        reinterpret_cast<uintptr_t>(hot), kPlacementAlignment));
+    size_t padding = aligned - hot;
+    if (hot_free >= potential_code_size + padding) {
+      hot = aligned;
+      hot_free -= padding;
+    }
+  }
   // Fix up the offsets for each code section before resolving links.
   // Both the `.text` and `.addrtab` sections are written to the hot section,
   // and we need to resolve offsets between them properly.
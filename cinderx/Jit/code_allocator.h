@@ -8,7 +8,9 @@
 
 #include "cinderx/ThirdParty/asmjit/src/asmjit/asmjit.h"
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace jit {
@@ -46,10 +48,30 @@ class CodeAllocator {
     return runtime_->environment();
   }
 
-  virtual asmjit::Error addCode(void** dst, asmjit::CodeHolder* code) noexcept {
+  asmjit::Error addCode(void** dst, asmjit::CodeHolder* code) noexcept {
+    return addCode(dst, code, nullptr);
+  }
+
+  // Add code, preferring to place it close to the existing code at near, if
+  // that's not nullptr, so that code which calls each other shares pages.
+  virtual asmjit::Error addCode(
+      void** dst,
+      asmjit::CodeHolder* code,
+      const void* /* near */) noexcept {
     return runtime_->add(dst, code);
   }
 
+  // Make all code allocated so far read-only and allocate later code on
+  // different pages. After a fork() the child then never writes to the pages
+  // holding the parent's code, so they stay shared copy-on-write. Allocators
+  // that can't promise this do nothing.
+  virtual void seal() {}
+
+  // Free code returned by addCode(), given the address it was placed at and
+  // its size. The caller must make sure nothing can run or jump into the code
+  // any more.
+  virtual void releaseCode(void* code, size_t size) noexcept;
+
  protected:
   std::unique_ptr<asmjit::JitRuntime> runtime_{
       std::make_unique<asmjit::JitRuntime>()};
@@ -63,7 +85,11 @@ class CodeAllocatorCinder : public CodeAllocator {
  public:
   virtual ~CodeAllocatorCinder();
 
-  asmjit::Error addCode(void** dst, asmjit::CodeHolder* code) noexcept override;
+  using CodeAllocator::addCode;
+  asmjit::Error addCode(
+      void** dst,
+      asmjit::CodeHolder* code,
+      const void* near) noexcept override;
 
   size_t usedBytes() const {
     return used_bytes_;
@@ -81,9 +107,72 @@ class CodeAllocatorCinder : public CodeAllocator {
     return huge_allocs_;
   }
 
+  size_t sealedBytes() const {
+    return sealed_bytes_;
+  }
+
+  // Total size of the free blocks that freed code has left behind, the number
+  // of those blocks, and the size of the largest one. Free blocks are reused by
+  // later code that fits in them.
+  size_t freeBytes() const {
+    return free_bytes_;
+  }
+
+  size_t freeBlocks() const {
+    return free_blocks_.size();
+  }
+
+  size_t largestFreeBlock() const {
+    return free_blocks_by_size_.empty() ? 0
+                                        : free_blocks_by_size_.rbegin()->first;
+  }
+
+  size_t reclaimedBytes() const {
+    return reclaimed_bytes_;
+  }
+
+  void seal() override;
+
+  void releaseCode(void* code, size_t size) noexcept override;
+
  private:
+  // Reserve memory for size bytes of code, aligned for code placement if it's
+  // enabled and preferably near the given address. Must be called with
+  // mutex_ held.
+  uint8_t* reserve(size_t size, const void* near);
+  // Give back memory that was reserved but not used. Must be called with
+  // mutex_ held.
+  void unreserve(uint8_t* start, size_t size);
+
+  // Guards all of the state below. Code is copied into the memory reserved
+  // for it without holding the lock, so batch compile workers can install
+  // code concurrently.
+  std::mutex mutex_;
+
+  struct Chunk {
+    void* base;
+    size_t size;
+  };
+
   // List of chunks allocated for use in deallocation
-  std::vector<void*> allocations_;
+  std::vector<Chunk> allocations_;
+  // Number of chunks at the front of allocations_ that have been sealed.
+  size_t num_sealed_{0};
+
+  // Take the smallest free block that can hold size bytes, or return nullptr
+  // if there isn't one.
+  uint8_t* takeFreeBlock(size_t size, size_t* block_size);
+  // Like takeFreeBlock(), but only consider blocks in the chunk containing
+  // near.
+  uint8_t* takeFreeBlockNear(const void* near, size_t size, size_t* block_size);
+  void addFreeBlock(uint8_t* block, size_t size);
+  void removeFreeBlock(std::map<uint8_t*, size_t>::iterator it);
+  bool inCurrentChunk(const void* addr) const;
+
+  // Memory released by releaseCode(), indexed by address for coalescing with
+  // neighbours and by size for best-fit allocation.
+  std::map<uint8_t*, size_t> free_blocks_;
+  std::multimap<size_t, uint8_t*> free_blocks_by_size_;
 
   // Pointer to next free address in the current chunk
   uint8_t* current_alloc_{nullptr};
@@ -98,17 +187,32 @@ class CodeAllocatorCinder : public CodeAllocator {
   size_t huge_allocs_{0};
   // Number of chunks allocated which did not use huge pages.
   size_t fragmented_allocs_{0};
+  // Number of bytes in sealed chunks, including any space left unused in
+  // them when they were sealed.
+  size_t sealed_bytes_{0};
+  size_t free_bytes_{0};
+  // Number of bytes of code released over the allocator's lifetime.
+  size_t reclaimed_bytes_{0};
 };
 
 class MultipleSectionCodeAllocator : public CodeAllocator {
  public:
   virtual ~MultipleSectionCodeAllocator();
 
-  asmjit::Error addCode(void** dst, asmjit::CodeHolder* code) noexcept override;
+  using CodeAllocator::addCode;
+  asmjit::Error addCode(
+      void** dst,
+      asmjit::CodeHolder* code,
+      const void* near) noexcept override;
+
+  // Code split across the hot and cold sections can't be freed, so this only
+  // frees code that didn't fit in them.
+  void releaseCode(void* code, size_t size) noexcept override;
 
  private:
   void createSlabs() noexcept;
 
+  std::mutex mutex_;
   std::unordered_map<codegen::CodeSection, uint8_t*> code_sections_;
   std::unordered_map<codegen::CodeSection, size_t> code_section_free_sizes_;
 
@@ -116,6 +220,10 @@ class MultipleSectionCodeAllocator : public CodeAllocator {
   size_t total_allocation_size_{0};
 };
 
+// Make [addr, addr + size) writable so code in it can be patched, in case it
+// was sealed by CodeAllocator::seal().
+void makeCodeWritable(void* addr, size_t size);
+
 void populateCodeSections(
     std::vector<std::pair<void*, std::size_t>>& output_vector,
     asmjit::CodeHolder& code,
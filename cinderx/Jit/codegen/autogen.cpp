@@ -8,10 +8,12 @@
 #include "cinderx/Jit/codegen/x86_64.h"
 #include "cinderx/Jit/deopt_patcher.h"
 #include "cinderx/Jit/frame.h"
+#include "cinderx/Jit/lir/block.h"
 #include "cinderx/Jit/lir/instruction.h"
 
 #include "cinderx/ThirdParty/asmjit/src/asmjit/x86/x86operand.h"
 
+#include <algorithm>
 #include <type_traits>
 #include <vector>
 
@@ -164,8 +166,6 @@ void fillLiveValueLocations(
     const Instruction* instr,
     size_t begin_input,
     size_t end_input) {
-  ThreadedCompileSerialize guard;
-
   DeoptMetadata& deopt_meta = runtime->getDeoptMetadata(deopt_idx);
   for (size_t i = begin_input; i < end_input; i++) {
     auto loc = instr->getInput(i)->getPhyRegOrStackSlot();
@@ -173,6 +173,22 @@ void fillLiveValueLocations(
   }
 }
 
+// A kNoOverflow guard reads the overflow flag left behind by the arithmetic it
+// checks, so only moves (which don't touch flags) may sit between the two.
+bool followsCheckedArithmetic(const Instruction* guard) {
+  auto& instrs = guard->basicblock()->instructions();
+  auto it = std::find_if(instrs.rbegin(), instrs.rend(), [&](auto& i) {
+    return i.get() == guard;
+  });
+  for (++it; it != instrs.rend(); ++it) {
+    const Instruction* prev = it->get();
+    if (!prev->isMove()) {
+      return prev->isAdd() || prev->isSub() || prev->isMul();
+    }
+  }
+  return false;
+}
+
 // Translate GUARD instruction
 void TranslateGuard(Environ* env, const Instruction* instr) {
   auto as = env->as;
@@ -232,6 +248,12 @@ void TranslateGuard(Environ* env, const Instruction* instr) {
         as->jnz(deopt_label);
         break;
       }
+      case kNoOverflow:
+        JIT_DCHECK(
+            followsCheckedArithmetic(instr),
+            "Overflow guard must directly follow its arithmetic");
+        as->jo(deopt_label);
+        break;
       case kAlwaysFail:
         as->jmp(deopt_label);
         break;
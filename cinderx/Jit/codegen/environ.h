@@ -74,13 +74,10 @@ struct Environ {
   // Location of incoming arguments
   std::vector<PhyLocation> arg_locations;
 
-  struct IndirectInfo {
-    IndirectInfo(void** indirect_ptr) : indirect(indirect_ptr) {}
-
-    void** indirect;
-    asmjit::Label trampoline{0};
-  };
-  UnorderedMap<PyFunctionObject*, IndirectInfo> function_indirections;
+  // Shared entry point for static calls to functions that haven't been
+  // compiled yet. Function entry caches point here until the function is
+  // compiled.
+  void* failed_deferred_compile_trampoline{nullptr};
 
   UnorderedMap<PyFunctionObject*, std::unique_ptr<_PyTypedArgsInfo>>
       function_typed_args;
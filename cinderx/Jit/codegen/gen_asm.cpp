@@ -15,6 +15,7 @@
 #include "cinderx/Jit/codegen/autogen.h"
 #include "cinderx/Jit/codegen/code_section.h"
 #include "cinderx/Jit/codegen/gen_asm_utils.h"
+#include "cinderx/Jit/compile_stats.h"
 #include "cinderx/Jit/config.h"
 #include "cinderx/Jit/frame.h"
 #include "cinderx/Jit/hir/analysis.h"
@@ -50,6 +51,23 @@ namespace jit::codegen {
 
 namespace {
 
+// Loop heads in hot code are aligned to a cache line when code placement is
+// enabled.
+constexpr uint32_t kLoopHeadAlignment = 64;
+
+// Total size of the blocks an asmjit Zone has allocated.
+std::size_t zoneBytes(const asmjit::Zone& zone) {
+  std::size_t bytes = 0;
+  for (auto block = zone._block; block != nullptr && block->size != 0;
+       block = block->prev) {
+    bytes += block->size;
+  }
+  for (auto block = zone._block->next; block != nullptr; block = block->next) {
+    bytes += block->size;
+  }
+  return bytes;
+}
+
 namespace shadow_frame {
 // Shadow stack frames appear at the beginning of native frames for jitted
 // functions
@@ -279,6 +297,7 @@ void* NativeGenerator::getVectorcallEntry() {
   auto func = GetFunction();
 
   env_.rt = Runtime::get();
+  env_.failed_deferred_compile_trampoline = failed_deferred_compile_trampoline_;
   PyCodeObject* code_obj = func->code;
   env_.code_rt = env_.rt->allocateCodeRuntime(
       code_obj, func->builtins, func->globals, func->frameMode);
@@ -290,10 +309,13 @@ void* NativeGenerator::getVectorcallEntry() {
   jit::lir::LIRGenerator lirgen(GetFunction(), &env_);
   std::unique_ptr<jit::lir::Function> lir_func;
 
-  COMPILE_TIMER(
-      GetFunction()->compilation_phase_timer,
-      "Lowering into LIR",
-      lir_func = lirgen.TranslateFunction())
+  {
+    CompilePhaseStopwatch stopwatch{kPhaseLIRGeneration};
+    COMPILE_TIMER(
+        GetFunction()->compilation_phase_timer,
+        "Lowering into LIR",
+        lir_func = lirgen.TranslateFunction())
+  }
 
   if (!g_dump_hir_passes_json.empty()) {
     lir::JSONPrinter lir_printer;
@@ -307,10 +329,13 @@ void* NativeGenerator::getVectorcallEntry() {
       *lir_func);
 
   PostGenerationRewrite post_gen(lir_func.get(), &env_);
-  COMPILE_TIMER(
-      GetFunction()->compilation_phase_timer,
-      "LIR transformations",
-      post_gen.run())
+  {
+    CompilePhaseStopwatch stopwatch{kPhaseLIRRewrites};
+    COMPILE_TIMER(
+        GetFunction()->compilation_phase_timer,
+        "LIR transformations",
+        post_gen.run())
+  }
 
   JIT_LOGIF(
       g_dump_lir,
@@ -318,18 +343,32 @@ void* NativeGenerator::getVectorcallEntry() {
       GetFunction()->fullname,
       *lir_func);
 
-  COMPILE_TIMER(
-      GetFunction()->compilation_phase_timer,
-      "DeadCodeElimination",
-      eliminateDeadCode(lir_func.get()))
+  {
+    CompilePhaseStopwatch stopwatch{kPhaseLIRRewrites};
+    COMPILE_TIMER(
+        GetFunction()->compilation_phase_timer,
+        "DeadCodeElimination",
+        eliminateDeadCode(lir_func.get()))
+  }
 
+  // Code that has been tiered up has proven itself hot, so it's worth the
+  // extra allocation work.
+  RegallocOptions regalloc_options;
+  regalloc_options.spill_costs = getConfig().regalloc_spill_costs;
+  regalloc_options.split_outside_loops =
+      getConfig().regalloc_split_outside_loops ||
+      (getConfig().tier2_threshold > 0 && !GetFunction()->baseline_tier);
   LinearScanAllocator lsalloc(
       lir_func.get(),
-      frame_header_size_ + max_inline_depth_ * kJITShadowFrameSize);
-  COMPILE_TIMER(
-      GetFunction()->compilation_phase_timer,
-      "Register Allocation",
-      lsalloc.run())
+      frame_header_size_ + max_inline_depth_ * kJITShadowFrameSize,
+      regalloc_options);
+  {
+    CompilePhaseStopwatch stopwatch{kPhaseRegisterAllocation};
+    COMPILE_TIMER(
+        GetFunction()->compilation_phase_timer,
+        "Register Allocation",
+        lsalloc.run())
+  }
 
   if (!g_dump_hir_passes_json.empty()) {
     lir::JSONPrinter lir_printer;
@@ -353,10 +392,13 @@ void* NativeGenerator::getVectorcallEntry() {
       *lir_func);
 
   PostRegAllocRewrite post_rewrite(lir_func.get(), &env_);
-  COMPILE_TIMER(
-      GetFunction()->compilation_phase_timer,
-      "Post Reg Alloc Rewrite",
-      post_rewrite.run())
+  {
+    CompilePhaseStopwatch stopwatch{kPhaseLIRRewrites};
+    COMPILE_TIMER(
+        GetFunction()->compilation_phase_timer,
+        "Post Reg Alloc Rewrite",
+        post_rewrite.run())
+  }
 
   JIT_LOGIF(
       g_dump_lir,
@@ -374,6 +416,7 @@ void* NativeGenerator::getVectorcallEntry() {
   lir_func_ = std::move(lir_func);
 
   try {
+    CompilePhaseStopwatch stopwatch{kPhaseCodeGeneration};
     COMPILE_TIMER(
         GetFunction()->compilation_phase_timer,
         "Code Generation",
@@ -397,6 +440,10 @@ void* NativeGenerator::getVectorcallEntry() {
    * JitRuntime::_add and may break in the future.
    */
 
+  recordCompileArenaBytes(
+      zoneBytes(as_->_codeZone) + zoneBytes(as_->_dataZone) +
+      zoneBytes(as_->_passZone) + zoneBytes(code._zone));
+
   JIT_DCHECK(code.codeSize() < INT_MAX, "Code size is larger than INT_MAX");
   compiled_size_ = static_cast<int>(code.codeSize());
   env_.code_rt->set_frame_size(env_.stack_frame_size);
@@ -768,7 +815,9 @@ void NativeGenerator::generatePrologue(
     }
   }
 
-  if (!func_->has_primitive_args) {
+  // OSR entries are only called by the interpreter, which always passes the
+  // exact frame layout and no kwnames.
+  if (!func_->has_primitive_args && !func_->osr_entry.has_value()) {
     as_->test(x86::rcx, x86::rcx); // test for kwargs
     if (!((code->co_flags & (CO_VARARGS | CO_VARKEYWORDS)) ||
           code->co_kwonlyargcount)) {
@@ -1071,17 +1120,6 @@ void NativeGenerator::generateEpilogue(BaseNode* epilogue_cursor) {
       "Epilogue (restore regs; pop native frame; error exit)",
       epilogue_error_cursor);
   env_.addAnnotation("Epilogue", epilogue_cursor);
-  if (env_.function_indirections.size()) {
-    auto jit_helpers = as_->cursor();
-    for (auto& x : env_.function_indirections) {
-      Label trampoline = as_->newLabel();
-      as_->bind(trampoline);
-      as_->mov(x86::r10, reinterpret_cast<uint64_t>(x.first));
-      as_->jmp(reinterpret_cast<uint64_t>(failed_deferred_compile_trampoline_));
-      x.second.trampoline = trampoline;
-    }
-    env_.addAnnotation("JitHelpers", jit_helpers);
-  }
 }
 
 void NativeGenerator::generateDeoptExits(const asmjit::CodeHolder& code) {
@@ -1097,15 +1135,43 @@ void NativeGenerator::generateDeoptExits(const asmjit::CodeHolder& code) {
 
   auto deopt_cursor = as_->cursor();
   auto deopt_exit = as_->newLabel();
+  // Exits whose deopts are identical can share their metadata, which
+  // consecutive guards bound to the same Snapshot usually do even though
+  // they're lowered from different HIR instructions. Yield points keep their
+  // own metadata, since suspended generators refer to it by index.
+  UnorderedSet<std::size_t> yield_indices = yieldPointDeoptIndices();
+  std::unordered_multimap<std::size_t, std::size_t> interned;
+  UnorderedMap<std::size_t, std::size_t> interned_indices;
+  for (auto& exit : deopt_exits) {
+    std::size_t& index = exit.deopt_meta_index;
+    if (yield_indices.count(index)) {
+      continue;
+    }
+    auto it = interned_indices.find(index);
+    if (it == interned_indices.end()) {
+      std::size_t interned_index =
+          env_.rt->internDeoptMetadata(index, interned);
+      it = interned_indices.emplace(index, interned_index).first;
+    }
+    index = it->second;
+  }
   std::sort(deopt_exits.begin(), deopt_exits.end(), [](auto& a, auto& b) {
     return a.deopt_meta_index < b.deopt_meta_index;
   });
-  // Generate stage 1 trampolines (one per guard). These push the index of the
-  // appropriate `DeoptMetadata` and then jump to the stage 2 trampoline.
-  for (const auto& exit : deopt_exits) {
-    as_->bind(exit.label);
-    as_->push(exit.deopt_meta_index);
-    emitCall(env_, deopt_exit, exit.instr);
+  // Generate stage 1 trampolines (one per DeoptMetadata). These push the index
+  // of the appropriate `DeoptMetadata` and then jump to the stage 2
+  // trampoline.
+  for (auto it = deopt_exits.begin(); it != deopt_exits.end();) {
+    auto group_end = std::find_if(it, deopt_exits.end(), [&](auto& exit) {
+      return exit.deopt_meta_index != it->deopt_meta_index;
+    });
+    for (auto exit = it; exit != group_end; ++exit) {
+      as_->bind(exit->label);
+    }
+    as_->push(it->deopt_meta_index);
+    emitCall(env_, deopt_exit, it->instr);
+    num_deopt_exit_stubs_++;
+    it = group_end;
   }
   // Generate the stage 2 trampoline (one per function). This saves the address
   // of the final part of the JIT-epilogue that is responsible for restoring
@@ -1155,6 +1221,32 @@ void NativeGenerator::generateDeoptExits(const asmjit::CodeHolder& code) {
   env_.addAnnotation("Deoptimization exits", deopt_cursor);
 }
 
+UnorderedSet<std::size_t> NativeGenerator::yieldPointDeoptIndices() const {
+  UnorderedSet<std::size_t> indices;
+  for (const auto& [yield_point, label] : env_.unresolved_gen_entry_labels) {
+    indices.insert(yield_point->deoptIdx());
+  }
+  return indices;
+}
+
+void NativeGenerator::packDeoptMetadata() {
+  // Metadata for yield points is read whenever a suspended generator is
+  // traversed by the GC, so it's left unpacked.
+  UnorderedSet<std::size_t> yield_indices = yieldPointDeoptIndices();
+  UnorderedSet<std::size_t> packed_indices;
+  std::size_t packed = 0;
+  std::size_t unpacked = 0;
+  for (const auto& exit : env_.deopt_exits) {
+    std::size_t index = exit.deopt_meta_index;
+    if (yield_indices.count(index) || !packed_indices.insert(index).second) {
+      continue;
+    }
+    unpacked += env_.rt->getDeoptMetadata(index).memoryUsage();
+    packed += env_.rt->packDeoptMetadata(index);
+  }
+  env_.code_rt->setDeoptMetadataBytes(packed, unpacked);
+}
+
 void NativeGenerator::linkDeoptPatchers(const asmjit::CodeHolder& code) {
   JIT_CHECK(code.hasBaseAddress(), "code not generated!");
   uint64_t base = code.baseAddress();
@@ -1219,6 +1311,13 @@ void NativeGenerator::generateResumeEntry() {
   env_.addAnnotation("Resume entry point", cursor);
 }
 
+// Static Python code calls JIT-compiled static functions and methods through
+// the static entry point (InvokeStaticFunction and InvokeMethodStatic). The
+// function object, or for a vtable call the entry's state, comes first and
+// the arguments follow in the native calling convention, so primitives stay
+// unboxed and doubles are passed in xmm registers. Arguments that don't fit
+// in registers are on the stack. Callers outside the JIT use the vectorcall
+// entry instead, through JITRT_CallStaticallyWithPrimitiveSignature.
 void NativeGenerator::generateStaticEntryPoint(
     Label native_entry_point,
     Label static_jmp_location) {
@@ -1320,9 +1419,23 @@ void NativeGenerator::generateStaticEntryPoint(
   env_.addAnnotation("StaticEntryPoint", static_entry_point_cursor);
 }
 
+bool hasDirectEntry(BorrowedRef<PyCodeObject> code) {
+  int unsupported_flags = CO_STATICALLY_COMPILED | CO_VARARGS |
+      CO_VARKEYWORDS | kCoFlagsAnyGenerator;
+  return getConfig().direct_calls && !(code->co_flags & unsupported_flags) &&
+      code->co_kwonlyargcount == 0;
+}
+
 bool NativeGenerator::hasStaticEntry() const {
-  PyCodeObject* code = GetFunction()->code;
-  return (code->co_flags & CO_STATICALLY_COMPILED);
+  const hir::Function* func = GetFunction();
+  PyCodeObject* code = func->code;
+  if (code->co_flags & CO_STATICALLY_COMPILED) {
+    return true;
+  }
+  // Baseline code is left to the generic entry so that calls to it are
+  // counted towards tiering up.
+  return hasDirectEntry(code) && !func->baseline_tier &&
+      !func->osr_entry.has_value();
 }
 
 void NativeGenerator::generateCode(CodeHolder& codeholder) {
@@ -1361,6 +1474,21 @@ void NativeGenerator::generateCode(CodeHolder& codeholder) {
   // vectorcall convention
   Label vectorcall_entry_label = as_->newLabel();
   as_->bind(vectorcall_entry_label);
+  Label tier_up = as_->newLabel();
+  Label tier_up_done = as_->newLabel();
+  bool baseline_tier = GetFunction()->baseline_tier;
+  if (baseline_tier) {
+    // Count calls to baseline code, asking for it to be replaced by fully
+    // optimized code once it's hot. The count wraps after reaching zero, so
+    // this only happens once.
+    env_.code_rt->startTierUpCountdown(getConfig().tier2_threshold);
+    as_->mov(
+        x86::rax,
+        reinterpret_cast<uint64_t>(env_.code_rt->tierUpCountdown()));
+    as_->sub(x86::dword_ptr(x86::rax), 1);
+    as_->jz(tier_up);
+    as_->bind(tier_up_done);
+  }
   generatePrologue(correct_arg_count, native_entry_point);
 
   generateEpilogue(epilogue_cursor);
@@ -1390,11 +1518,37 @@ void NativeGenerator::generateCode(CodeHolder& codeholder) {
         "Static argument typecheck failure stub", static_typecheck_cursor);
   }
 
+  if (baseline_tier) {
+    // Swap in the fully optimized entry point, then carry on with this call
+    // in the baseline code. The vectorcall arguments are still in registers.
+    auto tier_up_cursor = as_->cursor();
+    as_->bind(tier_up);
+    as_->push(x86::rdi);
+    as_->push(x86::rsi);
+    as_->push(x86::rdx);
+    as_->push(x86::rcx);
+    as_->sub(x86::rsp, 8);
+    as_->mov(x86::rdi, reinterpret_cast<uint64_t>(env_.code_rt));
+    as_->call(reinterpret_cast<uint64_t>(tierUpCode));
+    as_->add(x86::rsp, 8);
+    as_->pop(x86::rcx);
+    as_->pop(x86::rdx);
+    as_->pop(x86::rsi);
+    as_->pop(x86::rdi);
+    as_->jmp(tier_up_done);
+    env_.addAnnotation("Tier-up stub", tier_up_cursor);
+  }
+
   generateDeoptExits(codeholder);
+  packDeoptMetadata();
 
   ASM_CHECK_THROW(as_->finalize());
   void* code_top;
-  ASM_CHECK_THROW(CodeAllocator::get()->addCode(&code_top, &codeholder));
+  const void* near =
+      getConfig().code_placement ? placementHint() : nullptr;
+  ASM_CHECK_THROW(
+      CodeAllocator::get()->addCode(&code_top, &codeholder, near));
+  code_start_ = code_top;
 
   // ------------- code_top
   // ^
@@ -1446,16 +1600,6 @@ void NativeGenerator::generateCode(CodeHolder& codeholder) {
       "Disassembly for {}\n{}",
       GetFunction()->fullname,
       env_.annotations.disassemble(code_top, codeholder));
-  {
-    ThreadedCompileSerialize guard;
-    for (auto& x : env_.function_indirections) {
-      Label trampoline = x.second.trampoline;
-      *x.second.indirect = reinterpret_cast<void*>(
-          codeholder.labelOffsetFromBase(trampoline) +
-          codeholder.baseAddress());
-    }
-  }
-
   const hir::Function* func = GetFunction();
   std::string prefix = [&] {
     switch (func->frameMode) {
@@ -1509,23 +1653,31 @@ static void raiseAttributeError(BorrowedRef<> receiver, BorrowedRef<> name) {
       name);
 }
 
-static PyFrameObject*
-prepareForDeopt(const uint64_t* regs, Runtime* runtime, std::size_t deopt_idx) {
-  JIT_CHECK(deopt_idx != -1ull, "deopt_idx must be valid");
-  const DeoptMetadata& deopt_meta = runtime->getDeoptMetadata(deopt_idx);
+static PyFrameObject* prepareForDeopt(
+    const uint64_t* regs,
+    Runtime* runtime,
+    std::size_t deopt_idx,
+    const DeoptMetadata& deopt_meta) {
   PyThreadState* tstate = _PyThreadState_UncheckedGet();
   Ref<PyFrameObject> f = materializePyFrameForDeopt(tstate);
 
   PyFrameObject* frame = f.release();
   PyFrameObject* frame_iter = frame;
   _PyShadowFrame* sf_iter = tstate->shadow_frame;
+  // Inlined frames can share virtual objects, so materialize each one once.
+  MaterializedObjects materialized;
   // Iterate one past the inline depth because that is the caller frame.
   for (int i = deopt_meta.inline_depth(); i >= 0; i--) {
     // Transfer ownership of shadow frame to the interpreter. The associated
     // Python frame will be ignored during future attempts to materialize the
     // stack.
     _PyShadowFrame_SetOwner(sf_iter, PYSF_INTERP);
-    reifyFrame(frame_iter, deopt_meta, deopt_meta.frame_meta.at(i), regs);
+    reifyFrame(
+        frame_iter,
+        deopt_meta,
+        deopt_meta.frame_meta.at(i),
+        regs,
+        &materialized);
     frame_iter = frame_iter->f_back;
     sf_iter = sf_iter->prev;
   }
@@ -1539,6 +1691,9 @@ prepareForDeopt(const uint64_t* regs, Runtime* runtime, std::size_t deopt_idx) {
     switch (reason) {
       case DeoptReason::kGuardFailure: {
         runtime->guardFailed(deopt_meta);
+        if (runtime->recordGuardFailure(deopt_meta)) {
+          recompileCode(deopt_meta.code_rt);
+        }
         break;
       }
       case DeoptReason::kYieldFrom: {
@@ -1581,8 +1736,7 @@ prepareForDeopt(const uint64_t* regs, Runtime* runtime, std::size_t deopt_idx) {
 
 static PyObject* resumeInInterpreter(
     PyFrameObject* frame,
-    Runtime* runtime,
-    std::size_t deopt_idx) {
+    const DeoptMetadata& deopt_meta) {
   if (frame->f_gen) {
     auto gen = reinterpret_cast<PyGenObject*>(frame->f_gen);
     // It's safe to call JITRT_GenJitDataFree directly here, rather than
@@ -1594,7 +1748,6 @@ static PyObject* resumeInInterpreter(
   PyThreadState* tstate = PyThreadState_Get();
   PyObject* result = nullptr;
   // Resume all of the inlined frames and the caller
-  const DeoptMetadata& deopt_meta = runtime->getDeoptMetadata(deopt_idx);
   int inline_depth = deopt_meta.inline_depth();
   int err_occurred = (deopt_meta.reason != DeoptReason::kGuardFailure);
   while (inline_depth >= 0) {
@@ -1638,6 +1791,56 @@ static PyObject* resumeInInterpreter(
   return result;
 }
 
+// Unwind the frames of self tail calls that TailCallElimination turned into
+// jumps, once the outermost frame has been resumed. They return its result, so
+// all that's left is to release their recursion depth and, if it raised, to
+// add them to the traceback at the tail call.
+static void unwindElidedFrames(
+    const DeoptMetadata& deopt_meta,
+    Py_ssize_t elided_frames,
+    PyObject* result) {
+  PyThreadState* tstate = PyThreadState_Get();
+  tstate->recursion_depth -= elided_frames;
+  if (result != nullptr || elided_frames == 0) {
+    return;
+  }
+  PyObject *exc, *val, *tb;
+  PyErr_Fetch(&exc, &val, &tb);
+  const RuntimeFrameState* frame_state = deopt_meta.code_rt->frameState();
+  auto frame = Ref<PyFrameObject>::steal(PyFrame_New(
+      tstate, frame_state->code(), frame_state->globals(), nullptr));
+  if (frame == nullptr) {
+    _PyErr_ChainExceptions(exc, val, tb);
+    return;
+  }
+  PyErr_Restore(exc, val, tb);
+  frame->f_lasti = BCIndex{deopt_meta.tail_call_offset}.value();
+  for (Py_ssize_t i = 0; i < elided_frames; i++) {
+    if (PyTraceBack_Here(frame) < 0) {
+      return;
+    }
+  }
+}
+
+// Deopt using the metadata with the given index and return the result of
+// resuming in the interpreter. Packed metadata is only decoded once here and
+// shared by both steps.
+static PyObject*
+deoptimize(const uint64_t* regs, Runtime* runtime, std::size_t deopt_idx) {
+  JIT_CHECK(deopt_idx != -1ull, "deopt_idx must be valid");
+  DeoptMetadata scratch;
+  const DeoptMetadata& deopt_meta =
+      runtime->unpackDeoptMetadata(deopt_idx, scratch);
+  Py_ssize_t elided_frames = 0;
+  if (const LiveValue* value = deopt_meta.getValue(deopt_meta.elided_frames)) {
+    elided_frames = MemoryView{regs}.readSigned(*value);
+  }
+  PyFrameObject* frame = prepareForDeopt(regs, runtime, deopt_idx, deopt_meta);
+  PyObject* result = resumeInInterpreter(frame, deopt_meta);
+  unwindElidedFrames(deopt_meta, elided_frames, result);
+  return result;
+}
+
 void* generateDeoptTrampoline(bool generator_mode) {
   CodeHolder code;
   code.init(CodeAllocator::get()->asmJitEnvironment());
@@ -1742,50 +1945,33 @@ void* generateDeoptTrampoline(bool generator_mode) {
   auto deopt_meta_addr = x86::ptr(x86::rbp, -kPointerSize);
   a.mov(deopt_meta_addr, x86::rsi);
 
-  // Prep the frame for evaluation in the interpreter.
+  // Prep the frame for evaluation in the interpreter and resume it there.
   //
-  // We pass the array of saved registers, a pointer to the runtime, the index
-  // of deopt metadata, and the call method kind.
+  // We pass the array of saved registers, a pointer to the runtime, and the
+  // index of deopt metadata.
   annot_cursor = a.cursor();
   a.mov(x86::rdi, x86::rsp);
   a.mov(x86::rsi, reinterpret_cast<uint64_t>(Runtime::get()));
   a.mov(x86::rdx, deopt_meta_addr);
   static_assert(
       std::is_same_v<
-          decltype(prepareForDeopt),
-          PyFrameObject*(const uint64_t*, Runtime*, std::size_t)>,
-      "prepareForDeopt has unexpected signature");
-  a.call(reinterpret_cast<uint64_t>(prepareForDeopt));
+          decltype(deoptimize),
+          PyObject*(const uint64_t*, Runtime*, std::size_t)>,
+      "deoptimize has unexpected signature");
+  a.call(reinterpret_cast<uint64_t>(deoptimize));
+  annot.add("deoptimize", &a, annot_cursor);
 
   // Clean up saved registers.
-  //
-  // This isn't strictly necessary but saves 128 bytes on the stack if we end
-  // up resuming in the interpreter.
+  annot_cursor = a.cursor();
   a.add(x86::rsp, (PhyLocation::NUM_GP_REGS - 1) * kPointerSize);
   // We have to restore our scratch register manually since it's callee-saved
   // and the stage 2 trampoline used it to hold the address of this
   // trampoline. We can't rely on the JIT epilogue to restore it for us, as the
   // JIT-compiled code may not have spilled it.
   a.pop(deopt_scratch_reg);
-  annot.add("prepareForDeopt", &a, annot_cursor);
-
-  // Resume execution in the interpreter.
-  annot_cursor = a.cursor();
-  // First argument: frame returned from prepareForDeopt.
-  a.mov(x86::rdi, x86::rax);
-  // Second argument: runtime.
-  a.mov(x86::rsi, reinterpret_cast<uint64_t>(Runtime::get()));
-  // Third argument: DeoptMetadata index.
-  a.mov(x86::rdx, x86::ptr(x86::rsp, kPointerSize));
-  static_assert(
-      std::is_same_v<
-          decltype(resumeInInterpreter),
-          PyObject*(PyFrameObject*, Runtime*, std::size_t)>,
-      "resumeInInterpreter has unexpected signature");
-  a.call(reinterpret_cast<uint64_t>(resumeInInterpreter));
-  annot.add("resumeInInterpreter", &a, annot_cursor);
+  annot.add("restoreScratchReg", &a, annot_cursor);
 
-  // If we return a primitive and prepareForDeopt returned null, we need that
+  // If we return a primitive and deoptimize returned null, we need that
   // null in edx/xmm1 to signal error to our caller. Since this trampoline is
   // shared, we do this move unconditionally, but even if not needed, it's
   // harmless. (To eliminate it, we'd need another trampoline specifically for
@@ -1848,8 +2034,8 @@ void* generateFailedDeferredCompileTrampoline() {
 
   annot.add("saveRegisters", &a, annot_cursor);
 
-  // r10 contains the function object from our stub
-  a.mov(x86::rdi, x86::r10);
+  // rdi already holds the function object, which static callers pass as the
+  // first argument.
   a.mov(x86::rsi, x86::rsp);
   a.call(reinterpret_cast<uint64_t>(JITRT_FailedDeferredCompileShim));
   a.leave();
@@ -1886,13 +2072,33 @@ void* generateFailedDeferredCompileTrampoline() {
 void NativeGenerator::generateAssemblyBody(const asmjit::CodeHolder& code) {
   auto as = env_.as;
   auto& blocks = lir_func_->basicblocks();
+  UnorderedMap<const lir::BasicBlock*, size_t> layout_index;
   for (auto& basicblock : blocks) {
     env_.block_label_map.emplace(basicblock, as->newLabel());
+    layout_index.emplace(basicblock, layout_index.size());
   }
 
+  // A block is the head of a loop if a block laid out after it in the same
+  // section jumps back to it.
+  auto is_loop_head = [&](const lir::BasicBlock* block) {
+    size_t index = map_get(layout_index, block);
+    for (const lir::BasicBlock* pred : block->predecessors()) {
+      if (map_get(layout_index, pred) >= index &&
+          pred->section() == block->section()) {
+        return true;
+      }
+    }
+    return false;
+  };
+  bool align_loops = getConfig().code_placement;
+
   for (lir::BasicBlock* basicblock : blocks) {
     CodeSection section = basicblock->section();
     CodeSectionOverride section_override{as, &code, &metadata_, section};
+    if (align_loops && section == CodeSection::kHot &&
+        is_loop_head(basicblock)) {
+      as->align(AlignMode::kCode, kLoopHeadAlignment);
+    }
     as->bind(map_get(env_.block_label_map, basicblock));
     for (auto& instr : basicblock->instructions()) {
       asmjit::BaseNode* cursor = as->cursor();
@@ -1904,6 +2110,37 @@ void NativeGenerator::generateAssemblyBody(const asmjit::CodeHolder& code) {
   }
 }
 
+const void* NativeGenerator::placementHint() const {
+  if (const void* caller = callerCodeStart()) {
+    return caller;
+  }
+  const hir::Function* func = GetFunction();
+  if (func == nullptr) {
+    return nullptr;
+  }
+  for (const hir::BasicBlock& block : func->cfg.blocks) {
+    for (const hir::Instr& instr : block) {
+      BorrowedRef<PyFunctionObject> callee;
+      if (instr.IsInvokeStaticFunction()) {
+        callee =
+            static_cast<const hir::InvokeStaticFunction&>(instr).func();
+      } else if (
+          instr.IsVectorCall() || instr.IsVectorCallStatic() ||
+          instr.IsVectorCallKW()) {
+        hir::Type type =
+            static_cast<const hir::VectorCallBase&>(instr).func()->type();
+        if (type.hasValueSpec(hir::TFunc)) {
+          callee = reinterpret_cast<PyFunctionObject*>(type.objectSpec());
+        }
+      }
+      if (callee != nullptr && _PyJIT_IsCompiled(callee)) {
+        return reinterpret_cast<const void*>(callee->vectorcall);
+      }
+    }
+  }
+  return nullptr;
+}
+
 int NativeGenerator::calcFrameHeaderSize(const hir::Function* func) {
   if (func == nullptr || func->code->co_flags & kCoFlagsAnyGenerator) {
     return 0;
@@ -29,6 +29,11 @@ namespace jit::codegen {
 void* generateDeoptTrampoline(bool generator_mode);
 void* generateFailedDeferredCompileTrampoline();
 
+// Whether code compiled for the given code object gets a static entry point
+// for direct calls from JIT code even though it isn't Static Python. See
+// JITRT_GetDirectCallFallback().
+bool hasDirectEntry(BorrowedRef<PyCodeObject> code);
+
 class NativeGenerator {
  public:
   NativeGenerator(const hir::Function* func)
@@ -70,9 +75,19 @@ class NativeGenerator {
   std::string GetFunctionName() const;
   void* getVectorcallEntry();
   void* getStaticEntry();
+  // Start of the memory allocated for the generated code, which is
+  // GetCompiledFunctionSize() bytes long.
+  void* getCodeStart() const {
+    return code_start_;
+  }
   int GetCompiledFunctionSize() const;
   int GetCompiledFunctionStackSize() const;
   int GetCompiledFunctionSpillStackSize() const;
+  // Number of stage 1 deopt stubs, which deopt exits with identical metadata
+  // share.
+  int GetNumDeoptExitStubs() const {
+    return num_deopt_exit_stubs_;
+  }
   const hir::Function* GetFunction() const {
     return func_;
   }
@@ -91,6 +106,7 @@ class NativeGenerator {
  private:
   const hir::Function* func_;
   void* vectorcall_entry_{nullptr};
+  void* code_start_{nullptr};
   asmjit::x86::Builder* as_{nullptr};
   CodeHolderMetadata metadata_{CodeSection::kHot};
   void* deopt_trampoline_{nullptr};
@@ -99,10 +115,15 @@ class NativeGenerator {
 
   int compiled_size_{-1};
   int spill_stack_size_{-1};
+  int num_deopt_exit_stubs_{0};
   int frame_header_size_;
   int max_inline_depth_;
 
   bool hasStaticEntry() const;
+  // Existing JIT code that this function's code should be placed near: the
+  // JIT-compiled function calling it, or the first JIT-compiled function it
+  // calls directly.
+  const void* placementHint() const;
   int calcFrameHeaderSize(const hir::Function* func);
   int calcMaxInlineDepth(const hir::Function* func);
   void generateCode(asmjit::CodeHolder& code);
@@ -125,6 +146,11 @@ class NativeGenerator {
   void generateEpilogue(asmjit::BaseNode* epilogue_cursor);
   void generateEpilogueUnlinkFrame(asmjit::x86::Gp tstate_reg, bool is_gen);
   void generateDeoptExits(const asmjit::CodeHolder& code);
+  // Indices of the DeoptMetadata that this function's yield points refer to.
+  UnorderedSet<std::size_t> yieldPointDeoptIndices() const;
+  // Pack the metadata of this function's deopt exits, which is only needed
+  // after code generation when a deopt happens.
+  void packDeoptMetadata();
   void linkDeoptPatchers(const asmjit::CodeHolder& code);
   void generateResumeEntry();
   void generateStaticMethodTypeChecks(asmjit::Label setup_frame);
@@ -0,0 +1,103 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/compile_arena.h"
+
+#include "cinderx/Common/log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace jit {
+
+namespace {
+
+thread_local CompileArena* s_current_arena = nullptr;
+
+// Every allocation is preceded by a header recording the arena it came from,
+// or nullptr if it came from malloc(), so compileArenaFree() knows what to do
+// with it. The header is padded to keep allocations suitably aligned for any
+// type.
+struct alignas(alignof(std::max_align_t)) AllocHeader {
+  CompileArena* arena;
+};
+
+constexpr std::size_t kHeaderSize = sizeof(AllocHeader);
+
+std::size_t roundUp(std::size_t size) {
+  constexpr std::size_t kAlign = alignof(std::max_align_t);
+  return (size + kAlign - 1) & ~(kAlign - 1);
+}
+
+} // namespace
+
+CompileArena::~CompileArena() {
+  for (void* chunk : chunks_) {
+    std::free(chunk);
+  }
+}
+
+void* CompileArena::allocate(std::size_t size) {
+  size = roundUp(size);
+  if (static_cast<std::size_t>(end_ - ptr_) < size) {
+    if (size > next_chunk_size_ / 4) {
+      // Give large objects a chunk of their own rather than wasting the rest
+      // of the current one.
+      return allocateChunk(size);
+    }
+    ptr_ = static_cast<char*>(allocateChunk(next_chunk_size_));
+    end_ = ptr_ + next_chunk_size_;
+    next_chunk_size_ = std::min(next_chunk_size_ * 2, kMaxChunkSize);
+  }
+  void* result = ptr_;
+  ptr_ += size;
+  return result;
+}
+
+void* CompileArena::allocateChunk(std::size_t size) {
+  void* chunk = std::malloc(size);
+  if (chunk == nullptr) {
+    throw std::bad_alloc{};
+  }
+  chunks_.push_back(chunk);
+  bytes_ += size;
+  return chunk;
+}
+
+CompileArenaScope::CompileArenaScope(CompileArena* arena)
+    : arena_{arena}, outer_{s_current_arena} {
+  s_current_arena = arena;
+}
+
+CompileArenaScope::~CompileArenaScope() {
+  JIT_DCHECK(s_current_arena == arena_, "Compile arena scopes must nest");
+  s_current_arena = outer_;
+}
+
+void* compileArenaAlloc(std::size_t size) {
+  CompileArena* arena = s_current_arena;
+  void* mem;
+  if (arena != nullptr) {
+    mem = arena->allocate(kHeaderSize + size);
+  } else {
+    mem = std::malloc(kHeaderSize + size);
+    if (mem == nullptr) {
+      throw std::bad_alloc{};
+    }
+  }
+  static_cast<AllocHeader*>(mem)->arena = arena;
+  return static_cast<char*>(mem) + kHeaderSize;
+}
+
+void compileArenaFree(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  auto header = reinterpret_cast<AllocHeader*>(
+      static_cast<char*>(ptr) - kHeaderSize);
+  if (header->arena == nullptr) {
+    std::free(header);
+  }
+}
+
+} // namespace jit
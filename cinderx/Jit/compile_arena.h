@@ -0,0 +1,84 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#pragma once
+
+#include "cinderx/Common/util.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace jit {
+
+// A bump allocator for the HIR and LIR of a single compile.
+//
+// Compiling a large function allocates hundreds of thousands of small,
+// short-lived objects, which are all freed together when the compile
+// finishes. Allocating them from an arena avoids most of the malloc() and
+// free() calls, and keeps each compile's IR on its own pages, so concurrent
+// batch compile workers don't contend on the allocator.
+//
+// Freeing an object doesn't release its memory; everything is released when
+// the arena is destroyed, so the arena must outlive every object allocated
+// from it.
+class CompileArena {
+ public:
+  CompileArena() = default;
+  ~CompileArena();
+
+  void* allocate(std::size_t size);
+
+  // Bytes reserved from the system. Since nothing is returned until the arena
+  // is destroyed, this is also its peak size.
+  std::size_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompileArena);
+
+  void* allocateChunk(std::size_t size);
+
+  std::vector<void*> chunks_;
+  char* ptr_{nullptr};
+  char* end_{nullptr};
+  std::size_t next_chunk_size_{kMinChunkSize};
+  std::size_t bytes_{0};
+
+  static constexpr std::size_t kMinChunkSize = 64 * 1024;
+  static constexpr std::size_t kMaxChunkSize = 1024 * 1024;
+};
+
+// Makes arena the current thread's compile arena until destroyed, restoring
+// the previous one (if any) afterwards.
+class CompileArenaScope {
+ public:
+  explicit CompileArenaScope(CompileArena* arena);
+  ~CompileArenaScope();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompileArenaScope);
+
+  CompileArena* arena_;
+  CompileArena* outer_;
+};
+
+// Allocate memory for an IR object from the current thread's compile arena,
+// or with malloc() if there isn't one. Either way, the memory must be released
+// with compileArenaFree().
+void* compileArenaAlloc(std::size_t size);
+void compileArenaFree(void* ptr);
+
+// Base class for IR objects that are created with new, giving them and their
+// subclasses arena allocation during a compile.
+class CompileArenaAllocated {
+ public:
+  static void* operator new(std::size_t size) {
+    return compileArenaAlloc(size);
+  }
+
+  static void operator delete(void* ptr) {
+    compileArenaFree(ptr);
+  }
+};
+
+} // namespace jit
@@ -0,0 +1,180 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/compile_queue.h"
+
+#include "cinderx/Common/log.h"
+#include "cinderx/Interpreter/interpreter.h"
+#include "cinderx/Jit/pyjit.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace jit {
+
+namespace {
+
+std::unique_ptr<CompileQueue> s_compile_queue;
+
+unsigned numCalls(BorrowedRef<PyFunctionObject> func) {
+  auto code = reinterpret_cast<PyCodeObject*>(func->func_code);
+  return code->co_mutable->ncalls;
+}
+
+// Let a function that was dropped from the queue before being compiled be
+// queued again on its next call.
+void requeueOnNextCall(BorrowedRef<PyFunctionObject> func) {
+  if (func->vectorcall == (vectorcallfunc)PyEntry_AutoJITPending) {
+    PyEntry_init(func);
+  }
+}
+
+} // namespace
+
+CompileQueue::~CompileQueue() {
+  // Without a call to stop() the worker may still be waiting for work. It
+  // can't be joined here because it may need the GIL to finish.
+  if (worker_.joinable()) {
+    worker_.detach();
+  }
+}
+
+void CompileQueue::enqueue(BorrowedRef<PyFunctionObject> func) {
+  if (!queued_.emplace(func).second) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    queue_.push_back(
+        Entry{Ref<PyFunctionObject>::create(func),
+              std::chrono::steady_clock::now()});
+    if (!worker_.joinable()) {
+      worker_ = std::thread{&CompileQueue::workerLoop, this};
+    }
+  }
+  stats_.num_enqueued++;
+  stats_.depth = queue_.size();
+  stats_.max_depth = std::max(stats_.max_depth, stats_.depth);
+  cv_.notify_one();
+}
+
+void CompileQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  if (worker_.joinable()) {
+    Py_BEGIN_ALLOW_THREADS;
+    worker_.join();
+    Py_END_ALLOW_THREADS;
+  }
+
+  std::vector<Entry> dropped;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    dropped.swap(queue_);
+    stopping_ = false;
+  }
+  dropAll();
+  stats_.depth = 0;
+  // The functions we dropped are queued again on their next call, so they'll
+  // restart the worker if the JIT is still enabled.
+}
+
+void CompileQueue::dropAll() {
+  for (PyFunctionObject* func : queued_) {
+    requeueOnNextCall(func);
+  }
+  queued_.clear();
+}
+
+void CompileQueue::workerLoop() {
+  JIT_DLOG(
+      "Started compile queue worker in thread {}", std::this_thread::get_id());
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        break;
+      }
+    }
+    PyGILState_STATE gil_state = PyGILState_Ensure();
+    compileNext();
+    PyGILState_Release(gil_state);
+  }
+  JIT_DLOG(
+      "Finished compile queue worker in thread {}", std::this_thread::get_id());
+}
+
+void CompileQueue::compileNext() {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (stopping_ || queue_.empty()) {
+      return;
+    }
+    if (!_PyJIT_IsEnabled()) {
+      dropAll();
+      queue_.clear();
+      stats_.depth = 0;
+      return;
+    }
+    auto it = std::max_element(
+        queue_.begin(), queue_.end(), [](const Entry& a, const Entry& b) {
+          return numCalls(a.func) < numCalls(b.func);
+        });
+    entry = std::move(*it);
+    *it = std::move(queue_.back());
+    queue_.pop_back();
+  }
+  BorrowedRef<PyFunctionObject> func = entry.func;
+  queued_.erase(func);
+  stats_.depth = queue_.size();
+
+  auto start = std::chrono::steady_clock::now();
+  auto wait = start - entry.enqueue_time;
+  stats_.total_wait += wait;
+  stats_.max_wait = std::max<std::chrono::nanoseconds>(stats_.max_wait, wait);
+
+  // The function may have been compiled some other way while it was queued.
+  if (_PyJIT_IsCompiled(func)) {
+    return;
+  }
+  _PyJIT_Result result = _PyJIT_CompileFunction(func);
+  stats_.total_compile += std::chrono::steady_clock::now() - start;
+  if (result == PYJIT_RESULT_OK) {
+    stats_.num_compiled++;
+    return;
+  }
+
+  stats_.num_failed++;
+  if (result == PYJIT_RESULT_PYTHON_EXCEPTION) {
+    // There's no caller to raise this to.
+    PyErr_WriteUnraisable(entry.func);
+  }
+  // As with a failed synchronous compile, run the function in the interpreter
+  // from now on.
+  func->vectorcall = (vectorcallfunc)PyEntry_LazyInit;
+  PyEntry_initnow(func);
+}
+
+CompileQueue& compileQueue() {
+  if (s_compile_queue == nullptr) {
+    s_compile_queue = std::make_unique<CompileQueue>();
+  }
+  return *s_compile_queue;
+}
+
+void resetCompileQueueAfterFork() {
+  if (s_compile_queue == nullptr) {
+    return;
+  }
+  // The queue's mutex may have been held by the worker at the time of the
+  // fork, and its thread is gone, so leak it rather than touch either.
+  // queued_ is only guarded by the GIL, which the child holds.
+  CompileQueue* queue = s_compile_queue.release();
+  queue->dropAll();
+}
+
+} // namespace jit
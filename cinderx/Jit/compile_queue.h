@@ -0,0 +1,94 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#pragma once
+
+#include "Python.h"
+#include "cinderx/Common/ref.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace jit {
+
+struct CompileQueueStats {
+  // Number of functions currently waiting to be compiled, and the most that
+  // have ever been waiting at once.
+  std::size_t depth{0};
+  std::size_t max_depth{0};
+  std::size_t num_enqueued{0};
+  std::size_t num_compiled{0};
+  std::size_t num_failed{0};
+  // Time from a function being queued to its compile starting.
+  std::chrono::nanoseconds total_wait{0};
+  std::chrono::nanoseconds max_wait{0};
+  // Time spent compiling on the worker thread.
+  std::chrono::nanoseconds total_compile{0};
+};
+
+// Compiles hot functions on a background thread in auto-JIT mode, so the call
+// that crosses the compile threshold doesn't pay for the compile.
+//
+// Queued functions keep running in the interpreter, through
+// PyEntry_AutoJITPending, until the worker has compiled them. The worker takes
+// the GIL to compile, since preloading and compilation read and write Python
+// objects, so installing the new entry point in func->vectorcall is atomic
+// with respect to callers. It always compiles the queued function whose code
+// has been called the most.
+//
+// All methods must be called with the GIL held.
+class CompileQueue {
+ public:
+  ~CompileQueue();
+
+  // Queue func to be compiled, starting the worker thread if it isn't running.
+  // Does nothing if func is already queued.
+  void enqueue(BorrowedRef<PyFunctionObject> func);
+
+  // Stop the worker thread and drop any functions still waiting to be
+  // compiled. Releases the GIL while waiting for the worker to exit.
+  void stop();
+
+  // Forget every queued function without compiling it, letting each be
+  // queued again on its next call. Doesn't touch the worker thread or the
+  // entries it reads.
+  void dropAll();
+
+  const CompileQueueStats& stats() const {
+    return stats_;
+  }
+
+ private:
+  struct Entry {
+    Ref<PyFunctionObject> func;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
+
+  void workerLoop();
+  void compileNext();
+
+  // Guards queue_ and stopping_, which the worker checks without the GIL while
+  // it waits on cv_ for work.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_{false};
+  std::vector<Entry> queue_;
+
+  std::unordered_set<PyFunctionObject*> queued_;
+  std::thread worker_;
+  CompileQueueStats stats_;
+};
+
+// The process-wide compile queue.
+CompileQueue& compileQueue();
+
+// Forget the compile queue in the child after fork(), where its worker thread
+// doesn't exist. Functions that were queued get queued again on their next
+// call.
+void resetCompileQueueAfterFork();
+
+} // namespace jit
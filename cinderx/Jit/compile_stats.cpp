@@ -0,0 +1,91 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/compile_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <string_view>
+
+namespace jit {
+
+namespace {
+
+thread_local CompileStatsScope* s_current_scope = nullptr;
+
+// Compiles finish on the batch compile worker threads as well as the main
+// thread, so the aggregate needs its own lock.
+std::mutex s_stats_mutex;
+CompileStats s_stats;
+
+void addToHistogram(CompileStatsHistogram& histogram, uint64_t value) {
+  std::size_t bucket = value == 0 ? 0 : std::bit_width(value) - 1;
+  histogram[std::min(bucket, histogram.size() - 1)]++;
+}
+
+CompilePhaseTotals& phaseTotals(std::string_view name) {
+  // There are a few dozen phases at most, so a linear search is fine and keeps
+  // them in the order they ran.
+  for (CompilePhaseTotals& totals : s_stats.phases) {
+    if (totals.name == name) {
+      return totals;
+    }
+  }
+  CompilePhaseTotals& totals = s_stats.phases.emplace_back();
+  totals.name = name;
+  return totals;
+}
+
+} // namespace
+
+CompileStatsScope::CompileStatsScope()
+    : start_{std::chrono::steady_clock::now()}, outer_{s_current_scope} {
+  s_current_scope = this;
+}
+
+CompileStatsScope::~CompileStatsScope() {
+  s_current_scope = outer_;
+  auto time = std::chrono::steady_clock::now() - start_;
+
+  std::lock_guard<std::mutex> lock{s_stats_mutex};
+  s_stats.num_compiles++;
+  s_stats.total_time += time;
+  for (auto& [name, phase_time] : phases_) {
+    CompilePhaseTotals& totals = phaseTotals(name);
+    totals.count++;
+    totals.total += phase_time;
+    totals.max = std::max(totals.max, phase_time);
+  }
+  s_stats.total_arena_bytes += arena_bytes_;
+  s_stats.max_arena_bytes = std::max(s_stats.max_arena_bytes, arena_bytes_);
+  addToHistogram(
+      s_stats.time_us_histogram,
+      std::chrono::duration_cast<std::chrono::microseconds>(time).count());
+  addToHistogram(s_stats.arena_kib_histogram, arena_bytes_ / 1024);
+}
+
+void recordCompilePhase(const char* phase, std::chrono::nanoseconds time) {
+  CompileStatsScope* scope = s_current_scope;
+  if (scope != nullptr) {
+    scope->phases_.emplace_back(phase, time);
+  }
+}
+
+void recordCompileArenaBytes(std::size_t bytes) {
+  CompileStatsScope* scope = s_current_scope;
+  if (scope != nullptr) {
+    scope->arena_bytes_ += bytes;
+  }
+}
+
+CompileStats getCompileStats() {
+  std::lock_guard<std::mutex> lock{s_stats_mutex};
+  return s_stats;
+}
+
+void clearCompileStats() {
+  std::lock_guard<std::mutex> lock{s_stats_mutex};
+  s_stats = CompileStats{};
+}
+
+} // namespace jit
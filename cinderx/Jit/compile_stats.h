@@ -0,0 +1,103 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#pragma once
+
+#include "cinderx/Common/util.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jit {
+
+// Phase names used by the backend. HIR passes are recorded under their
+// pass.name().
+constexpr const char* kPhaseHIRBuild = "HIR build";
+constexpr const char* kPhaseLIRGeneration = "LIR generation";
+constexpr const char* kPhaseLIRRewrites = "LIR rewrites";
+constexpr const char* kPhaseRegisterAllocation = "Register allocation";
+constexpr const char* kPhaseCodeGeneration = "Code generation";
+
+// Histograms are log2 buckets: bucket i counts values in [2^i, 2^(i+1)), with
+// values below 1 going in bucket 0 and values above the range in the last.
+constexpr std::size_t kCompileStatsBuckets = 32;
+using CompileStatsHistogram = std::array<std::size_t, kCompileStatsBuckets>;
+
+struct CompilePhaseTotals {
+  std::string name;
+  std::size_t count{0};
+  std::chrono::nanoseconds total{0};
+  std::chrono::nanoseconds max{0};
+};
+
+// Aggregate compile-time and memory statistics over every function compiled
+// since startup, or since the last call to clearCompileStats().
+struct CompileStats {
+  std::size_t num_compiles{0};
+  std::chrono::nanoseconds total_time{0};
+  // In the order each phase first ran.
+  std::vector<CompilePhaseTotals> phases;
+  // Bytes held by the compiler's arenas at the end of a compile. Arenas only
+  // grow until they're destroyed, so this is each compile's peak.
+  std::size_t total_arena_bytes{0};
+  std::size_t max_arena_bytes{0};
+  // Per-compile wall time in microseconds.
+  CompileStatsHistogram time_us_histogram{};
+  // Per-compile peak arena bytes in KiB.
+  CompileStatsHistogram arena_kib_histogram{};
+};
+
+// Collects the phase times of one compile on the current thread, and adds
+// them to the process-wide CompileStats when it goes out of scope. Phases run
+// outside of a CompileStatsScope aren't recorded.
+//
+// The phases are kept locally so that recording one is cheap; the global stats
+// lock is only taken once per compile.
+class CompileStatsScope {
+ public:
+  CompileStatsScope();
+  ~CompileStatsScope();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompileStatsScope);
+
+  friend void recordCompilePhase(const char*, std::chrono::nanoseconds);
+  friend void recordCompileArenaBytes(std::size_t);
+
+  std::chrono::steady_clock::time_point start_;
+  CompileStatsScope* outer_;
+  std::vector<std::pair<const char*, std::chrono::nanoseconds>> phases_;
+  std::size_t arena_bytes_{0};
+};
+
+// Record time spent in the named phase of the current compile. phase must
+// outlive the compile, which string literals and pass names do.
+void recordCompilePhase(const char* phase, std::chrono::nanoseconds time);
+
+// Record bytes held by one of the current compile's arenas.
+void recordCompileArenaBytes(std::size_t bytes);
+
+// Times a phase of the current compile from construction to destruction.
+class CompilePhaseStopwatch {
+ public:
+  explicit CompilePhaseStopwatch(const char* phase)
+      : phase_{phase}, start_{std::chrono::steady_clock::now()} {}
+
+  ~CompilePhaseStopwatch() {
+    recordCompilePhase(phase_, std::chrono::steady_clock::now() - start_);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompilePhaseStopwatch);
+
+  const char* phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+CompileStats getCompileStats();
+void clearCompileStats();
+
+} // namespace jit
@@ -5,6 +5,8 @@
 #include "Python.h"
 #include "cinderx/Common/log.h"
 
+#include "cinderx/Jit/compile_arena.h"
+#include "cinderx/Jit/compile_stats.h"
 #include "cinderx/Jit/config.h"
 #include "cinderx/Jit/disassembler.h"
 #include "cinderx/Jit/hir/analysis.h"
@@ -69,6 +71,8 @@ static void runPass(hir::Function& func, PostPassFunction callback) {
                 PassTimer timer;
                 pass.Run(func);
                 std::size_t time_ns = timer.finish();
+                recordCompilePhase(
+                    pass.name(), std::chrono::nanoseconds{time_ns});
                 callback(func, pass.name(), time_ns);
 
                 JIT_LOGIF(
@@ -104,17 +108,39 @@ void Compiler::runPasses(
     PostPassFunction callback) {
   // SSAify must come first; nothing but SSAify should ever see non-SSA HIR.
   runPass<jit::hir::SSAify>(irfunc, callback);
+  if (config & PassConfig::kBaseline) {
+    runPass<jit::hir::PhiElimination>(irfunc, callback);
+    runPass<jit::hir::CleanCFG>(irfunc, callback);
+    runPass<jit::hir::RefcountInsertion>(irfunc, callback);
+    JIT_LOGIF(
+        g_dump_final_hir, "Baseline HIR for {}:\n{}", irfunc.fullname, irfunc);
+    return;
+  }
   runPass<jit::hir::Simplify>(irfunc, callback);
   runPass<jit::hir::DynamicComparisonElimination>(irfunc, callback);
   runPass<jit::hir::GuardTypeRemoval>(irfunc, callback);
   runPass<jit::hir::PhiElimination>(irfunc, callback);
+  if (config & PassConfig::kEnableTailCallElimination) {
+    // Before inlining, while the self calls are still calls.
+    runPass<jit::hir::TailCallElimination>(irfunc, callback);
+  }
   if (config & PassConfig::kEnableHIRInliner) {
     runPass<jit::hir::InlineFunctionCalls>(irfunc, callback);
     runPass<jit::hir::Simplify>(irfunc, callback);
     runPass<jit::hir::BeginInlinedFunctionElimination>(irfunc, callback);
   }
   runPass<jit::hir::BuiltinLoadMethodElimination>(irfunc, callback);
+  runPass<jit::hir::IntRangeAnalysis>(irfunc, callback);
   runPass<jit::hir::Simplify>(irfunc, callback);
+  runPass<jit::hir::FloatUnboxing>(irfunc, callback);
+  runPass<jit::hir::GlobalValueNumbering>(irfunc, callback);
+  runPass<jit::hir::LICM>(irfunc, callback);
+  runPass<jit::hir::EscapeAnalysis>(irfunc, callback);
+  if (config & PassConfig::kEnableHIRInliner) {
+    // Removed allocations may leave inlined functions with nothing that needs
+    // a shadow frame.
+    runPass<jit::hir::BeginInlinedFunctionElimination>(irfunc, callback);
+  }
   runPass<jit::hir::CleanCFG>(irfunc, callback);
   runPass<jit::hir::DeadCodeElimination>(irfunc, callback);
   runPass<jit::hir::CleanCFG>(irfunc, callback);
@@ -140,6 +166,10 @@ PassConfig createConfig() {
   if (getConfig().hir_inliner_enabled) {
     result = static_cast<PassConfig>(result | PassConfig::kEnableHIRInliner);
   }
+  if (getConfig().tail_call_elimination) {
+    result = static_cast<PassConfig>(
+        result | PassConfig::kEnableTailCallElimination);
+  }
   return result;
 }
 
@@ -167,6 +197,14 @@ std::unique_ptr<CompiledFunction> Compiler::Compile(
       fullname,
       reinterpret_cast<void*>(preloader.code().get()));
 
+  CompileStatsScope stats_scope;
+  // Everything allocated from the arena is freed before it is, except in debug
+  // mode, where it's handed to the CompiledFunctionDebug along with the HIR
+  // and LIR.
+  auto arena = std::make_unique<CompileArena>();
+  CompileArena* arena_ptr = arena.get();
+  CompileArenaScope arena_scope{arena_ptr};
+  SCOPE_EXIT(recordCompileArenaBytes(arena_ptr->bytes()));
   std::unique_ptr<CompilationPhaseTimer> compilation_phase_timer{nullptr};
 
   if (captureCompilationTimeFor(fullname)) {
@@ -178,6 +216,8 @@ std::unique_ptr<CompiledFunction> Compiler::Compile(
   PassTimer hir_build_timer;
   std::unique_ptr<jit::hir::Function> irfunc(jit::hir::buildHIR(preloader));
   std::size_t hir_build_time_ns = hir_build_timer.finish();
+  recordCompilePhase(
+      kPhaseHIRBuild, std::chrono::nanoseconds{hir_build_time_ns});
   if (nullptr != compilation_phase_timer) {
     compilation_phase_timer->end();
   }
@@ -194,7 +234,12 @@ std::unique_ptr<CompiledFunction> Compiler::Compile(
     irfunc->setCompilationPhaseTimer(std::move(compilation_phase_timer));
   }
 
-  PassConfig config = createConfig();
+  // OSR entries are only compiled for hot loops, so they're fully optimized
+  // right away.
+  bool baseline = !preloader.osrEntry().has_value() &&
+      Runtime::get()->useBaselineTier(preloader.code());
+  irfunc->baseline_tier = baseline;
+  PassConfig config = baseline ? PassConfig::kBaseline : createConfig();
   std::unique_ptr<nlohmann::json> json{nullptr};
   if (!g_dump_hir_passes_json.empty()) {
     // TODO(emacs): For inlined functions, grab the sources from all the
@@ -268,15 +313,18 @@ std::unique_ptr<CompiledFunction> Compiler::Compile(
   // Grab some fields off of irfunc and ngen before moving them.
   hir::Function::InlineFunctionStats inline_stats =
       std::move(irfunc->inline_function_stats);
+  void* code_start = ngen->getCodeStart();
   void* static_entry = ngen->getStaticEntry();
   CodeRuntime* code_runtime = ngen->codeRuntime();
 
   if (g_debug) {
     irfunc->setCompilationPhaseTimer(nullptr);
     return std::make_unique<CompiledFunctionDebug>(
+        std::move(arena),
         std::move(irfunc),
         std::move(ngen),
         reinterpret_cast<vectorcallfunc>(entry),
+        code_start,
         static_entry,
         code_runtime,
         func_size,
@@ -287,6 +335,7 @@ std::unique_ptr<CompiledFunction> Compiler::Compile(
   } else {
     return std::make_unique<CompiledFunction>(
         reinterpret_cast<vectorcallfunc>(entry),
+        code_start,
         static_entry,
         code_runtime,
         func_size,
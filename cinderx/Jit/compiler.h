@@ -6,6 +6,7 @@
 #include "cinderx/Common/util.h"
 
 #include "cinderx/Jit/codegen/gen_asm.h"
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/hir/hir.h"
 #include "cinderx/Jit/hir/preload.h"
 #include "cinderx/Jit/runtime.h"
@@ -23,6 +24,7 @@ class CompiledFunction {
  public:
   CompiledFunction(
       vectorcallfunc vectorcall_entry,
+      void* code_start,
       void* static_entry,
       CodeRuntime* code_runtime,
       int func_size,
@@ -31,6 +33,7 @@ class CompiledFunction {
       hir::Function::InlineFunctionStats inline_function_stats,
       const hir::OpcodeCounts& hir_opcode_counts)
       : vectorcall_entry_(vectorcall_entry),
+        code_start_(code_start),
         static_entry_(static_entry),
         code_runtime_(code_runtime),
         code_size_(func_size),
@@ -49,6 +52,12 @@ class CompiledFunction {
     return static_entry_;
   }
 
+  // Start of the memory allocated for the code, which is codeSize() bytes
+  // long.
+  void* codeStart() const {
+    return code_start_;
+  }
+
   PyObject* invoke(PyObject* func, PyObject** args, Py_ssize_t nargs) const {
     return vectorcall_entry_(func, args, nargs, NULL);
   }
@@ -80,6 +89,7 @@ class CompiledFunction {
   DISALLOW_COPY_AND_ASSIGN(CompiledFunction);
 
   vectorcallfunc const vectorcall_entry_;
+  void* const code_start_;
   void* const static_entry_;
   CodeRuntime* const code_runtime_;
   const int code_size_;
@@ -89,16 +99,18 @@ class CompiledFunction {
   hir::OpcodeCounts hir_opcode_counts_;
 };
 
-// same as CompiledFunction class but keeps HIR and LIR classes for debug
-// purposes
+// same as CompiledFunction class but keeps HIR and LIR classes, and the arena
+// they were allocated from, for debug purposes
 class CompiledFunctionDebug : public CompiledFunction {
  public:
   template <typename... Args>
   CompiledFunctionDebug(
+      std::unique_ptr<CompileArena> arena,
       std::unique_ptr<hir::Function> irfunc,
       std::unique_ptr<codegen::NativeGenerator> ngen,
       Args&&... args)
       : CompiledFunction(std::forward<Args>(args)...),
+        arena_(std::move(arena)),
         irfunc_(std::move(irfunc)),
         ngen_(std::move(ngen)) {}
 
@@ -106,6 +118,8 @@ class CompiledFunctionDebug : public CompiledFunction {
   void printHIR() const override;
 
  private:
+  // Declared first so it's destroyed last.
+  std::unique_ptr<CompileArena> arena_;
   std::unique_ptr<hir::Function> irfunc_;
   std::unique_ptr<codegen::NativeGenerator> ngen_;
 };
@@ -117,6 +131,11 @@ typedef std::function<
 enum PassConfig : uint64_t {
   kDefault = 0,
   kEnableHIRInliner = 1 << 0,
+  // Run only the passes needed to produce correct code, for baseline (tier 1)
+  // code that's replaced by fully optimized code if it gets hot.
+  kBaseline = 1 << 1,
+  // Turn self-calls in tail position into loops.
+  kEnableTailCallElimination = 1 << 2,
 };
 
 // Compiler is the high-level interface for translating Python functions into
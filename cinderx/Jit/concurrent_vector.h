@@ -0,0 +1,118 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#pragma once
+
+#include "cinderx/Common/log.h"
+#include "cinderx/Common/util.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace jit {
+
+// An append-only vector that multiple threads can append to at once without
+// locking. Elements never move once they've been added.
+//
+// Elements are stored in segments that double in size, so segment k holds
+// kFirstSegmentSize << k elements. Appending claims an index with an atomic
+// increment and allocates the index's segment if nobody has yet.
+//
+// An element may be accessed by the thread that added it as soon as
+// emplace_back() returns, and by other threads once they've synchronized with
+// that thread, e.g. by joining it or taking a lock it released. size() may
+// count elements that are still being constructed while an append is in
+// progress.
+template <typename T, std::size_t kFirstSegmentSize = 64>
+class ConcurrentVector {
+  static_assert(
+      std::has_single_bit(kFirstSegmentSize),
+      "First segment size must be a power of two");
+
+ public:
+  ConcurrentVector() = default;
+
+  ~ConcurrentVector() {
+    std::size_t size = size_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < size; ++i) {
+      (*this)[i].~T();
+    }
+    for (auto& segment : segments_) {
+      ::operator delete(
+          segment.load(std::memory_order_relaxed),
+          std::align_val_t{alignof(T)});
+    }
+  }
+
+  // Construct a new element at the end of the vector, returning its index.
+  template <typename... Args>
+  std::size_t emplace_back(Args&&... args) {
+    std::size_t index = size_.fetch_add(1, std::memory_order_relaxed);
+    auto [segment, offset] = locate(index);
+    T* storage = segments_[segment].load(std::memory_order_acquire);
+    if (storage == nullptr) {
+      storage = allocateSegment(segment);
+    }
+    new (storage + offset) T(std::forward<Args>(args)...);
+    return index;
+  }
+
+  T& operator[](std::size_t index) {
+    auto [segment, offset] = locate(index);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  const T& operator[](std::size_t index) const {
+    auto [segment, offset] = locate(index);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  std::size_t size() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentVector);
+
+  // Enough segments to cover any index that fits in a size_t.
+  static constexpr std::size_t kNumSegments =
+      sizeof(std::size_t) * 8 - std::countr_zero(kFirstSegmentSize);
+
+  static constexpr std::size_t segmentSize(std::size_t segment) {
+    return kFirstSegmentSize << segment;
+  }
+
+  // Returns the segment holding index, and index's offset within it.
+  static std::pair<std::size_t, std::size_t> locate(std::size_t index) {
+    std::size_t scaled = index / kFirstSegmentSize + 1;
+    std::size_t segment = std::bit_width(scaled) - 1;
+    std::size_t segment_start =
+        kFirstSegmentSize * ((std::size_t{1} << segment) - 1);
+    return {segment, index - segment_start};
+  }
+
+  T* allocateSegment(std::size_t segment) {
+    JIT_CHECK(segment < kNumSegments, "ConcurrentVector is full");
+    auto storage = static_cast<T*>(::operator new(
+        segmentSize(segment) * sizeof(T), std::align_val_t{alignof(T)}));
+    T* expected = nullptr;
+    if (!segments_[segment].compare_exchange_strong(
+            expected,
+            storage,
+            std::memory_order_acq_rel,
+            std::memory_order_acquire)) {
+      // Another thread got there first.
+      ::operator delete(storage, std::align_val_t{alignof(T)});
+      return expected;
+    }
+    return storage;
+  }
+
+  std::array<std::atomic<T*>, kNumSegments> segments_{};
+  std::atomic<std::size_t> size_{0};
+};
+
+} // namespace jit
@@ -33,6 +33,12 @@ struct Config {
   bool multiple_code_sections{false};
   bool multithreaded_compile_test{false};
   bool use_huge_pages{true};
+  // Before each fork(), make the code allocated so far read-only and put later
+  // code on fresh pages, so child processes keep sharing the parent's code.
+  bool seal_code_before_fork{false};
+  // Place each function's code next to its JIT-compiled caller, or a callee,
+  // and align loop heads in hot code to cache lines.
+  bool code_placement{false};
   size_t batch_compile_workers{0};
   // Sizes (in bytes) of the hot and cold code sections. Only applicable if
   // multiple code sections are enabled.
@@ -43,6 +49,35 @@ struct Config {
   uint32_t attr_cache_size{1};
   uint32_t auto_jit_threshold{0};
   uint32_t auto_jit_profile_threshold{0};
+  // Compile functions that cross auto_jit_threshold on a background thread,
+  // running them in the interpreter until they're compiled.
+  bool async_compile{false};
+  // Number of loop back-edges an interpreted frame takes before the
+  // interpreter tries to transfer into an on-stack replacement entry. 0
+  // disables OSR.
+  uint32_t osr_threshold{0};
+  // Number of guard failures in a compiled function after which it is thrown
+  // away and recompiled without the speculation that failed. 0 disables
+  // recompilation.
+  uint32_t recompile_threshold{0};
+  // Number of calls after which a function's baseline (tier 1) code, compiled
+  // with minimal optimization, is replaced by fully optimized (tier 2) code. 0
+  // disables tiered compilation, fully optimizing everything up front.
+  uint32_t tier2_threshold{0};
+  // Weigh register allocator spill decisions by loop depth and use count, and
+  // coalesce copies, rather than spilling the value used furthest away.
+  bool regalloc_spill_costs{false};
+  // Keep register allocator reloads out of loops in every function, not just
+  // in tier 2 code.
+  bool regalloc_split_outside_loops{false};
+  // Call JIT-compiled Python functions from JIT code through their native
+  // entry point, passing arguments in registers, rather than through
+  // vectorcall.
+  bool direct_calls{false};
+  // Turn calls functions make to themselves just before returning into jumps,
+  // so such recursion doesn't push a frame per call. The elided frames still
+  // count towards the recursion limit and show up in tracebacks.
+  bool tail_call_elimination{false};
   bool compile_perf_trampoline_prefork{false};
 };
 
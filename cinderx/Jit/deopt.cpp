@@ -13,6 +13,7 @@
 #include <folly/tracing/StaticTracepoint.h>
 
 #include <bit>
+#include <functional>
 #include <shared_mutex>
 
 using jit::codegen::PhyLocation;
@@ -78,8 +79,10 @@ Ref<> MemoryView::readOwned(const LiveValue& value) const {
     }
     case jit::hir::ValueKind::kUnsigned:
       return Ref<>::steal(PyLong_FromSize_t(raw));
-    case hir::ValueKind::kDouble:
-      return Ref<>::steal(PyFloat_FromDouble(raw));
+    case hir::ValueKind::kDouble: {
+      double raw_double = bit_cast<double, uint64_t>(raw);
+      return Ref<>::steal(PyFloat_FromDouble(raw_double));
+    }
     case jit::hir::ValueKind::kBool:
       return Ref<>::create(raw ? Py_True : Py_False);
     case jit::hir::ValueKind::kObject:
@@ -88,19 +91,95 @@ Ref<> MemoryView::readOwned(const LiveValue& value) const {
   JIT_ABORT("Unhandled ValueKind");
 }
 
+Py_ssize_t MemoryView::readSigned(const LiveValue& value) const {
+  JIT_CHECK(
+      value.value_kind == jit::hir::ValueKind::kSigned,
+      "cannot read a signed integer from a {} value",
+      value.value_kind);
+  return bit_cast<Py_ssize_t, uint64_t>(readRaw(value));
+}
+
+static Ref<> materializeVirtualObject(
+    const DeoptMetadata& meta,
+    const DeoptVirtualObject& virt,
+    const MemoryView& mem,
+    MaterializedObjects& materialized);
+
+// Read the value with index `idx` in `meta`, allocating it first if it's a
+// virtual object that hasn't been materialized yet.
+static Ref<> readOwnedValue(
+    const DeoptMetadata& meta,
+    int idx,
+    const MemoryView& mem,
+    MaterializedObjects& materialized) {
+  if (const LiveValue* value = meta.getValue(idx)) {
+    return mem.readOwned(*value);
+  }
+  auto it = materialized.find(idx);
+  if (it != materialized.end()) {
+    return Ref<>::create(it->second);
+  }
+  const DeoptVirtualObject* virt = meta.getVirtualObject(idx);
+  JIT_CHECK(virt != nullptr, "No value with index {}", idx);
+  Ref<> obj = materializeVirtualObject(meta, *virt, mem, materialized);
+  materialized.emplace(idx, Ref<>::create(obj));
+  return obj;
+}
+
+static Ref<> materializeVirtualObject(
+    const DeoptMetadata& meta,
+    const DeoptVirtualObject& virt,
+    const MemoryView& mem,
+    MaterializedObjects& materialized) {
+  const std::vector<int>& elements = virt.elements;
+  Py_ssize_t size = elements.size();
+  auto read = [&](int idx) {
+    return readOwnedValue(meta, idx, mem, materialized);
+  };
+  switch (virt.kind) {
+    case hir::VirtualObject::Kind::kTuple: {
+      auto tuple = Ref<>::steal(PyTuple_New(size));
+      JIT_CHECK(tuple != nullptr, "Failed to materialize tuple");
+      for (Py_ssize_t i = 0; i < size; ++i) {
+        PyTuple_SET_ITEM(tuple.get(), i, read(elements[i]).release());
+      }
+      return tuple;
+    }
+    case hir::VirtualObject::Kind::kList: {
+      auto list = Ref<>::steal(PyList_New(size));
+      JIT_CHECK(list != nullptr, "Failed to materialize list");
+      for (Py_ssize_t i = 0; i < size; ++i) {
+        PyList_SET_ITEM(list.get(), i, read(elements[i]).release());
+      }
+      return list;
+    }
+    case hir::VirtualObject::Kind::kSlice: {
+      JIT_CHECK(size == 2 || size == 3, "Bad slice size {}", size);
+      Ref<> start = read(elements[0]);
+      Ref<> stop = read(elements[1]);
+      Ref<> step = size == 3 ? read(elements[2]) : nullptr;
+      auto slice = Ref<>::steal(PySlice_New(start, stop, step));
+      JIT_CHECK(slice != nullptr, "Failed to materialize slice");
+      return slice;
+    }
+  }
+  JIT_ABORT("Unhandled VirtualObject kind");
+}
+
 static void reifyLocalsplus(
     PyFrameObject* frame,
     const DeoptMetadata& meta,
     const DeoptFrameMetadata& frame_meta,
-    const MemoryView& mem) {
+    const MemoryView& mem,
+    MaterializedObjects& materialized) {
   for (std::size_t i = 0; i < frame_meta.localsplus.size(); i++) {
-    auto value = meta.getLocalValue(i, frame_meta);
-    if (value == nullptr) {
+    int idx = frame_meta.localsplus[i];
+    if (idx == -1) {
       // Value is dead
       Py_CLEAR(frame->f_localsplus[i]);
       continue;
     }
-    PyObject* obj = mem.readOwned(*value).release();
+    PyObject* obj = readOwnedValue(meta, idx, mem, materialized).release();
     Py_XSETREF(frame->f_localsplus[i], obj);
   }
 }
@@ -109,12 +188,13 @@ static void reifyStack(
     PyFrameObject* frame,
     const DeoptMetadata& meta,
     const DeoptFrameMetadata& frame_meta,
-    const MemoryView& mem) {
+    const MemoryView& mem,
+    MaterializedObjects& materialized) {
   frame->f_stackdepth = frame_meta.stack.size();
   for (int i = frame_meta.stack.size() - 1; i >= 0; i--) {
-    const auto& value = meta.getStackValue(i, frame_meta);
-    Ref<> obj = mem.readOwned(value);
-    if (value.isLoadMethodResult()) {
+    const LiveValue* value = meta.getStackValue(i, frame_meta);
+    Ref<> obj = readOwnedValue(meta, frame_meta.stack[i], mem, materialized);
+    if (value != nullptr && value->isLoadMethodResult()) {
       // When we are deoptimizing a JIT-compiled function that contains an
       // optimizable LoadMethod, we need to be able to know whether or not the
       // LoadMethod returned a bound method object in order to properly
@@ -182,7 +262,8 @@ static void reifyFrameImpl(
     const DeoptMetadata& meta,
     bool for_gen_resume,
     const DeoptFrameMetadata& frame_meta,
-    const uint64_t* regs) {
+    const uint64_t* regs,
+    MaterializedObjects* materialized) {
   frame->f_locals = NULL;
   frame->f_trace = NULL;
   frame->f_trace_opcodes = 0;
@@ -207,8 +288,12 @@ static void reifyFrameImpl(
     frame->f_lasti--;
   }
   MemoryView mem{regs};
-  reifyLocalsplus(frame, meta, frame_meta, mem);
-  reifyStack(frame, meta, frame_meta, mem);
+  MaterializedObjects local_materialized;
+  if (materialized == nullptr) {
+    materialized = &local_materialized;
+  }
+  reifyLocalsplus(frame, meta, frame_meta, mem, *materialized);
+  reifyStack(frame, meta, frame_meta, mem, *materialized);
   reifyBlockStack(frame, frame_meta.block_stack);
   // Generator/frame linkage happens in `materializePyFrame` in frame.cpp
 }
@@ -217,8 +302,9 @@ void reifyFrame(
     PyFrameObject* frame,
     const DeoptMetadata& meta,
     const DeoptFrameMetadata& frame_meta,
-    const uint64_t* regs) {
-  reifyFrameImpl(frame, meta, false, frame_meta, regs);
+    const uint64_t* regs,
+    MaterializedObjects* materialized) {
+  reifyFrameImpl(frame, meta, false, frame_meta, regs, materialized);
 }
 
 void reifyGeneratorFrame(
@@ -228,7 +314,7 @@ void reifyGeneratorFrame(
     const void* base) {
   uint64_t regs[codegen::PhyLocation::NUM_GP_REGS]{};
   regs[codegen::PhyLocation::RBP] = reinterpret_cast<uint64_t>(base);
-  reifyFrameImpl(frame, meta, true, frame_meta, regs);
+  reifyFrameImpl(frame, meta, true, frame_meta, regs, nullptr);
 }
 
 void releaseRefs(const DeoptMetadata& meta, const MemoryView& mem) {
@@ -264,6 +350,7 @@ static DeoptReason getDeoptReason(const jit::hir::DeoptBase& instr) {
     case jit::hir::Opcode::kCheckField: {
       return DeoptReason::kUnhandledNullField;
     }
+    case jit::hir::Opcode::kCheckedIntBinaryOp:
     case jit::hir::Opcode::kDeopt:
     case jit::hir::Opcode::kDeoptPatchpoint:
     case jit::hir::Opcode::kGuard:
@@ -330,14 +417,29 @@ DeoptMetadata DeoptMetadata::fromInstr(
     i++;
   }
 
-  auto get_reg_idx = [&reg_idx](jit::hir::Register* reg) {
-    if (reg == nullptr) {
-      return -1;
-    }
-    auto it = reg_idx.find(reg);
-    JIT_CHECK(it != reg_idx.end(), "register {} not live", reg->name());
-    return it->second;
-  };
+  std::function<int(jit::hir::Register*)> get_reg_idx =
+      [&](jit::hir::Register* reg) {
+        if (reg == nullptr) {
+          return -1;
+        }
+        auto it = reg_idx.find(reg);
+        if (it != reg_idx.end()) {
+          return it->second;
+        }
+        JIT_CHECK(
+            reg->instr()->IsVirtualObject(), "register {} not live", reg->name());
+        // Virtual objects are numbered after the live values, and their
+        // elements come before them so they can be materialized in order.
+        auto virt = static_cast<const hir::VirtualObject*>(reg->instr());
+        DeoptVirtualObject obj{.kind = virt->kind(), .elements = {}};
+        for (std::size_t j = 0, n = virt->NumOperands(); j < n; ++j) {
+          obj.elements.push_back(get_reg_idx(virt->GetOperand(j)));
+        }
+        meta.virtual_objects.emplace_back(std::move(obj));
+        int idx = meta.live_values.size() + meta.virtual_objects.size() - 1;
+        reg_idx[reg] = idx;
+        return idx;
+      };
 
   auto populate_localsplus =
       [get_reg_idx](DeoptFrameMetadata& meta, hir::FrameState* fs) {
@@ -392,8 +494,21 @@ DeoptMetadata DeoptMetadata::fromInstr(
     meta.guilty_value = get_reg_idx(guilty_reg);
   }
 
+  const hir::FrameState* outer = fs;
+  while (outer->parent != nullptr) {
+    outer = outer->parent;
+  }
+  if (outer->elided_frames != nullptr) {
+    meta.elided_frames = get_reg_idx(outer->elided_frames);
+    meta.tail_call_offset = outer->tail_call_offset;
+  }
+
   meta.nonce = instr.nonce();
   meta.reason = getDeoptReason(instr);
+  meta.origin_offset = instr.bytecodeOffset();
+  if (meta.origin_offset < BCOffset{0}) {
+    meta.origin_offset = meta.instr_offset();
+  }
   JIT_CHECK(
       meta.reason != DeoptReason::kUnhandledNullField ||
           meta.guilty_value != -1,
@@ -425,4 +540,201 @@ DeoptMetadata DeoptMetadata::fromInstr(
   return meta;
 }
 
+template <typename T>
+static std::size_t vectorBytes(const std::vector<T>& vec) {
+  return vec.capacity() * sizeof(T);
+}
+
+std::size_t DeoptMetadata::memoryUsage() const {
+  std::size_t bytes = sizeof(*this) + vectorBytes(live_values) +
+      vectorBytes(virtual_objects) + vectorBytes(frame_meta);
+  for (const DeoptVirtualObject& obj : virtual_objects) {
+    bytes += vectorBytes(obj.elements);
+  }
+  for (const DeoptFrameMetadata& frame : frame_meta) {
+    bytes += vectorBytes(frame.localsplus) + vectorBytes(frame.stack) +
+        frame.block_stack.size() * sizeof(hir::ExecutionBlock);
+  }
+  return bytes;
+}
+
+namespace {
+
+// Writes integers as LEB128 varints. Signed values are zigzag encoded first,
+// so small negative numbers like the -1 used for dead locals take one byte.
+class VarintWriter {
+ public:
+  void writeUnsigned(uint64_t value) {
+    while (value >= 0x80) {
+      bytes_.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    bytes_.push_back(static_cast<uint8_t>(value));
+  }
+
+  void writeSigned(int64_t value) {
+    writeUnsigned(
+        (static_cast<uint64_t>(value) << 1) ^
+        static_cast<uint64_t>(value >> 63));
+  }
+
+  void writePointer(const void* ptr) {
+    writeUnsigned(reinterpret_cast<uintptr_t>(ptr));
+  }
+
+  template <typename T>
+  void writeIndices(const std::vector<T>& indices) {
+    writeUnsigned(indices.size());
+    for (T idx : indices) {
+      writeSigned(idx);
+    }
+  }
+
+  std::vector<uint8_t>& bytes() {
+    return bytes_;
+  }
+
+ private:
+  std::vector<uint8_t> bytes_;
+};
+
+class VarintReader {
+ public:
+  explicit VarintReader(const uint8_t* bytes) : ptr_{bytes} {}
+
+  uint64_t readUnsigned() {
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+      byte = *ptr_++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    return value;
+  }
+
+  int64_t readSigned() {
+    uint64_t value = readUnsigned();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  template <typename T>
+  T* readPointer() {
+    return reinterpret_cast<T*>(static_cast<uintptr_t>(readUnsigned()));
+  }
+
+  template <typename T>
+  void readIndices(std::vector<T>& indices) {
+    indices.resize(readUnsigned());
+    for (T& idx : indices) {
+      idx = static_cast<T>(readSigned());
+    }
+  }
+
+ private:
+  const uint8_t* ptr_;
+};
+
+// LiveValue's three small enums share a byte.
+constexpr int kValueKindShift = 2;
+constexpr int kSourceShift = 5;
+
+} // namespace
+
+PackedDeoptMetadata::PackedDeoptMetadata(const DeoptMetadata& meta) {
+  VarintWriter w;
+  w.writePointer(meta.eh_name.get());
+  w.writePointer(meta.code_rt);
+  w.writePointer(meta.descr);
+  w.writeSigned(meta.guilty_value);
+  w.writeSigned(meta.nonce);
+  w.writeUnsigned(static_cast<uint64_t>(meta.reason));
+  w.writeSigned(meta.origin_offset.value());
+  w.writeSigned(meta.elided_frames);
+  w.writeSigned(meta.tail_call_offset.value());
+
+  w.writeUnsigned(meta.live_values.size());
+  for (const LiveValue& value : meta.live_values) {
+    w.writeSigned(value.location.loc);
+    w.writeUnsigned(
+        static_cast<uint64_t>(value.ref_kind) |
+        (static_cast<uint64_t>(value.value_kind) << kValueKindShift) |
+        (static_cast<uint64_t>(value.source) << kSourceShift));
+  }
+
+  w.writeUnsigned(meta.virtual_objects.size());
+  for (const DeoptVirtualObject& obj : meta.virtual_objects) {
+    w.writeUnsigned(static_cast<uint64_t>(obj.kind));
+    w.writeIndices(obj.elements);
+  }
+
+  w.writeUnsigned(meta.frame_meta.size());
+  for (const DeoptFrameMetadata& frame : meta.frame_meta) {
+    w.writeIndices(frame.localsplus);
+    w.writeIndices(frame.stack);
+    w.writeUnsigned(frame.block_stack.size());
+    for (const hir::ExecutionBlock& block : frame.block_stack) {
+      w.writeUnsigned(block.opcode);
+      w.writeSigned(block.handler_off.value());
+      w.writeSigned(block.stack_level);
+    }
+    w.writePointer(frame.code);
+    w.writeSigned(frame.next_instr_offset.value());
+  }
+
+  std::vector<uint8_t>& bytes = w.bytes();
+  size_ = bytes.size();
+  bytes_ = std::make_unique<uint8_t[]>(size_);
+  std::copy(bytes.begin(), bytes.end(), bytes_.get());
+}
+
+DeoptMetadata PackedDeoptMetadata::unpack() const {
+  JIT_CHECK(bytes_ != nullptr, "Unpacking empty deopt metadata");
+  VarintReader r{bytes_.get()};
+  DeoptMetadata meta;
+  meta.eh_name = r.readPointer<PyObject>();
+  meta.code_rt = r.readPointer<CodeRuntime>();
+  meta.descr = r.readPointer<const char>();
+  meta.guilty_value = r.readSigned();
+  meta.nonce = r.readSigned();
+  meta.reason = static_cast<DeoptReason>(r.readUnsigned());
+  meta.origin_offset = BCOffset{r.readSigned()};
+  meta.elided_frames = r.readSigned();
+  meta.tail_call_offset = BCOffset{r.readSigned()};
+
+  meta.live_values.resize(r.readUnsigned());
+  for (LiveValue& value : meta.live_values) {
+    value.location = PhyLocation{static_cast<int>(r.readSigned())};
+    uint64_t kinds = r.readUnsigned();
+    value.ref_kind = static_cast<hir::RefKind>(kinds & 3);
+    value.value_kind =
+        static_cast<hir::ValueKind>((kinds >> kValueKindShift) & 7);
+    value.source = static_cast<LiveValue::Source>(kinds >> kSourceShift);
+  }
+
+  meta.virtual_objects.resize(r.readUnsigned());
+  for (DeoptVirtualObject& obj : meta.virtual_objects) {
+    obj.kind = static_cast<hir::VirtualObject::Kind>(r.readUnsigned());
+    r.readIndices(obj.elements);
+  }
+
+  meta.frame_meta.resize(r.readUnsigned());
+  for (DeoptFrameMetadata& frame : meta.frame_meta) {
+    r.readIndices(frame.localsplus);
+    r.readIndices(frame.stack);
+    std::size_t num_blocks = r.readUnsigned();
+    for (std::size_t i = 0; i < num_blocks; i++) {
+      hir::ExecutionBlock block;
+      block.opcode = static_cast<int>(r.readUnsigned());
+      block.handler_off = BCOffset{r.readSigned()};
+      block.stack_level = static_cast<int>(r.readSigned());
+      frame.block_stack.push(block);
+    }
+    frame.code = r.readPointer<PyCodeObject>();
+    frame.next_instr_offset = BCOffset{r.readSigned()};
+  }
+  return meta;
+}
+
 } // namespace jit
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Python.h"
+#include "cinderx/Common/util.h"
 
 #include "cinderx/Jit/codegen/x86_64.h"
 #include "cinderx/Jit/hir/hir.h"
@@ -13,6 +14,8 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace jit {
@@ -64,6 +67,8 @@ struct LiveValue {
     return source == Source::kLoadMethod;
   }
 
+  bool operator==(const LiveValue& other) const = default;
+
   std::string toString() const {
     return fmt::format(
         "{}:{}:{}:{}",
@@ -93,6 +98,18 @@ enum class DeoptReason : char {
 
 const char* deoptReasonName(DeoptReason reason);
 
+// An object whose allocation was removed by escape analysis (see
+// hir::VirtualObject). It's allocated and filled in only when deoptimizing.
+struct DeoptVirtualObject {
+  hir::VirtualObject::Kind kind;
+
+  // Index of the value for each element, in the same space as the indices in
+  // DeoptFrameMetadata.
+  std::vector<int> elements;
+
+  bool operator==(const DeoptVirtualObject& other) const = default;
+};
+
 // Deopt metadata that is specific to a particular (shadow) frame whose code
 // may have been inlined.
 struct DeoptFrameMetadata {
@@ -105,6 +122,9 @@ struct DeoptFrameMetadata {
   // Index into live_values for each entry in the operand stack.
   std::vector<int> stack;
 
+  // Indices in localsplus and stack that are past the end of live_values refer
+  // to DeoptMetadata::virtual_objects instead.
+
   jit::hir::BlockStack block_stack;
 
   // Code object associated with the JIT-compiled inlined function from which
@@ -119,6 +139,8 @@ struct DeoptFrameMetadata {
         next_instr_offset - int{sizeof(_Py_CODEUNIT)},
         BCOffset{-int{sizeof(_Py_CODEUNIT)}});
   }
+
+  bool operator==(const DeoptFrameMetadata& other) const = default;
 };
 
 // DeoptMetadata captures all the information necessary to reconstruct a
@@ -131,6 +153,10 @@ struct DeoptMetadata {
   // All live values
   std::vector<LiveValue> live_values;
 
+  // Objects that have to be materialized when deoptimizing, following
+  // live_values in index order.
+  std::vector<DeoptVirtualObject> virtual_objects;
+
   // Stack of inlined frame metadata unwound from the deopting instruction.
   std::vector<DeoptFrameMetadata> frame_meta;
 
@@ -152,6 +178,18 @@ struct DeoptMetadata {
   // Why we are de-opting
   DeoptReason reason{DeoptReason::kUnhandledException};
 
+  // Offset in code() of the bytecode instruction the deopting instruction was
+  // emitted for. This is where a guard's speculation was made, even if an
+  // optimization like LICM moved the guard and gave it another FrameState.
+  BCOffset origin_offset{-1};
+
+  // If not -1, index into live_values for the number of self tail calls that
+  // TailCallElimination turned into jumps in the outermost frame. The frames
+  // they would have pushed are still counted in the recursion depth, and
+  // appear in the traceback at tail_call_offset if the frame raises.
+  int elided_frames{-1};
+  BCOffset tail_call_offset{-1};
+
   BCOffset instr_offset() const {
     /* This is tricky: For guard failures, the `next_instr_offset` points to the
        instruction itself, but for exceptions, the next_instr_offset is the
@@ -173,17 +211,30 @@ struct DeoptMetadata {
     return frame_meta.size() - 1;
   }
 
-  const LiveValue& getStackValue(int i, const DeoptFrameMetadata& frame) const {
-    return live_values[frame.stack[i]];
+  // Returns nullptr if stack entry `i` is a virtual object.
+  const LiveValue* getStackValue(int i, const DeoptFrameMetadata& frame) const {
+    return getValue(frame.stack[i]);
   }
 
-  // Returns nullptr if local `i` is dead
+  // Returns nullptr if local `i` is dead or a virtual object.
   const LiveValue* getLocalValue(int i, const DeoptFrameMetadata& frame) const {
-    int v = frame.localsplus[i];
-    if (v == -1) {
+    return getValue(frame.localsplus[i]);
+  }
+
+  // Returns nullptr if `idx` is -1 or refers to a virtual object.
+  const LiveValue* getValue(int idx) const {
+    if (idx == -1 || static_cast<size_t>(idx) >= live_values.size()) {
+      return nullptr;
+    }
+    return &live_values[idx];
+  }
+
+  // Returns nullptr if `idx` doesn't refer to a virtual object.
+  const DeoptVirtualObject* getVirtualObject(int idx) const {
+    if (idx == -1 || static_cast<size_t>(idx) < live_values.size()) {
       return nullptr;
     }
-    return &live_values[v];
+    return &virtual_objects[idx - live_values.size()];
   }
 
   // Returns nullptr if there is no guilty value.
@@ -201,11 +252,12 @@ struct DeoptMetadata {
     }
     return fmt::format(
         "DeoptMetadata {{ reason={}, descr={}, inline_depth={}, "
-        "live_values=<{}> }}",
+        "live_values=<{}>, virtual_objects={} }}",
         deoptReasonName(reason),
         descr,
         inline_depth(),
-        fmt::join(live_value_strings, ", "));
+        fmt::join(live_value_strings, ", "),
+        virtual_objects.size());
   }
 
   // Construct a `DeoptMetadata` instance from the information in `instr`.
@@ -215,6 +267,34 @@ struct DeoptMetadata {
   static DeoptMetadata fromInstr(
       const jit::hir::DeoptBase& instr,
       CodeRuntime* code_rt);
+
+  // Approximate number of bytes used by this DeoptMetadata, including the
+  // contents of its vectors.
+  std::size_t memoryUsage() const;
+
+  // Two deopts with equal metadata rebuild the same frames from the same
+  // locations and are reported the same way, so they can share it.
+  bool operator==(const DeoptMetadata& other) const = default;
+};
+
+// A DeoptMetadata packed into a string of varints, for deopt points that are
+// only looked at when a deopt actually happens. Functions with lots of guards
+// use several times less memory on their metadata this way.
+class PackedDeoptMetadata {
+ public:
+  PackedDeoptMetadata() = default;
+
+  explicit PackedDeoptMetadata(const DeoptMetadata& meta);
+
+  DeoptMetadata unpack() const;
+
+  std::size_t size() const {
+    return size_;
+  }
+
+ private:
+  std::unique_ptr<uint8_t[]> bytes_;
+  std::size_t size_{0};
 };
 
 // Update `frame` so that execution can resume in the interpreter.
@@ -232,13 +312,23 @@ struct DeoptMetadata {
 // We expect `frame` to already have `globals`, `code`, and `builtins`
 // initialized.
 //
+// Virtual objects materialized during a deopt, keyed by their value index in
+// the DeoptMetadata. Every slot that refers to the same virtual object gets a
+// reference to the same materialized object.
+using MaterializedObjects = std::unordered_map<int, Ref<>>;
+
 // May return a reference to an object that is relevant to the deopt event. The
 // meaning of this object depends on meta.reason.
+//
+// When reifying several frames for the same deopt event, pass the same
+// `materialized` to each call so that virtual objects shared between frames
+// keep their identity.
 void reifyFrame(
     PyFrameObject* frame,
     const DeoptMetadata& meta,
     const DeoptFrameMetadata& frame_meta,
-    const uint64_t* regs);
+    const uint64_t* regs,
+    MaterializedObjects* materialized = nullptr);
 
 // Like reifyFrame(), but for a suspended generator. Takes a single base
 // pointer for spill data rather than a full set of registers.
@@ -254,6 +344,7 @@ struct MemoryView {
 
   BorrowedRef<> readBorrowed(const LiveValue& value) const;
   Ref<> readOwned(const LiveValue& value) const;
+  Py_ssize_t readSigned(const LiveValue& value) const;
 
  private:
   uint64_t readRaw(const LiveValue& value) const {
@@ -279,3 +370,23 @@ Ref<> profileDeopt(
     const MemoryView& mem);
 
 } // namespace jit
+
+template <>
+struct std::hash<jit::DeoptMetadata> {
+  std::size_t operator()(const jit::DeoptMetadata& meta) const {
+    std::size_t hash = jit::combineHash(
+        std::hash<int>{}(static_cast<int>(meta.reason)),
+        std::hash<jit::BCOffset>{}(meta.origin_offset),
+        std::hash<const void*>{}(meta.descr),
+        std::hash<int>{}(meta.guilty_value));
+    for (const jit::LiveValue& value : meta.live_values) {
+      hash = jit::combineHash(
+          hash, std::hash<jit::codegen::PhyLocation>{}(value.location));
+    }
+    for (const jit::DeoptFrameMetadata& frame : meta.frame_meta) {
+      hash = jit::combineHash(
+          hash, std::hash<jit::BCOffset>{}(frame.next_instr_offset));
+    }
+    return hash;
+  }
+};
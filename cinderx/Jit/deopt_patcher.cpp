@@ -4,6 +4,7 @@
 
 #include "cinderx/Common/log.h"
 #include "cinderx/Common/util.h"
+#include "cinderx/Jit/code_allocator.h"
 
 #include <cstring>
 
@@ -19,6 +20,7 @@ constexpr int kJmpSize = 5;
 void DeoptPatcher::patch() {
   JIT_CHECK(patchpoint_ != nullptr, "not linked!");
   JIT_DLOG("Patching DeoptPatchPoint at {}", static_cast<void*>(patchpoint_));
+  makeCodeWritable(patchpoint_, kJmpSize);
   // 32 bit relative jump - https://www.felixcloutier.com/x86/jmp
   patchpoint_[0] = 0xe9;
   std::memcpy(patchpoint_ + 1, &jmp_disp_, sizeof(jmp_disp_));
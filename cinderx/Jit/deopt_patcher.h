@@ -52,6 +52,13 @@ class DeoptPatcher {
   // a signed 32 bit int.
   void link(uintptr_t patchpoint, uintptr_t deopt_exit);
 
+  // Return true if the patcher is linked to a patchpoint in the given range of
+  // code.
+  bool isLinkedInto(const void* code, size_t size) const {
+    auto start = static_cast<const uint8_t*>(code);
+    return patchpoint_ >= start && patchpoint_ < start + size;
+  }
+
   // Write the nop that will be overwritten at runtime when patch() is called.
   static void emitPatchpoint(asmjit::x86::Builder& as);
 
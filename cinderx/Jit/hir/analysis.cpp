@@ -14,6 +14,7 @@
 #include <fmt/ostream.h>
 
 #include <memory>
+#include <unordered_set>
 
 namespace jit::hir {
 
@@ -64,6 +65,7 @@ bool isPassthrough(const Instr& instr) {
     case Opcode::kCallStatic:
     case Opcode::kCallStaticRetVoid:
     case Opcode::kCheckSequenceBounds:
+    case Opcode::kCheckedIntBinaryOp:
     case Opcode::kCompare:
     case Opcode::kCompareBool:
     case Opcode::kCopyDictWithoutKeys:
@@ -157,6 +159,7 @@ bool isPassthrough(const Instr& instr) {
     case Opcode::kUnpackExToTuple:
     case Opcode::kVectorCall:
     case Opcode::kVectorCallKW:
+    case Opcode::kVirtualObject:
     case Opcode::kVectorCallStatic:
     case Opcode::kWaitHandleLoadCoroOrResult:
     case Opcode::kWaitHandleLoadWaiter:
@@ -210,6 +213,32 @@ Register* modelReg(Register* reg) {
   return reg;
 }
 
+const FrameState* frameStateBefore(Instr& instr) {
+  BasicBlock* block = instr.block();
+  auto it = block->iterator_to(instr);
+  std::unordered_set<BasicBlock*> visited;
+  for (;;) {
+    visited.insert(block);
+    for (;;) {
+      if (const FrameState* fs = get_frame_state(*it)) {
+        return fs;
+      }
+      if (it == block->begin()) {
+        break;
+      }
+      --it;
+    }
+    if (block->in_edges().size() != 1) {
+      return nullptr;
+    }
+    block = (*block->in_edges().begin())->from();
+    if (visited.count(block)) {
+      return nullptr;
+    }
+    it = block->iterator_to(*block->GetTerminator());
+  }
+}
+
 bool isLoadMethodBase(const Instr& instr) {
   return dynamic_cast<const LoadMethodBase*>(&instr) != nullptr;
 }
@@ -487,6 +516,19 @@ void ForwardDataflowAnalysis::Run() {
   }
 }
 
+// A VirtualObject is rebuilt from its operands when deoptimizing, so any use of
+// one (which can only be from a FrameState) is also a use of its operands.
+template <typename UseFunc>
+static void useWithVirtualOperands(Register* reg, UseFunc& use) {
+  use(reg);
+  Instr* def = reg->instr();
+  if (def != nullptr && def->IsVirtualObject()) {
+    for (std::size_t i = 0, n = def->NumOperands(); i < n; ++i) {
+      useWithVirtualOperands(def->GetOperand(i), use);
+    }
+  }
+}
+
 template <typename OutputFunc, typename UseFunc>
 static void analyzeInstrLiveness(
     const Instr& instr,
@@ -502,7 +544,7 @@ static void analyzeInstrLiveness(
   }
 
   instr.visitUses([&](Register* reg) {
-    use(reg);
+    useWithVirtualOperands(reg, use);
     return true;
   });
 
@@ -42,6 +42,11 @@ bool isAnyLoadMethod(const Instr& instr);
 // given value, returning the original source of the value.
 Register* modelReg(Register* reg);
 
+// Find the FrameState to use for an instruction inserted immediately before
+// instr, looking back through single-predecessor blocks if needed. Returns
+// nullptr if there isn't one.
+const FrameState* frameStateBefore(Instr& instr);
+
 // Returns true if each instruction in func properly type-checks
 // Writes to err if any failure occurs and returns false
 bool funcTypeChecks(const Function& func, std::ostream& err);
@@ -345,6 +345,27 @@ void HIRBuilder::addLoadArgs(TranslationContext& tc, int num_args) {
   }
 }
 
+// Load the state of an interpreter frame that is transferring into an OSR
+// entry: every variable in localsplus, followed by the live value stack. Locals
+// may be unbound, but cells and freevars were already created by the
+// interpreter.
+void HIRBuilder::addOSRLoads(
+    TranslationContext& tc,
+    const OSREntry& osr_entry) {
+  int arg_idx = 0;
+  for (Register* local : tc.frame.locals) {
+    tc.emit<LoadArg>(local, arg_idx++, TOptObject);
+  }
+  for (Register* cell : tc.frame.cells) {
+    tc.emit<LoadArg>(cell, arg_idx++, TObject);
+  }
+  for (int i = 0; i < osr_entry.stack_depth; i++) {
+    Register* value = temps_.AllocateStack();
+    tc.emit<LoadArg>(value, arg_idx++, TObject);
+    tc.frame.stack.push(value);
+  }
+}
+
 // Add a MakeCell for each cellvar and load each freevar from closure.
 void HIRBuilder::addInitializeCells(
     TranslationContext& tc,
@@ -533,6 +554,19 @@ std::unique_ptr<Function> buildHIR(const Preloader& preloader) {
   return HIRBuilder{preloader}.buildHIR();
 }
 
+bool isOSREntryCandidate(BorrowedRef<PyCodeObject> code, BCOffset loop_header) {
+  for (const BytecodeInstruction& bci : BytecodeInstructionBlock{code}) {
+    if (!bci.IsBranch()) {
+      continue;
+    }
+    // A back-edge that jumps over loop_header belongs to an enclosing loop.
+    if (bci.GetJumpTarget() < loop_header && loop_header <= bci.offset()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // This performs an abstract interpretation over the bytecode for func in order
 // to translate it from a stack to register machine. The translation proceeds
 // in two passes over the bytecode. First, basic block boundaries are
@@ -568,6 +602,35 @@ BasicBlock* HIRBuilder::buildHIRImpl(
   BytecodeInstructionBlock bc_instrs{code_};
   block_map_ = createBlocks(*irfunc, bc_instrs);
 
+  if (frame_state == nullptr && irfunc->osr_entry.has_value()) {
+    // An OSR entry starts from the interpreter's state at a loop header and
+    // never runs the function prologue.
+    const OSREntry& osr_entry = *irfunc->osr_entry;
+    JIT_DCHECK(
+        isOSREntryCandidate(code_, osr_entry.loop_header),
+        "Can't enter {} at {}",
+        preloader_.fullname(),
+        osr_entry.loop_header);
+    BasicBlock* entry_block = irfunc->cfg.AllocateBlock();
+    irfunc->cfg.entry_block = entry_block;
+    TranslationContext entry_tc{
+        entry_block,
+        FrameState{
+            code_,
+            preloader_.globals(),
+            preloader_.builtins(),
+            /*parent=*/nullptr}};
+    AllocateRegistersForLocals(&irfunc->env, entry_tc.frame);
+    AllocateRegistersForCells(&irfunc->env, entry_tc.frame);
+    addOSRLoads(entry_tc, osr_entry);
+
+    BasicBlock* loop_header = getBlockAtOff(osr_entry.loop_header);
+    entry_block->appendWithOff<Branch>(osr_entry.loop_header, loop_header);
+    entry_tc.block = loop_header;
+    translate(*irfunc, bc_instrs, entry_tc);
+    return entry_block;
+  }
+
   // Ensure that the entry block isn't a loop header
   BasicBlock* entry_block = getBlockAtOff(BCOffset{0});
   for (const auto& bci : bc_instrs) {
@@ -596,10 +659,11 @@ BasicBlock* HIRBuilder::buildHIRImpl(
 
   addLoadArgs(entry_tc, preloader_.numArgs());
   Register* cur_func = nullptr;
-  // TODO(emacs): Check if the code object or preloader uses runtime func and
-  // drop the frame_state == nullptr check. Inlined functions should load a
-  // const instead of using LoadCurrentFunc.
-  if (frame_state == nullptr && irfunc->uses_runtime_func) {
+  // An inlined closure's LoadCurrentFunc is replaced by the inliner with the
+  // function being called.
+  bool uses_runtime_func = frame_state == nullptr ? irfunc->uses_runtime_func
+                                                  : usesRuntimeFunc(code_);
+  if (uses_runtime_func) {
     cur_func = temps_.AllocateNonStack();
     entry_tc.emit<LoadCurrentFunc>(cur_func);
   }
@@ -634,6 +698,10 @@ void HIRBuilder::emitProfiledTypes(
     // about its stack inputs.
     return;
   }
+  if (Runtime::get()->isSpeculationRelaxed(tc.frame.code, bc_instr.offset())) {
+    // A guard here failed in an earlier compilation of this code.
+    return;
+  }
 
   std::vector<Type> types = profile_runtime.getProfiledTypes(
       tc.frame.code, code_key, bc_instr.offset());
@@ -1102,7 +1170,18 @@ void HIRBuilder::translate(
           break;
         }
         case GET_ITER: {
-          emitGetIter(tc);
+          // The FOR_ITER starts a new block, so look past the end of this one
+          // with an iterator that folds in any EXTENDED_ARGs.
+          BCIndex next_idx = bc_instr.index() + 1;
+          BytecodeInstructionBlock::Iterator next{
+              bc_instrs.bytecode() + next_idx.value(),
+              next_idx,
+              BCIndex{bc_instrs.endOffset()}};
+          std::optional<BCOffset> for_iter;
+          if (!next.atEnd() && next->opcode() == FOR_ITER) {
+            for_iter = next->offset();
+          }
+          emitGetIter(tc, bc_instr, for_iter);
           break;
         }
         case GET_YIELD_FROM_ITER: {
@@ -1173,7 +1252,7 @@ void HIRBuilder::translate(
           break;
         }
         case FOR_ITER: {
-          emitForIter(tc, bc_instr);
+          emitForIter(irfunc.cfg, tc, bc_instr);
           break;
         }
         case LOAD_FIELD: {
@@ -1344,13 +1423,29 @@ void HIRBuilder::translate(
     BytecodeInstruction last_bc_instr = bc_block.lastInstr();
     switch (last_bc_instr.opcode()) {
       case FOR_ITER: {
-        auto condbr = static_cast<CondBranchIterNotDone*>(last_instr);
+        BasicBlock* body;
+        BasicBlock* footer;
+        if (last_instr->IsBranch()) {
+          // A native range loop ends with a Branch to the loop body; the check
+          // for the end of iteration is in the block before it.
+          JIT_CHECK(
+              tc.block->in_edges().size() == 1,
+              "Range loop should have a single predecessor");
+          BasicBlock* check = (*tc.block->in_edges().begin())->from();
+          body = static_cast<Branch*>(last_instr)->target();
+          footer =
+              static_cast<CondBranch*>(check->GetTerminator())->false_bb();
+        } else {
+          auto condbr = static_cast<CondBranchIterNotDone*>(last_instr);
+          body = condbr->true_bb();
+          footer = condbr->false_bb();
+        }
         auto new_frame = tc.frame;
         // Sentinel value signaling iteration is complete and the iterator
         // itself
         new_frame.stack.discard(2);
-        queue.emplace_back(condbr->true_bb(), tc.frame);
-        queue.emplace_back(condbr->false_bb(), new_frame);
+        queue.emplace_back(body, tc.frame);
+        queue.emplace_back(footer, new_frame);
         break;
       }
       case JUMP_IF_FALSE_OR_POP:
@@ -3082,16 +3177,119 @@ void HIRBuilder::emitStoreSubscr(TranslationContext& tc) {
   tc.emit<StoreSubscr>(result, container, sub, value, tc.frame);
 }
 
-void HIRBuilder::emitGetIter(TranslationContext& tc) {
+// Check if reg holds the result of calling the builtin range(). The global is
+// guarded by the LOAD_GLOBAL that produced the callee, so this deopts if
+// range is shadowed.
+static bool isBuiltinRangeCall(Register* reg) {
+  Instr* def = reg->instr();
+  if (def == nullptr || !def->IsVectorCall()) {
+    return false;
+  }
+  Instr* callee = static_cast<VectorCall*>(def)->func()->instr();
+  return callee != nullptr && callee->IsGuardIs() &&
+      static_cast<GuardIs*>(callee)->target() ==
+      reinterpret_cast<PyObject*>(&PyRange_Type);
+}
+
+void HIRBuilder::emitGetIter(
+    TranslationContext& tc,
+    const jit::BytecodeInstruction& bc_instr,
+    std::optional<BCOffset> for_iter) {
   Register* iterable = tc.frame.stack.pop();
   Register* result = temps_.AllocateStack();
   tc.emit<GetIter>(result, iterable, tc.frame);
   tc.frame.stack.push(result);
+  if (for_iter.has_value() && isBuiltinRangeCall(iterable) &&
+      !Runtime::get()->isSpeculationRelaxed(tc.frame.code, bc_instr.offset())) {
+    // range() falls back to a different iterator type for values that don't
+    // fit in a C long, which is left to the interpreter. The loop only reads
+    // the iterator's fields, so the UseType keeps GuardTypeElimination from
+    // removing the guard.
+    Type range_iter_type = Type::fromTypeExact(&PyRangeIter_Type);
+    tc.snapshot();
+    tc.emit<GuardType>(result, range_iter_type, result);
+    tc.emit<UseType>(result, range_iter_type);
+    range_loops_.emplace(*for_iter);
+  }
+}
+
+// Mirrors rangeiterobject from Objects/rangeobject.c, which isn't exposed in a
+// header.
+struct RangeIterObject {
+  PyObject_HEAD
+  long index;
+  long start;
+  long step;
+  long len;
+};
+
+// Iterate over a range iterator without calling rangeiter_next(). The
+// iterator's index is kept up to date in memory, so the interpreter can pick up
+// where we left off if we deopt, and the value is produced as a CInt64 that is
+// only boxed if something needs it as an object.
+void HIRBuilder::emitRangeForIter(
+    CFG& cfg,
+    TranslationContext& tc,
+    const jit::BytecodeInstruction& bc_instr) {
+  Register* iterator = tc.frame.stack.top();
+  auto load_field = [&](const char* name, std::size_t offset, Type type) {
+    Register* reg = temps_.AllocateStack();
+    tc.emit<LoadField>(reg, iterator, name, offset, type);
+    return reg;
+  };
+  Register* index =
+      load_field("index", offsetof(RangeIterObject, index), TCInt64);
+  Register* len = load_field("len", offsetof(RangeIterObject, len), TCInt64);
+  Register* has_next = temps_.AllocateStack();
+  tc.emit<PrimitiveCompare>(
+      has_next, PrimitiveCompareOp::kLessThan, index, len);
+  BasicBlock* next_block = cfg.AllocateBlock();
+  BasicBlock* footer = getBlockAtOff(bc_instr.GetJumpTarget());
+  tc.emit<CondBranch>(has_next, next_block, footer);
+
+  tc.block = next_block;
+  // Like rangeiter_next(), compute start + index * step in unsigned
+  // arithmetic. The intermediate product can overflow a C long (e.g. for
+  // range(LONG_MAX, LONG_MIN, -1)), but the wrapped result is always the
+  // right value, since every value the iterator produces fits in a C long.
+  Register* start =
+      load_field("start", offsetof(RangeIterObject, start), TCUInt64);
+  Register* step = load_field("step", offsetof(RangeIterObject, step), TCUInt64);
+  Register* unsigned_index = temps_.AllocateStack();
+  tc.emit<BitCast>(unsigned_index, index, TCUInt64);
+  Register* scaled = temps_.AllocateStack();
+  tc.emit<IntBinaryOp>(scaled, BinaryOpKind::kMultiply, unsigned_index, step);
+  Register* unsigned_value = temps_.AllocateStack();
+  tc.emit<IntBinaryOp>(unsigned_value, BinaryOpKind::kAdd, start, scaled);
+  Register* value = temps_.AllocateStack();
+  tc.emit<BitCast>(value, unsigned_value, TCInt64);
+  Register* one = temps_.AllocateStack();
+  tc.emit<LoadConst>(one, Type::fromCInt(1, TCInt64));
+  Register* next_index = temps_.AllocateStack();
+  tc.emit<IntBinaryOp>(next_index, BinaryOpKind::kAdd, index, one);
+  Register* previous = temps_.AllocateStack();
+  tc.emit<LoadConst>(previous, TNullptr);
+  tc.emit<StoreField>(
+      iterator,
+      "index",
+      offsetof(RangeIterObject, index),
+      next_index,
+      TCInt64,
+      previous);
+  Register* next_val = temps_.AllocateStack();
+  boxPrimitive(tc, next_val, value, TCInt64);
+  tc.frame.stack.push(next_val);
+  tc.emit<Branch>(getBlockAtOff(bc_instr.NextInstrOffset()));
 }
 
 void HIRBuilder::emitForIter(
+    CFG& cfg,
     TranslationContext& tc,
     const jit::BytecodeInstruction& bc_instr) {
+  if (range_loops_.count(bc_instr.offset())) {
+    emitRangeForIter(cfg, tc, bc_instr);
+    return;
+  }
   Register* iterator = tc.frame.stack.top();
   Register* next_val = temps_.AllocateStack();
   tc.emit<InvokeIterNext>(next_val, iterator, tc.frame);
@@ -15,6 +15,7 @@
 #include <deque>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -90,6 +91,11 @@ class BlockCanonicalizer {
 // analysis.
 std::unique_ptr<Function> buildHIR(const Preloader& preloader);
 
+// Can code be entered through on-stack replacement at loop_header? Only
+// headers of outermost loops qualify: entering a loop nested inside another
+// would leave the outer loop with a header that doesn't dominate its body.
+bool isOSREntryCandidate(BorrowedRef<PyCodeObject> code, BCOffset loop_header);
+
 // Inlining merges all of the different callee Returns (which terminate blocks,
 // leading to a bunch of distinct exit blocks) into Branches to one Return
 // block (one exit block), which the caller can transform into an Assign to the
@@ -273,7 +279,12 @@ class HIRBuilder {
   bool emitInvokeNative(
       TranslationContext& tc,
       const jit::BytecodeInstruction& bc_instr);
-  void emitGetIter(TranslationContext& tc);
+  // for_iter is the offset of the FOR_ITER that consumes the iterator, if
+  // one immediately follows the GET_ITER.
+  void emitGetIter(
+      TranslationContext& tc,
+      const jit::BytecodeInstruction& bc_instr,
+      std::optional<BCOffset> for_iter);
   void emitGetYieldFromIter(CFG& cfg, TranslationContext& tc);
   void emitListAppend(
       TranslationContext& tc,
@@ -283,6 +294,11 @@ class HIRBuilder {
       const jit::BytecodeInstruction& bc_instr);
   void emitListToTuple(TranslationContext& tc);
   void emitForIter(
+      CFG& cfg,
+      TranslationContext& tc,
+      const jit::BytecodeInstruction& bc_instr);
+  void emitRangeForIter(
+      CFG& cfg,
       TranslationContext& tc,
       const jit::BytecodeInstruction& bc_instr);
   bool emitInvokeMethod(
@@ -441,6 +457,7 @@ class HIRBuilder {
       const FrameState& frame);
   void addInitialYield(TranslationContext& tc);
   void addLoadArgs(TranslationContext& tc, int num_args);
+  void addOSRLoads(TranslationContext& tc, const OSREntry& osr_entry);
   void addInitializeCells(TranslationContext& tc, Register* cur_func);
   void AllocateRegistersForLocals(Environment* env, FrameState& state);
   void AllocateRegistersForCells(Environment* env, FrameState& state);
@@ -486,6 +503,10 @@ class HIRBuilder {
   BlockMap block_map_;
   const Preloader& preloader_;
 
+  // Offsets of FOR_ITER instructions that iterate over a builtin range() and
+  // are lowered to a native counted loop.
+  std::unordered_set<BCOffset> range_loops_;
+
   TempAllocator temps_{nullptr};
 };
 
@@ -0,0 +1,257 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/hir/optimization.h"
+#include "cinderx/Jit/hir/ssa.h"
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace jit::hir {
+
+// This file contains the EscapeAnalysis pass. An allocation is a candidate for
+// removal if every use of its result is one of:
+// - A load of one of its elements, or of its size, that can be answered
+//   directly from the allocation's operands.
+// - An address computation (LoadField/LoadFieldAddress of ob_item) that only
+//   feeds such element loads.
+// - A UseType, which only carries type information.
+// - A FrameState, or the operands of a VirtualObject that is itself only used
+//   by FrameStates.
+//
+// Anything else (a call, a store, a Phi, a return, ...) means the object
+// escapes and has to be allocated for real.
+
+namespace {
+
+// Lists are mutable and larger ones are rarely used as temporary aggregates,
+// so only small ones are considered.
+constexpr std::size_t kMaxVirtualListSize = 8;
+
+struct Uses {
+  // Instructions that use the register as an operand.
+  std::vector<Instr*> users;
+  // Whether the register appears in a FrameState or is an operand of a
+  // VirtualObject.
+  bool in_frame_state{false};
+  // Whether the register is used in a way this pass doesn't understand.
+  bool escapes{false};
+};
+
+using UseMap = std::unordered_map<Register*, Uses>;
+
+UseMap collectUses(Function& irfunc) {
+  UseMap uses;
+  for (auto& block : irfunc.cfg.blocks) {
+    for (auto& instr : block) {
+      for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+        Uses& reg_uses = uses[instr.GetOperand(i)];
+        if (instr.IsVirtualObject()) {
+          reg_uses.in_frame_state = true;
+        } else if (
+            reg_uses.users.empty() || reg_uses.users.back() != &instr) {
+          reg_uses.users.push_back(&instr);
+        }
+      }
+
+      FrameState* fs = nullptr;
+      if (instr.IsSnapshot()) {
+        fs = static_cast<Snapshot&>(instr).frameState();
+      } else if (auto db = instr.asDeoptBase()) {
+        fs = db->frameState();
+        if (db->guiltyReg() != nullptr) {
+          uses[db->guiltyReg()].escapes = true;
+        }
+        for (const RegState& rs : db->live_regs()) {
+          uses[rs.reg].escapes = true;
+        }
+      }
+      if (fs != nullptr) {
+        fs->visitUses([&](Register*& reg) {
+          uses[reg].in_frame_state = true;
+          return true;
+        });
+      }
+    }
+  }
+  return uses;
+}
+
+std::optional<VirtualObject::Kind> virtualKind(const Instr& instr) {
+  if (instr.IsMakeTuple()) {
+    return VirtualObject::Kind::kTuple;
+  }
+  if (instr.IsMakeList() && instr.NumOperands() <= kMaxVirtualListSize) {
+    return VirtualObject::Kind::kList;
+  }
+  if (instr.IsBuildSlice()) {
+    return VirtualObject::Kind::kSlice;
+  }
+  return std::nullopt;
+}
+
+// If `instr` loads an element of `obj` at a constant index, return that
+// index.
+std::optional<std::size_t> elementIndex(const Instr& instr, Register* obj) {
+  std::size_t size = obj->instr()->NumOperands();
+  if (instr.IsLoadTupleItem()) {
+    auto& load = static_cast<const LoadTupleItem&>(instr);
+    if (load.GetOperand(0) != obj || load.idx() >= size) {
+      return std::nullopt;
+    }
+    return load.idx();
+  }
+  if (!instr.IsLoadArrayItem()) {
+    return std::nullopt;
+  }
+  auto& load = static_cast<const LoadArrayItem&>(instr);
+  if (load.seq() != obj || load.type() != TObject ||
+      !load.idx()->type().hasIntSpec()) {
+    return std::nullopt;
+  }
+  intptr_t idx = load.idx()->type().intSpec();
+  if (idx < 0 || static_cast<std::size_t>(idx) >= size) {
+    return std::nullopt;
+  }
+  return idx;
+}
+
+// The uses of a candidate allocation, grouped by how they get replaced.
+struct Replacement {
+  std::vector<Instr*> element_loads;
+  std::vector<Instr*> size_loads;
+  std::vector<Instr*> removable;
+};
+
+// Check that every use of `obj` can be answered without the object, and
+// collect them.
+bool collectReplacements(
+    const UseMap& uses,
+    const std::unordered_set<Instr*>& deleted,
+    Register* obj,
+    VirtualObject::Kind kind,
+    Replacement& repl) {
+  auto it = uses.find(obj);
+  if (it == uses.end()) {
+    return true;
+  }
+  if (it->second.escapes) {
+    return false;
+  }
+  bool is_sequence = kind != VirtualObject::Kind::kSlice;
+  for (Instr* user : it->second.users) {
+    if (deleted.count(user)) {
+      // Another allocation that used this one was just removed; try again
+      // with fresh uses.
+      return false;
+    }
+    if (user->IsUseType()) {
+      repl.removable.push_back(user);
+    } else if (is_sequence && user->IsLoadVarObjectSize()) {
+      repl.size_loads.push_back(user);
+    } else if (is_sequence && elementIndex(*user, obj).has_value()) {
+      repl.element_loads.push_back(user);
+    } else if (
+        is_sequence && (user->IsLoadField() || user->IsLoadFieldAddress()) &&
+        user->GetOperand(0) == obj) {
+      // The address of ob_item. It's fine as long as it only feeds element
+      // loads from this object.
+      auto addr_uses = uses.find(user->GetOutput());
+      if (addr_uses != uses.end()) {
+        if (addr_uses->second.escapes || addr_uses->second.in_frame_state) {
+          return false;
+        }
+        for (Instr* addr_user : addr_uses->second.users) {
+          if (!elementIndex(*addr_user, obj).has_value() ||
+              addr_user->GetOperand(0) != user->GetOutput()) {
+            return false;
+          }
+        }
+      }
+      repl.removable.push_back(user);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+void EscapeAnalysis::Run(Function& irfunc) {
+  bool changed = false;
+  // Removing one allocation can let another one stop escaping, for example
+  // when a tuple is an element of another tuple.
+  for (bool progress = true; progress;) {
+    progress = false;
+    UseMap uses = collectUses(irfunc);
+
+    std::vector<Instr*> candidates;
+    for (auto& block : irfunc.cfg.blocks) {
+      for (auto& instr : block) {
+        if (virtualKind(instr).has_value()) {
+          candidates.push_back(&instr);
+        }
+      }
+    }
+
+    std::unordered_set<Instr*> deleted;
+    for (Instr* alloc : candidates) {
+      Register* obj = alloc->GetOutput();
+      VirtualObject::Kind kind = *virtualKind(*alloc);
+      Replacement repl;
+      if (!collectReplacements(uses, deleted, obj, kind, repl)) {
+        continue;
+      }
+
+      for (Instr* load : repl.element_loads) {
+        Register* element = alloc->GetOperand(*elementIndex(*load, obj));
+        auto assign = Assign::create(load->GetOutput(), element);
+        assign->copyBytecodeOffset(*load);
+        load->ReplaceWith(*assign);
+        delete load;
+      }
+      for (Instr* load : repl.size_loads) {
+        Register* output = load->GetOutput();
+        auto size = LoadConst::create(
+            output, Type::fromCInt(alloc->NumOperands(), output->type()));
+        size->copyBytecodeOffset(*load);
+        load->ReplaceWith(*size);
+        delete load;
+      }
+      for (Instr* instr : repl.removable) {
+        instr->unlink();
+        delete instr;
+      }
+
+      auto uses_it = uses.find(obj);
+      if (uses_it != uses.end() && uses_it->second.in_frame_state) {
+        auto virt = VirtualObject::create(alloc->NumOperands(), obj, kind);
+        for (std::size_t i = 0, n = alloc->NumOperands(); i < n; ++i) {
+          virt->SetOperand(i, alloc->GetOperand(i));
+        }
+        virt->copyBytecodeOffset(*alloc);
+        alloc->ReplaceWith(*virt);
+      } else {
+        alloc->unlink();
+      }
+      deleted.insert(alloc);
+      delete alloc;
+      progress = true;
+    }
+    if (progress) {
+      // Forward the element loads that were turned into Assigns, so an inner
+      // allocation sees the loads from it directly on the next iteration.
+      CopyPropagation{}.Run(irfunc);
+      changed = true;
+    }
+  }
+
+  if (changed) {
+    reflowTypes(irfunc);
+  }
+}
+
+} // namespace jit::hir
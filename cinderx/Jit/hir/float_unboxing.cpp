@@ -0,0 +1,420 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/hir/analysis.h"
+#include "cinderx/Jit/hir/optimization.h"
+#include "cinderx/Jit/hir/ssa.h"
+
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace jit::hir {
+
+// This file contains the FloatUnboxing pass. Simplify does arithmetic on exact
+// floats with CDouble values, but it only looks at one instruction at a time,
+// so it boxes every result again. When a float is carried around a loop (as in
+// `x = x * y`) or is only kept alive by FrameStates, that box is an allocation
+// per iteration that nothing needs.
+//
+// Floats carried around a loop are first shown to be exact floats, so that
+// Simplify can do their arithmetic on doubles. Then Phis whose inputs are
+// boxed doubles, float constants, or other such Phis become Phis of CDoubles.
+// Anything other than PrimitiveUnbox that uses one of the old Phis gets a new
+// box immediately before its first use in each block, as IntRangeAnalysis
+// does for small ints. FrameStates refer to the CDouble
+// inside any boxed double and box it again if we deopt.
+
+namespace {
+
+// The CDouble inside reg, if reg is a boxed double.
+Register* boxedDouble(Register* reg) {
+  Instr* def = reg->instr();
+  if (def == nullptr || !def->IsPrimitiveBox()) {
+    return nullptr;
+  }
+  auto box = static_cast<PrimitiveBox*>(def);
+  return box->type() <= TCDouble ? box->value() : nullptr;
+}
+
+bool isFloatConstant(const Register* reg) {
+  Type type = reg->type();
+  return type <= TFloatExact && type.hasObjectSpec();
+}
+
+// Is instr arithmetic that Simplify can do on doubles when its operands are
+// exact floats?
+bool isFloatArithmetic(const Instr& instr) {
+  if (instr.IsBinaryOp()) {
+    switch (static_cast<const BinaryOp&>(instr).op()) {
+      case BinaryOpKind::kAdd:
+      case BinaryOpKind::kSubtract:
+      case BinaryOpKind::kMultiply:
+      case BinaryOpKind::kTrueDivide:
+        return true;
+      default:
+        return false;
+    }
+  }
+  if (instr.IsInPlaceOp()) {
+    switch (static_cast<const InPlaceOp&>(instr).op()) {
+      case InPlaceOpKind::kAdd:
+      case InPlaceOpKind::kSubtract:
+      case InPlaceOpKind::kMultiply:
+      case InPlaceOpKind::kTrueDivide:
+        return true;
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+// A Phi's type is the union of its inputs, and `x * y` only gets a float type
+// once Simplify knows x is a float, so a float carried around a loop is never
+// typed on either side of the back edge. Assume every Phi and float arithmetic
+// op produces an exact float, then drop the ones that don't follow from their
+// inputs until nothing changes. An exact float combined with another one or
+// with an int is an exact float, so what's left holds floats by induction, and
+// those Phis are refined to FloatExact. Returns true if any Phi was refined.
+bool refineLoopFloats(Function& func) {
+  std::unordered_set<Instr*> floats;
+  for (auto& block : func.cfg.blocks) {
+    for (auto& instr : block) {
+      if ((instr.IsPhi() && !instr.GetOutput()->isA(TFloatExact)) ||
+          isFloatArithmetic(instr)) {
+        floats.insert(&instr);
+      }
+    }
+  }
+  auto is_float = [&](Register* reg) {
+    return reg->isA(TFloatExact) || floats.count(reg->instr()) != 0;
+  };
+  auto is_int_constant = [](Register* reg) {
+    Type type = reg->type();
+    return type <= TLongExact && type.hasObjectSpec();
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto it = floats.begin(); it != floats.end();) {
+      Instr* instr = *it;
+      bool ok;
+      if (instr->IsPhi()) {
+        ok = true;
+        for (Register* input : instr->GetOperands()) {
+          ok = ok && is_float(input);
+        }
+      } else {
+        Register* left = instr->GetOperand(0);
+        Register* right = instr->GetOperand(1);
+        ok = (is_float(left) || is_float(right)) &&
+            (is_float(left) || is_int_constant(left)) &&
+            (is_float(right) || is_int_constant(right));
+      }
+      if (ok) {
+        ++it;
+      } else {
+        it = floats.erase(it);
+        changed = true;
+      }
+    }
+  }
+
+  std::unordered_map<Register*, Register*> refined;
+  std::unordered_set<Instr*> refines;
+  for (Instr* instr : floats) {
+    if (!instr->IsPhi()) {
+      continue;
+    }
+    Instr* first = nullptr;
+    for (auto& other : *instr->block()) {
+      if (!other.IsPhi()) {
+        first = &other;
+        break;
+      }
+    }
+    Register* output = func.env.AllocateRegister();
+    auto refine = RefineType::create(output, TFloatExact, instr->GetOutput());
+    refine->copyBytecodeOffset(*instr);
+    refine->InsertBefore(*first);
+    refines.insert(refine);
+    refined[instr->GetOutput()] = output;
+  }
+  if (refined.empty()) {
+    return false;
+  }
+  for (auto& block : func.cfg.blocks) {
+    for (auto& instr : block) {
+      if (refines.count(&instr)) {
+        continue;
+      }
+      instr.visitUses([&](Register*& reg) {
+        auto it = refined.find(reg);
+        if (it != refined.end()) {
+          reg = it->second;
+        }
+        return true;
+      });
+    }
+  }
+  reflowTypes(func);
+  return true;
+}
+
+class FloatPhiLowering {
+ public:
+  explicit FloatPhiLowering(Function& func) : func_{func} {}
+
+  bool run() {
+    findPhis();
+    if (phis_.empty() || !planBoxes()) {
+      return false;
+    }
+    rewrite();
+    return true;
+  }
+
+ private:
+  bool isCandidate(Register* reg) const {
+    Instr* def = reg->instr();
+    return def != nullptr && def->IsPhi() &&
+        phis_.count(static_cast<Phi*>(def));
+  }
+
+  // Find the Phis of floats that can be unboxed. Each one has to be fed by at
+  // least one boxed double, directly or through other Phis; a Phi of only
+  // constants would just trade a constant for a new box.
+  void findPhis() {
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (instr.IsPhi() && instr.GetOutput()->type() <= TFloatExact) {
+          phis_.insert(static_cast<Phi*>(&instr));
+        }
+      }
+    }
+    for (bool changed = true; changed;) {
+      changed = false;
+      std::unordered_set<Phi*> fed;
+      for (bool grew = true; grew;) {
+        grew = false;
+        for (Phi* phi : phis_) {
+          if (fed.count(phi)) {
+            continue;
+          }
+          for (Register* input : phi->GetOperands()) {
+            if (boxedDouble(input) != nullptr ||
+                (isCandidate(input) &&
+                 fed.count(static_cast<Phi*>(input->instr())))) {
+              fed.insert(phi);
+              grew = true;
+              break;
+            }
+          }
+        }
+      }
+      for (auto it = phis_.begin(); it != phis_.end();) {
+        Phi* phi = *it;
+        bool ok = fed.count(phi) != 0;
+        for (Register* input : phi->GetOperands()) {
+          ok = ok &&
+              (boxedDouble(input) != nullptr || isFloatConstant(input) ||
+               isCandidate(input));
+        }
+        if (ok) {
+          ++it;
+        } else {
+          it = phis_.erase(it);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // Decide where the old Phis have to be boxed again, and with what
+  // FrameState. Returns false if there's no FrameState for one of them.
+  bool planBoxes() {
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (instr.IsPhi() && phis_.count(static_cast<Phi*>(&instr))) {
+          continue;
+        }
+        if ((instr.IsPrimitiveUnbox() || instr.IsUseType()) &&
+            isCandidate(instr.GetOperand(0))) {
+          continue;
+        }
+        for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+          Register* reg = instr.GetOperand(i);
+          if (!isCandidate(reg)) {
+            continue;
+          }
+          Instr* before = instr.IsPhi()
+              ? static_cast<Phi&>(instr).basic_blocks().at(i)->GetTerminator()
+              : &instr;
+          BasicBlock* site_block = before->block();
+          BoxSite& site = boxes_[{site_block, reg}];
+          if (site.before == nullptr ||
+              site.before == site_block->GetTerminator()) {
+            site.before = before;
+          }
+        }
+      }
+    }
+    for (auto& [key, site] : boxes_) {
+      const FrameState* frame = frameStateBefore(*site.before);
+      if (frame == nullptr) {
+        return false;
+      }
+      site.frame = *frame;
+    }
+    return true;
+  }
+
+  void rewrite() {
+    for (Phi* phi : phis_) {
+      unboxed_[phi->GetOutput()] = func_.env.AllocateRegister();
+    }
+    for (Phi* phi : phis_) {
+      std::unordered_map<BasicBlock*, Register*> args;
+      for (std::size_t i = 0, n = phi->NumOperands(); i < n; ++i) {
+        BasicBlock* pred = phi->basic_blocks().at(i);
+        Register* input = phi->GetOperand(i);
+        if (Register* value = boxedDouble(input)) {
+          args[pred] = value;
+        } else if (isCandidate(input)) {
+          args[pred] = unboxed_.at(input);
+        } else {
+          Instr* term = pred->GetTerminator();
+          Register* value = func_.env.AllocateRegister();
+          auto load = LoadConst::create(
+              value,
+              Type::fromCDouble(
+                  PyFloat_AS_DOUBLE(input->type().objectSpec())));
+          load->copyBytecodeOffset(*term);
+          load->InsertBefore(*term);
+          args[pred] = value;
+        }
+      }
+      auto unboxed_phi = Phi::create(unboxed_.at(phi->GetOutput()), args);
+      unboxed_phi->copyBytecodeOffset(*phi);
+      unboxed_phi->InsertBefore(*phi);
+    }
+
+    for (auto& [key, site] : boxes_) {
+      Register* boxed = func_.env.AllocateRegister();
+      auto box = PrimitiveBox::create(
+          boxed, unboxed_.at(key.second), TCDouble, *site.frame);
+      box->copyBytecodeOffset(*site.before);
+      box->InsertBefore(*site.before);
+      site.boxed = boxed;
+    }
+
+    std::vector<Instr*> dead;
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (instr.IsPhi() && phis_.count(static_cast<Phi*>(&instr))) {
+          dead.push_back(&instr);
+          continue;
+        }
+        if (instr.IsUseType() && isCandidate(instr.GetOperand(0))) {
+          dead.push_back(&instr);
+          continue;
+        }
+        if (instr.IsPrimitiveUnbox() && isCandidate(instr.GetOperand(0))) {
+          auto assign = Assign::create(
+              instr.GetOutput(), unboxed_.at(instr.GetOperand(0)));
+          assign->copyBytecodeOffset(instr);
+          assign->InsertBefore(instr);
+          dead.push_back(&instr);
+          continue;
+        }
+        for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+          Register* reg = instr.GetOperand(i);
+          if (!isCandidate(reg)) {
+            continue;
+          }
+          BasicBlock* site_block = instr.IsPhi()
+              ? static_cast<Phi&>(instr).basic_blocks().at(i)
+              : instr.block();
+          instr.SetOperand(i, boxes_.at({site_block, reg}).boxed);
+        }
+        if (FrameState* fs = get_frame_state(instr)) {
+          fs->visitUses([&](Register*& reg) {
+            auto it = unboxed_.find(reg);
+            if (it != unboxed_.end()) {
+              reg = it->second;
+            }
+            return true;
+          });
+        }
+      }
+    }
+    for (Instr* instr : dead) {
+      instr->unlink();
+      delete instr;
+    }
+  }
+
+  struct BoxSite {
+    Instr* before{nullptr};
+    std::optional<FrameState> frame;
+    Register* boxed{nullptr};
+  };
+
+  struct PairHash {
+    std::size_t operator()(const std::pair<BasicBlock*, Register*>& p) const {
+      return std::hash<BasicBlock*>{}(p.first) ^
+          (std::hash<Register*>{}(p.second) << 1);
+    }
+  };
+
+  Function& func_;
+  std::unordered_set<Phi*> phis_;
+  // The CDouble Phi replacing each of phis_, keyed by the old output.
+  std::unordered_map<Register*, Register*> unboxed_;
+  // Where to box each old Phi, keyed by the block it's needed in.
+  std::unordered_map<std::pair<BasicBlock*, Register*>, BoxSite, PairHash>
+      boxes_;
+};
+
+// Make FrameStates refer to the CDouble inside any boxed double rather than
+// the box, so the box can be removed when nothing else needs an object.
+void unboxFrameStateDoubles(Function& func) {
+  for (auto& block : func.cfg.blocks) {
+    for (auto& instr : block) {
+      FrameState* fs = get_frame_state(instr);
+      if (fs == nullptr) {
+        continue;
+      }
+      fs->visitUses([](Register*& reg) {
+        if (Register* value = boxedDouble(reg)) {
+          reg = value;
+        }
+        return true;
+      });
+    }
+  }
+}
+
+} // namespace
+
+void FloatUnboxing::Run(Function& irfunc) {
+  // Static Python boxes its own primitives, and those boxes are left alone.
+  // Generators save live values across yields in general-purpose registers
+  // only, so they keep their floats boxed too.
+  if (irfunc.code != nullptr &&
+      (irfunc.code->co_flags &
+       (CO_STATICALLY_COMPILED | kCoFlagsAnyGenerator))) {
+    return;
+  }
+  if (refineLoopFloats(irfunc)) {
+    Simplify{}.Run(irfunc);
+  }
+  if (FloatPhiLowering{irfunc}.run()) {
+    CopyPropagation{}.Run(irfunc);
+    reflowTypes(irfunc);
+  }
+  unboxFrameStateDoubles(irfunc);
+}
+
+} // namespace jit::hir
@@ -6,6 +6,7 @@
 #include "cinderx/Common/log.h"
 
 #include "cinderx/Jit/bytecode.h"
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/hir/register.h"
 #include "cinderx/Jit/stack.h"
 
@@ -45,7 +46,7 @@ using BlockStack = jit::Stack<ExecutionBlock>;
 using OperandStack = jit::Stack<Register*>;
 
 // The abstract state of the python frame
-struct FrameState {
+struct FrameState : CompileArenaAllocated {
   FrameState() = default;
   FrameState(const FrameState& other) {
     *this = other;
@@ -62,6 +63,8 @@ struct FrameState {
     code = other.code;
     globals = other.globals;
     builtins = other.builtins;
+    elided_frames = other.elided_frames;
+    tail_call_offset = other.tail_call_offset;
     return *this;
   }
   FrameState(
@@ -113,6 +116,13 @@ struct FrameState {
   // functions during e.g. deopt.
   FrameState* parent{nullptr};
 
+  // If self tail calls were turned into jumps by TailCallElimination, the
+  // number of calls made that way so far, whose frames the interpreter has to
+  // account for. Only set in the outermost FrameState.
+  Register* elided_frames{nullptr};
+  // Offset of the elided calls, where tracebacks show their frames.
+  BCOffset tail_call_offset{-1};
+
   // The bytecode offset of the current instruction, or -sizeof(_Py_CODEUNIT) if
   // no instruction has executed. This corresponds to the `f_lasti` field of
   // PyFrameObject.
@@ -138,6 +148,9 @@ struct FrameState {
         return false;
       }
     }
+    if (elided_frames != nullptr && !func(elided_frames)) {
+      return false;
+    }
     if (parent != nullptr) {
       return parent->visitUses(func);
     }
@@ -148,7 +161,8 @@ struct FrameState {
     return (next_instr_offset == other.next_instr_offset) &&
         (stack == other.stack) && (block_stack == other.block_stack) &&
         (locals == other.locals) && (cells == other.cells) &&
-        (code == other.code);
+        (code == other.code) && (elided_frames == other.elided_frames) &&
+        (tail_call_offset == other.tail_call_offset);
   }
 
   bool operator!=(const FrameState& other) const {
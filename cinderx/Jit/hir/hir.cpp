@@ -136,6 +136,7 @@ bool Instr::isReplayable() const {
     case Opcode::kCheckFreevar:
     case Opcode::kCheckNeg:
     case Opcode::kCheckSequenceBounds:
+    case Opcode::kCheckedIntBinaryOp:
     case Opcode::kCheckVar:
     case Opcode::kDoubleBinaryOp:
     case Opcode::kFormatValue:
@@ -178,6 +179,7 @@ bool Instr::isReplayable() const {
     case Opcode::kUnicodeConcat:
     case Opcode::kUnicodeSubscr:
     case Opcode::kUseType:
+    case Opcode::kVirtualObject:
     case Opcode::kWaitHandleLoadCoroOrResult:
     case Opcode::kWaitHandleLoadWaiter: {
       return true;
@@ -794,6 +796,30 @@ InPlaceOpKind ParseInPlaceOpName(std::string_view name) {
   JIT_ABORT("Invalid InPlaceOpKind '{}'", name);
 }
 
+std::string_view GetVirtualObjectKindName(VirtualObject::Kind kind) {
+  switch (kind) {
+    case VirtualObject::Kind::kTuple:
+      return "Tuple";
+    case VirtualObject::Kind::kList:
+      return "List";
+    case VirtualObject::Kind::kSlice:
+      return "Slice";
+  }
+  JIT_ABORT("Invalid VirtualObject::Kind {}", static_cast<int>(kind));
+}
+
+VirtualObject::Kind ParseVirtualObjectKindName(std::string_view name) {
+  for (auto kind :
+       {VirtualObject::Kind::kTuple,
+        VirtualObject::Kind::kList,
+        VirtualObject::Kind::kSlice}) {
+    if (name == GetVirtualObjectKindName(kind)) {
+      return kind;
+    }
+  }
+  JIT_ABORT("Invalid VirtualObject::Kind '{}'", name);
+}
+
 // NB: This needs to be in the order that the values appear in the FunctionAttr
 // enum
 static const char* gFunctionFields[] = {
@@ -896,6 +922,9 @@ int Function::numArgs() const {
     // code might be null if we parsed from textual ir
     return 0;
   }
+  if (osr_entry.has_value()) {
+    return static_cast<int>(numVars()) + osr_entry->stack_depth;
+  }
   return code->co_argcount + code->co_kwonlyargcount +
       bool(code->co_flags & CO_VARARGS) + bool(code->co_flags & CO_VARKEYWORDS);
 }
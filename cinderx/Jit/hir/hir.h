@@ -9,6 +9,7 @@
 #include "code.h"
 
 #include "cinderx/Jit/bytecode.h"
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/config.h"
 #include "cinderx/Jit/deopt_patcher.h"
 #include "cinderx/Jit/hir/frame_state.h"
@@ -155,7 +156,7 @@ class Instr {
 
   static void operator delete(void* ptr) {
     auto instr = static_cast<Instr*>(ptr);
-    free(instr->base());
+    compileArenaFree(instr->base());
   }
 
   // This defines a predicate per opcode that can be used to determine
@@ -380,8 +381,8 @@ class Instr {
   // concrete `Instr` subclasses.
   static void* allocate(std::size_t fixed_size, std::size_t num_operands) {
     auto variable_size = num_operands * kPointerSize;
-    char* ptr = static_cast<char*>(
-        malloc(variable_size + fixed_size + sizeof(std::size_t)));
+    char* ptr = static_cast<char*>(compileArenaAlloc(
+        variable_size + fixed_size + sizeof(std::size_t)));
     ptr += variable_size;
     *reinterpret_cast<size_t*>(ptr) = num_operands;
     ptr += sizeof(std::size_t);
@@ -1774,6 +1775,46 @@ class INSTR_CLASS(
   BinaryOpKind op_;
 };
 
+// Perform an addition, subtraction, or multiplication on two CInt64 values,
+// deopting if the result overflows. Used in place of a LongBinaryOp when both
+// operands are known to be ints that fit in a machine word.
+class INSTR_CLASS(
+    CheckedIntBinaryOp,
+    (TCInt64, TCInt64),
+    HasOutput,
+    Operands<2>,
+    DeoptBase) {
+ public:
+  CheckedIntBinaryOp(
+      Register* dst,
+      BinaryOpKind op,
+      Register* left,
+      Register* right,
+      const FrameState& frame)
+      : InstrT(dst, left, right, frame), op_(op) {
+    JIT_CHECK(
+        op == BinaryOpKind::kAdd || op == BinaryOpKind::kSubtract ||
+            op == BinaryOpKind::kMultiply,
+        "Unsupported CheckedIntBinaryOp {}",
+        GetBinaryOpName(op));
+  }
+
+  BinaryOpKind op() const {
+    return op_;
+  }
+
+  Register* left() const {
+    return GetOperand(0);
+  }
+
+  Register* right() const {
+    return GetOperand(1);
+  }
+
+ private:
+  BinaryOpKind op_;
+};
+
 // Perform a binary operation (e.g. '+', '-') on primitive double operands
 class INSTR_CLASS(
     DoubleBinaryOp,
@@ -2982,6 +3023,31 @@ class INSTR_CLASS(MakeTuple, (TObject), HasOutput, Operands<>, DeoptBase) {
   }
 };
 
+// Stands in for a MakeTuple, MakeList, or BuildSlice whose result never
+// escaped and was removed by EscapeAnalysis. It generates no code; the object
+// is only allocated from the operands when deoptimizing through a FrameState
+// that refers to it.
+class INSTR_CLASS(VirtualObject, (TObject), HasOutput, Operands<>) {
+ public:
+  enum class Kind : char {
+    kTuple,
+    kList,
+    kSlice,
+  };
+
+  VirtualObject(Register* dst, Kind kind) : InstrT(dst), kind_(kind) {}
+
+  Kind kind() const {
+    return kind_;
+  }
+
+ private:
+  const Kind kind_;
+};
+
+std::string_view GetVirtualObjectKindName(VirtualObject::Kind kind);
+VirtualObject::Kind ParseVirtualObjectKindName(std::string_view name);
+
 // Initialize a tuple from a list
 DEFINE_SIMPLE_INSTR(
     MakeTupleFromList,
@@ -3739,7 +3805,7 @@ DEFINE_SIMPLE_INSTR(
 
 class CFG;
 
-class BasicBlock {
+class BasicBlock : public CompileArenaAllocated {
  public:
   BasicBlock() : BasicBlock(0) {}
   explicit BasicBlock(int id_) : id(id_), cfg(nullptr) {}
@@ -4123,6 +4189,16 @@ struct TypedArgument {
   unsigned long thread_safe_flags;
 };
 
+// Describes an on-stack replacement entry point: a Function compiled to be
+// entered at a loop header from an interpreter frame that is already running
+// the code object. Such a Function takes the interpreter frame's variables
+// (locals + cellvars + freevars) followed by stack_depth value stack entries
+// as its arguments.
+struct OSREntry {
+  BCOffset loop_header;
+  int stack_depth{0};
+};
+
 // Does the given code object need access to its containing PyFunctionObject at
 // runtime?
 bool usesRuntimeFunc(BorrowedRef<PyCodeObject> code);
@@ -4197,6 +4273,14 @@ class Function {
 
   FrameMode frameMode{FrameMode::kNormal};
 
+  // Set if this is baseline (tier 1) code, which counts its calls and asks to
+  // be replaced by fully optimized code once it gets hot.
+  bool baseline_tier{false};
+
+  // Set if this is an on-stack replacement entry rather than a normal
+  // function body.
+  std::optional<OSREntry> osr_entry;
+
   CFG cfg;
 
   Environment env;
@@ -4205,7 +4289,7 @@ class Function {
   // phases
   std::unique_ptr<CompilationPhaseTimer> compilation_phase_timer{nullptr};
   // Return the total number of arguments (positional + kwonly + varargs +
-  // varkeywords)
+  // varkeywords), or the number of frame values passed in for an OSR entry.
   int numArgs() const;
 
   // Return the number of locals + cellvars + freevars
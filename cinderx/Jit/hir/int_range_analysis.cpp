@@ -0,0 +1,727 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/hir/analysis.h"
+#include "cinderx/Jit/hir/optimization.h"
+#include "cinderx/Jit/hir/ssa.h"
+#include "cinderx/Jit/runtime.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace jit::hir {
+
+// This file contains the IntRangeAnalysis pass. It finds registers that always
+// hold an int that fits in a machine word ("small ints"), and does the
+// arithmetic and comparisons on them with CInt64 values instead of calling into
+// the PyLong implementation.
+//
+// Small ints come from:
+// - Int constants that fit in an int64.
+// - len() results and boxed signed primitive ints.
+// - Add, Subtract, Multiply, And, Or, and Xor of two small ints. Add,
+//   Subtract, and Multiply become CheckedIntBinaryOp, which deopts to re-run
+//   the original bytecode in the interpreter instead of overflowing, unless the
+//   ranges of the operands prove that they can't overflow.
+// - Phis of small ints. These are assumed to be small until one of their
+//   inputs is shown not to be, which is what lets loop counters like
+//   `i = i + 1` be unboxed.
+//
+// The unboxed values are only boxed again where something needs an object,
+// immediately before the first such use in each block. FrameStates refer to the
+// unboxed values directly and box them if we deopt, and outside of Static
+// Python the same is done for any other int boxed from a CInt64, such as the
+// counter of a native range loop.
+
+namespace {
+
+struct Range {
+  int64_t lo;
+  int64_t hi;
+
+  bool operator==(const Range& other) const {
+    return lo == other.lo && hi == other.hi;
+  }
+  bool operator!=(const Range& other) const {
+    return !(*this == other);
+  }
+};
+
+constexpr int64_t kMinInt = std::numeric_limits<int64_t>::min();
+constexpr int64_t kMaxInt = std::numeric_limits<int64_t>::max();
+constexpr Range kFullRange{kMinInt, kMaxInt};
+
+// The operation performed by an instruction that this pass can lower to
+// machine arithmetic, if it is one.
+std::optional<BinaryOpKind> smallIntOp(const Instr& instr) {
+  BinaryOpKind op;
+  if (instr.IsBinaryOp()) {
+    op = static_cast<const BinaryOp&>(instr).op();
+  } else if (instr.IsLongBinaryOp()) {
+    op = static_cast<const LongBinaryOp&>(instr).op();
+  } else if (instr.IsInPlaceOp()) {
+    // int has no in-place slots, so these are the same as the binary ops.
+    switch (static_cast<const InPlaceOp&>(instr).op()) {
+      case InPlaceOpKind::kAdd:
+        op = BinaryOpKind::kAdd;
+        break;
+      case InPlaceOpKind::kSubtract:
+        op = BinaryOpKind::kSubtract;
+        break;
+      case InPlaceOpKind::kMultiply:
+        op = BinaryOpKind::kMultiply;
+        break;
+      case InPlaceOpKind::kAnd:
+        op = BinaryOpKind::kAnd;
+        break;
+      case InPlaceOpKind::kOr:
+        op = BinaryOpKind::kOr;
+        break;
+      case InPlaceOpKind::kXor:
+        op = BinaryOpKind::kXor;
+        break;
+      default:
+        return std::nullopt;
+    }
+  } else {
+    return std::nullopt;
+  }
+  switch (op) {
+    case BinaryOpKind::kAdd:
+    case BinaryOpKind::kSubtract:
+    case BinaryOpKind::kMultiply:
+    case BinaryOpKind::kAnd:
+    case BinaryOpKind::kOr:
+    case BinaryOpKind::kXor:
+      return op;
+    default:
+      return std::nullopt;
+  }
+}
+
+// The comparison performed by an instruction that this pass can lower to a
+// PrimitiveCompare, if it is one. CompareBool is only handled when its result
+// is only used to branch on, since PrimitiveCompare produces a CBool.
+std::optional<PrimitiveCompareOp> smallIntCompare(
+    const Instr& instr,
+    const std::unordered_map<Register*, std::vector<Instr*>>& users) {
+  CompareOp op;
+  if (instr.IsCompare()) {
+    op = static_cast<const Compare&>(instr).op();
+  } else if (instr.IsLongCompare()) {
+    op = static_cast<const LongCompare&>(instr).op();
+  } else if (instr.IsCompareBool()) {
+    op = static_cast<const CompareBool&>(instr).op();
+    auto it = users.find(instr.GetOutput());
+    if (it != users.end()) {
+      for (Instr* user : it->second) {
+        if (!user->IsCondBranch()) {
+          return std::nullopt;
+        }
+      }
+    }
+  } else {
+    return std::nullopt;
+  }
+  switch (op) {
+    case CompareOp::kLessThan:
+    case CompareOp::kLessThanEqual:
+    case CompareOp::kEqual:
+    case CompareOp::kNotEqual:
+    case CompareOp::kGreaterThan:
+    case CompareOp::kGreaterThanEqual:
+      return toPrimitiveCompareOp(op);
+    default:
+      return std::nullopt;
+  }
+}
+
+// The range of values held by a register defined by instr, if instr always
+// produces a small int without looking at any other small ints.
+std::optional<Range> sourceRange(const Instr& instr) {
+  if (instr.IsLoadConst()) {
+    Type type = instr.GetOutput()->type();
+    if (!(type <= TLongExact) || !type.hasObjectSpec()) {
+      return std::nullopt;
+    }
+    int overflow;
+    long long value = PyLong_AsLongLongAndOverflow(type.objectSpec(), &overflow);
+    if (overflow != 0) {
+      return std::nullopt;
+    }
+    return Range{value, value};
+  }
+  if (instr.IsGetLength()) {
+    return Range{0, PY_SSIZE_T_MAX};
+  }
+  if (instr.IsPrimitiveBox()) {
+    Register* value = static_cast<const PrimitiveBox&>(instr).value();
+    Type type = value->type();
+    if (value->instr()->IsLoadVarObjectSize()) {
+      return Range{0, PY_SSIZE_T_MAX};
+    }
+    if (type.hasIntSpec() && type <= TCSigned) {
+      return Range{type.intSpec(), type.intSpec()};
+    }
+    if (type <= TCInt8) {
+      return Range{INT8_MIN, INT8_MAX};
+    }
+    if (type <= TCInt16) {
+      return Range{INT16_MIN, INT16_MAX};
+    }
+    if (type <= TCInt32) {
+      return Range{INT32_MIN, INT32_MAX};
+    }
+    if (type <= TCInt64) {
+      return kFullRange;
+    }
+  }
+  return std::nullopt;
+}
+
+// Smallest all-ones value that is >= v, for a non-negative v.
+int64_t bitMaskCovering(int64_t v) {
+  int64_t mask = 0;
+  while (mask < v) {
+    mask = (mask << 1) | 1;
+  }
+  return mask;
+}
+
+// Compute the range of `left op right`. Sets `overflows` if the exact result
+// might not fit in an int64, in which case the returned range is clamped to
+// what fits, since a CheckedIntBinaryOp won't produce anything else.
+Range binaryOpRange(BinaryOpKind op, Range left, Range right, bool& overflows) {
+  using Wide = __int128;
+  Wide lo;
+  Wide hi;
+  switch (op) {
+    case BinaryOpKind::kAdd:
+      lo = Wide{left.lo} + right.lo;
+      hi = Wide{left.hi} + right.hi;
+      break;
+    case BinaryOpKind::kSubtract:
+      lo = Wide{left.lo} - right.hi;
+      hi = Wide{left.hi} - right.lo;
+      break;
+    case BinaryOpKind::kMultiply: {
+      Wide products[] = {
+          Wide{left.lo} * right.lo,
+          Wide{left.lo} * right.hi,
+          Wide{left.hi} * right.lo,
+          Wide{left.hi} * right.hi};
+      lo = *std::min_element(std::begin(products), std::end(products));
+      hi = *std::max_element(std::begin(products), std::end(products));
+      break;
+    }
+    case BinaryOpKind::kAnd:
+    case BinaryOpKind::kOr:
+    case BinaryOpKind::kXor:
+      overflows = false;
+      if (left.lo < 0 || right.lo < 0) {
+        return kFullRange;
+      }
+      if (op == BinaryOpKind::kAnd) {
+        return Range{0, std::min(left.hi, right.hi)};
+      }
+      return Range{0, bitMaskCovering(std::max(left.hi, right.hi))};
+    default:
+      JIT_ABORT("Unexpected op {}", GetBinaryOpName(op));
+  }
+  overflows = lo < kMinInt || hi > kMaxInt;
+  return Range{
+      static_cast<int64_t>(std::max(lo, Wide{kMinInt})),
+      static_cast<int64_t>(std::min(hi, Wide{kMaxInt}))};
+}
+
+class SmallIntLowering {
+ public:
+  explicit SmallIntLowering(Function& func) : func_{func} {}
+
+  bool run() {
+    findSmallInts();
+    if (ops_.empty() && compares_.empty()) {
+      return false;
+    }
+    computeRanges();
+    if (!planBoxes()) {
+      return false;
+    }
+    rewrite();
+    return true;
+  }
+
+ private:
+  bool isSmall(Register* reg) const {
+    return small_.count(reg) != 0;
+  }
+
+  // Whether a CheckedIntBinaryOp for op deopted in an earlier compilation of
+  // this code, in which case it's left as a BinaryOp.
+  static bool overflowedBefore(Instr& op) {
+    const FrameState* frame = op.getDominatingFrameState();
+    return frame != nullptr &&
+        Runtime::get()->isSpeculationRelaxed(frame->code, op.bytecodeOffset());
+  }
+
+  // Find the small ints, the arithmetic on them to lower, and the comparisons
+  // between them.
+  void findSmallInts() {
+    std::vector<Instr*> candidates;
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+          users_[instr.GetOperand(i)].push_back(&instr);
+        }
+        if (auto range = sourceRange(instr)) {
+          small_.insert(instr.GetOutput());
+          ranges_[instr.GetOutput()] = *range;
+        } else if (
+            instr.IsPhi() ||
+            (smallIntOp(instr).has_value() && !overflowedBefore(instr))) {
+          small_.insert(instr.GetOutput());
+          candidates.push_back(&instr);
+        }
+      }
+    }
+
+    // Optimistically assume every candidate is small, and remove the ones
+    // with an input that isn't until nothing changes.
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (Instr* instr : candidates) {
+        if (!isSmall(instr->GetOutput())) {
+          continue;
+        }
+        for (std::size_t i = 0, n = instr->NumOperands(); i < n; ++i) {
+          if (!isSmall(instr->GetOperand(i))) {
+            small_.erase(instr->GetOutput());
+            changed = true;
+            break;
+          }
+        }
+      }
+    }
+
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (instr.NumOperands() == 2 && isSmall(instr.GetOperand(0)) &&
+            isSmall(instr.GetOperand(1)) &&
+            smallIntCompare(instr, users_).has_value()) {
+          compares_.push_back(&instr);
+        }
+      }
+    }
+
+    // Only unbox Phis that are connected to some arithmetic or comparison;
+    // otherwise the values would just have to be boxed again where they're
+    // used.
+    std::vector<Instr*> worklist;
+    std::unordered_set<Instr*> connected;
+    auto visit = [&](Instr* instr) {
+      if (connected.insert(instr).second) {
+        worklist.push_back(instr);
+      }
+    };
+    for (Instr* instr : candidates) {
+      if (isSmall(instr->GetOutput()) && !instr->IsPhi()) {
+        visit(instr);
+      }
+    }
+    for (Instr* instr : compares_) {
+      visit(instr);
+    }
+    while (!worklist.empty()) {
+      Instr* instr = worklist.back();
+      worklist.pop_back();
+      for (std::size_t i = 0, n = instr->NumOperands(); i < n; ++i) {
+        Instr* def = instr->GetOperand(i)->instr();
+        if (def->IsPhi() && isSmall(def->GetOutput())) {
+          visit(def);
+        }
+      }
+      if (instr->GetOutput() == nullptr || !isSmall(instr->GetOutput())) {
+        continue;
+      }
+      for (Instr* user : users_[instr->GetOutput()]) {
+        if (user->IsPhi() && isSmall(user->GetOutput())) {
+          visit(user);
+        }
+      }
+    }
+    for (Instr* instr : candidates) {
+      if (!isSmall(instr->GetOutput())) {
+        continue;
+      }
+      if (instr->IsPhi() && !connected.count(instr)) {
+        small_.erase(instr->GetOutput());
+        continue;
+      }
+      ops_.push_back(instr);
+      removed_.insert(instr->GetOutput());
+    }
+  }
+
+  // Compute the range of every small int, widening Phis to the full range if
+  // they change after their first visit so that loops converge quickly.
+  void computeRanges() {
+    std::vector<BasicBlock*> rpo = func_.cfg.GetRPOTraversal();
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (BasicBlock* block : rpo) {
+        for (auto& instr : *block) {
+          Register* out = instr.GetOutput();
+          if (!removed_.count(out)) {
+            continue;
+          }
+          std::optional<Range> range;
+          if (instr.IsPhi()) {
+            for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+              auto it = ranges_.find(instr.GetOperand(i));
+              if (it == ranges_.end()) {
+                continue;
+              }
+              range = range.has_value()
+                  ? Range{std::min(range->lo, it->second.lo),
+                          std::max(range->hi, it->second.hi)}
+                  : it->second;
+            }
+          } else {
+            auto left = ranges_.find(instr.GetOperand(0));
+            auto right = ranges_.find(instr.GetOperand(1));
+            if (left != ranges_.end() && right != ranges_.end()) {
+              bool overflows;
+              range = binaryOpRange(
+                  *smallIntOp(instr), left->second, right->second, overflows);
+            }
+          }
+          if (!range.has_value()) {
+            continue;
+          }
+          auto it = ranges_.find(out);
+          if (it == ranges_.end()) {
+            ranges_.emplace(out, *range);
+            changed = true;
+          } else if (it->second != *range) {
+            Range next = instr.IsPhi() ? kFullRange : *range;
+            if (next != it->second) {
+              it->second = next;
+              changed = true;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Range rangeOf(Register* reg) const {
+    auto it = ranges_.find(reg);
+    return it == ranges_.end() ? kFullRange : it->second;
+  }
+
+  bool isRemoved(Register* reg) const {
+    return removed_.count(reg) != 0;
+  }
+
+  bool mayOverflow(Instr& op) const {
+    bool overflows = false;
+    binaryOpRange(
+        *smallIntOp(op),
+        rangeOf(op.GetOperand(0)),
+        rangeOf(op.GetOperand(1)),
+        overflows);
+    return overflows;
+  }
+
+  // Decide where the values of the instructions being removed have to be
+  // boxed again: before their first use in each block, or at the end of the
+  // predecessor for a Phi input. Returns false if there's no FrameState to
+  // box with for one of them.
+  bool planBoxes() {
+    std::unordered_set<Instr*> rewritten{ops_.begin(), ops_.end()};
+    rewritten.insert(compares_.begin(), compares_.end());
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (rewritten.count(&instr)) {
+          continue;
+        }
+        // A UseType only pins the type of the boxed value, which no longer
+        // exists.
+        if (instr.IsUseType() && isRemoved(instr.GetOperand(0))) {
+          use_types_.push_back(&instr);
+          continue;
+        }
+        for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+          Register* reg = instr.GetOperand(i);
+          if (!isRemoved(reg)) {
+            continue;
+          }
+          Instr* before = instr.IsPhi()
+              ? static_cast<Phi&>(instr).basic_blocks().at(i)->GetTerminator()
+              : &instr;
+          BasicBlock* site_block = before->block();
+          BoxSite& site = boxes_[{site_block, reg}];
+          // Uses in a block are visited in order, but a Phi input can be seen
+          // before or after them, so the terminator loses to any other use.
+          if (site.before == nullptr ||
+              site.before == site_block->GetTerminator()) {
+            site.before = before;
+          }
+        }
+      }
+    }
+    for (auto& [key, site] : boxes_) {
+      // Copied, since the instruction it came from may be rewritten before
+      // the box is inserted.
+      const FrameState* frame = frameStateBefore(*site.before);
+      if (frame == nullptr) {
+        return false;
+      }
+      site.frame = *frame;
+    }
+    // An op that can overflow deopts back to its own bytecode, so it needs
+    // the state from before it started.
+    for (Instr* instr : ops_) {
+      if (instr->IsPhi() || !mayOverflow(*instr)) {
+        continue;
+      }
+      const FrameState* frame = instr->getDominatingFrameState();
+      if (frame == nullptr) {
+        return false;
+      }
+      deopt_frames_[instr] = frame;
+    }
+    return true;
+  }
+
+  // Get the unboxed version of a small int, for use by `user`.
+  Register* unboxed(Register* reg, Instr& user) {
+    auto it = unboxed_.find(reg);
+    if (it != unboxed_.end()) {
+      return it->second;
+    }
+    Instr* def = reg->instr();
+    Register* result = func_.env.AllocateRegister();
+    if (def->IsLoadConst()) {
+      // Constants are materialized where they're used rather than memoized.
+      Range range = rangeOf(reg);
+      auto load = LoadConst::create(result, Type::fromCInt(range.lo, TCInt64));
+      load->copyBytecodeOffset(user);
+      load->InsertBefore(user);
+      return result;
+    }
+    Instr* conversion;
+    if (def->IsPrimitiveBox()) {
+      Register* value = static_cast<PrimitiveBox*>(def)->value();
+      if (value->type() <= TCInt64) {
+        unboxed_[reg] = value;
+        return value;
+      }
+      conversion = IntConvert::create(result, value, TCInt64);
+    } else {
+      JIT_CHECK(def->IsGetLength(), "Unexpected small int {}", def->opname());
+      conversion = PrimitiveUnbox::create(result, reg, TCInt64);
+    }
+    conversion->copyBytecodeOffset(*def);
+    conversion->InsertAfter(*def);
+    unboxed_[reg] = result;
+    return result;
+  }
+
+  void rewrite() {
+    // Phis can refer to values defined later, so allocate all their outputs
+    // before lowering anything.
+    std::vector<Phi*> phis;
+    for (Instr* instr : ops_) {
+      if (instr->IsPhi()) {
+        phis.push_back(static_cast<Phi*>(instr));
+        unboxed_[instr->GetOutput()] = func_.env.AllocateRegister();
+      }
+    }
+
+    std::unordered_set<Instr*> is_op{ops_.begin(), ops_.end()};
+    for (BasicBlock* block : func_.cfg.GetRPOTraversal()) {
+      for (auto it = block->begin(); it != block->end();) {
+        Instr& instr = *it++;
+        if (instr.IsPhi() || !is_op.count(&instr)) {
+          continue;
+        }
+        BinaryOpKind op = *smallIntOp(instr);
+        Register* unboxed_left = unboxed(instr.GetOperand(0), instr);
+        Register* unboxed_right = unboxed(instr.GetOperand(1), instr);
+        Register* result = func_.env.AllocateRegister();
+        Instr* lowered;
+        auto frame = deopt_frames_.find(&instr);
+        if (frame != deopt_frames_.end()) {
+          lowered = CheckedIntBinaryOp::create(
+              result, op, unboxed_left, unboxed_right, *frame->second);
+        } else {
+          lowered =
+              IntBinaryOp::create(result, op, unboxed_left, unboxed_right);
+        }
+        lowered->copyBytecodeOffset(instr);
+        lowered->InsertBefore(instr);
+        unboxed_[instr.GetOutput()] = result;
+      }
+    }
+
+    for (Phi* phi : phis) {
+      std::unordered_map<BasicBlock*, Register*> args;
+      for (std::size_t i = 0, n = phi->NumOperands(); i < n; ++i) {
+        BasicBlock* pred = phi->basic_blocks().at(i);
+        args[pred] = unboxed(phi->GetOperand(i), *pred->GetTerminator());
+      }
+      auto unboxed_phi = Phi::create(unboxed_[phi->GetOutput()], args);
+      unboxed_phi->copyBytecodeOffset(*phi);
+      unboxed_phi->InsertBefore(*phi);
+    }
+
+    for (Instr* instr : compares_) {
+      PrimitiveCompareOp op = *smallIntCompare(*instr, users_);
+      Register* left = unboxed(instr->GetOperand(0), *instr);
+      Register* right = unboxed(instr->GetOperand(1), *instr);
+      Register* result = func_.env.AllocateRegister();
+      auto compare = PrimitiveCompare::create(result, op, left, right);
+      compare->copyBytecodeOffset(*instr);
+      compare->InsertBefore(*instr);
+      if (!instr->IsCompareBool()) {
+        Register* boxed = func_.env.AllocateRegister();
+        auto box = PrimitiveBoxBool::create(boxed, result);
+        box->copyBytecodeOffset(*instr);
+        box->InsertBefore(*instr);
+        result = boxed;
+      }
+      auto assign = Assign::create(instr->GetOutput(), result);
+      assign->copyBytecodeOffset(*instr);
+      instr->ReplaceWith(*assign);
+      delete instr;
+    }
+
+    for (Instr* instr : use_types_) {
+      instr->unlink();
+      delete instr;
+    }
+    // Box the removed values for anything else that uses them.
+    for (auto& [key, site] : boxes_) {
+      Register* reg = key.second;
+      Register* boxed = func_.env.AllocateRegister();
+      auto box = PrimitiveBox::create(
+          boxed, unboxed_.at(reg), TCInt64, *site.frame);
+      box->copyBytecodeOffset(*site.before);
+      box->InsertBefore(*site.before);
+      site.boxed = boxed;
+    }
+    for (auto& block : func_.cfg.blocks) {
+      for (auto& instr : block) {
+        if (isRemoved(instr.GetOutput())) {
+          continue;
+        }
+        for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+          Register* reg = instr.GetOperand(i);
+          if (!isRemoved(reg)) {
+            continue;
+          }
+          BasicBlock* site_block = instr.IsPhi()
+              ? static_cast<Phi&>(instr).basic_blocks().at(i)
+              : instr.block();
+          instr.SetOperand(i, boxes_.at({site_block, reg}).boxed);
+        }
+        if (FrameState* fs = get_frame_state(instr)) {
+          fs->visitUses([&](Register*& reg) {
+            if (isRemoved(reg)) {
+              reg = unboxed_.at(reg);
+            }
+            return true;
+          });
+        }
+      }
+    }
+
+    for (Instr* instr : ops_) {
+      instr->unlink();
+      delete instr;
+    }
+  }
+
+  struct BoxSite {
+    Instr* before{nullptr};
+    std::optional<FrameState> frame;
+    Register* boxed{nullptr};
+  };
+
+  struct PairHash {
+    std::size_t operator()(const std::pair<BasicBlock*, Register*>& p) const {
+      return std::hash<BasicBlock*>{}(p.first) ^
+          (std::hash<Register*>{}(p.second) << 1);
+    }
+  };
+
+  Function& func_;
+  std::unordered_map<Register*, std::vector<Instr*>> users_;
+  // Registers known to hold small ints.
+  std::unordered_set<Register*> small_;
+  std::unordered_map<Register*, Range> ranges_;
+  // Arithmetic and Phis producing small ints, which will be replaced, and
+  // their outputs.
+  std::vector<Instr*> ops_;
+  std::unordered_set<Register*> removed_;
+  // Comparisons between two small ints.
+  std::vector<Instr*> compares_;
+  // Snapshots to deopt to for ops that may overflow.
+  std::unordered_map<Instr*, const FrameState*> deopt_frames_;
+  // UseTypes of removed values, which are dropped.
+  std::vector<Instr*> use_types_;
+  std::unordered_map<Register*, Register*> unboxed_;
+  // Where to box each removed value, keyed by the block it's needed in.
+  std::unordered_map<std::pair<BasicBlock*, Register*>, BoxSite, PairHash>
+      boxes_;
+};
+
+// Make FrameStates refer to the CInt64 inside any boxed int rather than the
+// box, so the box can be removed when nothing else needs an object.
+//
+// Outside of Static Python, the only boxed CInt64s are the ones made by this
+// pass and by the native range() loops in HIRBuilder, which box values that
+// started out as ints. Static Python code boxes its own primitives, and those
+// boxes are left alone.
+void unboxFrameStateInts(Function& func) {
+  if (func.code != nullptr &&
+      (func.code->co_flags & CO_STATICALLY_COMPILED)) {
+    return;
+  }
+  for (auto& block : func.cfg.blocks) {
+    for (auto& instr : block) {
+      FrameState* fs = get_frame_state(instr);
+      if (fs == nullptr) {
+        continue;
+      }
+      fs->visitUses([](Register*& reg) {
+        Instr* def = reg->instr();
+        if (def != nullptr && def->IsPrimitiveBox()) {
+          auto box = static_cast<PrimitiveBox*>(def);
+          if (box->type() <= TCInt64 && box->value()->type() <= TCInt64) {
+            reg = box->value();
+          }
+        }
+        return true;
+      });
+    }
+  }
+}
+
+} // namespace
+
+void IntRangeAnalysis::Run(Function& irfunc) {
+  if (SmallIntLowering{irfunc}.run()) {
+    CopyPropagation{}.Run(irfunc);
+    reflowTypes(irfunc);
+  }
+  unboxFrameStateInts(irfunc);
+}
+
+} // namespace jit::hir
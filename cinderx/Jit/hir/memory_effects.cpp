@@ -73,6 +73,10 @@ MemoryEffects memoryEffects(const Instr& inst) {
     case Opcode::kPrimitiveBoxBool:
       return borrowFrom(inst, AEmpty);
 
+    // A VirtualObject is never allocated, so there's no reference to own.
+    case Opcode::kVirtualObject:
+      return borrowFrom(inst, AEmpty);
+
     case Opcode::kPrimitiveBox:
       return commonEffects(inst, AEmpty);
 
@@ -95,6 +99,7 @@ MemoryEffects memoryEffects(const Instr& inst) {
     case Opcode::kCheckNeg:
     case Opcode::kCheckSequenceBounds:
     case Opcode::kCheckVar:
+    case Opcode::kCheckedIntBinaryOp:
     case Opcode::kGuard:
       return commonEffects(inst, AEmpty);
 
@@ -301,4 +306,78 @@ MemoryEffects memoryEffects(const Instr& inst) {
   JIT_ABORT("Bad opcode {}", static_cast<int>(inst.opcode()));
 }
 
+std::optional<AliasClass> memoryReads(const Instr& inst) {
+  switch (inst.opcode()) {
+    // Pure computations on their operands.
+    case Opcode::kBitCast:
+    case Opcode::kDoubleBinaryOp:
+    case Opcode::kIntConvert:
+    case Opcode::kLoadConst:
+    case Opcode::kLoadFieldAddress:
+    case Opcode::kPrimitiveCompare:
+    case Opcode::kPrimitiveUnaryOp:
+      return AEmpty;
+
+    // Integer division and modulo can trap when the divisor is zero, so they
+    // have to stay behind whatever checks the divisor.
+    case Opcode::kIntBinaryOp: {
+      switch (static_cast<const IntBinaryOp&>(inst).op()) {
+        case BinaryOpKind::kFloorDivide:
+        case BinaryOpKind::kFloorDivideUnsigned:
+        case BinaryOpKind::kModulo:
+        case BinaryOpKind::kModuloUnsigned:
+          return std::nullopt;
+        default:
+          return AEmpty;
+      }
+    }
+
+    // Guards deopt if their check fails, but otherwise only depend on their
+    // operand, whose type can't change once it's been observed.
+    case Opcode::kGuard:
+    case Opcode::kGuardIs:
+    case Opcode::kGuardType:
+      return AEmpty;
+
+    // Deopts on overflow, which only depends on the operands.
+    case Opcode::kCheckedIntBinaryOp:
+      return AEmpty;
+
+    case Opcode::kLoadField: {
+      auto& ldfld = static_cast<const LoadField&>(inst);
+      if (!ldfld.borrowed()) {
+        return std::nullopt;
+      }
+      // Object fields are only written by attribute stores. Primitive fields
+      // (ob_size, ob_item, etc.) are also updated by container mutations
+      // like ListAppend, so treat them as readable from anywhere.
+      if (ldfld.type() <= TOptObject) {
+        return AInObjectAttr;
+      }
+      return AManagedHeapAny;
+    }
+    case Opcode::kLoadVarObjectSize:
+      // The size of an immutable object never changes.
+      if (inst.GetOperand(0)->type() <=
+          (TBytesExact | TTupleExact | TUnicodeExact)) {
+        return AEmpty;
+      }
+      return AManagedHeapAny;
+
+    case Opcode::kLoadCellItem:
+      return ACellItem;
+    case Opcode::kLoadGlobalCached:
+      return AGlobal;
+    case Opcode::kLoadTupleItem:
+      return ATupleItem;
+    case Opcode::kLoadTypeAttrCacheItem:
+      return ATypeAttrCache;
+    case Opcode::kLoadTypeMethodCacheEntryType:
+      return ATypeMethodCache;
+
+    default:
+      return std::nullopt;
+  }
+}
+
 } // namespace jit::hir
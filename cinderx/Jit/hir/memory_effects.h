@@ -6,6 +6,7 @@
 #include "cinderx/Jit/hir/alias_class.h"
 
 #include <iosfwd>
+#include <optional>
 
 namespace jit::hir {
 
@@ -35,4 +36,13 @@ struct MemoryEffects {
 
 MemoryEffects memoryEffects(const Instr& inst);
 
+// Return the memory locations that the given instruction reads from, for
+// instructions whose only side-effect is a possible deopt and whose output is
+// fully determined by their operands and the contents of those locations.
+// Such an instruction can be moved or reused as long as nothing stores to the
+// returned locations in between.
+//
+// Returns std::nullopt for all other instructions.
+std::optional<AliasClass> memoryReads(const Instr& inst);
+
 } // namespace jit::hir
@@ -24,6 +24,7 @@ namespace jit::hir {
   V(CallStaticRetVoid)                 \
   V(Cast)                              \
   V(CheckSequenceBounds)               \
+  V(CheckedIntBinaryOp)                \
   V(CheckErrOccurred)                  \
   V(CheckExc)                          \
   V(CheckNeg)                          \
@@ -149,6 +150,7 @@ namespace jit::hir {
   V(VectorCall)                        \
   V(VectorCallStatic)                  \
   V(VectorCallKW)                      \
+  V(VirtualObject)                     \
   V(WaitHandleLoadCoroOrResult)        \
   V(WaitHandleLoadWaiter)              \
   V(WaitHandleRelease)                 \
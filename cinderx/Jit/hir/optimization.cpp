@@ -22,6 +22,7 @@
 
 #include <list>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -59,6 +60,12 @@ PassRegistry::PassRegistry() {
   addPass(GuardTypeRemoval::Factory);
   addPass(BeginInlinedFunctionElimination::Factory);
   addPass(BuiltinLoadMethodElimination::Factory);
+  addPass(LICM::Factory);
+  addPass(GlobalValueNumbering::Factory);
+  addPass(EscapeAnalysis::Factory);
+  addPass(IntRangeAnalysis::Factory);
+  addPass(FloatUnboxing::Factory);
+  addPass(TailCallElimination::Factory);
   // AllPasses is only used for testing.
   addPass(AllPasses::Factory);
 }
@@ -800,10 +807,31 @@ struct AbstractCall {
     JIT_ABORT("Unsupported call type {}", instr->opname());
   }
 
+  // The value for the callee's parameter i, once the call has been bound by
+  // bindArgs(). Parameters that the call doesn't pass are filled from the
+  // callee's defaults and have a nullptr register.
+  Register* boundArg(std::size_t i) const {
+    int arg_idx = bound_args.at(i);
+    return arg_idx < 0 ? nullptr : arg(arg_idx);
+  }
+
   Register* target{nullptr};
   BorrowedRef<PyFunctionObject> func{nullptr};
   size_t nargs{0};
   DeoptBase* instr{nullptr};
+  // Tuple of keyword argument names passed to a VectorCallKW. The last
+  // PyTuple_GET_SIZE(kwnames) of the nargs arguments are passed by keyword.
+  BorrowedRef<PyTupleObject> kwnames{nullptr};
+
+  // Filled in by bindArgs(): for each parameter of the callee, the index of
+  // the argument passed for it, or -1 if it comes from default_values.
+  std::vector<int> bound_args;
+  std::vector<BorrowedRef<>> default_values;
+  // The defaults the binding depends on, with the version of the
+  // func_kwdefaults dict at the time it was read.
+  BorrowedRef<PyTupleObject> defaults{nullptr};
+  BorrowedRef<PyDictObject> kwdefaults{nullptr};
+  uint64_t kwdefaults_version{0};
 };
 
 static void dlogAndCollectFailureStats(
@@ -830,6 +858,105 @@ static void dlogAndCollectFailureStats(
       tp_name);
 }
 
+// Bind the arguments of call_instr to the parameters of its callee the way
+// the interpreter would, filling in parameters the call doesn't pass from
+// func_defaults and func_kwdefaults. The defaults are read at compile time;
+// inlineFunctionCall() guards that they haven't changed.
+static bool bindArgs(
+    AbstractCall* call_instr,
+    BorrowedRef<PyCodeObject> code,
+    const std::string& fullname,
+    Function::InlineFailureStats& inline_failure_stats) {
+  auto mismatched = [&]() {
+    dlogAndCollectFailureStats(
+        inline_failure_stats,
+        InlineFailureType::kCalledWithMismatchedArgs,
+        fullname);
+    return false;
+  };
+  JIT_DCHECK(code->co_argcount >= 0, "argcount must be positive");
+  size_t argcount = static_cast<size_t>(code->co_argcount);
+  size_t num_params = argcount + code->co_kwonlyargcount;
+  BorrowedRef<PyTupleObject> kwnames = call_instr->kwnames;
+  size_t num_kwargs = kwnames == nullptr ? 0 : PyTuple_GET_SIZE(kwnames);
+  JIT_CHECK(num_kwargs <= call_instr->nargs, "more kwnames than arguments");
+  size_t num_positional = call_instr->nargs - num_kwargs;
+  if (num_positional > argcount) {
+    return mismatched();
+  }
+
+  call_instr->bound_args.assign(num_params, -1);
+  call_instr->default_values.assign(num_params, nullptr);
+  for (size_t i = 0; i < num_positional; i++) {
+    call_instr->bound_args[i] = i;
+  }
+  if (num_positional == num_params) {
+    return true;
+  }
+  // Static invokes have already been bound by the static compiler and don't
+  // have a function register to guard the defaults on.
+  if (call_instr->instr->IsInvokeStaticFunction()) {
+    return mismatched();
+  }
+
+  ThreadedCompileSerialize guard;
+  for (size_t i = 0; i < num_kwargs; i++) {
+    PyObject* name = PyTuple_GET_ITEM(kwnames, i);
+    size_t param = code->co_posonlyargcount;
+    for (; param < num_params; param++) {
+      PyObject* varname = PyTuple_GET_ITEM(code->co_varnames, param);
+      if (name == varname || _PyUnicode_EQ(name, varname)) {
+        break;
+      }
+    }
+    if (param == num_params || call_instr->bound_args[param] != -1) {
+      return mismatched();
+    }
+    call_instr->bound_args[param] = num_positional + i;
+  }
+
+  BorrowedRef<PyFunctionObject> func = call_instr->func;
+  BorrowedRef<PyTupleObject> defaults = func->func_defaults;
+  size_t num_defaults = defaults == nullptr ? 0 : PyTuple_GET_SIZE(defaults);
+  for (size_t i = 0; i < argcount; i++) {
+    if (call_instr->bound_args[i] != -1) {
+      continue;
+    }
+    if (i < argcount - num_defaults) {
+      return mismatched();
+    }
+    call_instr->default_values[i] =
+        PyTuple_GET_ITEM(defaults, i - (argcount - num_defaults));
+    call_instr->defaults = defaults;
+  }
+
+  BorrowedRef<> kwdefaults = func->func_kwdefaults;
+  for (size_t i = argcount; i < num_params; i++) {
+    if (call_instr->bound_args[i] != -1) {
+      continue;
+    }
+    if (kwdefaults == nullptr) {
+      return mismatched();
+    }
+    if (!PyDict_CheckExact(kwdefaults)) {
+      dlogAndCollectFailureStats(
+          inline_failure_stats, InlineFailureType::kHasKwdefaults, fullname);
+      return false;
+    }
+    PyObject* varname = PyTuple_GET_ITEM(code->co_varnames, i);
+    BorrowedRef<> value = PyDict_GetItemWithError(kwdefaults, varname);
+    if (value == nullptr) {
+      PyErr_Clear();
+      return mismatched();
+    }
+    call_instr->default_values[i] = value;
+    call_instr->kwdefaults = kwdefaults.get();
+    call_instr->kwdefaults_version =
+        call_instr->kwdefaults->ma_version_tag;
+  }
+  return true;
+}
+
 // Most of these checks are only temporary and do not in perpetuity prohibit
 // inlining. They are here to simplify bringup of the inliner and can be
 // treated as TODOs.
@@ -838,17 +965,7 @@ static bool canInline(
     BorrowedRef<PyFunctionObject> func,
     const std::string& fullname,
     Function::InlineFailureStats& inline_failure_stats) {
-  if (func->func_kwdefaults != nullptr) {
-    dlogAndCollectFailureStats(
-        inline_failure_stats, InlineFailureType::kHasKwdefaults, fullname);
-    return false;
-  }
   PyCodeObject* code = reinterpret_cast<PyCodeObject*>(func->func_code);
-  if (code->co_kwonlyargcount > 0) {
-    dlogAndCollectFailureStats(
-        inline_failure_stats, InlineFailureType::kHasKwOnlyArgs, fullname);
-    return false;
-  }
   if (code->co_flags & CO_VARARGS) {
     dlogAndCollectFailureStats(
         inline_failure_stats, InlineFailureType::kHasVarargs, fullname);
@@ -861,13 +978,13 @@ static bool canInline(
 
     return false;
   }
-  JIT_DCHECK(code->co_argcount >= 0, "argcount must be positive");
-  if (call_instr->nargs != static_cast<size_t>(code->co_argcount)) {
+  if (code->co_kwonlyargcount > 0 &&
+      call_instr->instr->IsInvokeStaticFunction()) {
     dlogAndCollectFailureStats(
-        inline_failure_stats,
-        InlineFailureType::kCalledWithMismatchedArgs,
-        fullname);
-
+        inline_failure_stats, InlineFailureType::kHasKwOnlyArgs, fullname);
+    return false;
+  }
+  if (!bindArgs(call_instr, code, fullname, inline_failure_stats)) {
     return false;
   }
   if (code->co_flags & kCoFlagsAnyGenerator) {
@@ -883,18 +1000,8 @@ static bool canInline(
 
     return false;
   }
-  Py_ssize_t nfreevars = PyTuple_GET_SIZE(code->co_freevars);
-  if (nfreevars > 0) {
-    dlogAndCollectFailureStats(
-        inline_failure_stats, InlineFailureType::kHasFreevars, fullname);
-
-    return false;
-  }
-  if (usesRuntimeFunc(code)) {
-    dlogAndCollectFailureStats(
-        inline_failure_stats, InlineFailureType::kNeedsRuntimeAccess, fullname);
-    return false;
-  }
+  // Freevars are fine: the inlined code reads its cells out of the closure of
+  // the function being called, and accesses them with LoadCellItem.
   return true;
 }
 
@@ -926,10 +1033,12 @@ static bool canInlineWithPreloader(
   return true;
 }
 
-void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
+// Return the Preloader for the function called by call_instr if it can be
+// inlined into caller, or nullptr after recording why it can't be.
+static Preloader* preloaderForInline(
+    Function& caller,
+    AbstractCall* call_instr) {
   BorrowedRef<PyFunctionObject> func = call_instr->func;
-  PyCodeObject* code = reinterpret_cast<PyCodeObject*>(func->func_code);
-  JIT_CHECK(PyCode_Check(code), "Expected PyCodeObject");
   PyObject* globals = func->func_globals;
   std::string fullname = funcFullname(func);
   Function::InlineFailureStats& inline_failure_stats =
@@ -940,7 +1049,7 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
         InlineFailureType::kGlobalsNotDict,
         fullname,
         Py_TYPE(globals)->tp_name);
-    return;
+    return nullptr;
   }
   if (!PyDict_CheckExact(func->func_builtins)) {
     dlogAndCollectFailureStats(
@@ -948,28 +1057,25 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
         InlineFailureType::kBuiltinsNotDict,
         fullname,
         Py_TYPE(func->func_builtins)->tp_name);
-    return;
+    return nullptr;
   }
   if (!canInline(call_instr, func, fullname, inline_failure_stats)) {
     JIT_DLOG("Cannot inline {} into {}", fullname, caller.fullname);
-    return;
+    return nullptr;
   }
 
-  auto caller_frame_state =
-      std::make_unique<FrameState>(*call_instr->instr->frameState());
-
   // We are only able to inline functions that were already preloaded, since we
   // can't safely preload anything mid-compile (preloading can execute arbitrary
   // Python code and raise Python exceptions). Currently this means that in
   // single-function-compile mode we are limited to inlining functions loaded as
-  // globals, or statically invoked. See `preloadFuncAndDeps` for what
-  // dependencies we will preload. In batch-compile mode we can inline anything
-  // that is part of the batch.
+  // globals, statically invoked, or called as methods on profiled receivers.
+  // See `preloadFuncAndDeps` for what dependencies we will preload. In
+  // batch-compile mode we can inline anything that is part of the batch.
   Preloader* preloader = lookupPreloader(func);
   if (!preloader) {
     dlogAndCollectFailureStats(
         inline_failure_stats, InlineFailureType::kNeedsPreload, fullname);
-    return;
+    return nullptr;
   }
 
   if (!canInlineWithPreloader(
@@ -978,8 +1084,78 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
         "canInlineWithPreloader vetoes inline of {} into {}",
         fullname,
         caller.fullname);
+    return nullptr;
+  }
+  return preloader;
+}
+
+// Append guards to instrs that deopt if the defaults that call_instr was bound
+// with are no longer the defaults of the function it calls.
+static void emitDefaultsGuards(
+    Function& caller,
+    AbstractCall* call_instr,
+    std::vector<Instr*>& instrs) {
+  Register* func = call_instr->target;
+  if (call_instr->defaults != nullptr) {
+    Register* defaults_obj = caller.env.AllocateRegister();
+    instrs.push_back(LoadField::create(
+        defaults_obj,
+        func,
+        "func_defaults",
+        offsetof(PyFunctionObject, func_defaults),
+        TOptObject));
+    instrs.push_back(GuardIs::create(
+        caller.env.AllocateRegister(),
+        reinterpret_cast<PyObject*>(call_instr->defaults.get()),
+        defaults_obj));
+  }
+  if (call_instr->kwdefaults == nullptr) {
     return;
   }
+  // func_kwdefaults is a mutable dict, so also check that it hasn't been
+  // modified since it was read.
+  Register* kwdefaults_obj = caller.env.AllocateRegister();
+  instrs.push_back(LoadField::create(
+      kwdefaults_obj,
+      func,
+      "func_kwdefaults",
+      offsetof(PyFunctionObject, func_kwdefaults),
+      TOptObject));
+  Register* kwdefaults = caller.env.AllocateRegister();
+  instrs.push_back(GuardIs::create(
+      kwdefaults,
+      reinterpret_cast<PyObject*>(call_instr->kwdefaults.get()),
+      kwdefaults_obj));
+  Register* version = caller.env.AllocateRegister();
+  instrs.push_back(LoadField::create(
+      version,
+      kwdefaults,
+      "ma_version_tag",
+      offsetof(PyDictObject, ma_version_tag),
+      TCUInt64));
+  Register* expected_version = caller.env.AllocateRegister();
+  instrs.push_back(LoadConst::create(
+      expected_version,
+      Type::fromCUInt(call_instr->kwdefaults_version, TCUInt64)));
+  Register* unmodified = caller.env.AllocateRegister();
+  instrs.push_back(PrimitiveCompare::create(
+      unmodified, PrimitiveCompareOp::kEqual, version, expected_version));
+  instrs.push_back(Guard::create(unmodified));
+}
+
+void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
+  BorrowedRef<PyFunctionObject> func = call_instr->func;
+  PyCodeObject* code = reinterpret_cast<PyCodeObject*>(func->func_code);
+  JIT_CHECK(PyCode_Check(code), "Expected PyCodeObject");
+  PyObject* globals = func->func_globals;
+  std::string fullname = funcFullname(func);
+  Preloader* preloader = preloaderForInline(caller, call_instr);
+  if (preloader == nullptr) {
+    return;
+  }
+
+  auto caller_frame_state =
+      std::make_unique<FrameState>(*call_instr->instr->frameState());
   HIRBuilder hir_builder(*preloader);
   InlineResult result =
       hir_builder.inlineHIR(&caller, caller_frame_state.get());
@@ -998,6 +1174,7 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
       std::move(caller_frame_state),
       fullname);
   auto callee_branch = Branch::create(result.entry);
+  std::vector<Instr*> prologue;
   if (call_instr->target != nullptr) {
     // Not a static call. Check that __code__ has not been swapped out since
     // the function was inlined.
@@ -1006,32 +1183,58 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
     // TODO(emacs): Emit a DeoptPatchpoint here to catch the case where someone
     // swaps out function.__code__.
     Register* code_obj = caller.env.AllocateRegister();
-    auto load_code = LoadField::create(
+    prologue.push_back(LoadField::create(
         code_obj,
         call_instr->target,
         "func_code",
         offsetof(PyFunctionObject, func_code),
-        TObject);
+        TObject));
     Register* guarded_code = caller.env.AllocateRegister();
-    auto guard_code = GuardIs::create(
-        guarded_code, reinterpret_cast<PyObject*>(code), code_obj);
-    call_instr->instr->ExpandInto(
-        {load_code, guard_code, begin_inlined_function, callee_branch});
-  } else {
-    call_instr->instr->ExpandInto({begin_inlined_function, callee_branch});
+    prologue.push_back(GuardIs::create(
+        guarded_code, reinterpret_cast<PyObject*>(code), code_obj));
+  }
+  if (call_instr->defaults != nullptr || call_instr->kwdefaults != nullptr) {
+    JIT_CHECK(call_instr->target != nullptr, "Defaults need a function");
+    emitDefaultsGuards(caller, call_instr, prologue);
   }
+  prologue.push_back(begin_inlined_function);
+  prologue.push_back(callee_branch);
+  call_instr->instr->ExpandInto(prologue);
   tail->push_front(EndInlinedFunction::create(begin_inlined_function));
 
-  // Transform LoadArg into Assign
+  // Transform LoadArg into Assign, or LoadConst of the default value for
+  // parameters the call doesn't pass. The callee's LoadCurrentFunc, which
+  // loads its closure, becomes the function being called.
   for (auto it = result.entry->begin(); it != result.entry->end();) {
     auto& instr = *it;
     ++it;
 
     if (instr.IsLoadArg()) {
       auto load_arg = static_cast<LoadArg*>(&instr);
-      auto assign = Assign::create(
-          instr.GetOutput(), call_instr->arg(load_arg->arg_idx()));
-      instr.ReplaceWith(*assign);
+      Instr* replacement;
+      if (Register* arg = call_instr->boundArg(load_arg->arg_idx())) {
+        replacement = Assign::create(instr.GetOutput(), arg);
+      } else {
+        ThreadedCompileSerialize guard;
+        BorrowedRef<> value =
+            call_instr->default_values.at(load_arg->arg_idx());
+        replacement = LoadConst::create(
+            instr.GetOutput(),
+            Type::fromObject(caller.env.addReference(value.get())));
+      }
+      instr.ReplaceWith(*replacement);
+      delete &instr;
+    } else if (instr.IsLoadCurrentFunc()) {
+      Instr* replacement;
+      if (call_instr->target != nullptr) {
+        replacement = Assign::create(instr.GetOutput(), call_instr->target);
+      } else {
+        replacement = LoadConst::create(
+            instr.GetOutput(),
+            Type::fromObject(caller.env.addReference(
+                reinterpret_cast<PyObject*>(func.get()))));
+      }
+      instr.ReplaceWith(*replacement);
       delete &instr;
     }
   }
@@ -1051,6 +1254,110 @@ void inlineFunctionCall(Function& caller, AbstractCall* call_instr) {
   caller.inline_function_stats.num_inlined_functions++;
 }
 
+// Replace a CallMethod with a dispatch on the method it loaded: each of
+// targets is compared against the method and called directly with a VectorCall
+// if it matches, and anything else goes through the original CallMethod.
+// Comparing the method rather than the receiver's type keeps the dispatch
+// correct even if the type or instance was modified since the method was
+// loaded.
+static void dispatchMethodCall(
+    Function& irfunc,
+    CallMethod* call,
+    const std::vector<BorrowedRef<PyFunctionObject>>& targets) {
+  BCOffset bc_off = call->bytecodeOffset();
+  Register* method = call->func();
+  Register* result = call->GetOutput();
+  BasicBlock* tail = call->block()->splitAfter(*call);
+  BasicBlock* block = call->block();
+  call->unlink();
+
+  BasicBlock* fallback = irfunc.cfg.AllocateBlock();
+  std::unordered_map<BasicBlock*, Register*> results;
+  for (std::size_t i = 0; i < targets.size(); ++i) {
+    Register* target = irfunc.env.AllocateRegister();
+    block->appendWithOff<LoadConst>(
+        bc_off,
+        target,
+        Type::fromObject(irfunc.env.addReference(
+            reinterpret_cast<PyObject*>(targets[i].get()))));
+    Register* is_target = irfunc.env.AllocateRegister();
+    block->appendWithOff<PrimitiveCompare>(
+        bc_off, is_target, PrimitiveCompareOp::kEqual, method, target);
+    BasicBlock* direct = irfunc.cfg.AllocateBlock();
+    BasicBlock* next =
+        i + 1 < targets.size() ? irfunc.cfg.AllocateBlock() : fallback;
+    block->appendWithOff<CondBranch>(bc_off, is_target, direct, next);
+
+    Register* direct_result = irfunc.env.AllocateRegister();
+    auto direct_call = direct->appendWithOff<VectorCall>(
+        bc_off,
+        call->NumOperands(),
+        direct_result,
+        call->isAwaited(),
+        *call->frameState());
+    direct_call->SetOperand(0, target);
+    for (std::size_t j = 1; j < call->NumOperands(); ++j) {
+      direct_call->SetOperand(j, call->GetOperand(j));
+    }
+    direct->appendWithOff<Branch>(bc_off, tail);
+    results[direct] = direct_result;
+    block = next;
+  }
+
+  Register* fallback_result = irfunc.env.AllocateRegister();
+  call->SetOutput(fallback_result);
+  fallback->Append(call);
+  fallback->appendWithOff<Branch>(bc_off, tail);
+  results[fallback] = fallback_result;
+  tail->push_front(Phi::create(result, results));
+}
+
+// Find the CallMethods whose LoadMethod saw receivers in the profile that
+// resolve to inlinable Python functions, and dispatch them to direct calls.
+static void dispatchProfiledMethodCalls(Function& irfunc) {
+  BorrowedRef<PyCodeObject> code = irfunc.code;
+  Preloader* preloader = lookupPreloader(code);
+  if (preloader == nullptr || preloader->methodTargets().empty()) {
+    return;
+  }
+  std::vector<
+      std::pair<CallMethod*, std::vector<BorrowedRef<PyFunctionObject>>>>
+      to_dispatch;
+  for (auto& block : irfunc.cfg.blocks) {
+    for (auto& instr : block) {
+      if (!instr.IsCallMethod()) {
+        continue;
+      }
+      auto call = static_cast<CallMethod*>(&instr);
+      Instr* load = call->func()->instr();
+      if (!load->IsLoadMethod()) {
+        continue;
+      }
+      auto it = preloader->methodTargets().find(load->bytecodeOffset());
+      if (it == preloader->methodTargets().end()) {
+        continue;
+      }
+      std::vector<BorrowedRef<PyFunctionObject>> targets;
+      for (const auto& target : it->second) {
+        // The receiver is passed as the first argument.
+        AbstractCall direct_call(target.get(), call->NumOperands() - 1, call);
+        if (preloaderForInline(irfunc, &direct_call) != nullptr) {
+          targets.emplace_back(target.get());
+        }
+      }
+      if (!targets.empty()) {
+        to_dispatch.emplace_back(call, std::move(targets));
+      }
+    }
+  }
+  for (auto& [call, targets] : to_dispatch) {
+    dispatchMethodCall(irfunc, call, targets);
+  }
+  if (!to_dispatch.empty()) {
+    reflowTypes(irfunc);
+  }
+}
+
 void InlineFunctionCalls::Run(Function& irfunc) {
   if (irfunc.code == nullptr) {
     // In tests, irfunc may not have bytecode.
@@ -1063,11 +1370,13 @@ void InlineFunctionCalls::Run(Function& irfunc) {
         irfunc.fullname);
     return;
   }
+  dispatchProfiledMethodCalls(irfunc);
   std::vector<AbstractCall> to_inline;
   for (auto& block : irfunc.cfg.blocks) {
     for (auto& instr : block) {
       // TODO(emacs): Support InvokeMethod
-      if (instr.IsVectorCall() || instr.IsVectorCallStatic()) {
+      if (instr.IsVectorCall() || instr.IsVectorCallStatic() ||
+          instr.IsVectorCallKW()) {
         auto call = static_cast<VectorCallBase*>(&instr);
         Register* target = call->func();
         if (!target->type().hasValueSpec(TFunc)) {
@@ -1078,7 +1387,22 @@ void InlineFunctionCalls::Run(Function& irfunc) {
               irfunc.fullname);
           continue;
         }
-        to_inline.emplace_back(AbstractCall(target, call->numArgs(), call));
+        if (!instr.IsVectorCallKW()) {
+          to_inline.emplace_back(AbstractCall(target, call->numArgs(), call));
+          continue;
+        }
+        // The keyword names are passed after the arguments.
+        Register* kwnames = call->arg(call->numArgs() - 1);
+        if (!kwnames->type().hasValueSpec(TTuple)) {
+          JIT_DLOG(
+              "Cannot inline call with unknown keyword names {} into {}",
+              *kwnames,
+              irfunc.fullname);
+          continue;
+        }
+        AbstractCall abstract_call(target, call->numArgs() - 1, call);
+        abstract_call.kwnames = kwnames->type().objectSpec();
+        to_inline.emplace_back(std::move(abstract_call));
       } else if (instr.IsInvokeStaticFunction()) {
         auto call = static_cast<InvokeStaticFunction*>(&instr);
         to_inline.emplace_back(
@@ -1297,4 +1621,989 @@ void BuiltinLoadMethodElimination::Run(Function& irfunc) {
   }
 }
 
+namespace {
+
+// A natural loop, identified by its header block.
+struct Loop {
+  BasicBlock* header{nullptr};
+  // Sources of the back edges to header.
+  std::vector<BasicBlock*> latches;
+  // Every block in the loop, including the header and latches.
+  std::unordered_set<BasicBlock*> blocks;
+};
+
+// Immediate dominators, in a form that can be updated as blocks are inserted.
+class DomTree {
+ public:
+  explicit DomTree(const Function& func) {
+    DominatorAnalysis doms{func};
+    for (auto& block : func.cfg.blocks) {
+      idoms_[&block] = doms.immediateDominator(&block);
+    }
+  }
+
+  bool dominates(const BasicBlock* a, const BasicBlock* b) const {
+    while (b != nullptr) {
+      if (a == b) {
+        return true;
+      }
+      auto it = idoms_.find(b);
+      b = it == idoms_.end() ? nullptr : it->second;
+    }
+    return false;
+  }
+
+  void setIdom(const BasicBlock* block, const BasicBlock* idom) {
+    idoms_[block] = idom;
+  }
+
+ private:
+  std::unordered_map<const BasicBlock*, const BasicBlock*> idoms_;
+};
+
+// Find all natural loops in func, ordered from innermost to outermost.
+std::vector<Loop> findLoops(const Function& func, const DomTree& doms) {
+  std::unordered_map<BasicBlock*, Loop> loops;
+  std::vector<BasicBlock*> headers;
+  for (BasicBlock* block : func.cfg.GetRPOTraversal()) {
+    Instr* term = block->GetTerminator();
+    for (std::size_t i = 0, n = term->numEdges(); i < n; ++i) {
+      BasicBlock* succ = term->successor(i);
+      if (!doms.dominates(succ, block)) {
+        continue;
+      }
+      Loop& loop = loops[succ];
+      if (loop.header == nullptr) {
+        loop.header = succ;
+        headers.push_back(succ);
+      }
+      loop.latches.push_back(block);
+    }
+  }
+
+  std::vector<Loop> result;
+  for (BasicBlock* header : headers) {
+    Loop& loop = loops[header];
+    loop.blocks.insert(header);
+    std::vector<BasicBlock*> stack(loop.latches.begin(), loop.latches.end());
+    while (!stack.empty()) {
+      BasicBlock* block = stack.back();
+      stack.pop_back();
+      if (!loop.blocks.insert(block).second) {
+        continue;
+      }
+      for (const Edge* edge : block->in_edges()) {
+        stack.push_back(edge->from());
+      }
+    }
+    result.emplace_back(std::move(loop));
+  }
+  std::stable_sort(result.begin(), result.end(), [](auto& a, auto& b) {
+    return a.blocks.size() < b.blocks.size();
+  });
+  return result;
+}
+
+// Return a block that the loop's only entry edge comes from and that has no
+// other successors, splitting the entry edge if necessary. Returns nullptr if
+// the loop has more than one entry edge.
+BasicBlock* getOrCreatePreheader(
+    Function& func,
+    Loop& loop,
+    std::vector<Loop>& loops,
+    DomTree& doms) {
+  const Edge* entry = nullptr;
+  for (const Edge* edge : loop.header->in_edges()) {
+    if (loop.blocks.count(edge->from())) {
+      continue;
+    }
+    if (entry != nullptr) {
+      return nullptr;
+    }
+    entry = edge;
+  }
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  BasicBlock* pred = entry->from();
+  if (pred->GetTerminator()->numEdges() == 1) {
+    return pred;
+  }
+
+  BasicBlock* preheader = func.cfg.AllocateBlock();
+  preheader->appendWithOff<Branch>(
+      pred->GetTerminator()->bytecodeOffset(), loop.header);
+  const_cast<Edge*>(entry)->set_to(preheader);
+  loop.header->fixupPhis(pred, preheader);
+  doms.setIdom(preheader, pred);
+  doms.setIdom(loop.header, preheader);
+  // The new block belongs to every enclosing loop.
+  for (Loop& other : loops) {
+    if (other.blocks.count(pred) && other.blocks.count(loop.header)) {
+      other.blocks.insert(preheader);
+    }
+  }
+  return preheader;
+}
+
+// Find the FrameState at the top of the loop: the first Snapshot reachable
+// from the header without passing through anything with side-effects.
+const Snapshot* findLoopEntrySnapshot(const Loop& loop) {
+  BasicBlock* block = loop.header;
+  std::unordered_set<BasicBlock*> visited;
+  while (visited.insert(block).second) {
+    for (Instr& instr : *block) {
+      if (instr.IsSnapshot()) {
+        return static_cast<Snapshot*>(&instr);
+      }
+      if (instr.IsTerminator()) {
+        break;
+      }
+      if (!instr.IsPhi() && !instr.isReplayable()) {
+        return nullptr;
+      }
+    }
+
+    Instr* term = block->GetTerminator();
+    if (term->IsBranch()) {
+      block = term->successor(0);
+      if (!loop.blocks.count(block)) {
+        return nullptr;
+      }
+      continue;
+    }
+    // A conditional branch is fine as long as both sides agree on the state
+    // of the frame (e.g. the eval breaker check).
+    if (!term->IsCondBranch()) {
+      return nullptr;
+    }
+    const Snapshot* result = nullptr;
+    for (std::size_t i = 0, n = term->numEdges(); i < n; ++i) {
+      BasicBlock* succ = term->successor(i);
+      const Snapshot* snapshot =
+          loop.blocks.count(succ) ? succ->entrySnapshot() : nullptr;
+      if (snapshot == nullptr || snapshot->frameState() == nullptr ||
+          (result != nullptr &&
+           *result->frameState() != *snapshot->frameState())) {
+        return nullptr;
+      }
+      result = snapshot;
+    }
+    return result;
+  }
+  return nullptr;
+}
+
+bool definedInLoop(const Loop& loop, const Register* reg) {
+  return reg->instr() != nullptr && loop.blocks.count(reg->instr()->block());
+}
+
+// Translate the FrameState at the top of the loop into one that's valid in the
+// preheader, by replacing the header's Phis with their incoming values.
+std::unique_ptr<FrameState> makePreheaderFrameState(
+    const Loop& loop,
+    const FrameState& loop_state,
+    BasicBlock* preheader) {
+  auto state = std::make_unique<FrameState>(loop_state);
+  auto remap = [&](Register*& reg) {
+    if (reg == nullptr || !definedInLoop(loop, reg)) {
+      return true;
+    }
+    Instr* def = reg->instr();
+    if (!def->IsPhi() || def->block() != loop.header) {
+      return false;
+    }
+    auto phi = static_cast<Phi*>(def);
+    reg = phi->GetOperand(phi->blockIndex(preheader));
+    return true;
+  };
+  for (auto& reg : state->stack) {
+    if (!remap(reg)) {
+      return nullptr;
+    }
+  }
+  for (auto& reg : state->locals) {
+    if (!remap(reg)) {
+      return nullptr;
+    }
+  }
+  for (auto& reg : state->cells) {
+    if (!remap(reg)) {
+      return nullptr;
+    }
+  }
+  if (!remap(state->elided_frames)) {
+    return nullptr;
+  }
+  // The parent FrameState is shared, so it must already be loop-invariant.
+  if (state->parent != nullptr &&
+      !state->parent->visitUses(
+          [&](Register*& reg) { return !definedInLoop(loop, reg); })) {
+    return nullptr;
+  }
+  return state;
+}
+
+// Guards are bound to the FrameState of the closest preceding Snapshot by
+// RefcountInsertion, so hoisting them only needs a Snapshot in the preheader.
+bool usesSnapshotFrameState(const Instr& instr) {
+  return instr.IsGuard() || instr.IsGuardIs() || instr.IsGuardType();
+}
+
+// Check that everything state refers to is available in block.
+bool frameStateAvailableIn(
+    const FrameState& state,
+    const BasicBlock* block,
+    const DomTree& doms) {
+  return const_cast<FrameState&>(state).visitUses([&](Register*& reg) {
+    return reg->instr() == nullptr ||
+        doms.dominates(reg->instr()->block(), block);
+  });
+}
+
+// Clone a side-effect-free instruction, giving the copy a fresh output.
+Instr* cloneWithOutput(Instr& instr, Register* dst) {
+  Register* orig = instr.GetOutput();
+  Instr* copy = instr.clone();
+  copy->SetOutput(dst);
+  orig->set_instr(&instr);
+  return copy;
+}
+
+bool hoistLoopInvariants(
+    Function& func,
+    Loop& loop,
+    std::vector<Loop>& loops,
+    DomTree& doms) {
+  AliasClass kills{AEmpty};
+  std::vector<Instr*> periodic_tasks;
+  for (BasicBlock* block : loop.blocks) {
+    for (Instr& instr : *block) {
+      if (instr.IsPhi() || instr.IsTerminator()) {
+        continue;
+      }
+      if (instr.IsRunPeriodicTasks() &&
+          static_cast<RunPeriodicTasks&>(instr).frameState() != nullptr) {
+        periodic_tasks.push_back(&instr);
+        continue;
+      }
+      kills = kills | memoryEffects(instr).may_store;
+    }
+  }
+
+  // Only hoist out of blocks that run on every complete iteration. Hoisting
+  // anything else is still correct but would speculate on code that may
+  // never run.
+  auto runs_every_iteration = [&](BasicBlock* block) {
+    for (BasicBlock* latch : loop.latches) {
+      if (!doms.dominates(block, latch)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<Instr*> candidates;
+  for (BasicBlock* block : func.cfg.GetRPOTraversal()) {
+    if (!loop.blocks.count(block) || !runs_every_iteration(block)) {
+      continue;
+    }
+    for (Instr& instr : *block) {
+      // Hoisting constants just stretches out their live ranges. They're
+      // rematerialized in the preheader if something hoisted uses them.
+      if (instr.IsLoadConst()) {
+        continue;
+      }
+      // Anything else that can deopt carries its own FrameState, which can
+      // be replaced, but only if it doesn't have to be built mid-iteration.
+      auto deopt = instr.asDeoptBase();
+      if (deopt != nullptr && !usesSnapshotFrameState(instr) &&
+          deopt->frameState() == nullptr) {
+        continue;
+      }
+      std::optional<AliasClass> reads = memoryReads(instr);
+      if (reads.has_value() && (*reads & kills) == AEmpty) {
+        candidates.push_back(&instr);
+      }
+    }
+  }
+  if (candidates.empty()) {
+    return false;
+  }
+
+  BasicBlock* preheader = getOrCreatePreheader(func, loop, loops, doms);
+  if (preheader == nullptr) {
+    return false;
+  }
+  const Snapshot* loop_snapshot = findLoopEntrySnapshot(loop);
+  std::unique_ptr<FrameState> preheader_state =
+      loop_snapshot == nullptr || loop_snapshot->frameState() == nullptr
+      ? nullptr
+      : makePreheaderFrameState(
+            loop, *loop_snapshot->frameState(), preheader);
+
+  Instr* term = preheader->GetTerminator();
+  bool emitted_snapshot = false;
+  std::vector<Instr*> hoisted_loads;
+  JIT_DCHECK(
+      preheader_state == nullptr ||
+          frameStateAvailableIn(*preheader_state, preheader, doms),
+      "Preheader FrameState uses values defined after the preheader");
+  std::unordered_map<Register*, Register*> consts;
+  for (Instr* instr : candidates) {
+    bool invariant = true;
+    for (Register* operand : instr->GetOperands()) {
+      if (definedInLoop(loop, operand) && !operand->instr()->IsLoadConst()) {
+        invariant = false;
+        break;
+      }
+    }
+    if (!invariant) {
+      continue;
+    }
+    auto deopt = instr->asDeoptBase();
+    if (deopt != nullptr) {
+      if (preheader_state == nullptr) {
+        continue;
+      }
+      // A guard failure is recorded against the bytecode offset instr was
+      // emitted for, in the code of the frame it deopts to, so it can't move
+      // out of an inlined function.
+      const FrameState* frame = instr->getDominatingFrameState();
+      if (frame == nullptr || frame->code != preheader_state->code) {
+        continue;
+      }
+      if (!usesSnapshotFrameState(*instr)) {
+        // Deopting from the preheader resumes at the top of the loop, not
+        // wherever instr used to be. It keeps its own bytecode offset, which
+        // is where a failure is recorded for recompilation.
+        deopt->setFrameState(*preheader_state);
+      } else if (!emitted_snapshot) {
+        auto snapshot = Snapshot::create(*preheader_state);
+        snapshot->copyBytecodeOffset(*loop_snapshot);
+        snapshot->InsertBefore(*term);
+        emitted_snapshot = true;
+      }
+    }
+    for (std::size_t i = 0, n = instr->NumOperands(); i < n; ++i) {
+      Register* operand = instr->GetOperand(i);
+      if (!definedInLoop(loop, operand)) {
+        continue;
+      }
+      Register*& copy = consts[operand];
+      if (copy == nullptr) {
+        copy = func.env.AllocateRegister();
+        Instr* load = cloneWithOutput(*operand->instr(), copy);
+        load->copyBytecodeOffset(*term);
+        load->InsertBefore(*term);
+      }
+      instr->SetOperand(i, copy);
+    }
+    instr->unlink();
+    instr->InsertBefore(*term);
+    JIT_DCHECK(
+        deopt == nullptr || deopt->frameState() == nullptr ||
+            frameStateAvailableIn(*deopt->frameState(), preheader, doms),
+        "Hoisted {} has a FrameState that isn't available in the preheader",
+        *instr);
+    if (memoryReads(*instr) != AEmpty) {
+      hoisted_loads.push_back(instr);
+    }
+  }
+
+  // RunPeriodicTasks can run arbitrary code. Reload anything we hoisted after
+  // it and deopt back to the top of the loop if it changed.
+  if (!hoisted_loads.empty()) {
+    for (Instr* tasks : periodic_tasks) {
+      Instr* cursor = tasks;
+      auto insert = [&](Instr* instr) {
+        instr->copyBytecodeOffset(*tasks);
+        instr->InsertAfter(*cursor);
+        cursor = instr;
+      };
+      insert(Snapshot::create(
+          *static_cast<RunPeriodicTasks*>(tasks)->frameState()));
+      for (Instr* load : hoisted_loads) {
+        Register* reloaded = func.env.AllocateRegister();
+        insert(cloneWithOutput(*load, reloaded));
+        Register* same = func.env.AllocateRegister();
+        insert(PrimitiveCompare::create(
+            same, PrimitiveCompareOp::kEqual, reloaded, load->GetOutput()));
+        auto guard = Guard::create(same);
+        guard->setDescr("loop invariant modified by periodic tasks");
+        insert(guard);
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+void LICM::Run(Function& irfunc) {
+  DomTree doms{irfunc};
+  std::vector<Loop> loops = findLoops(irfunc, doms);
+  bool changed = false;
+  for (Loop& loop : loops) {
+    changed |= hoistLoopInvariants(irfunc, loop, loops, doms);
+  }
+  if (changed) {
+    reflowTypes(irfunc);
+  }
+}
+
+namespace {
+
+// Return the memory read by instr if it's a candidate for value numbering, or
+// std::nullopt if it isn't.
+std::optional<AliasClass> valueNumberingReads(const Instr& instr) {
+  if (instr.IsLoadConst()) {
+    // Constants are materialized where they're used, so merging them would
+    // only stretch out their live ranges.
+    return std::nullopt;
+  }
+  if (instr.IsIsTruthy()) {
+    // The truthiness of an immutable builtin can't run user code or change.
+    Type ty = instr.GetOperand(0)->type();
+    if (ty <=
+        (TBool | TBytesExact | TFloatExact | TLongExact | TNoneType |
+         TTupleExact | TUnicodeExact)) {
+      return AEmpty;
+    }
+    return std::nullopt;
+  }
+  return memoryReads(instr);
+}
+
+PyObject* globalName(const LoadGlobalCached& instr) {
+  BorrowedRef<PyCodeObject> code = instr.code();
+  if (code == nullptr) {
+    return nullptr;
+  }
+  return PyTuple_GET_ITEM(code->co_names, instr.name_idx());
+}
+
+// Compare everything about two instructions with the same opcode other than
+// their operands.
+bool sameAttributes(const Instr& a, const Instr& b) {
+  switch (a.opcode()) {
+    case Opcode::kBitCast:
+      return static_cast<const BitCast&>(a).type() ==
+          static_cast<const BitCast&>(b).type();
+    case Opcode::kDoubleBinaryOp:
+      return static_cast<const DoubleBinaryOp&>(a).op() ==
+          static_cast<const DoubleBinaryOp&>(b).op();
+    case Opcode::kGuard:
+    case Opcode::kIsTruthy:
+    case Opcode::kLoadCellItem:
+    case Opcode::kLoadFieldAddress:
+    case Opcode::kLoadVarObjectSize:
+      return true;
+    case Opcode::kGuardIs:
+      return static_cast<const GuardIs&>(a).target() ==
+          static_cast<const GuardIs&>(b).target();
+    case Opcode::kGuardType:
+      return static_cast<const GuardType&>(a).target() ==
+          static_cast<const GuardType&>(b).target();
+    case Opcode::kIntBinaryOp:
+      return static_cast<const IntBinaryOp&>(a).op() ==
+          static_cast<const IntBinaryOp&>(b).op();
+    case Opcode::kCheckedIntBinaryOp:
+      return static_cast<const CheckedIntBinaryOp&>(a).op() ==
+          static_cast<const CheckedIntBinaryOp&>(b).op();
+    case Opcode::kIntConvert:
+      return static_cast<const IntConvert&>(a).type() ==
+          static_cast<const IntConvert&>(b).type();
+    case Opcode::kLoadField: {
+      auto& fa = static_cast<const LoadField&>(a);
+      auto& fb = static_cast<const LoadField&>(b);
+      return fa.offset() == fb.offset() && fa.type() == fb.type() &&
+          fa.borrowed() == fb.borrowed();
+    }
+    case Opcode::kLoadGlobalCached: {
+      auto& ga = static_cast<const LoadGlobalCached&>(a);
+      auto& gb = static_cast<const LoadGlobalCached&>(b);
+      if (ga.globals() != gb.globals() || ga.builtins() != gb.builtins()) {
+        return false;
+      }
+      // Inlined functions have their own code objects, so compare names
+      // rather than indices when possible.
+      PyObject* name_a = globalName(ga);
+      PyObject* name_b = globalName(gb);
+      if (name_a == nullptr || name_b == nullptr) {
+        return ga.code() == gb.code() && ga.name_idx() == gb.name_idx();
+      }
+      return name_a == name_b;
+    }
+    case Opcode::kLoadTupleItem:
+      return static_cast<const LoadTupleItem&>(a).idx() ==
+          static_cast<const LoadTupleItem&>(b).idx();
+    case Opcode::kLoadTypeAttrCacheItem: {
+      auto& ca = static_cast<const LoadTypeAttrCacheItem&>(a);
+      auto& cb = static_cast<const LoadTypeAttrCacheItem&>(b);
+      return ca.cache_id() == cb.cache_id() && ca.item_idx() == cb.item_idx();
+    }
+    case Opcode::kLoadTypeMethodCacheEntryType:
+      return static_cast<const LoadTypeMethodCacheEntryType&>(a).cache_id() ==
+          static_cast<const LoadTypeMethodCacheEntryType&>(b).cache_id();
+    case Opcode::kPrimitiveCompare:
+      return static_cast<const PrimitiveCompare&>(a).op() ==
+          static_cast<const PrimitiveCompare&>(b).op();
+    case Opcode::kPrimitiveUnaryOp:
+      return static_cast<const PrimitiveUnaryOp&>(a).op() ==
+          static_cast<const PrimitiveUnaryOp&>(b).op();
+    default:
+      return false;
+  }
+}
+
+// Constants aren't merged themselves (see valueNumberingReads()), so compare
+// them by value when they're used as operands.
+std::optional<Type> constantOperand(const Register* reg) {
+  const Instr* def = reg->instr();
+  if (def == nullptr || !def->IsLoadConst()) {
+    return std::nullopt;
+  }
+  return static_cast<const LoadConst*>(def)->type();
+}
+
+bool sameOperand(const Register* a, const Register* b) {
+  if (a == b) {
+    return true;
+  }
+  std::optional<Type> ca = constantOperand(a);
+  return ca.has_value() && ca == constantOperand(b);
+}
+
+struct ValueHash {
+  std::size_t operator()(const Instr* instr) const {
+    std::size_t hash = std::hash<int>{}(static_cast<int>(instr->opcode()));
+    for (std::size_t i = 0, n = instr->NumOperands(); i < n; ++i) {
+      const Register* operand = instr->GetOperand(i);
+      std::optional<Type> constant = constantOperand(operand);
+      hash = combineHash(
+          hash,
+          constant.has_value() ? std::hash<Type>{}(*constant)
+                              : std::hash<const Register*>{}(operand));
+    }
+    return hash;
+  }
+};
+
+struct ValueEquals {
+  bool operator()(const Instr* a, const Instr* b) const {
+    if (a->opcode() != b->opcode() || a->NumOperands() != b->NumOperands()) {
+      return false;
+    }
+    for (std::size_t i = 0, n = a->NumOperands(); i < n; ++i) {
+      if (!sameOperand(a->GetOperand(i), b->GetOperand(i))) {
+        return false;
+      }
+    }
+    // Deopts with different nonces have to stay distinguishable in their
+    // DeoptMetadata.
+    auto deopt_a = a->asDeoptBase();
+    auto deopt_b = b->asDeoptBase();
+    if (deopt_a != nullptr && deopt_a->nonce() != deopt_b->nonce()) {
+      return false;
+    }
+    return sameAttributes(*a, *b);
+  }
+};
+
+using ValueSet = std::unordered_set<Instr*, ValueHash, ValueEquals>;
+using LoadMap = std::unordered_map<Instr*, AliasClass, ValueHash, ValueEquals>;
+
+} // namespace
+
+void GlobalValueNumbering::Run(Function& irfunc) {
+  DominatorAnalysis doms{irfunc};
+  std::unordered_map<const BasicBlock*, std::vector<BasicBlock*>> children;
+  for (BasicBlock* block : irfunc.cfg.GetRPOTraversal()) {
+    if (block != irfunc.cfg.entry_block) {
+      children[doms.immediateDominator(block)].push_back(block);
+    }
+  }
+
+  // Pure values are available in every block dominated by their definition.
+  // Each block records what it added so it can be removed again once the
+  // walk leaves its subtree.
+  ValueSet values;
+  std::unordered_map<Register*, Register*> replacements;
+  std::vector<std::unique_ptr<Instr>> removed;
+
+  struct Visit {
+    BasicBlock* block;
+    // Loads available at the start of the block.
+    LoadMap loads;
+    std::vector<Instr*> added;
+    bool done;
+  };
+  std::vector<Visit> stack;
+  stack.push_back(Visit{irfunc.cfg.entry_block, {}, {}, false});
+  while (!stack.empty()) {
+    if (stack.back().done) {
+      for (Instr* instr : stack.back().added) {
+        values.erase(instr);
+      }
+      stack.pop_back();
+      continue;
+    }
+    stack.back().done = true;
+    BasicBlock* block = stack.back().block;
+    LoadMap loads = std::move(stack.back().loads);
+    std::vector<Instr*> added;
+
+    for (auto it = block->begin(); it != block->end();) {
+      Instr& instr = *it;
+      ++it;
+      for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
+        auto repl = replacements.find(instr.GetOperand(i));
+        if (repl != replacements.end()) {
+          instr.SetOperand(i, repl->second);
+        }
+      }
+      if (instr.IsPhi() || instr.IsTerminator()) {
+        continue;
+      }
+
+      std::optional<AliasClass> reads = valueNumberingReads(instr);
+      if (reads.has_value()) {
+        Instr* existing = nullptr;
+        if (*reads == AEmpty) {
+          auto found = values.find(&instr);
+          if (found != values.end()) {
+            existing = *found;
+          } else {
+            values.insert(&instr);
+            added.push_back(&instr);
+          }
+        } else {
+          auto found = loads.find(&instr);
+          if (found != loads.end()) {
+            existing = found->first;
+          } else {
+            loads.emplace(&instr, *reads);
+          }
+        }
+        if (existing != nullptr) {
+          Register* output = instr.GetOutput();
+          if (output != nullptr) {
+            replacements[output] = existing->GetOutput();
+            auto assign = Assign::create(output, existing->GetOutput());
+            assign->copyBytecodeOffset(instr);
+            instr.ReplaceWith(*assign);
+          } else {
+            instr.unlink();
+          }
+          removed.emplace_back(&instr);
+        }
+        continue;
+      }
+
+      AliasClass stores = memoryEffects(instr).may_store;
+      if (stores == AEmpty) {
+        continue;
+      }
+      for (auto load = loads.begin(); load != loads.end();) {
+        if ((load->second & stores) != AEmpty) {
+          load = loads.erase(load);
+        } else {
+          ++load;
+        }
+      }
+    }
+
+    stack.back().added = std::move(added);
+    // Memory state only carries over to a successor that can't be reached any
+    // other way.
+    for (BasicBlock* child : children[block]) {
+      bool single_pred = child->in_edges().size() == 1;
+      stack.push_back(
+          Visit{child, single_pred ? loads : LoadMap{}, {}, false});
+    }
+  }
+
+  if (!removed.empty()) {
+    CopyPropagation{}.Run(irfunc);
+    reflowTypes(irfunc);
+  }
+}
+
+namespace {
+
+// A call a function makes to itself just before returning its result.
+struct TailCall {
+  // Snapshot immediately before the call.
+  Snapshot* snapshot;
+  VectorCall* call;
+};
+
+bool canLoop(const Function& irfunc) {
+  if (irfunc.code == nullptr || irfunc.osr_entry.has_value()) {
+    return false;
+  }
+  int unsupported_flags = CO_STATICALLY_COMPILED | CO_VARARGS |
+      CO_VARKEYWORDS | kCoFlagsAnyGenerator;
+  return !(irfunc.code->co_flags & unsupported_flags) &&
+      irfunc.code->co_kwonlyargcount == 0 && irfunc.code->co_argcount > 0 &&
+      irfunc.cfg.entry_block->in_edges().empty();
+}
+
+// Is func a call to a function that runs irfunc's code in the same
+// environment?
+bool isSelf(const Function& irfunc, Register* func) {
+  Type type = func->type();
+  if (!type.hasValueSpec(TFunc)) {
+    return false;
+  }
+  auto target = reinterpret_cast<PyFunctionObject*>(type.objectSpec());
+  auto same = [](PyObject* obj, const auto& ref) {
+    return obj == reinterpret_cast<PyObject*>(ref.get());
+  };
+  return same(target->func_code, irfunc.code) &&
+      same(target->func_globals, irfunc.globals) &&
+      same(target->func_builtins, irfunc.builtins) &&
+      target->func_closure == nullptr;
+}
+
+// If block ends by returning the result of a self call, return that call.
+std::optional<TailCall> findTailCall(
+    const Function& irfunc,
+    BasicBlock* block) {
+  Instr* term = block->GetTerminator();
+  if (term == nullptr || !term->IsReturn()) {
+    return std::nullopt;
+  }
+  auto it = block->reverse_iterator_to(*term);
+  for (++it; it != block->rend() && it->IsSnapshot(); ++it) {
+  }
+  if (it == block->rend() || !it->IsVectorCall() ||
+      it->GetOutput() != term->GetOperand(0)) {
+    return std::nullopt;
+  }
+  auto call = static_cast<VectorCall*>(&*it);
+  const FrameState* frame = call->frameState();
+  if (call->isAwaited() || frame == nullptr || frame->parent != nullptr ||
+      !frame->block_stack.isEmpty() ||
+      call->numArgs() != static_cast<std::size_t>(irfunc.code->co_argcount) ||
+      !isSelf(irfunc, call->func())) {
+    return std::nullopt;
+  }
+  ++it;
+  if (it == block->rend() || !it->IsSnapshot() ||
+      static_cast<Snapshot&>(*it).frameState() == nullptr) {
+    return std::nullopt;
+  }
+  return TailCall{static_cast<Snapshot*>(&*it), call};
+}
+
+// Tracebacks can only show the elided frames at one line, so only eliminate
+// the calls if they're all on the same line.
+bool onOneLine(const Function& irfunc, const std::vector<TailCall>& calls) {
+  int line = -1;
+  for (const TailCall& tail_call : calls) {
+    int call_line =
+        PyCode_Addr2Line(irfunc.code, tail_call.call->bytecodeOffset().value());
+    if (line != -1 && call_line != line) {
+      return false;
+    }
+    line = call_line;
+  }
+  return true;
+}
+
+} // namespace
+
+// A function that ends by returning the result of calling itself, as in
+//
+//   def fact(n, acc):
+//       if n <= 1:
+//           return acc
+//       return fact(n - 1, acc * n)
+//
+// pushes a frame per call. This pass turns those calls into jumps back to the
+// top of the function. The entry block is split after its LoadArgs, which
+// become the initial values of a Phi per argument in the new header block, and
+// each tail call passes its arguments to those Phis instead.
+//
+// A call is only rewritten when it's to a known function object with this
+// function's code, globals, and builtins, and no closure, which passes exactly
+// the positional arguments the code takes and isn't inside a try or with
+// block. The callee's __code__ can still be reassigned, so each jump is
+// guarded on it, with the Snapshot from before the call: if the guard fails,
+// the interpreter makes the call. Each jump also checks the eval breaker, as
+// the call would have, so the loop can be interrupted.
+//
+// The elided frames still have to be accounted for. Another Phi in the header
+// counts the jumps taken, and every FrameState refers to it as elided_frames.
+// Each jump charges the recursion depth for its frame with
+// JITRT_EnterTailCall(), raising a RecursionError where the call would have,
+// and each Return releases the frames before returning. When deoptimizing,
+// the frames are released once the outermost frame finishes in the
+// interpreter, and if it raised, they're added to the traceback at the tail
+// call. If tracing or profiling is on, JITRT_EnterTailCall() returns 0 and
+// the jump deopts instead, so the interpreter makes the call and it's traced.
+void TailCallElimination::Run(Function& irfunc) {
+  if (!canLoop(irfunc)) {
+    return;
+  }
+  std::vector<TailCall> tail_calls;
+  for (auto& block : irfunc.cfg.blocks) {
+    if (auto tail_call = findTailCall(irfunc, &block)) {
+      tail_calls.push_back(*tail_call);
+    }
+  }
+  if (tail_calls.empty() || !onOneLine(irfunc, tail_calls)) {
+    return;
+  }
+
+  BasicBlock* entry = irfunc.cfg.entry_block;
+  std::vector<LoadArg*> load_args;
+  for (auto& instr : *entry) {
+    if (!instr.IsLoadArg()) {
+      break;
+    }
+    load_args.push_back(static_cast<LoadArg*>(&instr));
+  }
+  if (load_args.size() !=
+      static_cast<std::size_t>(irfunc.code->co_argcount)) {
+    return;
+  }
+  BCOffset entry_off = load_args.back()->bytecodeOffset();
+  BasicBlock* header = entry->splitAfter(*load_args.back());
+  Register* no_frames = irfunc.env.AllocateRegister();
+  entry->appendWithOff<LoadConst>(
+      entry_off, no_frames, Type::fromCInt(0, TCInt64));
+  entry->appendWithOff<Branch>(entry_off, header);
+
+  // Everything but the LoadArgs now sees the current iteration's arguments.
+  std::vector<Register*> args;
+  for (LoadArg* load_arg : load_args) {
+    Register* arg = irfunc.env.AllocateRegister();
+    args.push_back(arg);
+    for (auto& block : irfunc.cfg.blocks) {
+      if (&block == entry) {
+        continue;
+      }
+      for (auto& instr : block) {
+        instr.ReplaceUsesOf(load_arg->GetOutput(), arg);
+      }
+    }
+  }
+  Register* elided_frames = irfunc.env.AllocateRegister();
+
+  std::vector<std::unordered_map<BasicBlock*, Register*>> phi_args(
+      load_args.size());
+  for (std::size_t i = 0; i < load_args.size(); ++i) {
+    phi_args[i][entry] = load_args[i]->GetOutput();
+  }
+  std::unordered_map<BasicBlock*, Register*> frame_counts{
+      {entry, no_frames}};
+  for (const TailCall& tail_call : tail_calls) {
+    VectorCall* call = tail_call.call;
+    BasicBlock* block = call->block();
+    BCOffset bc_off = call->bytecodeOffset();
+    Register* func = call->func();
+    std::vector<Register*> call_args;
+    for (std::size_t i = 0; i < call->numArgs(); ++i) {
+      call_args.push_back(call->arg(i));
+    }
+    const FrameState& frame = *tail_call.snapshot->frameState();
+    FrameState call_frame = *call->frameState();
+
+    // Drop the call, the Snapshots after it, and the Return.
+    for (auto it = std::next(block->iterator_to(*tail_call.snapshot));
+         it != block->end();) {
+      Instr& instr = *it;
+      ++it;
+      instr.unlink();
+      delete &instr;
+    }
+
+    Register* code_obj = irfunc.env.AllocateRegister();
+    block->appendWithOff<LoadField>(
+        bc_off,
+        code_obj,
+        func,
+        "func_code",
+        offsetof(PyFunctionObject, func_code),
+        TObject);
+    block->appendWithOff<GuardIs>(
+        bc_off,
+        irfunc.env.AllocateRegister(),
+        reinterpret_cast<PyObject*>(irfunc.code.get()),
+        code_obj);
+    Register* eval_breaker = irfunc.env.AllocateRegister();
+    block->appendWithOff<LoadEvalBreaker>(bc_off, eval_breaker);
+    BasicBlock* periodic_tasks = irfunc.cfg.AllocateBlock();
+    BasicBlock* jump = irfunc.cfg.AllocateBlock();
+    block->appendWithOff<CondBranch>(
+        bc_off, eval_breaker, periodic_tasks, jump);
+
+    periodic_tasks->appendWithOff<Snapshot>(bc_off, frame);
+    periodic_tasks->appendWithOff<RunPeriodicTasks>(
+        bc_off, irfunc.env.AllocateRegister(), frame);
+    periodic_tasks->appendWithOff<Branch>(bc_off, jump);
+
+    // A RecursionError is raised by the call, and tracing makes it for real,
+    // from the state before it.
+    Register* entered = irfunc.env.AllocateRegister();
+    jump->appendWithOff<CallStatic>(
+        bc_off,
+        0,
+        entered,
+        reinterpret_cast<void*>(JITRT_EnterTailCall),
+        TCInt32);
+    Register* checked = irfunc.env.AllocateRegister();
+    jump->appendWithOff<CheckNeg>(bc_off, checked, entered, call_frame);
+    jump->appendWithOff<Snapshot>(bc_off, frame);
+    jump->appendWithOff<Guard>(bc_off, checked);
+    Register* one = irfunc.env.AllocateRegister();
+    jump->appendWithOff<LoadConst>(bc_off, one, Type::fromCInt(1, TCInt64));
+    Register* next_count = irfunc.env.AllocateRegister();
+    jump->appendWithOff<IntBinaryOp>(
+        bc_off, next_count, BinaryOpKind::kAdd, elided_frames, one);
+    jump->appendWithOff<Branch>(bc_off, header);
+
+    for (std::size_t i = 0; i < call_args.size(); ++i) {
+      phi_args[i][jump] = call_args[i];
+    }
+    frame_counts[jump] = next_count;
+  }
+
+  BCOffset tail_call_offset = tail_calls.front().call->bytecodeOffset();
+  for (auto& block : irfunc.cfg.blocks) {
+    if (&block == entry) {
+      continue;
+    }
+    for (auto& instr : block) {
+      FrameState* fs = nullptr;
+      if (instr.IsSnapshot()) {
+        fs = static_cast<Snapshot&>(instr).frameState();
+      } else if (DeoptBase* deopt = instr.asDeoptBase()) {
+        fs = deopt->frameState();
+      }
+      if (fs != nullptr) {
+        fs->elided_frames = elided_frames;
+        fs->tail_call_offset = tail_call_offset;
+      }
+      if (instr.IsReturn()) {
+        auto leave = CallStaticRetVoid::create(
+            1, reinterpret_cast<void*>(JITRT_LeaveTailCalls));
+        leave->SetOperand(0, elided_frames);
+        leave->copyBytecodeOffset(instr);
+        leave->InsertBefore(instr);
+      }
+    }
+  }
+
+  header->push_front(Phi::create(elided_frames, frame_counts));
+  for (std::size_t i = load_args.size(); i > 0; --i) {
+    header->push_front(Phi::create(args[i - 1], phi_args[i - 1]));
+  }
+
+  reflowTypes(irfunc);
+}
+
 } // namespace jit::hir
@@ -202,6 +202,100 @@ class BuiltinLoadMethodElimination : public Pass {
   }
 };
 
+// Loop-invariant code motion: hoist pure computations, loads from memory that
+// isn't written inside the loop, and guards on loop-invariant values into the
+// loop's preheader.
+//
+// Hoisted guards deopt to the top of the loop, using the FrameState at the
+// loop header with the header's Phis replaced by their incoming values from
+// the preheader. Loads are still allowed to be hoisted across
+// RunPeriodicTasks, which can run arbitrary code; they get re-checked after it
+// and deopt if anything changed.
+class LICM : public Pass {
+ public:
+  LICM() : Pass("LICM") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<LICM> Factory() {
+    return std::make_unique<LICM>();
+  }
+};
+
+// Dominator-based global value numbering: replace an instruction with an
+// equivalent one that dominates it. Pure computations and guards are reused
+// anywhere in the dominator tree. Loads are only reused within a chain of
+// single-predecessor blocks, and only until something may have written to the
+// memory they read.
+class GlobalValueNumbering : public Pass {
+ public:
+  GlobalValueNumbering() : Pass("GlobalValueNumbering") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<GlobalValueNumbering> Factory() {
+    return std::make_unique<GlobalValueNumbering>();
+  }
+};
+
+// Remove MakeTuple, small MakeList, and BuildSlice allocations whose result
+// never escapes the function: loads of their elements and size are replaced
+// with the values they were built from. If a FrameState still refers to the
+// object, the allocation becomes a VirtualObject, which is only materialized
+// if we deopt.
+class EscapeAnalysis : public Pass {
+ public:
+  EscapeAnalysis() : Pass("EscapeAnalysis") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<EscapeAnalysis> Factory() {
+    return std::make_unique<EscapeAnalysis>();
+  }
+};
+
+// Do arithmetic and comparisons on ints that are known to fit in a machine word
+// with CInt64 values, deopting if a result overflows. See
+// int_range_analysis.cpp for details.
+class IntRangeAnalysis : public Pass {
+ public:
+  IntRangeAnalysis() : Pass("IntRangeAnalysis") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<IntRangeAnalysis> Factory() {
+    return std::make_unique<IntRangeAnalysis>();
+  }
+};
+
+// Keep floats that Simplify unboxed as CDoubles across Phis and in
+// FrameStates, so loop-carried floats aren't boxed on every iteration. See
+// float_unboxing.cpp for details.
+class FloatUnboxing : public Pass {
+ public:
+  FloatUnboxing() : Pass("FloatUnboxing") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<FloatUnboxing> Factory() {
+    return std::make_unique<FloatUnboxing>();
+  }
+};
+
+// Turn calls a function makes to itself just before returning into jumps back
+// to its start, so they don't use a frame each. See the comment on Run() in
+// optimization.cpp for details.
+class TailCallElimination : public Pass {
+ public:
+  TailCallElimination() : Pass("TailCallElimination") {}
+
+  void Run(Function& irfunc) override;
+
+  static std::unique_ptr<TailCallElimination> Factory() {
+    return std::make_unique<TailCallElimination>();
+  }
+};
+
 class PassRegistry {
  public:
   PassRegistry();
@@ -274,6 +274,19 @@ HIRParser::parseInstr(std::string_view opcode, Register* dst, int bb_index) {
         args.end(),
         std::bind(std::mem_fn(&HIRParser::ParseRegister), this));
     instruction = newInstr<MakeTuple>(nvalues, dst, args);
+  } else if (opcode == "BuildSlice") {
+    expect("<");
+    int nvalues = GetNextInteger();
+    expect(">");
+    std::vector<Register*> args(nvalues);
+    std::generate(
+        args.begin(),
+        args.end(),
+        std::bind(std::mem_fn(&HIRParser::ParseRegister), this));
+    instruction = newInstr<BuildSlice>(nvalues, dst);
+    for (int i = 0; i < nvalues; i++) {
+      instruction->SetOperand(i, args[i]);
+    }
   } else if (opcode == "MakeSet") {
     NEW_INSTR(MakeSet, dst);
   } else if (opcode == "SetSetItem") {
@@ -430,6 +443,13 @@ HIRParser::parseInstr(std::string_view opcode, Register* dst, int bb_index) {
     auto left = ParseRegister();
     auto right = ParseRegister();
     NEW_INSTR(IntBinaryOp, dst, op, left, right);
+  } else if (opcode == "CheckedIntBinaryOp") {
+    expect("<");
+    BinaryOpKind op = ParseBinaryOpName(GetNextToken());
+    expect(">");
+    auto left = ParseRegister();
+    auto right = ParseRegister();
+    instruction = newInstr<CheckedIntBinaryOp>(dst, op, left, right);
   } else if (opcode == "Compare") {
     expect("<");
     CompareOp op = ParseCompareOpName(GetNextToken());
@@ -604,6 +624,17 @@ HIRParser::parseInstr(std::string_view opcode, Register* dst, int bb_index) {
     expect(">");
     auto operand = ParseRegister();
     NEW_INSTR(UseType, operand, ty);
+  } else if (opcode == "VirtualObject") {
+    expect("<");
+    auto kind = ParseVirtualObjectKindName(GetNextToken());
+    expect(",");
+    int nvalues = GetNextInteger();
+    expect(">");
+    auto virt = VirtualObject::create(nvalues, dst, kind);
+    for (int i = 0; i < nvalues; i++) {
+      virt->SetOperand(i, ParseRegister());
+    }
+    instruction = virt;
   } else if (opcode == "HintType") {
     ProfiledTypes types;
     expect("<");
@@ -697,6 +728,13 @@ HIRParser::parseInstr(std::string_view opcode, Register* dst, int bb_index) {
     instruction = newInstr<InvokeStaticFunction>(argcount, dst, func, ty);
   } else if (opcode == "LoadCurrentFunc") {
     NEW_INSTR(LoadCurrentFunc, dst);
+  } else if (opcode == "LoadEvalBreaker") {
+    NEW_INSTR(LoadEvalBreaker, dst);
+  } else if (opcode == "RunPeriodicTasks") {
+    instruction = newInstr<RunPeriodicTasks>(dst);
+  } else if (opcode == "LoadVarObjectSize") {
+    auto obj = ParseRegister();
+    NEW_INSTR(LoadVarObjectSize, dst, obj);
   } else if (opcode == "ListAppend") {
     auto list = ParseRegister();
     auto value = ParseRegister();
@@ -751,6 +789,11 @@ FrameState HIRParser::parseFrameState() {
       for (Register* r : parseRegisterVector()) {
         fs.stack.push(r);
       }
+    } else if (token == "ElidedFrames") {
+      expect("<");
+      fs.tail_call_offset = BCOffset{GetNextInteger()};
+      expect(">");
+      fs.elided_frames = ParseRegister();
     } else if (token == "BlockStack") {
       expect("{");
       while (peekNextToken() != "}") {
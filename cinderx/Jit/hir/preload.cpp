@@ -11,6 +11,7 @@
 #include "cinderx/Jit/codegen/gen_asm.h"
 #include "cinderx/Jit/hir/optimization.h"
 
+#include <algorithm>
 #include <utility>
 
 namespace jit::hir {
@@ -322,6 +323,12 @@ std::unique_ptr<Function> Preloader::makeFunction() const {
   auto irfunc = std::make_unique<Function>();
   irfunc->fullname = fullname_;
   irfunc->setCode(code_);
+  if (osr_entry_.has_value()) {
+    // Cells and freevars are read out of the interpreter frame, so the entry
+    // never needs the function object.
+    irfunc->osr_entry = osr_entry_;
+    irfunc->uses_runtime_func = false;
+  }
   irfunc->builtins.reset(builtins_);
   irfunc->globals.reset(globals_);
   irfunc->prim_args_info.reset(prim_args_info_);
@@ -343,6 +350,33 @@ BorrowedRef<> Preloader::constArg(BytecodeInstruction& bc_instr) const {
   return PyTuple_GET_ITEM(code_->co_consts, bc_instr.oparg());
 }
 
+void Preloader::preloadMethodTargets(BytecodeInstruction& bc_instr) {
+  auto& profile_runtime = Runtime::get()->profileRuntime();
+  std::vector<BorrowedRef<PyTypeObject>> types =
+      profile_runtime.getPolymorphicTypes(code_, bc_instr.offset());
+  BorrowedRef<> name = PyTuple_GET_ITEM(code_->co_names, bc_instr.oparg());
+  std::vector<Ref<PyFunctionObject>> targets;
+  for (BorrowedRef<PyTypeObject> type : types) {
+    if (type->tp_getattro != PyObject_GenericGetAttr) {
+      continue;
+    }
+    BorrowedRef<> method = typeLookupSafe(type, name);
+    if (method == nullptr || !PyFunction_Check(method)) {
+      continue;
+    }
+    auto same_method = [&](const Ref<PyFunctionObject>& target) {
+      return target.get() ==
+          reinterpret_cast<PyFunctionObject*>(method.get());
+    };
+    if (std::none_of(targets.begin(), targets.end(), same_method)) {
+      targets.emplace_back(Ref<PyFunctionObject>::create(method));
+    }
+  }
+  if (!targets.empty()) {
+    method_targets_.emplace(bc_instr.offset(), std::move(targets));
+  }
+}
+
 bool Preloader::preload() {
   if (code_->co_flags & CO_STATICALLY_COMPILED) {
     PyTypeOpt ret_type =
@@ -431,6 +465,10 @@ bool Preloader::preload() {
         }
         break;
       }
+      case LOAD_METHOD: {
+        preloadMethodTargets(bc_instr);
+        break;
+      }
       case BUILD_CHECKED_LIST:
       case BUILD_CHECKED_MAP: {
         BorrowedRef<> descr = PyTuple_GetItem(constArg(bc_instr), 0);
@@ -12,8 +12,10 @@
 #include "cinderx/Jit/hir/type.h"
 
 #include <map>
+#include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace jit::hir {
 
@@ -22,6 +24,8 @@ Type prim_type_to_type(int prim_type);
 using PyTypeOpt = std::tuple<Ref<PyTypeObject>, bool, bool>;
 using ArgToType = std::map<long, Type>;
 using GlobalNamesMap = std::unordered_map<int, BorrowedRef<>>;
+using MethodTargetMap =
+    std::unordered_map<BCOffset, std::vector<Ref<PyFunctionObject>>>;
 
 struct FieldInfo {
   Py_ssize_t offset;
@@ -129,6 +133,12 @@ class Preloader {
     return global_names_;
   }
 
+  // Python functions that the receiver types profiled at each LOAD_METHOD
+  // resolve to, keyed by the offset of the LOAD_METHOD.
+  const MethodTargetMap& methodTargets() const {
+    return method_targets_;
+  }
+
   // get the type from argument check info for the given locals index, or
   // TObject
   Type checkArgType(long local_idx) const;
@@ -168,6 +178,16 @@ class Preloader {
         bool(code_->co_flags & CO_VARKEYWORDS);
   }
 
+  // Mark this preloader as producing an on-stack replacement entry at the
+  // given loop header instead of a normal function body.
+  void setOSREntry(OSREntry entry) {
+    osr_entry_ = entry;
+  }
+
+  const std::optional<OSREntry>& osrEntry() const {
+    return osr_entry_;
+  }
+
   std::unique_ptr<InvokeTarget> resolve_target_descr(
       BorrowedRef<> descr,
       int opcode);
@@ -176,6 +196,7 @@ class Preloader {
   BorrowedRef<> constArg(BytecodeInstruction& bc_instr) const;
   GlobalCache getGlobalCache(BorrowedRef<> name) const;
   bool canCacheGlobals() const;
+  void preloadMethodTargets(BytecodeInstruction& bc_instr);
   bool preload();
 
   explicit Preloader(
@@ -194,6 +215,7 @@ class Preloader {
   Ref<PyDictObject> builtins_;
   Ref<PyDictObject> globals_;
   const std::string fullname_;
+  std::optional<OSREntry> osr_entry_;
 
   // keyed by type descr tuple identity (they are interned in code objects)
   std::unordered_map<PyObject*, PyTypeOpt> types_;
@@ -206,6 +228,7 @@ class Preloader {
   std::map<long, PyTypeOpt> check_arg_pytypes_;
   // keyed by name index, names borrowed from code object
   GlobalNamesMap global_names_;
+  MethodTargetMap method_targets_;
   Type return_type_{TObject};
   bool has_primitive_args_{false};
   bool has_primitive_first_arg_{false};
@@ -224,8 +224,13 @@ static std::string format_varname(const Instr& instr, int idx) {
     return fmt::format("{}", idx);
   }
 
-  auto names = getVarnameTuple(code, &idx);
-  return format_name_impl(idx, names);
+  int name_idx = idx;
+  auto names = getVarnameTuple(code, &name_idx);
+  if (name_idx >= PyTuple_GET_SIZE(names)) {
+    // OSR entries load the interpreter's value stack after all variables.
+    return fmt::format("{}", idx);
+  }
+  return format_name_impl(name_idx, names);
 }
 
 static std::string format_immediates(const Instr& instr) {
@@ -516,6 +521,10 @@ static std::string format_immediates(const Instr& instr) {
       const auto& bin_op = static_cast<const IntBinaryOp&>(instr);
       return std::string{GetBinaryOpName(bin_op.op())};
     }
+    case Opcode::kCheckedIntBinaryOp: {
+      const auto& bin_op = static_cast<const CheckedIntBinaryOp&>(instr);
+      return std::string{GetBinaryOpName(bin_op.op())};
+    }
     case Opcode::kPrimitiveCompare: {
       const auto& cmp = static_cast<const PrimitiveCompare&>(instr);
       return std::string{GetPrimitiveCompareOpName(cmp.op())};
@@ -657,6 +666,11 @@ static std::string format_immediates(const Instr& instr) {
       const auto& gs = static_cast<const UseType&>(instr);
       return fmt::format("{}", gs.type().toString());
     }
+    case Opcode::kVirtualObject: {
+      const auto& virt = static_cast<const VirtualObject&>(instr);
+      return fmt::format(
+          "{}, {}", GetVirtualObjectKindName(virt.kind()), virt.NumOperands());
+    }
     case Opcode::kRaiseAwaitableError: {
       const auto& ra = static_cast<const RaiseAwaitableError&>(instr);
       return fmt::format("{}, {}", ra.with_prev_opcode(), ra.with_opcode());
@@ -811,6 +825,11 @@ void HIRPrinter::Print(std::ostream& os, const FrameState& state) {
     os << std::endl;
   }
 
+  if (state.elided_frames != nullptr) {
+    Indented(os) << "ElidedFrames<" << state.tail_call_offset << "> "
+                 << state.elided_frames->name() << std::endl;
+  }
+
   auto& bs = state.block_stack;
   if (bs.size() > 0) {
     Indented(os) << "BlockStack {" << std::endl;
@@ -932,6 +932,10 @@ void fillDeoptLiveRegs(const StateMap& live_regs, Instr& instr) {
   for (auto& pair : live_regs) {
     auto& rstate = pair.second;
     auto ref_kind = rstate.kind();
+    if (pair.first->instr()->IsVirtualObject()) {
+      // Rebuilt from its operands, which are live here too.
+      continue;
+    }
     for (int i = 0, n = rstate.numCopies(); i < n; ++i) {
       Register* reg = rstate.copy(i);
       deopt->emplaceLiveReg(reg, ref_kind, deoptValueKind(reg->type()));
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/hir/type.h"
 
 #include <iosfwd>
@@ -15,7 +16,7 @@ class Instr;
 // represented by the Register class. After SSAify has run on a Function, its
 // Registers represent SSA values, and their Types should be kept up-to-date and
 // trusted.
-class Register {
+class Register : public CompileArenaAllocated {
  public:
   explicit Register(int i) : id_(i) {}
 
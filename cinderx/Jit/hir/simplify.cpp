@@ -8,6 +8,7 @@
 #include "cinderx/Jit/hir/optimization.h"
 #include "cinderx/Jit/hir/printer.h"
 #include "cinderx/Jit/hir/ssa.h"
+#include "cinderx/Jit/jit_rt.h"
 #include "cinderx/Jit/profile_runtime.h"
 #include "cinderx/Jit/runtime.h"
 #include "cinderx/Jit/type_deopt_patchers.h"
@@ -307,6 +308,81 @@ Register* simplifyIntConvert(Env& env, const IntConvert* instr) {
   return nullptr;
 }
 
+// Floats are immutable and arithmetic and ordering comparisons on them can't
+// run arbitrary code, so when an operand is known to be an exact float
+// (usually because of a GuardType from its profiled type) we can work on
+// unboxed doubles. Within a chain of these ops, unbox(box(x)) simplifies to
+// x, and DCE removes the unused boxes. Every result is still boxed here, since
+// locals and FrameStates refer to it; FloatUnboxing removes the boxes that are
+// only needed by Phis and FrameStates.
+//
+// The other operand may also be an int constant that converts to a double
+// exactly, which is what float.__add__ and friends would do with it.
+bool isUnboxableFloat(Register* reg) {
+  if (reg->isA(TFloatExact)) {
+    return true;
+  }
+  Type type = reg->type();
+  if (!(type <= TLongExact) || !type.hasObjectSpec()) {
+    return false;
+  }
+  int overflow;
+  long long value = PyLong_AsLongLongAndOverflow(type.objectSpec(), &overflow);
+  constexpr long long kMaxExactDouble = 1LL << 53;
+  return overflow == 0 && value >= -kMaxExactDouble &&
+      value <= kMaxExactDouble;
+}
+
+Register* emitUnboxFloat(Env& env, Register* reg) {
+  Type type = reg->type();
+  if (reg->isA(TFloatExact)) {
+    env.emit<UseType>(reg, TFloatExact);
+    return env.emit<PrimitiveUnbox>(reg, TCDouble);
+  }
+  env.emit<UseType>(reg, type);
+  double value = PyLong_AsDouble(type.objectSpec());
+  return env.emit<LoadConst>(Type::fromCDouble(value));
+}
+
+bool canUnboxFloatOperands(Register* lhs, Register* rhs) {
+  return (lhs->isA(TFloatExact) || rhs->isA(TFloatExact)) &&
+      isUnboxableFloat(lhs) && isUnboxableFloat(rhs);
+}
+
+Register* simplifyFloatBinaryOp(
+    Env& env,
+    BinaryOpKind op,
+    Register* lhs,
+    Register* rhs,
+    const FrameState& frame) {
+  switch (op) {
+    case BinaryOpKind::kAdd:
+    case BinaryOpKind::kSubtract:
+    case BinaryOpKind::kMultiply:
+    case BinaryOpKind::kTrueDivide:
+      break;
+    default:
+      // Floor division, modulo, and power have Python-specific semantics that
+      // DoubleBinaryOp doesn't implement.
+      return nullptr;
+  }
+  if (!canUnboxFloatOperands(lhs, rhs)) {
+    return nullptr;
+  }
+  Register* left = emitUnboxFloat(env, lhs);
+  Register* right = emitUnboxFloat(env, rhs);
+  if (op == BinaryOpKind::kTrueDivide) {
+    // Let the interpreter raise ZeroDivisionError. NaN divisors also fail this
+    // check, which is harmless.
+    Register* zero = env.emit<LoadConst>(Type::fromCDouble(0.0));
+    Register* nonzero =
+        env.emit<PrimitiveCompare>(PrimitiveCompareOp::kNotEqual, right, zero);
+    env.emit<Guard>(nonzero, frame);
+  }
+  Register* result = env.emit<DoubleBinaryOp>(op, left, right);
+  return env.emit<PrimitiveBox>(result, TCDouble, frame);
+}
+
 Register* simplifyCompare(Env& env, const Compare* instr) {
   Register* left = instr->GetOperand(0);
   Register* right = instr->GetOperand(1);
@@ -341,6 +417,27 @@ Register* simplifyCompare(Env& env, const Compare* instr) {
         op == CompareOp::kExcMatch)) {
     return env.emit<UnicodeCompare>(instr->op(), left, right);
   }
+  // Ordering comparisons on doubles. comisd reports NaN operands as "below"
+  // and "equal", so only the above/above-or-equal conditions give the right
+  // answer for NaN, and less-than is done by swapping the operands. (==) and
+  // (!=) would get NaN wrong either way and are left alone.
+  if ((op == CompareOp::kLessThan || op == CompareOp::kLessThanEqual ||
+       op == CompareOp::kGreaterThan || op == CompareOp::kGreaterThanEqual) &&
+      canUnboxFloatOperands(left, right)) {
+    Register* unboxed_left = emitUnboxFloat(env, left);
+    Register* unboxed_right = emitUnboxFloat(env, right);
+    bool or_equal =
+        op == CompareOp::kLessThanEqual || op == CompareOp::kGreaterThanEqual;
+    PrimitiveCompareOp prim_op = or_equal
+        ? PrimitiveCompareOp::kGreaterThanEqualUnsigned
+        : PrimitiveCompareOp::kGreaterThanUnsigned;
+    if (op == CompareOp::kLessThan || op == CompareOp::kLessThanEqual) {
+      std::swap(unboxed_left, unboxed_right);
+    }
+    Register* result =
+        env.emit<PrimitiveCompare>(prim_op, unboxed_left, unboxed_right);
+    return env.emit<PrimitiveBoxBool>(result);
+  }
   return nullptr;
 }
 
@@ -545,6 +642,19 @@ Register* simplifyBinaryOp(Env& env, const BinaryOp* instr) {
     if (lhs->isA(TDictExact)) {
       return env.emit<DictSubscr>(lhs, rhs, *instr->frameState());
     }
+    if (rhs->instr()->IsBuildSlice() && rhs->instr()->NumOperands() == 2) {
+      // Slice without going through the slice object, so it can be removed by
+      // EscapeAnalysis if nothing else needs it.
+      auto slice = static_cast<const BuildSlice*>(rhs->instr());
+      Register* result = env.emitVariadic<CallStatic>(
+          3,
+          reinterpret_cast<void*>(JITRT_GetSlice),
+          TOptObject,
+          lhs,
+          slice->start(),
+          slice->stop());
+      return env.emit<CheckExc>(result, *instr->frameState());
+    }
     if (!rhs->isA(TLongExact)) {
       return nullptr;
     }
@@ -654,11 +764,38 @@ Register* simplifyBinaryOp(Env& env, const BinaryOp* instr) {
       (instr->op() == BinaryOpKind::kAdd)) {
     return env.emit<UnicodeConcat>(lhs, rhs, *instr->frameState());
   }
+  if (Register* result = simplifyFloatBinaryOp(
+          env, instr->op(), lhs, rhs, *instr->frameState())) {
+    return result;
+  }
 
   // Unsupported case.
   return nullptr;
 }
 
+Register* simplifyInPlaceOp(Env& env, const InPlaceOp* instr) {
+  // float has no in-place slots, so these are the same as the binary ops.
+  BinaryOpKind op;
+  switch (instr->op()) {
+    case InPlaceOpKind::kAdd:
+      op = BinaryOpKind::kAdd;
+      break;
+    case InPlaceOpKind::kSubtract:
+      op = BinaryOpKind::kSubtract;
+      break;
+    case InPlaceOpKind::kMultiply:
+      op = BinaryOpKind::kMultiply;
+      break;
+    case InPlaceOpKind::kTrueDivide:
+      op = BinaryOpKind::kTrueDivide;
+      break;
+    default:
+      return nullptr;
+  }
+  return simplifyFloatBinaryOp(
+      env, op, instr->left(), instr->right(), *instr->frameState());
+}
+
 Register* simplifyLongBinaryOp(Env& env, const LongBinaryOp* instr) {
   Type left_type = instr->left()->type();
   Type right_type = instr->right()->type();
@@ -1334,6 +1471,8 @@ Register* simplifyInstr(Env& env, const Instr* instr) {
       return simplifyBinaryOp(env, static_cast<const BinaryOp*>(instr));
     case Opcode::kLongBinaryOp:
       return simplifyLongBinaryOp(env, static_cast<const LongBinaryOp*>(instr));
+    case Opcode::kInPlaceOp:
+      return simplifyInPlaceOp(env, static_cast<const InPlaceOp*>(instr));
     case Opcode::kUnaryOp:
       return simplifyUnaryOp(env, static_cast<const UnaryOp*>(instr));
 
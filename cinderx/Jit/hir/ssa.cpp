@@ -468,6 +468,8 @@ Type outputType(
       }
       return binop.left()->type().unspecialized();
     }
+    case Opcode::kCheckedIntBinaryOp:
+      return TCInt64;
     case Opcode::kDoubleBinaryOp: {
       return TCDouble;
     }
@@ -581,6 +583,16 @@ Type outputType(
     case Opcode::kMakeTupleFromList:
     case Opcode::kUnpackExToTuple:
       return TMortalTupleExact;
+    case Opcode::kVirtualObject:
+      switch (static_cast<const VirtualObject&>(instr).kind()) {
+        case VirtualObject::Kind::kTuple:
+          return TMortalTupleExact;
+        case VirtualObject::Kind::kList:
+          return TMortalListExact;
+        case VirtualObject::Kind::kSlice:
+          return TMortalSlice;
+      }
+      JIT_ABORT("Bad VirtualObject kind");
     case Opcode::kPhi: {
       auto ty = TBottom;
       for (std::size_t i = 0, n = instr.NumOperands(); i < n; ++i) {
@@ -326,3 +326,16 @@ struct FunctionEntryCacheValue {
 
 using FunctionEntryCacheMap =
     jit::UnorderedMap<PyFunctionObject*, FunctionEntryCacheValue>;
+
+// The entry point that JIT code calls a function through in a direct call:
+// the function's static entry point when it has JIT-compiled code with one, or
+// the generic fallback otherwise. Only valid for the code the function had
+// when the cache was created, since callers pass its number of arguments.
+struct DirectCallCacheValue {
+  void** ptr{nullptr};
+  void* fallback{nullptr};
+  BorrowedRef<PyCodeObject> code;
+};
+
+using DirectCallCacheMap =
+    jit::UnorderedMap<PyFunctionObject*, DirectCallCacheValue>;
@@ -3,7 +3,9 @@
 #include "cinderx/Jit/jit_context.h"
 
 #include "cinderx/Common/log.h"
+#include "internal/pycore_shadow_frame.h"
 
+#include "cinderx/Jit/code_allocator.h"
 #include "cinderx/Jit/codegen/gen_asm.h"
 #include "cinderx/Jit/jit_gdb_support.h"
 
@@ -20,6 +22,24 @@ constexpr int kMaxCompileDepth = 10;
 std::unordered_set<CompilationKey> active_compiles;
 thread_local int compile_depth = 0;
 
+// Return true if any thread has a frame for code on its stack. This is
+// conservative: the frame may be running in the interpreter, or in a newer
+// compiled version of the code.
+bool isRunningOnAnyThread(BorrowedRef<PyCodeObject> code) {
+  PyInterpreterState* interp = PyThreadState_GET()->interp;
+  for (PyThreadState* tstate = PyInterpreterState_ThreadHead(interp);
+       tstate != nullptr;
+       tstate = PyThreadState_Next(tstate)) {
+    for (_PyShadowFrame* sf = tstate->shadow_frame; sf != nullptr;
+         sf = sf->prev) {
+      if (_PyShadowFrame_GetCode(sf) == code) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 } // namespace
 
 Context::~Context() {
@@ -34,6 +54,11 @@ Context::~Context() {
 _PyJIT_Result Context::compilePreloader(
     BorrowedRef<PyFunctionObject> func,
     const hir::Preloader& preloader) {
+  // Checking whether retired code is still running needs the GIL, which batch
+  // compile workers don't hold.
+  if (!g_threaded_compile_context.compileRunning()) {
+    reclaimRetiredCode();
+  }
   CompilationResult result = compilePreloader(preloader);
   if (result.compiled == nullptr) {
     return result.result;
@@ -167,6 +192,114 @@ void Context::clearCache() {
     orphaned_compiled_codes_.emplace_back(std::move(entry.second));
   }
   compiled_codes_.clear();
+  for (auto& entry : osr_entries_) {
+    if (entry.second != nullptr) {
+      orphaned_compiled_codes_.emplace_back(std::move(entry.second));
+    }
+  }
+  osr_entries_.clear();
+}
+
+void Context::recompile(const CodeRuntime* code_rt) {
+  ThreadedCompileSerialize guard;
+  retire(code_rt);
+  reclaimRetiredCode();
+}
+
+void Context::tierUp(const CodeRuntime* code_rt) {
+  ThreadedCompileSerialize guard;
+  Runtime::get()->tierUp(code_rt->frameState()->code());
+  // The baseline code calls this before pushing its frame, so it wouldn't be
+  // seen as running by reclaimRetiredCode(). Leave that to the next compile.
+  retire(code_rt);
+}
+
+void Context::retire(const CodeRuntime* code_rt) {
+  auto owns_runtime = [&](const std::unique_ptr<CompiledFunction>& compiled) {
+    return compiled != nullptr && compiled->codeRuntime() == code_rt;
+  };
+
+  std::unique_ptr<CompiledFunction> retired;
+  for (auto it = compiled_codes_.begin(); it != compiled_codes_.end(); ++it) {
+    if (!owns_runtime(it->second)) {
+      continue;
+    }
+    CompilationKey key = it->first;
+    retired = std::move(it->second);
+    compiled_codes_.erase(it);
+
+    std::vector<BorrowedRef<PyFunctionObject>> funcs;
+    for (BorrowedRef<PyFunctionObject> func : compiled_funcs_) {
+      CompilationKey func_key{
+          func->func_code, func->func_builtins, func->func_globals};
+      if (func_key == key) {
+        funcs.push_back(func);
+      }
+    }
+    for (BorrowedRef<PyFunctionObject> func : funcs) {
+      deoptFunc(func);
+    }
+    break;
+  }
+
+  if (retired == nullptr) {
+    for (auto it = osr_entries_.begin(); it != osr_entries_.end(); ++it) {
+      if (owns_runtime(it->second)) {
+        retired = std::move(it->second);
+        osr_entries_.erase(it);
+        break;
+      }
+    }
+  }
+
+  if (retired != nullptr) {
+    // The caller is still running the retired code, so it can't be freed
+    // until a later call to reclaimRetiredCode().
+    retired_compiled_codes_.emplace_back(std::move(retired));
+  }
+}
+
+void Context::reclaimRetiredCode() {
+  ThreadedCompileSerialize guard;
+  if (retired_compiled_codes_.empty()) {
+    return;
+  }
+  Runtime* rt = Runtime::get();
+  std::vector<std::unique_ptr<CompiledFunction>> still_retired;
+  for (std::unique_ptr<CompiledFunction>& compiled : retired_compiled_codes_) {
+    void* code = compiled->codeStart();
+    size_t size = compiled->codeSize();
+    BorrowedRef<PyCodeObject> py_code =
+        compiled->codeRuntime()->frameState()->code();
+    // A suspended generator keeps a resume address in its code, and there's
+    // no cheap way to find them all, so generator code is never freed.
+    if (code == nullptr || (py_code->co_flags & kCoFlagsAnyGenerator)) {
+      orphaned_compiled_codes_.emplace_back(std::move(compiled));
+      continue;
+    }
+    if (rt->isCodeReferenced(code, size) || isRunningOnAnyThread(py_code)) {
+      still_retired.emplace_back(std::move(compiled));
+      continue;
+    }
+    JIT_DLOG(
+        "Freeing {} bytes of retired code for {} at {}",
+        size,
+        codeQualname(py_code),
+        code);
+    rt->forgetDeoptPatchers(code, size);
+    CodeAllocator::get()->releaseCode(code, size);
+    compiled.reset();
+  }
+  retired_compiled_codes_ = std::move(still_retired);
+}
+
+size_t Context::retiredCodeBytes() const {
+  size_t bytes = 0;
+  for (const std::unique_ptr<CompiledFunction>& compiled :
+       retired_compiled_codes_) {
+    bytes += compiled->codeSize();
+  }
+  return bytes;
 }
 
 Context::CompilationResult Context::compilePreloader(
@@ -221,6 +354,44 @@ Context::CompilationResult Context::compilePreloader(
   return {pair.first->second.get(), PYJIT_RESULT_OK};
 }
 
+CompiledFunction* Context::compileOSREntry(const hir::Preloader& preloader) {
+  JIT_CHECK(
+      preloader.osrEntry().has_value(),
+      "Preloader for {} has no OSR entry",
+      preloader.fullname());
+  BorrowedRef<PyCodeObject> code = preloader.code();
+  OSRKey key{
+      CompilationKey{code, preloader.builtins(), preloader.globals()},
+      preloader.osrEntry()->loop_header};
+  if (std::optional<CompiledFunction*> compiled = lookupOSREntry(key)) {
+    return *compiled;
+  }
+
+  if (compile_depth == kMaxCompileDepth) {
+    return nullptr;
+  }
+  compile_depth++;
+  std::unique_ptr<CompiledFunction> compiled = jit_compiler_.Compile(preloader);
+  compile_depth--;
+
+  ThreadedCompileSerialize guard;
+  if (compiled != nullptr) {
+    register_pycode_debug_symbol(
+        code, preloader.fullname().c_str(), compiled.get());
+  }
+  auto pair = osr_entries_.emplace(key, std::move(compiled));
+  return pair.first->second.get();
+}
+
+std::optional<CompiledFunction*> Context::lookupOSREntry(const OSRKey& key) {
+  ThreadedCompileSerialize guard;
+  auto it = osr_entries_.find(key);
+  if (it == osr_entries_.end()) {
+    return std::nullopt;
+  }
+  return it->second.get();
+}
+
 CompiledFunction* Context::lookupCode(
     BorrowedRef<PyCodeObject> code,
     BorrowedRef<PyDictObject> builtins,
@@ -234,6 +405,7 @@ void Context::deoptFunc(BorrowedRef<PyFunctionObject> func) {
   if (compiled_funcs_.erase(func) != 0) {
     // Reset the entry point.
     func->vectorcall = (vectorcallfunc)PyEntry_LazyInit;
+    Runtime::get()->setDirectCallEntry(func, nullptr);
   }
 }
 
@@ -253,6 +425,9 @@ void Context::finalizeFunc(
     void** indirect = rt->findFunctionEntryCache(func);
     *indirect = compiled.staticEntry();
   }
+  // Baseline code has no static entry, which keeps direct calls on the
+  // fallback, and counting towards tiering up, until it's replaced.
+  rt->setDirectCallEntry(func, compiled.staticEntry());
   return;
 }
 
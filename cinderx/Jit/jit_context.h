@@ -13,6 +13,7 @@
 #include "cinderx/Jit/pyjit_typeslots.h"
 
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace jit {
@@ -32,6 +33,18 @@ struct CompilationKey {
   constexpr bool operator==(const CompilationKey& other) const = default;
 };
 
+// Lookup key for OSR entries in Context: the compilation key of the code
+// object plus the loop header being entered.
+struct OSRKey {
+  CompilationKey code_key;
+  BCOffset loop_header;
+
+  OSRKey(CompilationKey code_key, BCOffset loop_header)
+      : code_key(code_key), loop_header(loop_header) {}
+
+  constexpr bool operator==(const OSRKey& other) const = default;
+};
+
 } // namespace jit
 
 template <>
@@ -43,6 +56,15 @@ struct std::hash<jit::CompilationKey> {
   }
 };
 
+template <>
+struct std::hash<jit::OSRKey> {
+  std::size_t operator()(const jit::OSRKey& key) const {
+    return jit::combineHash(
+        std::hash<jit::CompilationKey>{}(key.code_key),
+        std::hash<jit::BCOffset>{}(key.loop_header));
+  }
+};
+
 namespace jit {
 
 /*
@@ -64,6 +86,22 @@ class Context {
       BorrowedRef<PyFunctionObject> func,
       const hir::Preloader& preloader);
 
+  /*
+   * JIT compile an on-stack replacement entry from a Preloader that has an
+   * OSR entry set.
+   *
+   * Returns the cached entry if this loop header was already compiled, and
+   * nullptr if compilation fails. Failures are cached as well so they are not
+   * retried every time the interpreter reaches the loop.
+   */
+  CompiledFunction* compileOSREntry(const hir::Preloader& preloader);
+
+  /*
+   * Look up an OSR entry that was previously compiled for key. Returns
+   * std::nullopt if compilation was never attempted, and nullptr if it failed.
+   */
+  std::optional<CompiledFunction*> lookupOSREntry(const OSRKey& key);
+
   /*
    * Attach already-compiled code to the given function, if it exists.
    *
@@ -82,6 +120,31 @@ class Context {
   void funcModified(BorrowedRef<PyFunctionObject> func);
   void funcDestroyed(BorrowedRef<PyFunctionObject> func);
 
+  /*
+   * Throw away the compiled code that owns code_rt, so that the functions
+   * using it are compiled again on their next call. The code is kept alive
+   * since it may still be running.
+   */
+  void recompile(const CodeRuntime* code_rt);
+
+  /*
+   * Throw away the baseline code that owns code_rt because it has got hot, so
+   * that the functions using it are fully optimized on their next call.
+   */
+  void tierUp(const CodeRuntime* code_rt);
+
+  /*
+   * Free the code of functions thrown away by recompile() once nothing can be
+   * running or calling it any more. Must be called with the GIL held.
+   */
+  void reclaimRetiredCode();
+
+  /*
+   * Total size of the code thrown away by recompile() that hasn't been freed
+   * yet.
+   */
+  size_t retiredCodeBytes() const;
+
   /*
    * Return whether or not this context compiled the supplied function.
    */
@@ -92,6 +155,15 @@ class Context {
    */
   CompiledFunction* lookupFunc(BorrowedRef<PyFunctionObject> func);
 
+  /*
+   * Look up the compiled code for a code object with the given builtins and
+   * globals.
+   */
+  CompiledFunction* lookupCode(
+      BorrowedRef<PyCodeObject> code,
+      BorrowedRef<PyDictObject> builtins,
+      BorrowedRef<PyDictObject> globals);
+
   /*
    * Returns the number of functions inlined into a specified JIT-compiled
    * function.
@@ -155,16 +227,17 @@ class Context {
 
   CompilationResult compilePreloader(const hir::Preloader& preloader);
 
-  CompiledFunction* lookupCode(
-      BorrowedRef<PyCodeObject> code,
-      BorrowedRef<PyDictObject> builtins,
-      BorrowedRef<PyDictObject> globals);
-
   /*
    * Reset a function's entry point if it was JIT-compiled.
    */
   void deoptFunc(BorrowedRef<PyFunctionObject> func);
 
+  /*
+   * Move the compiled code that owns code_rt to retired_compiled_codes_,
+   * resetting the entry points of the functions using it.
+   */
+  void retire(const CodeRuntime* code_rt);
+
   /*
    * Record per-function metadata for a newly compiled function and set the
    * function's entrypoint.
@@ -186,13 +259,24 @@ class Context {
   UnorderedMap<CompilationKey, std::unique_ptr<CompiledFunction>>
       compiled_codes_;
 
+  /*
+   * Map of all compiled OSR entries, with nullptr for loop headers that failed
+   * to compile.
+   */
+  UnorderedMap<OSRKey, std::unique_ptr<CompiledFunction>> osr_entries_;
+
   /*
    * Code which is being kept alive in case it was in use when
-   * clearCache was called. Only intended to be used during
-   * multithreaded_compile_test.
+   * clearCache was called, or which was retired by recompile() but can never
+   * be freed.
    */
   std::vector<std::unique_ptr<CompiledFunction>> orphaned_compiled_codes_;
 
+  /*
+   * Code thrown away by recompile(), waiting until it's safe to free.
+   */
+  std::vector<std::unique_ptr<CompiledFunction>> retired_compiled_codes_;
+
   Ref<> cinderjit_module_;
 };
 
@@ -21,12 +21,16 @@
 #include "cinderx/Jit/runtime_support.h"
 
 // clang-format off
+#include "internal/pycore_ceval.h"
 #include "internal/pycore_pyerrors.h"
 #include "internal/pycore_pystate.h"
 #include "internal/pycore_object.h"
 #include "pycore_tuple.h"
 // clang-format on
 
+#include <array>
+#include <utility>
+
 // This is mostly taken from ceval.c _PyEval_EvalCodeWithName
 // We use the same logic to turn **args, nargsf, and kwnames into
 // **args / nargsf.
@@ -451,6 +455,38 @@ TRetType JITRT_CallStaticallyWithPrimitiveSignatureTemplate(
       TVectorcall>(func, args, nargsf, arg_info);
 }
 
+template <std::size_t>
+using DirectCallArg = PyObject*;
+
+template <std::size_t... Is>
+static PyObject* directCallFallback(PyObject* func, DirectCallArg<Is>... args) {
+  PyObject* argv[] = {args..., nullptr};
+  return _PyObject_Vectorcall(func, argv, sizeof...(Is), nullptr);
+}
+
+template <std::size_t... Is>
+static void* directCallFallbackEntry(std::index_sequence<Is...>) {
+  PyObject* (*entry)(PyObject*, DirectCallArg<Is>...) =
+      directCallFallback<Is...>;
+  return reinterpret_cast<void*>(entry);
+}
+
+template <std::size_t... Nargs>
+static std::array<void*, sizeof...(Nargs)> makeDirectCallFallbacks(
+    std::index_sequence<Nargs...>) {
+  return {directCallFallbackEntry(std::make_index_sequence<Nargs>{})...};
+}
+
+void* JITRT_GetDirectCallFallback(int nargs) {
+  static const auto fallbacks = makeDirectCallFallbacks(
+      std::make_index_sequence<JITRT_MAX_DIRECT_CALL_ARGS + 1>{});
+  JIT_CHECK(
+      nargs >= 0 && nargs <= JITRT_MAX_DIRECT_CALL_ARGS,
+      "Too many arguments ({}) for a direct call",
+      nargs);
+  return fallbacks[nargs];
+}
+
 JITRT_StaticCallReturn JITRT_CallStaticallyWithPrimitiveSignature(
     PyFunctionObject* func,
     PyObject** args,
@@ -1798,6 +1834,43 @@ PyObject* JITRT_GetLength(PyObject* obj) {
   return PyLong_FromSsize_t(len);
 }
 
+static bool isSimpleSliceIndex(PyObject* index) {
+  return index == Py_None || PyLong_CheckExact(index);
+}
+
+PyObject* JITRT_GetSlice(PyObject* obj, PyObject* start, PyObject* stop) {
+  PyTypeObject* type = Py_TYPE(obj);
+  if ((type == &PyList_Type || type == &PyTuple_Type ||
+       type == &PyUnicode_Type) &&
+      isSimpleSliceIndex(start) && isSimpleSliceIndex(stop)) {
+    // Same bounds handling as PySlice_Unpack() and PySlice_AdjustIndices().
+    Py_ssize_t istart = 0;
+    Py_ssize_t istop = PY_SSIZE_T_MAX;
+    if (!_PyEval_SliceIndex(start, &istart) ||
+        !_PyEval_SliceIndex(stop, &istop)) {
+      return nullptr;
+    }
+    if (type == &PyUnicode_Type) {
+      if (PyUnicode_READY(obj) == -1) {
+        return nullptr;
+      }
+      PySlice_AdjustIndices(PyUnicode_GET_LENGTH(obj), &istart, &istop, 1);
+      return PyUnicode_Substring(obj, istart, istop);
+    }
+    PySlice_AdjustIndices(Py_SIZE(obj), &istart, &istop, 1);
+    if (type == &PyList_Type) {
+      return PyList_GetSlice(obj, istart, istop);
+    }
+    return PyTuple_GetSlice(obj, istart, istop);
+  }
+
+  Ref<> slice = Ref<>::steal(PySlice_New(start, stop, nullptr));
+  if (slice == nullptr) {
+    return nullptr;
+  }
+  return PyObject_GetItem(obj, slice);
+}
+
 int JITRT_DictUpdate(PyThreadState* tstate, PyObject* dict, PyObject* update) {
   if (PyDict_Update(dict, update) < 0) {
     if (_PyErr_ExceptionMatches(tstate, PyExc_AttributeError)) {
@@ -1838,3 +1911,18 @@ PyObject* JITRT_CopyDictWithoutKeys(PyObject* subject, PyObject* keys) {
   }
   return rest.release();
 }
+
+int JITRT_EnterTailCall() {
+  PyThreadState* tstate = _PyThreadState_GET();
+  if (tstate->cframe->use_tracing) {
+    return 0;
+  }
+  if (_Py_EnterRecursiveCall(tstate, " while calling a Python object")) {
+    return -1;
+  }
+  return 1;
+}
+
+void JITRT_LeaveTailCalls(int64_t count) {
+  _PyThreadState_GET()->recursion_depth -= count;
+}
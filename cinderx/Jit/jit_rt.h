@@ -482,6 +482,20 @@ JITRT_StaticCallReturn JITRT_FailedDeferredCompileShim(
     PyFunctionObject* func,
     PyObject** args);
 
+/* Largest number of arguments in a direct call from JIT code to a Python
+ * function. See JITRT_GetDirectCallFallback().
+ */
+#define JITRT_MAX_DIRECT_CALL_ARGS 8
+
+/* JIT code can call a non-static Python function through its JIT-compiled
+ * static entry point, passing the function object and then the arguments in
+ * the native calling convention and getting the result back as from a
+ * vectorcall. Until the callee has such an entry, these calls go to the
+ * function returned here for the given number of arguments, which vectorcalls
+ * the function instead.
+ */
+void* JITRT_GetDirectCallFallback(int nargs);
+
 JITRT_StaticCallReturn JITRT_CallStaticallyWithPrimitiveSignature(
     PyFunctionObject* func,
     PyObject** args,
@@ -538,6 +552,11 @@ Py_ssize_t JITRT_CheckSequenceBounds(PyObject* seq, Py_ssize_t i);
  * set if there was an error. */
 PyObject* JITRT_GetLength(PyObject* obj);
 
+/* Return obj[start:stop]. Exact lists, tuples, and strs with int or None bounds
+ * are sliced directly, without allocating a slice object. Return NULL with an
+ * exception set if there was an error. */
+PyObject* JITRT_GetSlice(PyObject* obj, PyObject* start, PyObject* stop);
+
 /* Call match_keys() in ceval.c
  * NOTE: This function is here as a wrapper around the private match_keys
  * function and should be removed when match_keys becomes public.
@@ -556,3 +575,13 @@ int JITRT_DictMerge(
 /* Returns nullptr on error and an exact dict otherwise. Used by
  * COPY_DICT_WITHOUT_KEYS implementation. */
 PyObject* JITRT_CopyDictWithoutKeys(PyObject* subject, PyObject* keys);
+
+/* Charge the recursion depth for a self tail call that TailCallElimination
+ * turned into a jump, as calling the function would have. Returns 1 if the
+ * jump can be taken, 0 if tracing or profiling is active and the call has to
+ * be made so that it's seen, or -1 with a RecursionError set if the call would
+ * have exceeded the recursion limit. */
+int JITRT_EnterTailCall();
+
+/* Release the recursion depth charged for `count` elided self tail calls. */
+void JITRT_LeaveTailCalls(int64_t count);
@@ -17,6 +17,7 @@
 #include "listobject.h"
 #include "pystate.h"
 
+#include "cinderx/Jit/codegen/gen_asm.h"
 #include "cinderx/Jit/codegen/x86_64.h"
 #include "cinderx/Jit/config.h"
 #include "cinderx/Jit/containers.h"
@@ -346,27 +347,81 @@ void LIRGenerator::appendGuardAlwaysFail(
     BasicBlockBuilder& bbb,
     const hir::DeoptBase& hir_instr) {
   auto deopt_id = bbb.makeDeoptMetadata();
+  auto live_defs = liveRegDefs(bbb, hir_instr);
   Instruction* instr = bbb.appendInstr(
       Instruction::kGuard,
       Imm{InstrGuardKind::kAlwaysFail},
       Imm{deopt_id},
       Imm{0},
       Imm{0});
-  addLiveRegOperands(bbb, instr, hir_instr);
+  addLiveRegOperands(instr, live_defs);
 }
 
-void LIRGenerator::addLiveRegOperands(
+std::vector<Instruction*> LIRGenerator::liveRegDefs(
     BasicBlockBuilder& bbb,
-    Instruction* instr,
     const hir::DeoptBase& hir_instr) {
-  auto& regstates = hir_instr.live_regs();
-  for (const auto& reg_state : regstates) {
+  std::vector<Instruction*> live_defs;
+  for (const auto& reg_state : hir_instr.live_regs()) {
     hir::Register* reg = reg_state.reg;
-    instr->addOperands(VReg{bbb.getDefInstr(reg)});
+    Instruction* def = bbb.getDefInstr(reg);
+    if (reg->type() <= TCDouble) {
+      // The deopt trampoline only saves general-purpose registers, so copy
+      // the bits of a double out of its XMM register.
+      def = bbb.appendInstr(OutVReg{}, Instruction::kMove, VReg{def});
+    }
+    live_defs.push_back(def);
+  }
+  return live_defs;
+}
+
+void LIRGenerator::addLiveRegOperands(
+    Instruction* instr,
+    const std::vector<Instruction*>& live_defs) {
+  for (Instruction* def : live_defs) {
+    instr->addOperands(VReg{def});
   }
 }
 
 // Attempt to emit a type-specialized call, returning true if successful.
+// Call a Python function through its static entry point, with the function
+// object and arguments in registers. The entry point is loaded from a cache
+// that points at a fallback until the function is JIT-compiled, so the callee
+// doesn't have to be compiled first.
+bool LIRGenerator::TranslateDirectCall(
+    BasicBlockBuilder& bbb,
+    const hir::VectorCallBase& hir_instr,
+    BorrowedRef<PyFunctionObject> callee) {
+  BorrowedRef<PyCodeObject> code = callee->func_code;
+  size_t nargs = hir_instr.numArgs();
+  if (hir_instr.isAwaited() || !codegen::hasDirectEntry(code) ||
+      static_cast<size_t>(code->co_argcount) != nargs ||
+      nargs > JITRT_MAX_DIRECT_CALL_ARGS) {
+    return false;
+  }
+
+  void** cache;
+  {
+    ThreadedCompileSerialize guard;
+    cache = env_->rt->findDirectCallCache(callee);
+    // A callee that's already compiled won't be finalized again. Baseline code
+    // has no static entry and is left on the fallback.
+    if (_PyJIT_IsCompiled(callee)) {
+      if (void* entry = compiledStaticEntry(callee)) {
+        env_->rt->setDirectCallEntry(callee, entry);
+      }
+    }
+  }
+
+  Instruction* target = bbb.appendInstr(
+      OutVReg{OperandBase::k64bit}, Instruction::kMove, MemImm{cache});
+  Instruction* instr =
+      bbb.appendInstr(hir_instr.dst(), Instruction::kCall, target);
+  for (hir::Register* arg : hir_instr.GetOperands()) {
+    instr->addOperands(VReg{bbb.getDefInstr(arg)});
+  }
+  return true;
+}
+
 bool LIRGenerator::TranslateSpecializedCall(
     BasicBlockBuilder& bbb,
     const hir::VectorCallBase& hir_instr) {
@@ -383,6 +438,12 @@ bool LIRGenerator::TranslateSpecializedCall(
     return false;
   }
 
+  if (PyFunction_Check(callee) && getConfig().direct_calls &&
+      TranslateDirectCall(
+          bbb, hir_instr, reinterpret_cast<PyFunctionObject*>(callee))) {
+    return true;
+  }
+
   // TODO(bsimmers): This is where we can go bananas with specializing calls to
   // things like tuple(), list(), etc, hardcoding or inlining calls to tp_new
   // and tp_init as appropriate. For now, we simply support any callable with a
@@ -433,9 +494,15 @@ bool LIRGenerator::TranslateSpecializedCall(
     return _PyVectorcall_Function(callee);
   }();
   if (func == nullptr ||
-      func == reinterpret_cast<vectorcallfunc>(PyEntry_LazyInit)) {
+      func == reinterpret_cast<vectorcallfunc>(PyEntry_LazyInit) ||
+      func == reinterpret_cast<vectorcallfunc>(PyEntry_AutoJITPending)) {
     // Bail if the object doesn't support vectorcall, or if it's a function
-    // that hasn't been initialized yet.
+    // that hasn't been initialized yet or is about to be compiled.
+    return false;
+  }
+  if (getConfig().tier2_threshold > 0 && PyFunction_Check(callee)) {
+    // The function's baseline code will be replaced once it's hot, so its
+    // entry point has to be loaded on every call.
     return false;
   }
 
@@ -847,6 +914,29 @@ LIRGenerator::TranslatedBlock LIRGenerator::TranslateOneBasicBlock(
 
         break;
       }
+      case Opcode::kCheckedIntBinaryOp: {
+        auto instr = static_cast<const CheckedIntBinaryOp*>(&i);
+        auto op = Instruction::kNop;
+        switch (instr->op()) {
+          case BinaryOpKind::kAdd:
+            op = Instruction::kAdd;
+            break;
+          case BinaryOpKind::kSubtract:
+            op = Instruction::kSub;
+            break;
+          case BinaryOpKind::kMultiply:
+            op = Instruction::kMul;
+            break;
+          default:
+            JIT_ABORT("not implemented");
+        }
+        // The guard reads the overflow flag set by the arithmetic, so nothing
+        // may be emitted between the two.
+        Instruction* result =
+            bbb.appendInstr(instr->dst(), op, instr->left(), instr->right());
+        appendGuard(bbb, InstrGuardKind::kNoOverflow, *instr, result);
+        break;
+      }
       case Opcode::kDoubleBinaryOp: {
         auto instr = static_cast<const DoubleBinaryOp*>(&i);
 
@@ -1662,14 +1752,12 @@ LIRGenerator::TranslatedBlock LIRGenerator::TranslateOneBasicBlock(
       case Opcode::kDeoptPatchpoint: {
         const auto& instr = static_cast<const DeoptPatchpoint&>(i);
         std::size_t deopt_id = bbb.makeDeoptMetadata();
-        auto& regstates = instr.live_regs();
+        auto live_defs = liveRegDefs(bbb, instr);
         Instruction* lir = bbb.appendInstr(
             Instruction::kDeoptPatchpoint,
             MemImm{instr.patcher()},
             Imm{deopt_id});
-        for (const auto& reg_state : regstates) {
-          lir->addOperands(VReg{bbb.getDefInstr(reg_state.reg)});
-        }
+        addLiveRegOperands(lir, live_defs);
         break;
       }
       case Opcode::kRaiseAwaitableError: {
@@ -1874,14 +1962,22 @@ LIRGenerator::TranslatedBlock LIRGenerator::TranslateOneBasicBlock(
         std::stringstream ss;
         Instruction* lir;
         if (_PyJIT_IsCompiled(func)) {
+          auto static_entry = reinterpret_cast<void*>(
+              JITRT_GET_STATIC_ENTRY(func->vectorcall));
+          env_->rt->pinCode(static_entry);
           lir = bbb.appendInstr(
               instr->dst(),
               Instruction::kCall,
-              Imm{reinterpret_cast<uint64_t>(
-                  JITRT_GET_STATIC_ENTRY(func->vectorcall))});
+              Imm{reinterpret_cast<uint64_t>(static_entry)});
         } else {
+          // The function is still called with its arguments in registers.
+          // Until it's compiled, the shared trampoline spills them for a
+          // vectorcall; finalizing the compiled function repoints the cache
+          // at its static entry.
           void** indir = env_->rt->findFunctionEntryCache(func);
-          env_->function_indirections.emplace(func, indir);
+          if (*indir == nullptr) {
+            *indir = env_->failed_deferred_compile_trampoline;
+          }
           Instruction* move = bbb.appendInstr(
               OutVReg{OperandBase::k64bit}, Instruction::kMove, MemImm{indir});
 
@@ -2515,6 +2611,10 @@ LIRGenerator::TranslatedBlock LIRGenerator::TranslateOneBasicBlock(
         // UseTypes are purely informative
         break;
       }
+      case Opcode::kVirtualObject: {
+        // VirtualObjects are only materialized when deoptimizing
+        break;
+      }
       case Opcode::kHintType: {
         // HintTypes are purely informative
         break;
@@ -2809,6 +2909,7 @@ LIRGenerator::TranslatedBlock LIRGenerator::TranslateOneBasicBlock(
         case Opcode::kCheckExc:
         case Opcode::kCheckField:
         case Opcode::kCheckVar:
+        case Opcode::kCheckedIntBinaryOp:
         case Opcode::kDeleteAttr:
         case Opcode::kDeleteSubscr:
         case Opcode::kDeopt:
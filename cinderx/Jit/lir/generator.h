@@ -11,6 +11,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace jit::lir {
 
@@ -70,6 +71,7 @@ class LIRGenerator {
       TOperand&& guard_var) {
     JIT_CHECK(kind != InstrGuardKind::kAlwaysFail, "Use appendGuardAlwaysFail");
     auto deopt_id = bbb.makeDeoptMetadata();
+    auto live_defs = liveRegDefs(bbb, hir_instr);
     auto instr = bbb.appendInstr(
         Instruction::kGuard,
         Imm{kind},
@@ -93,13 +95,18 @@ class LIRGenerator {
       instr->addOperands(Imm{0});
     }
 
-    addLiveRegOperands(bbb, instr, hir_instr);
+    addLiveRegOperands(instr, live_defs);
   }
 
-  void addLiveRegOperands(
+  // Get the LIR values for the live registers of hir_instr. This has to be
+  // called before appending the instruction that will deopt, since it may emit
+  // moves.
+  std::vector<Instruction*> liveRegDefs(
       BasicBlockBuilder& bbb,
-      Instruction* instr,
       const hir::DeoptBase& hir_instr);
+  void addLiveRegOperands(
+      Instruction* instr,
+      const std::vector<Instruction*>& live_defs);
 
   void MakeIncref(
       BasicBlockBuilder& bbb,
@@ -113,6 +120,10 @@ class LIRGenerator {
   bool TranslateSpecializedCall(
       BasicBlockBuilder& bbb,
       const jit::hir::VectorCallBase& instr);
+  bool TranslateDirectCall(
+      BasicBlockBuilder& bbb,
+      const jit::hir::VectorCallBase& instr,
+      BorrowedRef<PyFunctionObject> callee);
 
   TranslatedBlock TranslateOneBasicBlock(const hir::BasicBlock* bb);
 
@@ -4,6 +4,7 @@
 
 #include "cinderx/Common/util.h"
 
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/lir/operand.h"
 
 #include <memory>
@@ -188,7 +189,7 @@ enum OperandSizeType {
 // Every instruction can have no more than one output, but arbitrary
 // number of inputs. The instruction logically has no output also
 // has an output data member with the type kNone.
-class Instruction {
+class Instruction : public CompileArenaAllocated {
  public:
   // instruction type
   enum Opcode : int {
@@ -647,6 +648,9 @@ enum InstrGuardKind {
   kNotNegative,
   kNotZero,
   kZero,
+  // Deopt if the arithmetic before the guard overflowed. Only moves, which
+  // leave the flags alone, may come between the two.
+  kNoOverflow,
 };
 
 // This class defines instruction properties for different types of
@@ -4,6 +4,7 @@
 
 #include "cinderx/Common/log.h"
 
+#include "cinderx/Jit/compile_arena.h"
 #include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/lir/x86_64.h"
 
@@ -31,7 +32,7 @@ class MemoryIndirect;
 
 // base class of operand
 // defines the interface that all the operands must have.
-class OperandBase {
+class OperandBase : public CompileArenaAllocated {
  public:
   explicit OperandBase(Instruction* parent) : parent_instr_(parent) {}
   OperandBase(const OperandBase& ob)
@@ -172,7 +173,7 @@ class OperandBase {
 };
 
 // memory reference: [base_reg + index_reg * (2^index_multiplier) + offset]
-class MemoryIndirect {
+class MemoryIndirect : public CompileArenaAllocated {
  public:
   explicit MemoryIndirect(Instruction* parent) : parent_(parent) {}
 
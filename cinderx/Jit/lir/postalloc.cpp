@@ -6,7 +6,10 @@
 #include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/lir/operand.h"
 
+#include <algorithm>
 #include <optional>
+#include <utility>
+#include <vector>
 
 using namespace jit::codegen;
 
@@ -21,10 +24,14 @@ void PostRegAllocRewrite::registerRewrites() {
   registerOneRewriteFunction(rewriteBinaryOpInstrs);
   registerOneRewriteFunction(removePhiInstructions);
   registerOneRewriteFunction(rewriteByteMultiply);
+  registerOneRewriteFunction(rewriteAddToLea);
 
   registerOneRewriteFunction(optimizeMoveSequence, 1);
   registerOneRewriteFunction(optimizeMoveInstrs, 1);
   registerOneRewriteFunction(rewriteDivide);
+
+  registerOneRewriteFunction(removeRedundantMoves, 2);
+  registerOneRewriteFunction(removeRedundantTests, 2);
 }
 
 Rewrite::RewriteResult PostRegAllocRewrite::removePhiInstructions(
@@ -410,7 +417,10 @@ Rewrite::RewriteResult PostRegAllocRewrite::optimizeMoveInstrs(
 
   Operand* in_opnd = nullptr;
   auto inp = instr->getInput(0);
+  // xor clobbers the flags, so leave the mov alone if something still needs
+  // them.
   if (inp->isImm() && !inp->isFp() && inp->getConstant() == 0 && out->isReg() &&
+      !flagsReadAfter(instr_iter) &&
       (in_opnd = dynamic_cast<Operand*>(inp))) {
     instr->setOpcode(Instruction::kXor);
     auto reg = out->getPhyRegister();
@@ -990,4 +1000,195 @@ Rewrite::RewriteResult PostRegAllocRewrite::optimizeMoveSequence(
   }
   return changed;
 }
+
+Rewrite::RewriteResult PostRegAllocRewrite::rewriteAddToLea(
+    instr_iter_t instr_iter) {
+  Instruction* instr = instr_iter->get();
+  if (!instr->isAdd()) {
+    return kUnchanged;
+  }
+
+  // Out = Add In0, In1 is a mov and an add when Out is neither of the inputs
+  // (rewriteBinaryOpInstrs() handles the other cases), but lea does it in one
+  // instruction if nothing needs the flags from the add.
+  OperandBase* out = instr->output();
+  OperandBase* in0 = instr->getInput(0);
+  OperandBase* in1 = instr->getInput(1);
+  auto is_64bit_reg = [](const OperandBase* opnd) {
+    return opnd->isReg() && !opnd->isFp() && opnd->sizeInBits() == 64;
+  };
+  if (!is_64bit_reg(out) || !is_64bit_reg(in0) ||
+      out->getPhyRegister() == in0->getPhyRegister()) {
+    return kUnchanged;
+  }
+
+  PhyLocation index = PhyLocation::REG_INVALID;
+  int32_t offset = 0;
+  if (is_64bit_reg(in1) && out->getPhyRegister() != in1->getPhyRegister()) {
+    index = in1->getPhyRegister();
+  } else if (
+      in1->isImm() && fitsInt32(static_cast<int64_t>(in1->getConstant()))) {
+    offset = static_cast<int32_t>(in1->getConstant());
+  } else {
+    return kUnchanged;
+  }
+  if (flagsReadAfter(instr_iter)) {
+    return kUnchanged;
+  }
+
+  BasicBlock* block = instr->basicblock();
+  block->allocateInstrBefore(
+      instr_iter,
+      Instruction::kLea,
+      OutPhyReg(out->getPhyRegister(), out->dataType()),
+      Ind(PhyLocation(in0->getPhyRegister()), index, offset));
+  block->removeInstr(instr_iter);
+  return kRemoved;
+}
+
+Rewrite::RewriteResult PostRegAllocRewrite::removeRedundantMoves(
+    BasicBlock* block) {
+  // Pairs of registers known to hold the same value, from earlier moves
+  // between them in this block.
+  std::vector<std::pair<PhyLocation, PhyLocation>> copies;
+  auto is_copy = [&](PhyLocation a, PhyLocation b) {
+    return std::any_of(copies.begin(), copies.end(), [&](const auto& copy) {
+      return (copy.first == a && copy.second == b) ||
+          (copy.first == b && copy.second == a);
+    });
+  };
+  auto forget = [&](PhyLocation reg) {
+    std::erase_if(copies, [&](const auto& copy) {
+      return copy.first == reg || copy.second == reg;
+    });
+  };
+
+  bool changed = false;
+  auto& instrs = block->instructions();
+  for (auto it = instrs.begin(); it != instrs.end();) {
+    Instruction* instr = it->get();
+    auto next = std::next(it);
+    if (!instr->isMove()) {
+      copies.clear();
+      it = next;
+      continue;
+    }
+
+    // Stores to the stack or memory leave the registers alone.
+    OperandBase* out = instr->output();
+    if (out->isReg()) {
+      PhyLocation dst = out->getPhyRegister();
+      OperandBase* in = instr->getInput(0);
+      if (in->isReg() && out->sizeInBits() == 64 &&
+          in->sizeInBits() == 64 && out->isFp() == in->isFp()) {
+        PhyLocation src = in->getPhyRegister();
+        if (is_copy(dst, src)) {
+          block->removeInstr(it);
+          changed = true;
+          it = next;
+          continue;
+        }
+        forget(dst);
+        copies.emplace_back(dst, src);
+      } else {
+        forget(dst);
+      }
+    }
+    it = next;
+  }
+
+  return changed ? kChanged : kUnchanged;
+}
+
+// Returns true if the next instruction in the block that reads the flags after
+// instr_iter is a branch on the zero or sign flag, which a test of a register
+// against itself sets the same way as an arithmetic instruction producing that
+// register.
+static bool nextFlagReaderIsZeroOrSign(Rewrite::instr_iter_t instr_iter) {
+  auto& instrs = (*instr_iter)->basicblock()->instructions();
+  for (auto it = std::next(instr_iter); it != instrs.end(); ++it) {
+    Instruction* instr = it->get();
+    switch (instr->opcode()) {
+      case Instruction::kBranchZ:
+      case Instruction::kBranchNZ:
+      case Instruction::kBranchE:
+      case Instruction::kBranchS:
+      case Instruction::kBranchNS:
+        return true;
+      default:
+        break;
+    }
+    FlagEffects effects = InstrProperty::getProperties(instr).flag_effects;
+    if (instr->isBranchCC() || effects != FlagEffects::kNone) {
+      return false;
+    }
+  }
+  return false;
+}
+
+Rewrite::RewriteResult PostRegAllocRewrite::removeRedundantTests(
+    BasicBlock* block) {
+  bool changed = false;
+  auto& instrs = block->instructions();
+  for (auto it = instrs.begin(); it != instrs.end();) {
+    Instruction* test = it->get();
+    auto next = std::next(it);
+    if (!test->isTest() || !test->getInput(0)->isReg() ||
+        !test->getInput(1)->isReg() ||
+        test->getInput(0)->getPhyRegister() !=
+            test->getInput(1)->getPhyRegister() ||
+        !nextFlagReaderIsZeroOrSign(it)) {
+      it = next;
+      continue;
+    }
+    PhyLocation reg = test->getInput(0)->getPhyRegister();
+    OperandBase::DataType data_type = test->getInput(0)->dataType();
+
+    // Find the instruction that last set the flags, skipping moves that leave
+    // reg alone.
+    Instruction* setter = nullptr;
+    for (auto prev = it; prev != instrs.begin();) {
+      --prev;
+      Instruction* instr = prev->get();
+      if (instr->isMove()) {
+        Operand* out = instr->output();
+        if (out->isReg() && out->getPhyRegister() == reg) {
+          break;
+        }
+        continue;
+      }
+      setter = instr;
+      break;
+    }
+
+    bool redundant = false;
+    if (setter == nullptr) {
+      // Nothing to compare against.
+    } else if (setter->isTest()) {
+      redundant = setter->getInput(0)->isReg() &&
+          setter->getInput(1)->isReg() &&
+          setter->getInput(0)->getPhyRegister() == reg &&
+          setter->getInput(1)->getPhyRegister() == reg &&
+          setter->getInput(0)->dataType() == data_type;
+    } else if (
+        setter->isAdd() || setter->isSub() || setter->isAnd() ||
+        setter->isOr() || setter->isXor()) {
+      // The result is in the output, or in the first input in the two-operand
+      // form.
+      OperandBase* result = setter->output()->isNone() ? setter->getInput(0)
+                                                       : setter->output();
+      redundant = result->isReg() && result->getPhyRegister() == reg &&
+          result->dataType() == data_type;
+    }
+
+    if (redundant) {
+      block->removeInstr(it);
+      changed = true;
+    }
+    it = next;
+  }
+
+  return changed ? kChanged : kUnchanged;
+}
+
 } // namespace jit::lir
@@ -72,6 +72,9 @@ class PostRegAllocRewrite : public Rewrite {
   // rewrite 8-bit multiply to use single-operand imul
   static RewriteResult rewriteByteMultiply(instr_iter_t instr_iter);
 
+  // rewrite three-operand 64-bit adds to lea when the flags aren't needed
+  static RewriteResult rewriteAddToLea(instr_iter_t instr_iter);
+
   // replace memory input with register when possible within a basic block
   // and remove the unnecessary moves after the replacement
   static RewriteResult optimizeMoveSequence(jit::lir::BasicBlock* basicblock);
@@ -79,6 +82,14 @@ class PostRegAllocRewrite : public Rewrite {
   // rewrite division instructions to use correct registers
   static RewriteResult rewriteDivide(instr_iter_t instr_iter);
 
+  // remove register-to-register moves made redundant by an earlier move
+  // between the same registers in a basic block
+  static RewriteResult removeRedundantMoves(jit::lir::BasicBlock* basicblock);
+
+  // remove Test Reg, Reg instructions before branches on the zero or sign flag
+  // when the preceding arithmetic instruction already set the flags from Reg
+  static RewriteResult removeRedundantTests(jit::lir::BasicBlock* basicblock);
+
   // insert a move from an operand to a memory location given by base + index.
   // this function handles cases where operand is a >32-bit immediate and
   // operand is a stack location.
@@ -2,8 +2,14 @@
 
 #include "cinderx/Jit/lir/postgen.h"
 
+#include "cinderx/Common/util.h"
+
+#include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/lir/inliner.h"
 
+#include <optional>
+#include <variant>
+
 using namespace jit::codegen;
 
 namespace jit::lir {
@@ -356,4 +362,251 @@ Rewrite::RewriteResult PostGenerationRewrite::rewriteLoadSecondCallResult(
   return kRemoved;
 }
 
+using BaseOrIndex = std::variant<Instruction*, PhyLocation>;
+
+namespace {
+
+// The components of a MemoryIndirect while its inputs are being folded into
+// it.
+struct Address {
+  BaseOrIndex base;
+  BaseOrIndex index;
+  int multiplier;
+  int64_t offset;
+
+  bool hasIndex() const {
+    auto reg = std::get_if<PhyLocation>(&index);
+    return reg == nullptr || *reg != PhyLocation::REG_INVALID;
+  }
+};
+
+} // namespace
+
+static Instruction* linkedDef(OperandBase* opnd) {
+  if (opnd == nullptr || !opnd->isLinked()) {
+    return nullptr;
+  }
+  return static_cast<LinkedOperand*>(opnd)->getLinkedInstr();
+}
+
+static BaseOrIndex toBaseOrIndex(OperandBase* opnd) {
+  if (opnd == nullptr) {
+    return PhyLocation::REG_INVALID;
+  }
+  if (opnd->isLinked()) {
+    return linkedDef(opnd);
+  }
+  return PhyLocation(opnd->getPhyRegister());
+}
+
+static void unlink(OperandBase* opnd) {
+  if (opnd != nullptr && opnd->isLinked()) {
+    auto linked = static_cast<LinkedOperand*>(opnd);
+    linked->getLinkedInstr()->output()->removeUse(linked);
+  }
+}
+
+static bool is64BitInt(const OperandBase* opnd) {
+  return !opnd->isFp() && opnd->sizeInBits() == 64;
+}
+
+// Returns the instruction defining instr's first input, if both instr's
+// output and that input are 64-bit integer vregs.
+static Instruction* addressInput(Instruction* instr) {
+  if (!is64BitInt(instr->output()) || instr->getNumInputs() != 2) {
+    return nullptr;
+  }
+  OperandBase* input = instr->getInput(0);
+  return is64BitInt(input) ? linkedDef(input) : nullptr;
+}
+
+// Returns instr's second input as a signed constant, if it is an immediate.
+static std::optional<int64_t> immInput(Instruction* instr) {
+  if (instr->getNumInputs() != 2 || !instr->getInput(1)->isImm()) {
+    return std::nullopt;
+  }
+  return static_cast<int64_t>(instr->getInput(1)->getConstant());
+}
+
+// [b + (i << s) * 2^m + d] => [b + i * 2^(m + s) + d]
+static bool foldShiftedIndex(Instruction* index, Address& addr) {
+  if (!index->isLShift()) {
+    return false;
+  }
+  Instruction* input = addressInput(index);
+  std::optional<int64_t> shift = immInput(index);
+  if (input == nullptr || !shift.has_value() || *shift < 0 ||
+      *shift > 3 - addr.multiplier) {
+    return false;
+  }
+  addr.index = input;
+  addr.multiplier += *shift;
+  return true;
+}
+
+// [(x + c) * 2^m + d] => [x * 2^m + (d + c * 2^m)], for either the base (with
+// m = 0) or the index.
+static bool foldConstantAdd(
+    Instruction* def,
+    int multiplier,
+    BaseOrIndex& reg,
+    int64_t& offset) {
+  if (!def->isAdd() && !def->isSub()) {
+    return false;
+  }
+  Instruction* input = addressInput(def);
+  std::optional<int64_t> imm = immInput(def);
+  if (input == nullptr || !imm.has_value() || !fitsInt32(*imm)) {
+    return false;
+  }
+  int64_t scaled = (def->isSub() ? -*imm : *imm) * (int64_t{1} << multiplier);
+  if (!fitsInt32(offset + scaled)) {
+    return false;
+  }
+  reg = input;
+  offset += scaled;
+  return true;
+}
+
+// [(b + i) + d] => [b + i + d]
+static bool foldRegisterAdd(Instruction* base, Address& addr) {
+  if (!base->isAdd() || addr.hasIndex()) {
+    return false;
+  }
+  Instruction* input = addressInput(base);
+  OperandBase* other = base->getInput(1);
+  if (input == nullptr || !other->isLinked() || !is64BitInt(other)) {
+    return false;
+  }
+  addr.base = input;
+  addr.index = linkedDef(other);
+  addr.multiplier = 0;
+  return true;
+}
+
+// [[b + i * 2^m + c] + d] => [b + i * 2^m + (c + d)]
+static bool foldLeaBase(Instruction* base, Address& addr) {
+  if (!base->isLea() || !base->getInput(0)->isInd()) {
+    return false;
+  }
+  MemoryIndirect* lea = base->getInput(0)->getMemoryIndirect();
+  OperandBase* lea_base = lea->getBaseRegOperand();
+  OperandBase* lea_index = lea->getIndexRegOperand();
+  // Physical registers may have changed between the Lea and the use.
+  if (lea_base == nullptr || !lea_base->isLinked() ||
+      (lea_index != nullptr && (!lea_index->isLinked() || addr.hasIndex())) ||
+      !fitsInt32(addr.offset + lea->getOffset())) {
+    return false;
+  }
+  addr.base = linkedDef(lea_base);
+  if (lea_index != nullptr) {
+    addr.index = linkedDef(lea_index);
+    addr.multiplier = lea->getMultipiler();
+  }
+  addr.offset += lea->getOffset();
+  return true;
+}
+
+// Fold the instruction defining the base or the index of ind into it, if
+// possible. Returns the folded instruction, or nullptr.
+static Instruction* foldAddressInput(MemoryIndirect* ind) {
+  Address addr{
+      toBaseOrIndex(ind->getBaseRegOperand()),
+      toBaseOrIndex(ind->getIndexRegOperand()),
+      ind->getMultipiler(),
+      ind->getOffset()};
+  Instruction* base = linkedDef(ind->getBaseRegOperand());
+  Instruction* index = linkedDef(ind->getIndexRegOperand());
+
+  Instruction* folded = nullptr;
+  if (index != nullptr &&
+      (foldShiftedIndex(index, addr) ||
+       foldConstantAdd(index, addr.multiplier, addr.index, addr.offset))) {
+    folded = index;
+  } else if (
+      base != nullptr &&
+      (foldConstantAdd(base, 0, addr.base, addr.offset) ||
+       foldRegisterAdd(base, addr) || foldLeaBase(base, addr))) {
+    folded = base;
+  } else {
+    return nullptr;
+  }
+
+  unlink(ind->getBaseRegOperand());
+  unlink(ind->getIndexRegOperand());
+  ind->setMemoryIndirect(
+      addr.base,
+      addr.index,
+      addr.multiplier,
+      static_cast<int32_t>(addr.offset));
+  return folded;
+}
+
+Rewrite::RewriteResult PostGenerationRewrite::rewriteFoldAddressing(
+    function_rewrite_arg_t func) {
+  UnorderedSet<Instruction*> folded;
+  auto fold = [&](OperandBase* opnd) {
+    if (opnd == nullptr || !opnd->isInd()) {
+      return;
+    }
+    MemoryIndirect* ind = opnd->getMemoryIndirect();
+    while (Instruction* def = foldAddressInput(ind)) {
+      folded.insert(def);
+    }
+  };
+  for (auto& block : func->basicblocks()) {
+    for (auto& instr : block->instructions()) {
+      instr->foreachInputOperand(fold);
+      fold(instr->output());
+    }
+  }
+  if (folded.empty()) {
+    return kUnchanged;
+  }
+
+  // Remove the folded instructions that are now unused. DCE keeps anything
+  // that sets the flags, which includes all of them but Lea, so do it here as
+  // long as nothing reads their flags.
+  bool removed;
+  do {
+    UnorderedSet<Instruction*> used;
+    auto mark_used = [&](OperandBase* opnd) {
+      if (opnd == nullptr) {
+        return;
+      }
+      if (opnd->isInd()) {
+        MemoryIndirect* ind = opnd->getMemoryIndirect();
+        used.insert(linkedDef(ind->getBaseRegOperand()));
+        used.insert(linkedDef(ind->getIndexRegOperand()));
+      } else {
+        used.insert(linkedDef(opnd));
+      }
+    };
+    for (auto& block : func->basicblocks()) {
+      for (auto& instr : block->instructions()) {
+        instr->foreachInputOperand(mark_used);
+        mark_used(instr->output());
+      }
+    }
+
+    removed = false;
+    for (auto& block : func->basicblocks()) {
+      auto& instrs = block->instructions();
+      for (auto it = instrs.begin(); it != instrs.end();) {
+        Instruction* instr = it->get();
+        auto next = std::next(it);
+        if (folded.count(instr) && !used.count(instr) &&
+            !flagsReadAfter(it)) {
+          folded.erase(instr);
+          block->removeInstr(it);
+          removed = true;
+        }
+        it = next;
+      }
+    }
+  } while (removed);
+
+  return kChanged;
+}
+
 } // namespace jit::lir
@@ -23,6 +23,9 @@ class PostGenerationRewrite : public Rewrite {
     registerOneRewriteFunction(rewriteLoadArg, 1);
     registerOneRewriteFunction(rewriteMoveToMemoryLargeConstant, 1);
     registerOneRewriteFunction(rewriteLoadSecondCallResult, 1);
+
+    // Runs after the large constants have been moved into registers.
+    registerOneRewriteFunction(rewriteFoldAddressing, 2);
   }
 
  private:
@@ -53,6 +56,12 @@ class PostGenerationRewrite : public Rewrite {
   // replace LoadSecondCallResult instructions with an appropriate Move.
   static RewriteResult rewriteLoadSecondCallResult(instr_iter_t instr_iter);
 
+  // Fold the address arithmetic (Lea, and Add, Sub and LShift by small
+  // constants) defining the base and index of memory operands into the
+  // operands' addressing modes, and remove the arithmetic if it's no longer
+  // used.
+  static RewriteResult rewriteFoldAddressing(function_rewrite_arg_t func);
+
   FRIEND_TEST(LIRRewriteTest, RewriteCondBranchTest);
 };
 } // namespace jit::lir
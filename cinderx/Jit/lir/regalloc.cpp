@@ -195,6 +195,10 @@ void LinearScanAllocator::initialize() {
   regalloc_blocks_.clear();
   vreg_last_use_.clear();
   vreg_global_last_use_.clear();
+  vreg_copy_hints_.clear();
+  vreg_last_reg_.clear();
+  block_start_ids_.clear();
+  block_loop_depth_.clear();
 
   max_stack_slot_ = initial_max_stack_slot_;
   free_stack_slots_.clear();
@@ -304,10 +308,26 @@ void LinearScanAllocator::calculateLiveIntervals() {
       auto instr = instr_iter->get();
       auto instr_opcode = instr->opcode();
       if (instr_opcode == Instruction::kPhi) {
-        // ignore phi instructions
+        // ignore phi instructions other than for coalescing
+        if (options_.spill_costs) {
+          auto output = instr->output();
+          for (size_t i = 1; i < instr->getNumInputs(); i += 2) {
+            auto input = instr->getInput(i);
+            if (input->isVreg()) {
+              vreg_copy_hints_[output].push_back(input->getDefine());
+              vreg_copy_hints_[input->getDefine()].push_back(output);
+            }
+          }
+        }
         continue;
       }
 
+      if (options_.spill_costs && instr_opcode == Instruction::kMove &&
+          instr->output()->isVreg() && instr->getInput(0)->isVreg()) {
+        vreg_copy_hints_[instr->output()].push_back(
+            instr->getInput(0)->getDefine());
+      }
+
       // output
       auto output_opnd = instr->output();
       if (output_opnd->isVreg()) {
@@ -467,6 +487,52 @@ void LinearScanAllocator::calculateLiveIntervals() {
 
     visited_blocks.insert(bb);
   }
+
+  if (options_.spill_costs || options_.split_outside_loops) {
+    calculateLoopDepths(loop_ends);
+  }
+}
+
+void LinearScanAllocator::calculateLoopDepths(
+    const UnorderedMap<const BasicBlock*, std::vector<int>>& loop_ends) {
+  const auto& basic_blocks = func_->basicblocks();
+  for (auto& bb : basic_blocks) {
+    block_start_ids_.push_back(
+        regalloc_blocks_.find(bb)->second.block_start_index);
+  }
+
+  // Like the liveness above, treat a loop as every block from its header up to
+  // its last loop end, and count how many loops start and stop at each block.
+  std::vector<int> depth_change(basic_blocks.size() + 1, 0);
+  for (auto& [header, ends] : loop_ends) {
+    LIRLocation header_start =
+        regalloc_blocks_.find(header)->second.block_start_index;
+    // loop_ends also records forward edges, which end before the successor.
+    LIRLocation loop_end = *std::max_element(ends.begin(), ends.end());
+    if (loop_end <= header_start) {
+      continue;
+    }
+    auto first = std::lower_bound(
+        block_start_ids_.begin(), block_start_ids_.end(), header_start);
+    auto last = std::lower_bound(first, block_start_ids_.end(), loop_end);
+    depth_change[std::distance(block_start_ids_.begin(), first)]++;
+    depth_change[std::distance(block_start_ids_.begin(), last)]--;
+  }
+
+  int depth = 0;
+  for (size_t i = 0; i < basic_blocks.size(); i++) {
+    depth += depth_change[i];
+    block_loop_depth_.push_back(depth);
+  }
+}
+
+int LinearScanAllocator::loopDepthAt(LIRLocation loc) const {
+  auto iter =
+      std::upper_bound(block_start_ids_.begin(), block_start_ids_.end(), loc);
+  if (iter == block_start_ids_.begin()) {
+    return 0;
+  }
+  return block_loop_depth_[std::distance(block_start_ids_.begin(), iter) - 1];
 }
 
 int LinearScanAllocator::initialYieldSpillSize() const {
@@ -650,6 +716,9 @@ void LinearScanAllocator::linearScan() {
     if (current->isRegisterAllocated()) {
       changed_regs_.Set(current->allocated_loc);
       active.insert(current);
+      if (options_.spill_costs) {
+        vreg_last_reg_[current->vreg] = current->allocated_loc;
+      }
     } else {
       stack_intervals.emplace(current);
     }
@@ -717,6 +786,15 @@ bool LinearScanAllocator::tryAllocateFreeReg(
     }
   }
 
+  // otherwise, try to share a register with a copy of current
+  if (regFreeUntil == START_LOCATION && options_.spill_costs) {
+    PhyLocation hint = getCopyHint(current, freeUntilPos);
+    if (hint != PhyLocation::REG_INVALID) {
+      reg = hint;
+      regFreeUntil = freeUntilPos[hint];
+    }
+  }
+
   // if not preallocated interval or cannot honor the preallocated register
   if (regFreeUntil == START_LOCATION) {
     auto start =
@@ -787,14 +865,65 @@ void LinearScanAllocator::allocateBlockedReg(
   auto& reg_use = *reg_iter;
 
   auto first_current_use = getUseAtOrAfter(current->vreg, current_start);
-  if (first_current_use >= reg_use) {
+  bool spill_current = first_current_use >= reg_use;
+
+  if (!spill_current && options_.spill_costs) {
+    // Any register that isn't needed again before current's first use will
+    // do. Evict the intervals with the lowest spill cost per location they'd
+    // spend out of a register, which favors the furthest next use as before
+    // but keeps values used in loops, or spill current if it's cheaper still.
+    auto evictionCost = [&](PhyLocation candidate) {
+      auto act_iter = reg_active_interval.find(candidate);
+      if (act_iter == reg_active_interval.end() || act_iter->second->fixed) {
+        return std::numeric_limits<double>::infinity();
+      }
+      uint64_t cost = spillCost(act_iter->second, current_start);
+      auto inact_iter = reg_inactive_intervals.find(candidate);
+      if (inact_iter != reg_inactive_intervals.end()) {
+        for (auto& inact_interval : inact_iter->second) {
+          if (!inact_interval->fixed &&
+              inact_interval->intersectWith(*current) != INVALID_LOCATION) {
+            cost += spillCost(inact_interval, current_start);
+          }
+        }
+      }
+      return static_cast<double>(cost) /
+          (nextUsePos[candidate] - current_start);
+    };
+
+    double best_cost = evictionCost(reg);
+    for (auto iter = start; iter != end; ++iter) {
+      if (*iter <= first_current_use) {
+        continue;
+      }
+      PhyLocation candidate = std::distance(nextUsePos.begin(), iter);
+      double cost = evictionCost(candidate);
+      if (cost < best_cost ||
+          (cost == best_cost && *iter > nextUsePos[reg])) {
+        reg = candidate;
+        best_cost = cost;
+      }
+    }
+
+    if (first_current_use > current_start) {
+      double current_cost =
+          static_cast<double>(spillCost(current, current_start)) /
+          (first_current_use - current_start);
+      spill_current = current_cost < best_cost;
+    }
+  }
+
+  if (spill_current) {
     auto stack_slot = getStackSlot(current->vreg);
     current->allocateTo(stack_slot);
 
     // first_current_use can be MAX_LOCATION when vreg is in a loop and there is
     // no more uses after current_start
     if (first_current_use < current->endLocation()) {
-      splitAndSave(current, first_current_use, unhandled);
+      splitAndSave(
+          current,
+          getReloadPosition(current_start, first_current_use),
+          unhandled);
     }
   } else {
     current->allocateTo(reg);
@@ -854,6 +983,81 @@ LIRLocation LinearScanAllocator::getUseAtOrAfter(
   return *iter;
 }
 
+uint64_t LinearScanAllocator::spillCost(
+    const LiveInterval* interval,
+    LIRLocation loc) const {
+  auto vreg_use_iter = vreg_phy_uses_.find(interval->vreg);
+  if (vreg_use_iter == vreg_phy_uses_.end()) {
+    return 0;
+  }
+
+  // Uses in loops nested deeper than this are weighted the same, which keeps
+  // the sums from overflowing.
+  constexpr int kMaxWeightedDepth = 6;
+  constexpr int kLoopWeightShift = 3;
+
+  auto& uses = vreg_use_iter->second;
+  auto end = interval->endLocation();
+  uint64_t cost = 0;
+  for (auto iter = uses.lower_bound(loc); iter != uses.end() && *iter < end;
+       ++iter) {
+    int depth = std::min(loopDepthAt(*iter), kMaxWeightedDepth);
+    cost += uint64_t{1} << (depth * kLoopWeightShift);
+  }
+  return cost;
+}
+
+PhyLocation LinearScanAllocator::getCopyHint(
+    const LiveInterval* current,
+    const std::vector<LIRLocation>& freeUntilPos) const {
+  auto hints_iter = vreg_copy_hints_.find(current->vreg);
+  if (hints_iter == vreg_copy_hints_.end()) {
+    return PhyLocation::REG_INVALID;
+  }
+
+  bool is_fp = current->vreg->isFp();
+  for (const Operand* related : hints_iter->second) {
+    auto reg_iter = vreg_last_reg_.find(related);
+    if (reg_iter == vreg_last_reg_.end()) {
+      continue;
+    }
+    PhyLocation reg = reg_iter->second;
+    // only take the hint if it doesn't mean splitting current.
+    if (reg.is_fp_register() == is_fp &&
+        freeUntilPos[reg] >= current->endLocation()) {
+      return reg;
+    }
+  }
+  return PhyLocation::REG_INVALID;
+}
+
+LIRLocation LinearScanAllocator::getReloadPosition(
+    LIRLocation from,
+    LIRLocation to) const {
+  if (!options_.split_outside_loops) {
+    return to;
+  }
+
+  // Walk back over the blocks between from and to, looking for the outermost
+  // loop entered along the way, and reload at the start of its header
+  // instead.
+  auto iter =
+      std::upper_bound(block_start_ids_.begin(), block_start_ids_.end(), to);
+  JIT_DCHECK(iter != block_start_ids_.begin(), "to must be inside a block");
+  size_t index = std::distance(block_start_ids_.begin(), iter) - 1;
+
+  LIRLocation pos = to;
+  int depth = block_loop_depth_[index];
+  while (index > 0 && block_start_ids_[index] > from) {
+    if (block_loop_depth_[index - 1] < depth) {
+      pos = block_start_ids_[index];
+      depth = block_loop_depth_[index - 1];
+    }
+    index--;
+  }
+  return pos;
+}
+
 void LinearScanAllocator::markDisallowedRegisters(
     std::vector<LIRLocation>& locs) {
   auto stack_registers = STACK_REGISTERS;
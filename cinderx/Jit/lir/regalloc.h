@@ -11,11 +11,13 @@
 #include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/lir/printer.h"
 
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <ostream>
 #include <queue>
 #include <utility>
+#include <vector>
 
 namespace jit::lir {
 
@@ -138,6 +140,18 @@ struct LiveInterval {
   }
 };
 
+struct RegallocOptions {
+  // When every register is taken, evict the values that are cheapest to spill,
+  // weighing each register use 8 times more per enclosing loop, rather than
+  // the value used furthest away. Also try to give copies and phis the
+  // register of the value they copy, so the move between them disappears.
+  bool spill_costs{false};
+  // Move the point where a spilled value is reloaded out of any loop it
+  // doesn't need to be in, so the reload runs once rather than every
+  // iteration. Costs a bit more compile time, so it's meant for hot code.
+  bool split_outside_loops{false};
+};
+
 // The linear scan allocator.
 // The register allocator works in four steps:
 //   1. reorder the basic blocks in RPO order,
@@ -148,8 +162,11 @@ class LinearScanAllocator {
  public:
   explicit LinearScanAllocator(
       lir::Function* func,
-      int reserved_stack_space = 0)
-      : func_(func), initial_max_stack_slot_(-reserved_stack_space) {}
+      int reserved_stack_space = 0,
+      RegallocOptions options = RegallocOptions{})
+      : func_(func),
+        options_(options),
+        initial_max_stack_slot_(-reserved_stack_space) {}
   void run();
 
   jit::codegen::PhyRegisterSet getChangedRegs() const {
@@ -170,6 +187,7 @@ class LinearScanAllocator {
 
  private:
   lir::Function* func_;
+  RegallocOptions options_;
   UnorderedMap<const lir::Operand*, LiveInterval> vreg_interval_;
   UnorderedMap<const lir::Operand*, OrderedSet<LIRLocation>> vreg_phy_uses_;
   UnorderedMap<const lir::BasicBlock*, RegallocBlockState> regalloc_blocks_;
@@ -185,6 +203,18 @@ class LinearScanAllocator {
   // the global last use of an operand (vreg)
   UnorderedMap<const lir::Operand*, LIRLocation> vreg_global_last_use_;
 
+  // vregs that are copied to or from a vreg by a Move or a Phi. Giving them
+  // the same register turns the copy into a no-op.
+  UnorderedMap<const lir::Operand*, std::vector<const lir::Operand*>>
+      vreg_copy_hints_;
+  // the register most recently allocated to each vreg
+  UnorderedMap<const lir::Operand*, PhyLocation> vreg_last_reg_;
+
+  // the start location and loop nesting depth of each basic block, in
+  // allocation order.
+  std::vector<LIRLocation> block_start_ids_;
+  std::vector<int> block_loop_depth_;
+
   int initial_max_stack_slot_;
   int max_stack_slot_;
   std::vector<int> free_stack_slots_;
@@ -203,6 +233,10 @@ class LinearScanAllocator {
   void initialize();
   void calculateLiveIntervals();
 
+  void calculateLoopDepths(
+      const UnorderedMap<const lir::BasicBlock*, std::vector<int>>& loop_ends);
+  int loopDepthAt(LIRLocation loc) const;
+
   void spillRegistersForYield(int instr_id);
   void reserveCallerSaveRegisters(int instr_id);
   void reserveRegisters(int instr_id, jit::codegen::PhyRegisterSet phy_regs);
@@ -242,6 +276,18 @@ class LinearScanAllocator {
       UnhandledQueue& unhandled);
   LIRLocation getUseAtOrAfter(const lir::Operand* vreg, LIRLocation loc) const;
 
+  // the cost of keeping interval out of a register from loc on: its register
+  // uses from there, weighted by loop depth.
+  uint64_t spillCost(const LiveInterval* interval, LIRLocation loc) const;
+  // the register current should prefer to be coalesced with, or
+  // REG_INVALID if none of them is free for all of current.
+  PhyLocation getCopyHint(
+      const LiveInterval* current,
+      const std::vector<LIRLocation>& freeUntilPos) const;
+  // where to split an interval that is spilled from `from` and needs a
+  // register again at `to`.
+  LIRLocation getReloadPosition(LIRLocation from, LIRLocation to) const;
+
   // split at loc and save the new interval to unhandled and allocated_
   void
   splitAndSave(LiveInterval* interval, LIRLocation loc, UnhandledQueue& queue);
@@ -333,6 +379,7 @@ class LinearScanAllocator {
 
   FRIEND_TEST(LinearScanAllocatorTest, RegAllocationNoSpill);
   FRIEND_TEST(LinearScanAllocatorTest, RegAllocation);
+  FRIEND_TEST(LinearScanAllocatorTest, LoopDepth);
 };
 
 std::ostream& operator<<(std::ostream& out, const LiveRange& rhs);
@@ -94,4 +94,22 @@ Instruction* Rewrite::findRecentFlagAffectingInstr(instr_iter_t instr_iter) {
   return nullptr;
 }
 
+bool Rewrite::flagsReadAfter(instr_iter_t instr_iter) {
+  auto& instrs = (*instr_iter)->basicblock()->instructions();
+  for (auto it = std::next(instr_iter); it != instrs.end(); ++it) {
+    Instruction* instr = it->get();
+    if (instr->isBranchCC()) {
+      return true;
+    }
+    if (instr->isGuard()) {
+      return instr->getInput(0)->getConstant() == InstrGuardKind::kNoOverflow;
+    }
+    FlagEffects effects = InstrProperty::getProperties(instr).flag_effects;
+    if (effects != FlagEffects::kNone) {
+      return false;
+    }
+  }
+  return false;
+}
+
 } // namespace jit::lir
@@ -96,6 +96,10 @@ class Rewrite {
   static jit::lir::Instruction* findRecentFlagAffectingInstr(
       instr_iter_t instr_iter);
 
+  // Returns true if an instruction later in the basic block reads the status
+  // flags as they are right after the instruction at instr_iter.
+  static bool flagsReadAfter(instr_iter_t instr_iter);
+
  private:
   template <typename T>
   std::pair<bool, const T*> getStageRewrites(
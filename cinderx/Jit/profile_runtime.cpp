@@ -157,6 +157,54 @@ std::vector<hir::Type> ProfileRuntime::getLoadedProfiledTypes(
   return result;
 }
 
+std::vector<BorrowedRef<PyTypeObject>> ProfileRuntime::getPolymorphicTypes(
+    BorrowedRef<PyCodeObject> code,
+    BCOffset bc_off) const {
+  std::vector<BorrowedRef<PyTypeObject>> result;
+
+  // Always prioritize profiles loaded from a file.
+  auto loaded_it = loaded_profiles_.find(codeKey(code));
+  if (loaded_it != loaded_profiles_.end()) {
+    auto types_it = loaded_it->second.find(bc_off);
+    if (types_it != loaded_it->second.end()) {
+      for (auto const& type_names : types_it->second) {
+        BorrowedRef<PyTypeObject> py_type =
+            type_names.empty() ? nullptr : s_live_types.get(type_names[0]);
+        if (py_type == nullptr) {
+          return {};
+        }
+        result.emplace_back(py_type);
+      }
+      return result;
+    }
+  }
+
+  auto code_it = profiles_.find(code);
+  if (code_it == profiles_.end()) {
+    return {};
+  }
+  auto& typed_hits = code_it->second.typed_hits;
+  auto type_profiler_it = typed_hits.find(bc_off);
+  if (type_profiler_it == typed_hits.end()) {
+    return {};
+  }
+  auto& type_profiler = type_profiler_it->second;
+  if (type_profiler->empty() || type_profiler->other() > 0) {
+    return {};
+  }
+  for (int row = 0; row < type_profiler->rows(); ++row) {
+    if (type_profiler->count(row) == 0) {
+      break;
+    }
+    BorrowedRef<PyTypeObject> py_type = type_profiler->type(row, 0);
+    if (py_type == nullptr) {
+      return {};
+    }
+    result.emplace_back(py_type);
+  }
+  return result;
+}
+
 void ProfileRuntime::profileInstr(
     BorrowedRef<PyFrameObject> frame,
     PyObject** stack_top,
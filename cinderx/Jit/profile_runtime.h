@@ -68,6 +68,14 @@ class ProfileRuntime {
       const CodeKey& code_key,
       BCOffset bc_off) const;
 
+  // For a given code object and bytecode offset, get every type the runtime has
+  // seen for the instruction's first profiled stack input. Will be empty if
+  // there is not enough profiling data, or if more types were seen than the
+  // profile can hold.
+  std::vector<BorrowedRef<PyTypeObject>> getPolymorphicTypes(
+      BorrowedRef<PyCodeObject> code,
+      BCOffset bc_off) const;
+
   // Record a type profile for an instruction and its current Python stack.
   void profileInstr(
       BorrowedRef<PyFrameObject> frame,
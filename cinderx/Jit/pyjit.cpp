@@ -15,6 +15,8 @@
 
 #include "cinderx/Jit/code_allocator.h"
 #include "cinderx/Jit/codegen/gen_asm.h"
+#include "cinderx/Jit/compile_queue.h"
+#include "cinderx/Jit/compile_stats.h"
 #include "cinderx/Jit/config.h"
 #include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/elf.h"
@@ -32,6 +34,7 @@
 #include "cinderx/Jit/profile_runtime.h"
 #include "cinderx/Jit/runtime.h"
 #include "cinderx/Jit/type_profiler.h"
+#include "cinderx/Jit/warm_start.h"
 
 #include "cinderx/ThirdParty/i386-dis/dis-asm.h"
 
@@ -152,6 +155,8 @@ static std::unordered_map<PyFunctionObject*, std::chrono::duration<double>>
 // If non-empty, profile information will be written to this filename at
 // shutdown.
 static std::string g_write_profile_file;
+static std::string g_warm_start_file;
+static WarmStartSet g_warm_start;
 
 // If non-empty, jit compiled functions' names will be written to this filename
 // at shutdown.
@@ -290,6 +295,43 @@ void initFlagProcessor() {
         },
         "Combined with -X jit-auto, configure the runtime to type profile each "
         "function for a number of calls before compiling it");
+    xarg_flag_processor.addOption(
+        "jit-async-compile",
+        "PYTHONJITASYNCCOMPILE",
+        [](int val) {
+          if (use_jit && val) {
+            getMutableConfig().async_compile = true;
+          } else {
+            warnJITOff("jit-async-compile");
+          }
+        },
+        "Combined with -X jit-auto, compile hot functions on a background "
+        "thread while they keep running in the interpreter");
+    xarg_flag_processor.addOption(
+        "jit-osr",
+        "PYTHONJITOSR",
+        [](unsigned threshold) {
+          use_jit = 1;
+          getMutableConfig().osr_threshold = threshold;
+        },
+        "Enable on-stack replacement, which moves an interpreted frame into "
+        "JIT code after its loops take the given number of back-edges");
+    xarg_flag_processor.addOption(
+        "jit-recompile",
+        "PYTHONJITRECOMPILE",
+        [](unsigned threshold) {
+          getMutableConfig().recompile_threshold = threshold;
+        },
+        "Recompile a function once its guards have failed the given number of "
+        "times, emitting generic code where they failed");
+    xarg_flag_processor.addOption(
+        "jit-tier2-threshold",
+        "PYTHONJITTIER2THRESHOLD",
+        [](unsigned threshold) {
+          getMutableConfig().tier2_threshold = threshold;
+        },
+        "Compile functions quickly with minimal optimization at first, fully "
+        "optimizing them once they've been called the given number of times");
 
     xarg_flag_processor.addOption(
         "jit-debug",
@@ -495,6 +537,16 @@ void initFlagProcessor() {
             "Write profiling data to <filename>")
         .withFlagParamName("filename");
 
+    xarg_flag_processor
+        .addOption(
+            "jit-warm-start",
+            "PYTHONJITWARMSTART",
+            g_warm_start_file,
+            "Combined with -X jit-auto, compile the functions that a previous "
+            "run of this build recorded in <filename> on their first call, and "
+            "record the functions compiled by this run there at exit")
+        .withFlagParamName("filename");
+
     xarg_flag_processor
         .addOption(
             "jit-profile-strip-pattern",
@@ -617,6 +669,84 @@ void initFlagProcessor() {
         },
         "Dump IR passes as JSON to the directory specified by this flag's "
         "value");
+    xarg_flag_processor.addOption(
+        "jit-code-placement",
+        "PYTHONJITCODEPLACEMENT",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().code_placement = val;
+          } else {
+            warnJITOff("jit-code-placement");
+          }
+        },
+        "Place JIT code next to the JIT code that calls it and align loop "
+        "heads to cache lines");
+
+    xarg_flag_processor.addOption(
+        "jit-regalloc-spill-costs",
+        "PYTHONJITREGALLOCSPILLCOSTS",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().regalloc_spill_costs = val;
+          } else {
+            warnJITOff("jit-regalloc-spill-costs");
+          }
+        },
+        "Choose registers to spill by loop-weighted use counts and coalesce "
+        "copies");
+
+    xarg_flag_processor.addOption(
+        "jit-regalloc-split-outside-loops",
+        "PYTHONJITREGALLOCSPLITOUTSIDELOOPS",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().regalloc_split_outside_loops = val;
+          } else {
+            warnJITOff("jit-regalloc-split-outside-loops");
+          }
+        },
+        "Move register reloads out of loops in all functions, rather than "
+        "only in tier 2 code");
+
+    xarg_flag_processor.addOption(
+        "jit-direct-calls",
+        "PYTHONJITDIRECTCALLS",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().direct_calls = val;
+          } else {
+            warnJITOff("jit-direct-calls");
+          }
+        },
+        "Call JIT-compiled functions through their native entry point, "
+        "passing arguments in registers");
+
+    xarg_flag_processor.addOption(
+        "jit-tail-calls",
+        "PYTHONJITTAILCALLS",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().tail_call_elimination = val;
+          } else {
+            warnJITOff("jit-tail-calls");
+          }
+        },
+        "Turn calls functions make to themselves just before returning into "
+        "loops, unless tracing or profiling");
+
+    xarg_flag_processor.addOption(
+        "jit-seal-code-before-fork",
+        "PYTHONJITSEALCODEBEFOREFORK",
+        [](int val) {
+          if (use_jit) {
+            getMutableConfig().seal_code_before_fork = val;
+          } else {
+            warnJITOff("jit-seal-code-before-fork");
+          }
+        },
+        "Make JIT code read-only before fork() and put later code on new "
+        "pages, so child processes share the parent's code pages");
+
     xarg_flag_processor.addOption(
         "jit-multiple-code-sections",
         "PYTHONJITMULTIPLECODESECTIONS",
@@ -737,6 +867,25 @@ _PyJIT_Result tryCompilePreloaded(BorrowedRef<> unit) {
                    : PYJIT_RESULT_NO_PRELOADER;
 }
 
+void recompileCode(const CodeRuntime* code_rt) {
+  if (jit_ctx != nullptr) {
+    JIT_DLOG(
+        "Recompiling {} after repeated guard failures",
+        codeQualname(code_rt->frameState()->code()));
+    jit_ctx->recompile(code_rt);
+  }
+}
+
+void tierUpCode(CodeRuntime* code_rt) {
+  if (jit_ctx != nullptr) {
+    JIT_DLOG(
+        "Fully optimizing {} after {} calls",
+        codeQualname(code_rt->frameState()->code()),
+        getConfig().tier2_threshold);
+    jit_ctx->tierUp(code_rt);
+  }
+}
+
 } // namespace jit
 
 static void compile_worker_thread() {
@@ -1164,6 +1313,21 @@ static PyObject* get_function_hir_opcode_counts(PyObject*, PyObject* func) {
   return dict.release();
 }
 
+static PyObject* get_function_compile_tier(PyObject*, PyObject* func) {
+  if (!PyFunction_Check(func)) {
+    PyErr_SetString(PyExc_TypeError, "arg 1 must be a function");
+    return nullptr;
+  }
+  if (jit_ctx == nullptr || !jit_ctx->didCompile(func)) {
+    Py_RETURN_NONE;
+  }
+  CompiledFunction* compiled = jit_ctx->lookupFunc(func);
+  if (compiled == nullptr) {
+    Py_RETURN_NONE;
+  }
+  return PyLong_FromLong(compiled->codeRuntime()->isBaselineTier() ? 1 : 2);
+}
+
 static PyObject* mlock_profiler_dependencies(PyObject* /* self */, PyObject*) {
   if (jit_ctx == nullptr) {
     Py_RETURN_NONE;
@@ -1202,8 +1366,10 @@ Ref<> make_deopt_stats() {
   Runtime* runtime = Runtime::get();
   auto stats = Ref<>::steal(check(PyList_New(0)));
 
+  DeoptMetadata scratch;
   for (auto& pair : runtime->deoptStats()) {
-    const DeoptMetadata& meta = runtime->getDeoptMetadata(pair.first);
+    const DeoptMetadata& meta =
+        runtime->unpackDeoptMetadata(pair.first, scratch);
     const DeoptStat& stat = pair.second;
     const DeoptFrameMetadata& frame_meta = meta.frame_meta[meta.inline_depth()];
     BorrowedRef<PyCodeObject> code = frame_meta.code;
@@ -1279,6 +1445,95 @@ static PyObject* get_and_clear_runtime_stats(PyObject* /* self */, PyObject*) {
   return stats.release();
 }
 
+static PyObject* get_compile_queue_stats(PyObject*, PyObject*) {
+  const CompileQueueStats& stats = compileQueue().stats();
+  auto result = Ref<>::steal(PyDict_New());
+  if (result == nullptr) {
+    return nullptr;
+  }
+  try {
+    auto set_item = [&](const char* key, PyObject* value) {
+      auto value_obj = Ref<>::steal(check(value));
+      check(PyDict_SetItemString(result, key, value_obj));
+    };
+    auto to_ms = [](std::chrono::nanoseconds ns) {
+      return PyFloat_FromDouble(
+          std::chrono::duration<double, std::milli>(ns).count());
+    };
+    set_item("depth", PyLong_FromSize_t(stats.depth));
+    set_item("max_depth", PyLong_FromSize_t(stats.max_depth));
+    set_item("enqueued", PyLong_FromSize_t(stats.num_enqueued));
+    set_item("compiled", PyLong_FromSize_t(stats.num_compiled));
+    set_item("failed", PyLong_FromSize_t(stats.num_failed));
+    set_item("total_wait_ms", to_ms(stats.total_wait));
+    set_item("max_wait_ms", to_ms(stats.max_wait));
+    set_item("total_compile_ms", to_ms(stats.total_compile));
+  } catch (const CAPIError&) {
+    return nullptr;
+  }
+  return result.release();
+}
+
+static PyObject* get_compile_phase_stats(PyObject*, PyObject*) {
+  CompileStats stats = getCompileStats();
+  auto result = Ref<>::steal(PyDict_New());
+  if (result == nullptr) {
+    return nullptr;
+  }
+  try {
+    auto set_item = [](BorrowedRef<> dict, const char* key, PyObject* value) {
+      auto value_obj = Ref<>::steal(check(value));
+      check(PyDict_SetItemString(dict, key, value_obj));
+    };
+    auto to_ms = [](std::chrono::nanoseconds ns) {
+      return PyFloat_FromDouble(
+          std::chrono::duration<double, std::milli>(ns).count());
+    };
+    // Drop trailing empty buckets, which are most of them.
+    auto to_list = [](const CompileStatsHistogram& histogram) {
+      std::size_t size = histogram.size();
+      while (size > 0 && histogram[size - 1] == 0) {
+        size--;
+      }
+      auto list = Ref<>::steal(check(PyList_New(size)));
+      for (std::size_t i = 0; i < size; ++i) {
+        PyList_SET_ITEM(
+            list.get(), i, check(PyLong_FromSize_t(histogram[i])));
+      }
+      return list.release();
+    };
+
+    set_item(result, "compiles", PyLong_FromSize_t(stats.num_compiles));
+    set_item(result, "total_ms", to_ms(stats.total_time));
+    auto phases = Ref<>::steal(check(PyDict_New()));
+    for (const CompilePhaseTotals& totals : stats.phases) {
+      auto phase = Ref<>::steal(check(PyDict_New()));
+      set_item(phase, "count", PyLong_FromSize_t(totals.count));
+      set_item(phase, "total_ms", to_ms(totals.total));
+      set_item(phase, "max_ms", to_ms(totals.max));
+      check(PyDict_SetItemString(phases, totals.name.c_str(), phase));
+    }
+    check(PyDict_SetItemString(result, "phases", phases));
+    set_item(
+        result,
+        "total_arena_bytes",
+        PyLong_FromSize_t(stats.total_arena_bytes));
+    set_item(
+        result, "max_arena_bytes", PyLong_FromSize_t(stats.max_arena_bytes));
+    set_item(result, "time_us_histogram", to_list(stats.time_us_histogram));
+    set_item(
+        result, "arena_kib_histogram", to_list(stats.arena_kib_histogram));
+  } catch (const CAPIError&) {
+    return nullptr;
+  }
+  return result.release();
+}
+
+static PyObject* clear_compile_phase_stats(PyObject*, PyObject*) {
+  clearCompileStats();
+  Py_RETURN_NONE;
+}
+
 static PyObject* clear_runtime_stats(PyObject* /* self */, PyObject*) {
   Runtime::get()->clearDeoptStats();
   Py_RETURN_NONE;
@@ -1293,6 +1548,23 @@ static PyObject* get_compiled_size(PyObject* /* self */, PyObject* func) {
   return PyLong_FromLong(size);
 }
 
+static PyObject* get_compiled_deopt_metadata_size(
+    PyObject* /* self */,
+    PyObject* func) {
+  if (jit_ctx == nullptr) {
+    return Py_BuildValue("(nn)", Py_ssize_t{0}, Py_ssize_t{0});
+  }
+  CompiledFunction* compiled_func = jit_ctx->lookupFunc(func);
+  if (compiled_func == nullptr) {
+    return Py_BuildValue("(nn)", Py_ssize_t{-1}, Py_ssize_t{-1});
+  }
+  CodeRuntime* code_rt = compiled_func->codeRuntime();
+  return Py_BuildValue(
+      "(nn)",
+      static_cast<Py_ssize_t>(code_rt->deoptMetadataBytes()),
+      static_cast<Py_ssize_t>(code_rt->unpackedDeoptMetadataBytes()));
+}
+
 static PyObject* get_compiled_stack_size(PyObject* /* self */, PyObject* func) {
   if (jit_ctx == nullptr) {
     return PyLong_FromLong(0);
@@ -1431,6 +1703,26 @@ static PyObject* get_allocator_stats(PyObject*, PyObject*) {
       PyDict_SetItemString(stats, "huge_allocs", huge_allocs) < 0) {
     return nullptr;
   }
+  auto sealed_bytes = Ref<>::steal(PyLong_FromLong(allocator->sealedBytes()));
+  if (sealed_bytes == nullptr ||
+      PyDict_SetItemString(stats, "sealed_bytes", sealed_bytes) < 0) {
+    return nullptr;
+  }
+  // Space left behind by freed code, and code waiting to be freed.
+  const std::pair<const char*, size_t> reclaim_stats[] = {
+      {"free_bytes", allocator->freeBytes()},
+      {"free_blocks", allocator->freeBlocks()},
+      {"largest_free_block", allocator->largestFreeBlock()},
+      {"reclaimed_bytes", allocator->reclaimedBytes()},
+      {"retired_bytes", jit_ctx != nullptr ? jit_ctx->retiredCodeBytes() : 0},
+  };
+  for (const auto& [name, value] : reclaim_stats) {
+    auto value_obj = Ref<>::steal(PyLong_FromSize_t(value));
+    if (value_obj == nullptr ||
+        PyDict_SetItemString(stats, name, value_obj) < 0) {
+      return nullptr;
+    }
+  }
   return stats.release();
 }
 
@@ -1514,8 +1806,16 @@ static int deopt_gen_visitor(PyObject* obj, void*) {
   return 1;
 }
 
+static PyObject* before_fork(PyObject*, PyObject*) {
+  if (jit_ctx != nullptr) {
+    CodeAllocator::get()->seal();
+  }
+  Py_RETURN_NONE;
+}
+
 static PyObject* after_fork_child(PyObject*, PyObject*) {
   perf::afterForkChild();
+  resetCompileQueueAfterFork();
   Py_RETURN_NONE;
 }
 
@@ -1594,6 +1894,11 @@ static PyMethodDef jit_methods[] = {
      get_compiled_size,
      METH_O,
      "Return code size in bytes for a JIT-compiled function."},
+    {"get_compiled_deopt_metadata_size",
+     get_compiled_deopt_metadata_size,
+     METH_O,
+     "Return a tuple of the size in bytes of the packed deopt metadata for a "
+     "JIT-compiled function, and the size it would have been unpacked."},
     {"get_compiled_stack_size",
      get_compiled_stack_size,
      METH_O,
@@ -1646,11 +1951,38 @@ static PyMethodDef jit_methods[] = {
      get_num_inlined_functions,
      METH_O,
      "Return the number of inline sites in this function."},
+    {"get_compile_queue_stats",
+     get_compile_queue_stats,
+     METH_NOARGS,
+     "Return a dict of statistics about background compilation with "
+     "-X jit-async-compile: the current and maximum queue depth, the number "
+     "of functions enqueued, compiled, and failed, and the total and maximum "
+     "time functions waited in the queue plus the total compile time, in "
+     "milliseconds."},
+    {"get_compile_phase_stats",
+     get_compile_phase_stats,
+     METH_NOARGS,
+     "Return a dict of compile time and memory statistics aggregated over "
+     "every function compiled: the number of compiles and their total time, "
+     "the count, total and maximum time of each phase (HIR build, each HIR "
+     "pass, LIR generation, LIR rewrites, register allocation and code "
+     "generation), the total and maximum bytes held by the compiler's arenas "
+     "in one compile, and log2 histograms of per-compile time in "
+     "microseconds and arena size in KiB. Times are in milliseconds."},
+    {"clear_compile_phase_stats",
+     clear_compile_phase_stats,
+     METH_NOARGS,
+     "Reset the statistics returned by get_compile_phase_stats()."},
     {"get_function_hir_opcode_counts",
      get_function_hir_opcode_counts,
      METH_O,
      "Return a map from HIR opcode name to the count of that opcode in the "
      "JIT-compiled version of this function."},
+    {"get_function_compile_tier",
+     get_function_compile_tier,
+     METH_O,
+     "Return 1 if this function is running baseline JIT code, 2 if it's "
+     "running fully optimized JIT code, or None if it isn't JIT-compiled."},
     {"mlock_profiler_dependencies",
      mlock_profiler_dependencies,
      METH_NOARGS,
@@ -1663,6 +1995,10 @@ static PyMethodDef jit_methods[] = {
      after_fork_child,
      METH_NOARGS,
      "Callback to be invoked by the runtime after fork()."},
+    {"before_fork",
+     before_fork,
+     METH_NOARGS,
+     "Callback to be invoked by the runtime before fork()."},
     {"_deopt_gen",
      deopt_gen,
      METH_O,
@@ -1762,6 +2098,14 @@ bool preloadFuncAndDeps(BorrowedRef<PyFunctionObject> func) {
         worklist.push_back(func);
       }
     }
+    for (const auto& [offset, targets] : preloader->methodTargets()) {
+      for (const auto& target : targets) {
+        BorrowedRef<PyFunctionObject> func = target.get();
+        if (!isPreloaded(func) && shouldCompile(func)) {
+          worklist.push_back(func);
+        }
+      }
+    }
   }
   return true;
 }
@@ -1777,8 +2121,9 @@ static _PyJIT_Result compile_func(BorrowedRef<PyFunctionObject> func) {
                                   : PYJIT_RESULT_PYTHON_EXCEPTION;
 }
 
-// Call posix.register_at_fork(None, None, cinderjit.after_fork_child), if it
-// exists. Returns 0 on success or if the module/function doesn't exist, and -1
+// Call posix.register_at_fork(after_in_child=cinderjit.after_fork_child), if
+// it exists, also passing before=cinderjit.before_fork if code is sealed before
+// fork(). Returns 0 on success or if the module/function doesn't exist, and -1
 // on any other errors.
 static int register_fork_callback(BorrowedRef<> cinderjit_module) {
   auto os_module = Ref<>::steal(
@@ -1804,8 +2149,18 @@ static int register_fork_callback(BorrowedRef<> cinderjit_module) {
   }
   auto kwargs = Ref<>::steal(PyDict_New());
   if (kwargs == nullptr ||
-      PyDict_SetItemString(kwargs, "after_in_child", callback) < 0 ||
-      PyObject_Call(register_at_fork, args, kwargs) == nullptr) {
+      PyDict_SetItemString(kwargs, "after_in_child", callback) < 0) {
+    return -1;
+  }
+  if (getConfig().seal_code_before_fork) {
+    auto before = Ref<>::steal(
+        PyObject_GetAttrString(cinderjit_module, "before_fork"));
+    if (before == nullptr ||
+        PyDict_SetItemString(kwargs, "before", before) < 0) {
+      return -1;
+    }
+  }
+  if (Ref<>::steal(PyObject_Call(register_at_fork, args, kwargs)) == nullptr) {
     return -1;
   }
   return 0;
@@ -1956,6 +2311,14 @@ int _PyJIT_Initialize() {
     }
   }
 
+  if (!g_warm_start_file.empty()) {
+    // The file won't exist on the first run.
+    std::ifstream file(g_warm_start_file, std::ios::binary);
+    if (file) {
+      g_warm_start.load(file);
+    }
+  }
+
   if (jit_profile_interp) {
     _PyJIT_SetProfileNewInterpThreads(true);
     Ci_ThreadState_SetProfileInterpAll(1);
@@ -2022,6 +2385,37 @@ unsigned _PyJIT_AutoJITProfileThreshold() {
   return getConfig().auto_jit_profile_threshold;
 }
 
+int _PyJIT_IsWarmStartCode(PyCodeObject* code) {
+  if (g_warm_start.empty()) {
+    return 0;
+  }
+  auto& profile_runtime = Runtime::get()->profileRuntime();
+  return g_warm_start.contains(profile_runtime.codeKey(code));
+}
+
+int _PyJIT_IsAsyncCompileEnabled() {
+  return getConfig().async_compile;
+}
+
+_PyJIT_Result _PyJIT_EnqueueCompile(PyFunctionObject* raw_func) {
+  if (jit_ctx == nullptr) {
+    return PYJIT_NOT_INITIALIZED;
+  }
+
+  BorrowedRef<PyFunctionObject> func{raw_func};
+
+  if (!shouldCompile(func)) {
+    return PYJIT_RESULT_NOT_ON_JITLIST;
+  }
+
+  compileQueue().enqueue(func);
+  return PYJIT_RESULT_OK;
+}
+
+unsigned _PyJIT_OSRThreshold() {
+  return getConfig().osr_threshold;
+}
+
 int _PyJIT_IsAutoJITEnabled() {
   return _PyJIT_AutoJITThreshold() > 0;
 }
@@ -2054,6 +2448,59 @@ _PyJIT_Result _PyJIT_CompileFunction(PyFunctionObject* raw_func) {
   return compile_func(func);
 }
 
+vectorcallfunc _PyJIT_CompileOSREntry(
+    PyFrameObject* frame,
+    int loop_header,
+    int stack_depth) {
+  if (jit_ctx == nullptr || !_PyJIT_IsEnabled()) {
+    return nullptr;
+  }
+
+  BorrowedRef<PyCodeObject> code{frame->f_code};
+  constexpr int kRequiredFlags = CO_OPTIMIZED | CO_NEWLOCALS;
+  if ((code->co_flags & kRequiredFlags) != kRequiredFlags ||
+      (code->co_flags &
+       (kCoFlagsAnyGenerator | CO_STATICALLY_COMPILED | CO_SUPPRESS_JIT)) ||
+      !PyDict_CheckExact(frame->f_globals) ||
+      !PyDict_CheckExact(frame->f_builtins)) {
+    return nullptr;
+  }
+
+  BorrowedRef<> module_name =
+      PyDict_GetItemString(frame->f_globals, "__name__");
+  if (!shouldCompile(module_name, code)) {
+    PyErr_Clear();
+    return nullptr;
+  }
+
+  BCOffset header{loop_header};
+  if (!hir::isOSREntryCandidate(code, header)) {
+    return nullptr;
+  }
+  OSRKey key{
+      CompilationKey{code, frame->f_builtins, frame->f_globals}, header};
+  if (std::optional<CompiledFunction*> compiled =
+          jit_ctx->lookupOSREntry(key)) {
+    return *compiled != nullptr ? (*compiled)->vectorcallEntry() : nullptr;
+  }
+
+  IsolatedPreloaders ip;
+  std::unique_ptr<hir::Preloader> preloader = hir::Preloader::makePreloader(
+      code,
+      BorrowedRef<PyDictObject>{frame->f_builtins},
+      BorrowedRef<PyDictObject>{frame->f_globals},
+      codeFullname(module_name, code));
+  if (preloader == nullptr) {
+    // OSR is only an optimization; keep interpreting if preloading raised.
+    PyErr_Clear();
+    return nullptr;
+  }
+  preloader->setOSREntry(hir::OSREntry{header, stack_depth});
+
+  CompiledFunction* compiled = jit_ctx->compileOSREntry(*preloader);
+  return compiled != nullptr ? compiled->vectorcallEntry() : nullptr;
+}
+
 // Recursively search the given co_consts tuple for any code objects that are
 // on the current jit-list, using the given module name to form a
 // fully-qualified function name.
@@ -2222,6 +2669,10 @@ int _PyJIT_Finalize() {
   // invoke the JIT while we're finalizing our data structures.
   getMutableConfig().is_enabled = 0;
 
+  // Background compiles must finish before the data structures they use go
+  // away.
+  compileQueue().stop();
+
   // Deopt all JIT generators, since JIT generators reference code and other
   // metadata that we will be freeing later in this function.
   PyUnstable_GC_VisitObjects(deopt_gen_visitor, nullptr);
@@ -2243,6 +2694,16 @@ int _PyJIT_Finalize() {
     g_write_compiled_functions_file.clear();
   }
 
+  if (!g_warm_start_file.empty() && jit_ctx != nullptr) {
+    std::vector<CodeKey> keys;
+    for (BorrowedRef<PyFunctionObject> func : jit_ctx->compiledFuncs()) {
+      keys.emplace_back(profile_runtime.codeKey(func->func_code));
+    }
+    g_warm_start.save(g_warm_start_file, keys);
+    g_warm_start.clear();
+    g_warm_start_file.clear();
+  }
+
   // Always release references from Runtime objects: C++ clients may have
   // invoked the JIT directly without initializing a full jit::Context.
   jit::Runtime::get()->clearDeoptStats();
@@ -2400,6 +2861,48 @@ const jit::RuntimeFrameState* getRuntimeFrameState(
 }
 } // namespace
 
+namespace jit {
+
+const void* callerCodeStart() {
+  // Batch compile workers don't have a Python thread state to look at.
+  if (jit_ctx == nullptr || g_threaded_compile_context.compileRunning()) {
+    return nullptr;
+  }
+  _PyShadowFrame* shadow_frame = PyThreadState_GET()->shadow_frame;
+  if (shadow_frame == nullptr ||
+      _PyShadowFrame_GetOwner(shadow_frame) != PYSF_JIT) {
+    return nullptr;
+  }
+  BorrowedRef<> builtins;
+  BorrowedRef<> globals;
+  if (_PyShadowFrame_GetPtrKind(shadow_frame) == PYSF_PYFRAME) {
+    PyFrameObject* frame = _PyShadowFrame_GetPyFrame(shadow_frame);
+    builtins = frame->f_builtins;
+    globals = frame->f_globals;
+  } else {
+    const RuntimeFrameState* frame_state = getRuntimeFrameState(shadow_frame);
+    builtins = frame_state->builtins();
+    globals = frame_state->globals();
+  }
+  // For an inlined frame this finds the code compiled for the inlined
+  // function on its own, if there is any, which is still a good neighbour.
+  CompiledFunction* compiled = jit_ctx->lookupCode(
+      _PyShadowFrame_GetCode(shadow_frame),
+      reinterpret_cast<PyDictObject*>(builtins.get()),
+      reinterpret_cast<PyDictObject*>(globals.get()));
+  return compiled != nullptr ? compiled->codeStart() : nullptr;
+}
+
+void* compiledStaticEntry(BorrowedRef<PyFunctionObject> func) {
+  if (jit_ctx == nullptr) {
+    return nullptr;
+  }
+  CompiledFunction* compiled = jit_ctx->lookupFunc(func);
+  return compiled != nullptr ? compiled->staticEntry() : nullptr;
+}
+
+} // namespace jit
+
 PyObject* _PyJIT_GetGlobals(PyThreadState* tstate) {
   _PyShadowFrame* shadow_frame = tstate->shadow_frame;
   if (shadow_frame == nullptr) {
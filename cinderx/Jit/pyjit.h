@@ -72,6 +72,50 @@ PyAPI_FUNC(unsigned) _PyJIT_AutoJITThreshold(void);
  */
 PyAPI_FUNC(unsigned) _PyJIT_AutoJITProfileThreshold(void);
 
+/*
+ * Returns 1 if code was compiled by a previous run of this build, according to
+ * the file given with -X jit-warm-start, and 0 otherwise.  AutoJIT compiles
+ * such code on its first call.
+ */
+PyAPI_FUNC(int) _PyJIT_IsWarmStartCode(PyCodeObject* code);
+
+/*
+ * Returns 1 if AutoJIT compiles hot functions on a background thread and 0
+ * otherwise.
+ */
+PyAPI_FUNC(int) _PyJIT_IsAsyncCompileEnabled(void);
+
+/*
+ * Queue func to be compiled on a background thread.  It keeps running in the
+ * interpreter until the compile finishes and its entry point is patched.
+ *
+ * Returns PYJIT_RESULT_OK if func was queued or already is.
+ */
+PyAPI_FUNC(_PyJIT_Result) _PyJIT_EnqueueCompile(PyFunctionObject* func);
+
+/*
+ * Get the number of loop back-edges an interpreted frame takes before trying
+ * to enter an on-stack replacement entry.  Returns 0 when OSR is disabled.
+ */
+PyAPI_FUNC(unsigned) _PyJIT_OSRThreshold(void);
+
+/*
+ * JIT compile an on-stack replacement entry for frame's code, starting at the
+ * loop header at bytecode offset loop_header with stack_depth values on the
+ * value stack.
+ *
+ * The returned entry is called with the frame's f_localsplus array, followed
+ * by its value stack, as positional arguments.  It borrows those references
+ * and runs the rest of the frame, returning the frame's result.
+ *
+ * Returns NULL, without an exception set, if the code can't be entered at this
+ * loop header.
+ */
+PyAPI_FUNC(vectorcallfunc) _PyJIT_CompileOSREntry(
+    PyFrameObject* frame,
+    int loop_header,
+    int stack_depth);
+
 /*
  * JIT compile func and patch its entry point.
  *
@@ -296,6 +340,8 @@ PyAPI_FUNC(void) _PyPerfTrampoline_CompilePerfTrampolinePreFork(void);
 #ifdef __cplusplus
 namespace jit {
 
+class CodeRuntime;
+
 /*
  * JIT compile func or code object, only if a preloader is available.
  *
@@ -328,6 +374,31 @@ bool isPreloaded(BorrowedRef<> unit);
  */
 bool preloadFuncAndDeps(BorrowedRef<PyFunctionObject> func);
 
+/*
+ * Throw away the compiled code that owns code_rt, so that it is compiled again
+ * the next time it is used. Does nothing if the JIT isn't initialized.
+ */
+void recompileCode(const CodeRuntime* code_rt);
+
+/*
+ * Replace the baseline code that owns code_rt with fully optimized code the
+ * next time it is used. Called by the baseline code itself once it's hot.
+ */
+void tierUpCode(CodeRuntime* code_rt);
+
+/*
+ * Return the start of the JIT code for the function that is calling into the
+ * JIT on the current thread, or nullptr if the caller isn't JIT-compiled or
+ * can't be found.
+ */
+const void* callerCodeStart();
+
+/*
+ * Return the static entry point of the code compiled for func, or nullptr if
+ * func isn't compiled or its code has no static entry point.
+ */
+void* compiledStaticEntry(BorrowedRef<PyFunctionObject> func);
+
 using PreloaderMap = std::
     unordered_map<BorrowedRef<PyCodeObject>, std::unique_ptr<hir::Preloader>>;
 
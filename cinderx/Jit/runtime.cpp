@@ -5,6 +5,7 @@
 #include "cinderx/Common/watchers.h"
 #include "internal/pycore_interp.h"
 
+#include "cinderx/Jit/config.h"
 #include "cinderx/Jit/type_deopt_patchers.h"
 
 #include <sys/mman.h>
@@ -223,18 +224,94 @@ _PyTypedArgsInfo* Runtime::findFunctionPrimitiveArgInfo(
   return cache->second.arg_info.get();
 }
 
-std::size_t Runtime::addDeoptMetadata(DeoptMetadata&& deopt_meta) {
-  // Serialize as the deopt data is shared across compile threads.
+void** Runtime::findDirectCallCache(BorrowedRef<PyFunctionObject> function) {
+  ThreadedCompileSerialize guard;
+  BorrowedRef<PyCodeObject> code = function->func_code;
+  auto it = direct_call_caches_.find(function);
+  if (it != direct_call_caches_.end() && it->second.code == code) {
+    return it->second.ptr;
+  }
+  // Callers of the function's previous code keep using its cache, which
+  // stays pointed at the fallback.
+  DirectCallCacheValue& cache = direct_call_caches_[function];
+  addReference(function);
+  addReference(code);
+  cache.ptr = pointer_caches_.allocate();
+  cache.fallback = JITRT_GetDirectCallFallback(code->co_argcount);
+  cache.code = code;
+  *cache.ptr = cache.fallback;
+  return cache.ptr;
+}
+
+void Runtime::setDirectCallEntry(
+    BorrowedRef<PyFunctionObject> function,
+    void* entry) {
   ThreadedCompileSerialize guard;
-  deopt_metadata_.emplace_back(std::move(deopt_meta));
-  return deopt_metadata_.size() - 1;
+  auto it = direct_call_caches_.find(function);
+  if (it == direct_call_caches_.end()) {
+    return;
+  }
+  // The fallback is always safe, even if the function's code has already
+  // been replaced.
+  DirectCallCacheValue& cache = it->second;
+  if (entry == nullptr) {
+    *cache.ptr = cache.fallback;
+  } else if (cache.code == function->func_code) {
+    *cache.ptr = entry;
+  }
+}
+
+std::size_t Runtime::addDeoptMetadata(DeoptMetadata&& deopt_meta) {
+  return deopt_metadata_.emplace_back(std::move(deopt_meta));
 }
 
 DeoptMetadata& Runtime::getDeoptMetadata(std::size_t id) {
-  JIT_CHECK(
-      g_threaded_compile_context.canAccessSharedData(),
-      "getDeoptMetadata() called in unsafe context");
-  return deopt_metadata_[id];
+  JIT_DCHECK(id < deopt_metadata_.size(), "Invalid deopt id {}", id);
+  DeoptMetadataEntry& entry = deopt_metadata_[id];
+  JIT_DCHECK(entry.full != nullptr, "Deopt metadata {} is packed", id);
+  return *entry.full;
+}
+
+const DeoptMetadata& Runtime::unpackDeoptMetadata(
+    std::size_t id,
+    DeoptMetadata& scratch) {
+  JIT_DCHECK(id < deopt_metadata_.size(), "Invalid deopt id {}", id);
+  DeoptMetadataEntry& entry = deopt_metadata_[id];
+  if (entry.full != nullptr) {
+    return *entry.full;
+  }
+  scratch = entry.packed.unpack();
+  return scratch;
+}
+
+std::size_t Runtime::packDeoptMetadata(std::size_t id) {
+  JIT_DCHECK(id < deopt_metadata_.size(), "Invalid deopt id {}", id);
+  DeoptMetadataEntry& entry = deopt_metadata_[id];
+  if (entry.full != nullptr) {
+    entry.packed = PackedDeoptMetadata{*entry.full};
+    entry.full.reset();
+  }
+  return entry.packed.size();
+}
+
+std::size_t Runtime::internDeoptMetadata(
+    std::size_t id,
+    std::unordered_multimap<std::size_t, std::size_t>& interned) {
+  const DeoptMetadata& meta = getDeoptMetadata(id);
+  std::size_t hash = std::hash<DeoptMetadata>{}(meta);
+  auto [begin, end] = interned.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    std::size_t other = it->second;
+    if (other == id) {
+      return id;
+    }
+    if (getDeoptMetadata(other) == meta) {
+      deopt_metadata_[id].full.reset();
+      return other;
+    }
+  }
+  interned.emplace(hash, id);
+  return id;
 }
 
 void Runtime::recordDeopt(std::size_t idx, PyObject* guilty_value) {
@@ -295,6 +372,67 @@ void Runtime::clearGuardFailureCallback() {
   guard_failure_callback_ = nullptr;
 }
 
+bool Runtime::recordGuardFailure(const DeoptMetadata& deopt_meta) {
+  uint32_t threshold = getConfig().recompile_threshold;
+  if (threshold == 0) {
+    return false;
+  }
+  // Bound the number of recompiles, in case the generic code keeps failing
+  // guards that can't be relaxed, like those on globals.
+  constexpr int kMaxRecompiles = 3;
+
+  ThreadedCompileSerialize guard;
+  BorrowedRef<PyCodeObject> code = deopt_meta.code();
+  auto [it, inserted] = relaxed_speculation_.try_emplace(code);
+  if (inserted) {
+    addReference(code);
+  }
+  // Key by where the guard was made rather than where it deopted to, since
+  // LICM may have hoisted it to the top of a loop.
+  it->second.offsets.insert(deopt_meta.origin_offset);
+
+  CodeRuntime* code_rt = deopt_meta.code_rt;
+  if (code_rt->recordGuardFailure() != threshold) {
+    return false;
+  }
+  // Static Python callers may hold the old entry point in their entry caches,
+  // so it can't be replaced.
+  BorrowedRef<PyCodeObject> outer_code = code_rt->frameState()->code();
+  if (outer_code->co_flags & CO_STATICALLY_COMPILED) {
+    return false;
+  }
+  auto& outer = relaxed_speculation_[outer_code];
+  return outer.recompiles++ < kMaxRecompiles;
+}
+
+bool Runtime::isSpeculationRelaxed(
+    BorrowedRef<PyCodeObject> code,
+    BCOffset offset) {
+  ThreadedCompileSerialize guard;
+  auto it = relaxed_speculation_.find(code);
+  return it != relaxed_speculation_.end() && it->second.offsets.count(offset);
+}
+
+bool Runtime::useBaselineTier(BorrowedRef<PyCodeObject> code) {
+  if (getConfig().tier2_threshold == 0) {
+    return false;
+  }
+  // Static Python callers may hold the entry point in their entry caches, so
+  // it can't be replaced once it's hot.
+  if (code->co_flags & CO_STATICALLY_COMPILED) {
+    return false;
+  }
+  ThreadedCompileSerialize guard;
+  return tiered_up_codes_.count(code) == 0;
+}
+
+void Runtime::tierUp(BorrowedRef<PyCodeObject> code) {
+  ThreadedCompileSerialize guard;
+  if (tiered_up_codes_.insert(code).second) {
+    addReference(code);
+  }
+}
+
 void Runtime::addReference(Ref<>&& obj) {
   JIT_CHECK(obj != nullptr, "Can't own a reference to nullptr");
   // Serialize as we modify the globally accessible references_ object.
@@ -312,6 +450,8 @@ void Runtime::releaseReferences() {
   for (auto& code_rt : code_runtimes_) {
     code_rt.releaseReferences();
   }
+  relaxed_speculation_.clear();
+  tiered_up_codes_.clear();
   references_.clear();
   type_deopt_patchers_.clear();
 }
@@ -362,4 +502,47 @@ void Runtime::notifyTypeModified(
   }
 }
 
+void Runtime::forgetDeoptPatchers(const void* code, size_t size) {
+  ThreadedCompileSerialize guard;
+  for (auto it = type_deopt_patchers_.begin();
+       it != type_deopt_patchers_.end();) {
+    std::erase_if(it->second, [&](TypeDeoptPatcher* patcher) {
+      return patcher->isLinkedInto(code, size);
+    });
+    if (it->second.empty()) {
+      it = type_deopt_patchers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Runtime::pinCode(const void* target) {
+  ThreadedCompileSerialize guard;
+  pinned_code_.emplace(target);
+}
+
+bool Runtime::isCodeReferenced(const void* code, size_t size) const {
+  auto start = static_cast<const uint8_t*>(code);
+  auto in_code = [&](const void* addr) {
+    auto p = static_cast<const uint8_t*>(addr);
+    return p >= start && p < start + size;
+  };
+  auto pinned = pinned_code_.lower_bound(code);
+  if (pinned != pinned_code_.end() && in_code(*pinned)) {
+    return true;
+  }
+  for (const auto& [func, cache] : function_entry_caches_) {
+    if (in_code(*cache.ptr)) {
+      return true;
+    }
+  }
+  for (const auto& [func, cache] : direct_call_caches_) {
+    if (in_code(*cache.ptr)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 } // namespace jit
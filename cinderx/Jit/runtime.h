@@ -6,6 +6,7 @@
 #include "cinder/genobject_jit.h"
 #include "cinderx/Common/util.h"
 
+#include "cinderx/Jit/concurrent_vector.h"
 #include "cinderx/Jit/containers.h"
 #include "cinderx/Jit/debug_info.h"
 #include "cinderx/Jit/deopt.h"
@@ -19,6 +20,7 @@
 #include "cinderx/Jit/threaded_compile.h"
 
 #include <optional>
+#include <set>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
@@ -193,8 +195,8 @@ class alignas(16) CodeRuntime {
 
   template <typename... Args>
   RuntimeFrameState* allocateRuntimeFrameState(Args&&... args) {
-    // Serialize as we modify the globally shared runtimes data.
-    ThreadedCompileSerialize guard;
+    // No lock is needed, since a CodeRuntime is only modified by the compile
+    // that allocated it.
     inlined_frame_states_.emplace_back(
         std::make_unique<RuntimeFrameState>(std::forward<Args>(args)...));
     return inlined_frame_states_.back().get();
@@ -227,6 +229,19 @@ class alignas(16) CodeRuntime {
     return &gen_yield_points_.back();
   }
 
+  // Record how much memory this code's deopt metadata uses, and would have
+  // used if it hadn't been packed.
+  void setDeoptMetadataBytes(std::size_t packed, std::size_t unpacked) {
+    deopt_metadata_bytes_ = packed;
+    unpacked_deopt_metadata_bytes_ = unpacked;
+  }
+  std::size_t deoptMetadataBytes() const {
+    return deopt_metadata_bytes_;
+  }
+  std::size_t unpackedDeoptMetadataBytes() const {
+    return unpacked_deopt_metadata_bytes_;
+  }
+
   void set_frame_size(int size) {
     frame_size_ = size;
   }
@@ -238,6 +253,28 @@ class alignas(16) CodeRuntime {
     return &debug_info_;
   }
 
+  // Count a deopt caused by a guard failing in this code, returning the new
+  // total.
+  std::size_t recordGuardFailure() {
+    return ++guard_failures_;
+  }
+
+  // Make this baseline (tier 1) code, which asks to be replaced by fully
+  // optimized code after the given number of calls.
+  void startTierUpCountdown(uint32_t calls) {
+    baseline_tier_ = true;
+    tier_up_countdown_ = calls;
+  }
+
+  bool isBaselineTier() const {
+    return baseline_tier_;
+  }
+
+  // Calls left until baseline code tiers up. Decremented by the code itself.
+  uint32_t* tierUpCountdown() {
+    return &tier_up_countdown_;
+  }
+
   static constexpr int64_t frameStateOffset() {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Winvalid-offsetof"
@@ -258,6 +295,11 @@ class alignas(16) CodeRuntime {
   std::deque<GenYieldPoint> gen_yield_points_;
 
   int frame_size_{-1};
+  std::size_t guard_failures_{0};
+  std::size_t deopt_metadata_bytes_{0};
+  std::size_t unpacked_deopt_metadata_bytes_{0};
+  uint32_t tier_up_countdown_{0};
+  bool baseline_tier_{false};
 
   DebugInfo debug_info_;
 };
@@ -325,16 +367,47 @@ class Runtime {
   // is typed to.  Typed object references are explicitly excluded.
   _PyTypedArgsInfo* findFunctionPrimitiveArgInfo(PyFunctionObject* function);
 
+  // Find the cache holding the entry point for direct calls to a function
+  // with its current code, creating it if needed. A new cache points at the
+  // generic fallback.
+  void** findDirectCallCache(BorrowedRef<PyFunctionObject> function);
+
+  // Point the direct call cache for a function at the given static entry
+  // point for its current code, or back at the generic fallback if entry is
+  // nullptr.
+  void setDirectCallEntry(BorrowedRef<PyFunctionObject> function, void* entry);
+
   // Add metadata used during deopt. Returns a handle that can be used to
   // fetch the metadata from generated code.
   std::size_t addDeoptMetadata(DeoptMetadata&& deopt_meta);
 
-  // Get a reference to the DeoptMetadata with the given id. If this function is
-  // called from a context where a threaded compile may be active, the caller is
-  // responsible for holding the threaded compile lock for the lifetime of the
-  // returned reference.
+  // Get a reference to the DeoptMetadata with the given id, which must not
+  // have been packed. During a threaded compile, a worker may only access the
+  // metadata that it added itself.
   DeoptMetadata& getDeoptMetadata(std::size_t id);
 
+  // Get the DeoptMetadata with the given id, whether or not it has been
+  // packed. Packed metadata is decoded into `scratch`, which is returned;
+  // otherwise the stored metadata is returned and `scratch` is untouched.
+  const DeoptMetadata& unpackDeoptMetadata(
+      std::size_t id,
+      DeoptMetadata& scratch);
+
+  // Pack the DeoptMetadata with the given id once its code has been
+  // generated, returning the number of bytes it now uses. It can't be changed
+  // or fetched with getDeoptMetadata() afterwards.
+  std::size_t packDeoptMetadata(std::size_t id);
+
+  // Return the id of the DeoptMetadata in `interned` that's equal to the one
+  // with the given id, and free the latter if they're different. If there's
+  // none, add the given id to `interned`, which maps hashes to ids, and
+  // return it. Deopt exits can then share metadata, and a stub, whichever
+  // instruction they were emitted for. Only valid once the live value
+  // locations have been filled in, and before the metadata is packed.
+  std::size_t internDeoptMetadata(
+      std::size_t id,
+      std::unordered_multimap<std::size_t, std::size_t>& interned);
+
   // Record that a deopt of the given index happened at runtime, with an
   // optional guilty value.
   void recordDeopt(std::size_t idx, PyObject* guilty_value);
@@ -355,6 +428,25 @@ class Runtime {
   void guardFailed(const DeoptMetadata& deopt_meta);
   void clearGuardFailureCallback();
 
+  // Record a deopt caused by a guard failure, remembering where it happened
+  // so that code compiled from now on doesn't speculate there. Returns true
+  // if the guard failures in the function it happened in have reached the
+  // recompile threshold, and the function should be compiled again.
+  bool recordGuardFailure(const DeoptMetadata& deopt_meta);
+
+  // Return whether a guard emitted for the bytecode instruction at offset in
+  // code has failed at runtime, in which case the compiler should emit generic
+  // code there instead of a guard.
+  bool isSpeculationRelaxed(BorrowedRef<PyCodeObject> code, BCOffset offset);
+
+  // Return whether code should be compiled as baseline (tier 1) code, with
+  // minimal optimization, rather than fully optimized straight away.
+  bool useBaselineTier(BorrowedRef<PyCodeObject> code);
+
+  // Record that code's baseline code has got hot, so it's fully optimized
+  // from now on.
+  void tierUp(BorrowedRef<PyCodeObject> code);
+
   // Ensure that this Runtime owns a reference to the given owned object,
   // keeping it alive for use by the compiled code. Transfer ownership of the
   // object to the CodeRuntime.
@@ -431,6 +523,20 @@ class Runtime {
   // call patcher->maybePatch(new_ty).
   void watchType(BorrowedRef<PyTypeObject> type, TypeDeoptPatcher* patcher);
 
+  // Stop notifying the deopt patchers linked into a range of code that is
+  // about to be freed.
+  void forgetDeoptPatchers(const void* code, size_t size);
+
+  // Record that compiled code calls target directly, rather than through a
+  // function object or entry cache, so the code containing target can never
+  // be freed.
+  void pinCode(const void* target);
+
+  // Return true if freeing the given range of code would leave a pinned
+  // address, a function entry cache, or a direct call cache pointing into
+  // freed memory.
+  bool isCodeReferenced(const void* code, size_t size) const;
+
   // Callback for when a type is modified or destroyed. lookup_type should be
   // the type that triggered the call (the type that's being
   // modified/deleted/otherwise messed with), and new_type should be the "new"
@@ -465,11 +571,38 @@ class Runtime {
 
   GlobalCacheManager global_caches_;
   FunctionEntryCacheMap function_entry_caches_;
+  DirectCallCacheMap direct_call_caches_;
 
-  std::vector<DeoptMetadata> deopt_metadata_;
+  // Appended to by every compile, so batch compile workers add to it without
+  // taking the threaded compile lock.
+  //
+  // Metadata is kept in full while its code is being generated, and packed
+  // afterwards if it's only needed when deoptimizing.
+  struct DeoptMetadataEntry {
+    explicit DeoptMetadataEntry(DeoptMetadata&& meta)
+        : full{std::make_unique<DeoptMetadata>(std::move(meta))} {}
+
+    std::unique_ptr<DeoptMetadata> full;
+    PackedDeoptMetadata packed;
+  };
+  ConcurrentVector<DeoptMetadataEntry> deopt_metadata_;
   DeoptStats deopt_stats_;
   GuardFailureCallback guard_failure_callback_;
 
+  // Bytecode offsets where guards have failed, and how many times each code
+  // object has been recompiled because of them. Only populated when
+  // recompilation is enabled.
+  struct RelaxedSpeculation {
+    std::unordered_set<BCOffset> offsets;
+    int recompiles{0};
+  };
+  std::unordered_map<BorrowedRef<PyCodeObject>, RelaxedSpeculation>
+      relaxed_speculation_;
+
+  // Code objects whose baseline code has got hot. Only populated when tiered
+  // compilation is enabled.
+  std::unordered_set<BorrowedRef<PyCodeObject>> tiered_up_codes_;
+
   // Note: Ideally this would be separate from JIT metadata.  It should be
   // usable even when the JIT is fully reset.
   ProfileRuntime profile_runtime_;
@@ -482,6 +615,9 @@ class Runtime {
 
   std::unordered_map<BorrowedRef<PyTypeObject>, std::vector<TypeDeoptPatcher*>>
       type_deopt_patchers_;
+
+  // Addresses in compiled code that other compiled code calls directly.
+  std::set<const void*> pinned_code_;
 };
 
 // Symbolize and demangle the given function.
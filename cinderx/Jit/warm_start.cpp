@@ -0,0 +1,148 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#include "cinderx/Jit/warm_start.h"
+
+#include "Python.h"
+#include "cinderx/Common/log.h"
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <istream>
+#include <ostream>
+
+namespace jit {
+
+namespace {
+
+constexpr uint64_t kMagicHeader = 0x7472617473647261;
+constexpr uint32_t kVersion = 1;
+
+template <typename T>
+T read(std::istream& stream) {
+  static_assert(
+      std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+  T val;
+  stream.read(reinterpret_cast<char*>(&val), sizeof(val));
+  return val;
+}
+
+template <typename T>
+void write(std::ostream& stream, T value) {
+  static_assert(
+      std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeStr(std::ostream& stream, const std::string& str) {
+  write<uint16_t>(stream, str.size());
+  stream.write(str.data(), str.size());
+}
+
+std::string readStr(std::istream& stream) {
+  auto len = read<uint16_t>(stream);
+  std::string result(len, '\0');
+  stream.read(result.data(), len);
+  return result;
+}
+
+} // namespace
+
+std::string WarmStartSet::buildID() {
+  // Py_GetVersion() identifies the Python build. CinderX has no build ID of
+  // its own, so use the identity of the shared object the JIT was loaded from.
+  std::string cinderx_id = "unknown";
+  Dl_info info;
+  struct stat st;
+  if (::dladdr(reinterpret_cast<void*>(&WarmStartSet::buildID), &info) != 0 &&
+      info.dli_fname != nullptr && ::stat(info.dli_fname, &st) == 0) {
+    cinderx_id = fmt::format(
+        "{}:{}:{}:{}",
+        info.dli_fname,
+        st.st_size,
+        st.st_mtim.tv_sec,
+        st.st_mtim.tv_nsec);
+  }
+  return fmt::format("{} {}", Py_GetVersion(), cinderx_id);
+}
+
+bool WarmStartSet::load(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    JIT_LOG("Failed to open {} for reading", filename);
+    return false;
+  }
+  JIT_LOG("Loading warm start data from {}", filename);
+  return load(file);
+}
+
+bool WarmStartSet::load(std::istream& stream) {
+  keys_.clear();
+  try {
+    stream.exceptions(std::ios::badbit | std::ios::failbit);
+    auto magic = read<uint64_t>(stream);
+    if (magic != kMagicHeader) {
+      JIT_LOG("Bad magic value {:#x} in warm start data", magic);
+      return false;
+    }
+    auto version = read<uint32_t>(stream);
+    if (version != kVersion) {
+      JIT_LOG("Unknown warm start data version {}", version);
+      return false;
+    }
+    std::string build_id = readStr(stream);
+    if (build_id != buildID()) {
+      JIT_LOG("Ignoring warm start data from a different build: {}", build_id);
+      return true;
+    }
+    auto num_keys = read<uint32_t>(stream);
+    for (uint32_t i = 0; i < num_keys; ++i) {
+      keys_.emplace(readStr(stream));
+    }
+  } catch (const std::runtime_error& e) {
+    JIT_LOG("Failed to load warm start data: {}", e.what());
+    keys_.clear();
+    return false;
+  }
+  JIT_LOG("Loaded warm start data for {} code objects", keys_.size());
+  return true;
+}
+
+bool WarmStartSet::save(
+    const std::string& filename,
+    const std::vector<CodeKey>& keys) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) {
+    JIT_LOG("Failed to open {} for writing", filename);
+    return false;
+  }
+  JIT_LOG("Writing out warm start data to {}", filename);
+  return save(file, keys);
+}
+
+bool WarmStartSet::save(
+    std::ostream& stream,
+    const std::vector<CodeKey>& keys) const {
+  // Keep what was loaded, so functions that didn't get called in this run are
+  // still compiled early in the next one.
+  UnorderedSet<CodeKey> all_keys{keys_};
+  all_keys.insert(keys.begin(), keys.end());
+  try {
+    stream.exceptions(std::ios::badbit | std::ios::failbit);
+    write<uint64_t>(stream, kMagicHeader);
+    write<uint32_t>(stream, kVersion);
+    writeStr(stream, buildID());
+    write<uint32_t>(stream, all_keys.size());
+    for (const CodeKey& key : all_keys) {
+      writeStr(stream, key);
+    }
+  } catch (const std::runtime_error& e) {
+    JIT_LOG("Failed to write warm start data: {}", e.what());
+    return false;
+  }
+  JIT_LOG("Wrote warm start data for {} code objects", all_keys.size());
+  return true;
+}
+
+} // namespace jit
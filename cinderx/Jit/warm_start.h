@@ -0,0 +1,72 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+
+#pragma once
+
+#include "cinderx/Jit/containers.h"
+#include "cinderx/Jit/profile_runtime.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace jit {
+
+// The set of code objects that a previous run of the same Python and CinderX
+// build JIT-compiled, identified by their ProfileRuntime code keys.
+//
+// With auto-JIT, a new process otherwise has to rediscover which functions are
+// hot, and profile them, before compiling anything. Functions in the warm
+// start set are instead compiled on their first call, using the type profile
+// loaded with -X jit-read-profile if there is one. Generated code itself isn't
+// persisted: it embeds addresses of Python objects, inline caches and runtime
+// helpers that are only valid in the process that compiled it.
+//
+// TODO: A persistent code cache, which would map previously generated code
+// instead of compiling it again, is a separate follow-up. It needs relocatable
+// code, with DeoptMetadata, referenced constants and the guards it depends on
+// stored alongside and revalidated at load time.
+//
+// File format, with integers little endian:
+//   uint64: magic value 0x7472617473647261
+//   uint32: 1 (version identifier)
+//   uint16 len + bytes: build ID (see buildID())
+//   uint32: num_code_keys
+//   [num_code_keys] uint16 len + bytes: code key
+class WarmStartSet {
+ public:
+  // Load a warm start file, returning false if it can't be read. A file written
+  // by a different build loads as an empty set.
+  bool load(const std::string& filename);
+  bool load(std::istream& stream);
+
+  // Write the given code keys, plus any loaded ones, to a warm start file.
+  // Returns false on failure.
+  bool save(const std::string& filename, const std::vector<CodeKey>& keys)
+      const;
+  bool save(std::ostream& stream, const std::vector<CodeKey>& keys) const;
+
+  bool contains(const CodeKey& key) const {
+    return keys_.contains(key);
+  }
+
+  bool empty() const {
+    return keys_.empty();
+  }
+
+  std::size_t size() const {
+    return keys_.size();
+  }
+
+  void clear() {
+    keys_.clear();
+  }
+
+  // An identifier for the running Python and CinderX build. Warm start files
+  // are only used by the build that wrote them.
+  static std::string buildID();
+
+ private:
+  UnorderedSet<CodeKey> keys_;
+};
+
+} // namespace jit
@@ -0,0 +1,83 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+#include <gtest/gtest.h>
+
+#include "cinderx/Jit/compile_arena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+using namespace jit;
+
+struct Node : CompileArenaAllocated {
+  explicit Node(int v) : value{v} {}
+  int value;
+  char padding[100];
+};
+
+bool isAligned(void* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t) == 0;
+}
+
+} // namespace
+
+TEST(CompileArenaTest, AllocationsDontOverlap) {
+  CompileArena arena;
+  constexpr int kCount = 10000;
+  std::vector<char*> ptrs;
+  for (int i = 0; i < kCount; ++i) {
+    auto ptr = static_cast<char*>(arena.allocate(24));
+    ASSERT_TRUE(isAligned(ptr));
+    std::memset(ptr, i & 0xff, 24);
+    ptrs.push_back(ptr);
+  }
+  for (int i = 0; i < kCount; ++i) {
+    for (int j = 0; j < 24; ++j) {
+      ASSERT_EQ(ptrs[i][j], static_cast<char>(i & 0xff));
+    }
+  }
+  EXPECT_GE(arena.bytes(), kCount * 24);
+}
+
+TEST(CompileArenaTest, LargeAllocations) {
+  CompileArena arena;
+  auto small = static_cast<char*>(arena.allocate(16));
+  std::size_t bytes = arena.bytes();
+  auto big = static_cast<char*>(arena.allocate(1024 * 1024));
+  std::memset(big, 0xb, 1024 * 1024);
+  EXPECT_GE(arena.bytes(), bytes + 1024 * 1024);
+  // The big allocation got its own chunk, leaving room in the first one.
+  auto small2 = static_cast<char*>(arena.allocate(16));
+  EXPECT_EQ(small2, small + 16);
+}
+
+TEST(CompileArenaTest, AllocatedFromCurrentArena) {
+  CompileArena arena;
+  std::unique_ptr<Node> heap_node = std::make_unique<Node>(1);
+  EXPECT_EQ(arena.bytes(), 0);
+  {
+    CompileArenaScope scope{&arena};
+    auto node = std::make_unique<Node>(2);
+    EXPECT_TRUE(isAligned(node.get()));
+    EXPECT_GT(arena.bytes(), 0);
+    {
+      // Scopes nest.
+      CompileArena inner;
+      CompileArenaScope inner_scope{&inner};
+      auto inner_node = std::make_unique<Node>(3);
+      EXPECT_GT(inner.bytes(), 0);
+    }
+    std::size_t bytes = arena.bytes();
+    auto node2 = std::make_unique<Node>(4);
+    EXPECT_EQ(arena.bytes(), bytes);
+    EXPECT_EQ(node->value, 2);
+    EXPECT_EQ(node2->value, 4);
+  }
+  // Outside of any scope, objects come from the heap again.
+  std::size_t bytes = arena.bytes();
+  auto node = std::make_unique<Node>(5);
+  EXPECT_EQ(arena.bytes(), bytes);
+  EXPECT_EQ(heap_node->value, 1);
+}
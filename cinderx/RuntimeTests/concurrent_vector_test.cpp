@@ -0,0 +1,49 @@
+// Copyright (c) Meta Platforms, Inc. and affiliates.
+#include <gtest/gtest.h>
+
+#include "cinderx/Jit/concurrent_vector.h"
+
+#include <thread>
+#include <vector>
+
+using namespace jit;
+
+TEST(ConcurrentVectorTest, ElementsDontMove) {
+  ConcurrentVector<int, 4> vec;
+  std::vector<int*> addrs;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(vec.emplace_back(i), i);
+    addrs.push_back(&vec[i]);
+  }
+  ASSERT_EQ(vec.size(), 1000);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(&vec[i], addrs[i]);
+    ASSERT_EQ(vec[i], i);
+  }
+}
+
+TEST(ConcurrentVectorTest, ConcurrentAppends) {
+  ConcurrentVector<std::vector<int>> vec;
+  constexpr int kThreads = 8;
+  constexpr int kPerThread = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kPerThread; ++i) {
+        int value = t * kPerThread + i;
+        std::size_t id = vec.emplace_back(2, value);
+        ASSERT_EQ(vec[id][1], value);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(vec.size(), kThreads * kPerThread);
+  std::vector<bool> seen(kThreads * kPerThread);
+  for (std::size_t i = 0; i < vec.size(); ++i) {
+    int value = vec[i][0];
+    ASSERT_FALSE(seen[value]);
+    seen[value] = true;
+  }
+}
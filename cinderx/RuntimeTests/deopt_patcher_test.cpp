@@ -24,6 +24,7 @@ class DeoptPatcherTest : public RuntimeTest {
     int spill_stack_size = ngen.GetCompiledFunctionSpillStackSize();
     return std::make_unique<jit::CompiledFunction>(
         reinterpret_cast<vectorcallfunc>(entry),
+        ngen.getCodeStart(),
         ngen.getStaticEntry(),
         ngen.codeRuntime(),
         func_size,
@@ -106,3 +107,48 @@ def func():
   ASSERT_EQ(PyLong_AsLong(res2), 314159);
   EXPECT_TRUE(did_deopt);
 }
+
+TEST_F(DeoptPatcherTest, PatchpointsAfterOneSnapshotShareDeoptExit) {
+  const char* pycode = R"(
+def func():
+  a = 314159
+  return a
+)";
+
+  Ref<PyFunctionObject> pyfunc(compileAndGet(pycode, "func"));
+  ASSERT_NE(pyfunc, nullptr);
+
+  auto irfunc = buildHIR(pyfunc);
+  ASSERT_NE(irfunc, nullptr);
+
+  jit::hir::Instr* term = irfunc->cfg.entry_block->GetTerminator();
+  ASSERT_NE(term, nullptr);
+  ASSERT_TRUE(term->IsReturn());
+
+  // Both patchpoints are bound to the Snapshot before the return, so they
+  // deopt with identical metadata.
+  jit::Runtime* jit_rt = jit::Runtime::get();
+  auto patcher1 = jit_rt->allocateDeoptPatcher<MyDeoptPatcher>(1);
+  auto patcher2 = jit_rt->allocateDeoptPatcher<MyDeoptPatcher>(2);
+  jit::hir::DeoptPatchpoint::create(patcher1)->InsertBefore(*term);
+  jit::hir::DeoptPatchpoint::create(patcher2)->InsertBefore(*term);
+
+  jit::Compiler::runPasses(*irfunc, jit::PassConfig::kDefault);
+  jit::codegen::NativeGenerator ngen(irfunc.get());
+  auto jitfunc = generateCode(ngen);
+  ASSERT_NE(jitfunc, nullptr);
+  EXPECT_TRUE(patcher1->isInitialized());
+  EXPECT_TRUE(patcher2->isInitialized());
+  EXPECT_EQ(ngen.GetNumDeoptExitStubs(), 1);
+
+  // Deopting through the second patchpoint still works.
+  bool did_deopt = false;
+  auto callback = [&did_deopt](const jit::DeoptMetadata&) { did_deopt = true; };
+  jit_rt->setGuardFailureCallback(callback);
+  patcher2->patch();
+  auto res = Ref<>::steal(jitfunc->invoke(pyfunc, nullptr, 0));
+  jit_rt->clearGuardFailureCallback();
+  ASSERT_NE(res, nullptr);
+  ASSERT_EQ(PyLong_AsLong(res), 314159);
+  EXPECT_TRUE(did_deopt);
+}
@@ -770,3 +770,64 @@ TEST_F(DeoptTest, ValueKind) {
   EXPECT_EQ(deoptValueKind(TLong), ValueKind::kObject);
   EXPECT_EQ(deoptValueKind(TNullptr), ValueKind::kObject);
 }
+
+TEST_F(DeoptTest, PackedMetadataRoundTrips) {
+  const char* src = R"(
+def test(a, b):
+  return a + b
+)";
+  Ref<PyFunctionObject> func(compileAndGet(src, "test"));
+  ASSERT_NE(func, nullptr);
+  CodeRuntime code_rt{func, FrameMode::kNormal};
+  auto name = Ref<>::steal(PyUnicode_FromString("attr"));
+
+  DeoptMetadata dm;
+  dm.eh_name = name;
+  dm.live_values = {
+      {PhyLocation{PhyLocation::RDI},
+       RefKind::kOwned,
+       ValueKind::kObject,
+       LiveValue::Source::kUnknown},
+      {PhyLocation{-1000},
+       RefKind::kBorrowed,
+       ValueKind::kDouble,
+       LiveValue::Source::kLoadMethod}};
+  dm.virtual_objects = {{VirtualObject::Kind::kTuple, {0, 1}}};
+  DeoptFrameMetadata dfm;
+  dfm.localsplus = {0, -1, 2};
+  dfm.stack = {1};
+  dfm.block_stack.push({SETUP_FINALLY, BCOffset{300}, 1});
+  dfm.code = reinterpret_cast<PyCodeObject*>(PyFunction_GetCode(func));
+  dfm.next_instr_offset = BCOffset{12};
+  dm.frame_meta.push_back(dfm);
+  dm.code_rt = &code_rt;
+  dm.descr = "GuardType";
+  dm.guilty_value = 1;
+  dm.nonce = 123456;
+  dm.reason = DeoptReason::kGuardFailure;
+  dm.elided_frames = 0;
+  dm.tail_call_offset = BCOffset{10};
+
+  PackedDeoptMetadata packed{dm};
+  EXPECT_LT(packed.size(), dm.memoryUsage());
+
+  DeoptMetadata unpacked = packed.unpack();
+  EXPECT_EQ(unpacked.toString(), dm.toString());
+  EXPECT_EQ(unpacked.eh_name, dm.eh_name);
+  EXPECT_EQ(unpacked.code_rt, dm.code_rt);
+  EXPECT_EQ(unpacked.guilty_value, dm.guilty_value);
+  EXPECT_EQ(unpacked.nonce, dm.nonce);
+  EXPECT_EQ(unpacked.elided_frames, dm.elided_frames);
+  EXPECT_EQ(unpacked.tail_call_offset, dm.tail_call_offset);
+  EXPECT_TRUE(unpacked.live_values[1].isLoadMethodResult());
+  ASSERT_EQ(unpacked.virtual_objects.size(), 1);
+  EXPECT_EQ(unpacked.virtual_objects[0].kind, VirtualObject::Kind::kTuple);
+  EXPECT_EQ(unpacked.virtual_objects[0].elements, std::vector<int>({0, 1}));
+  ASSERT_EQ(unpacked.frame_meta.size(), 1);
+  const DeoptFrameMetadata& frame = unpacked.frame_meta[0];
+  EXPECT_EQ(frame.localsplus, dfm.localsplus);
+  EXPECT_EQ(frame.stack, dfm.stack);
+  EXPECT_EQ(frame.block_stack, dfm.block_stack);
+  EXPECT_EQ(frame.code, dfm.code);
+  EXPECT_EQ(frame.next_instr_offset, dfm.next_instr_offset);
+}
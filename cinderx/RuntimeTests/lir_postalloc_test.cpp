@@ -134,4 +134,47 @@ BB %1 - preds: %0 - section: .coldtext
   ASSERT_TRUE(verifyPostRegAllocInvariants(parsed_func.get(), std::cout));
 }
 
+TEST_F(LIRPostAllocRewriteTest, TestPeepholes) {
+  auto lir_input_str = fmt::format(R"(Function:
+BB %0 - succs: %1 %2
+       RAX:Object = Add RDI:Object, RSI:Object
+       RCX:64bit = Add RDI:64bit, 8(0x8):64bit
+       RDX:Object = Move RAX:Object
+       RAX:Object = Move RDX:Object
+       RAX:Object = Sub RAX:Object, RCX:64bit
+       CondBranch RAX:Object, BB%1, BB%2
+BB %1 - preds: %0
+       RAX:Object = Move RDI:Object
+BB %2 - preds: %0
+       RAX:Object = Move RSI:Object
+)");
+
+  Parser parser;
+  auto parsed_func = parser.parse(lir_input_str);
+
+  jit::codegen::Environ env_;
+  PostRegAllocRewrite post_rewrite(parsed_func.get(), &env_);
+  post_rewrite.run();
+
+  std::stringstream ss;
+  ss << *parsed_func;
+  auto expected_lir_str = fmt::format(R"(Function:
+BB %0 - succs: %1 %2
+      RAX:Object = Lea [RDI:Object + RSI:Object]:Object
+       RCX:64bit = Lea [RDI:Object + 0x8]:Object
+      RDX:Object = Move RAX:Object
+      RAX:Object = Sub RAX:Object, RCX:64bit
+                   BranchZ BB%2
+
+BB %1 - preds: %0
+      RAX:Object = Move RDI:Object
+
+BB %2 - preds: %0
+      RAX:Object = Move RSI:Object
+
+)");
+  ASSERT_EQ(expected_lir_str, ss.str());
+  ASSERT_TRUE(verifyPostRegAllocInvariants(parsed_func.get(), std::cout));
+}
+
 } // namespace jit::lir
@@ -142,4 +142,49 @@ BB %6
   EXPECT_EQ(runPostGenRewrite(lir_input_str), expected_lir_str);
 }
 
+TEST_F(LIRPostGenerationRewriteTest, FoldsAddressArithmetic) {
+  const char* lir_input_str = R"(Function:
+BB %0
+  %1:Object = Bind RDI:Object
+  %2:64bit = Bind RSI:64bit
+  %3:64bit = LShift %2:64bit, 3(0x3):64bit
+  %4:Object = Add %1:Object, %3:64bit
+  %5:Object = Add %4:Object, 16(0x10):64bit
+  %6:Object = Move [%5:Object + 0x8]:Object
+  Return %6:Object
+)";
+
+  const char* expected_lir_str = R"(Function:
+BB %0
+       %1:Object = Bind RDI:Object
+        %2:64bit = Bind RSI:64bit
+       %6:Object = Move [%1:Object + %2:64bit * 8 + 0x18]:Object
+                   Return %6:Object
+
+)";
+
+  EXPECT_EQ(runPostGenRewrite(lir_input_str), expected_lir_str);
+}
+
+TEST_F(LIRPostGenerationRewriteTest, FoldsLeaButKeepsItIfUsed) {
+  const char* lir_input_str = R"(Function:
+BB %0
+  %1:Object = Bind RDI:Object
+  %2:Object = Lea [%1:Object + 0x10]:Object
+  [%2:Object + 0x8]:Object = Move 0(0x0):64bit
+  Return %2:Object
+)";
+
+  const char* expected_lir_str = R"(Function:
+BB %0
+       %1:Object = Bind RDI:Object
+       %2:Object = Lea [%1:Object + 0x10]:Object
+[%1:Object + 0x18]:Object = Move 0(0x0):64bit
+                   Return %2:Object
+
+)";
+
+  EXPECT_EQ(runPostGenRewrite(lir_input_str), expected_lir_str);
+}
+
 } // namespace jit::lir
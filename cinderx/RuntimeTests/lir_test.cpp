@@ -147,7 +147,7 @@ BB %0 - succs: %3
        %1:Object = Bind R10:Object
        %2:Object = Bind R11:Object
 
-BB %3 - preds: %0 - succs: %9
+BB %3 - preds: %0 - succs: %10
 
 # v4:CDouble[3.1415] = LoadConst<CDouble[3.1415]>
         %4:64bit = Move 4614256447914709615(0x400921cac083126f):64bit
@@ -185,7 +185,7 @@ BB %0 - succs: %3
        %1:Object = Bind R10:Object
        %2:Object = Bind R11:Object
 
-BB %3 - preds: %0 - succs: %12
+BB %3 - preds: %0 - succs: %15
 
 # v7:CDouble[1.14] = LoadConst<CDouble[1.14]>
         %4:64bit = Move 4607812922747849277(0x3ff23d70a3d70a3d):64bit
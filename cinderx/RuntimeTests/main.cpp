@@ -146,6 +146,15 @@ int main(int argc, char* argv[]) {
   register_json_test("RuntimeTests/hir_tests/json_test.txt");
   register_test(
       "RuntimeTests/hir_tests/builtin_load_method_elimination_test.txt");
+  register_test("RuntimeTests/hir_tests/global_value_numbering_test.txt");
+  register_test("RuntimeTests/hir_tests/escape_analysis_test.txt");
+  register_test("RuntimeTests/hir_tests/int_range_analysis_test.txt");
+  register_test("RuntimeTests/hir_tests/float_unboxing_test.txt");
+  register_test("RuntimeTests/hir_tests/tail_call_elimination_test.txt");
+  register_test("RuntimeTests/hir_tests/loop_invariant_code_motion_test.txt");
+  register_test(
+      "RuntimeTests/hir_tests/loop_invariant_code_motion_static_test.txt",
+      HIRTest::kCompileStatic);
   register_test("RuntimeTests/hir_tests/all_passes_test.txt");
   register_test(
       "RuntimeTests/hir_tests/all_passes_static_test.txt",
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 using namespace jit;
@@ -294,6 +295,154 @@ BB %28
   }
 }
 
+TEST_F(LinearScanAllocatorTest, LoopDepth) {
+  const char* lir_source = R"(Function:
+BB %0 - succs: %3
+  %1 = Move 0(0x0)
+  Branch BB%3
+BB %3 - succs: %7 %11
+  %4 = Phi (BB%0, %1), (BB%7, %8)
+  %5 = Add %4, 1
+  CondBranch %5, BB%7, BB%11
+BB %7 - succs: %3
+  %8 = Add %5, 1
+  Branch BB%3
+BB %11 - succs: %14
+  Return %5
+BB %14
+
+)";
+
+  Parser parser;
+  auto lir_func = parser.parse(lir_source);
+
+  RegallocOptions options;
+  options.spill_costs = true;
+  LinearScanAllocator lsallocator(lir_func.get(), 0, options);
+  lsallocator.initialize();
+  lsallocator.calculateLiveIntervals();
+
+  EXPECT_EQ(lsallocator.block_loop_depth_, (std::vector<int>{0, 1, 1, 0, 0}));
+
+  // The back edge copy of the loop variable should be coalesced away.
+  lsallocator.linearScan();
+  auto instrs = parser.getOutputInstrMap();
+  const Operand* phi = instrs.at(4)->output();
+  const Operand* next = instrs.at(8)->output();
+  for (auto& interval : lsallocator.allocated_) {
+    if (interval->vreg == next) {
+      EXPECT_EQ(interval->allocated_loc, lsallocator.vreg_last_reg_.at(phi));
+    }
+  }
+}
+
+TEST_F(LinearScanAllocatorTest, SpillCostsKeepLoopValuesInRegisters) {
+  // %2-%5 are only used between the loops and %6-%9 only in the second loop.
+  // The first loop needs more registers than are left, so something has to be
+  // spilled while it runs.
+  const char* lir_source = R"(Function:
+BB %1 - succs: %11
+  %2 = Move 0(0x0)
+  %3 = Move 1(0x1)
+  %4 = Move 2(0x2)
+  %5 = Move 3(0x3)
+  %6 = Move 100(0x64)
+  %7 = Move 101(0x65)
+  %8 = Move 102(0x66)
+  %9 = Move 103(0x67)
+  %10 = Move 0(0x0)
+  Branch BB%11
+BB %11 - succs: %12 %13
+  %18 = Phi (BB%1, %10), (BB%12, %39)
+  %19 = Add %18, 1
+  CondBranch %19, BB%12, BB%13
+BB %12 - succs: %11
+  %20 = Add %19, 0(0x0)
+  %21 = Add %19, 1(0x1)
+  %22 = Add %19, 2(0x2)
+  %23 = Add %19, 3(0x3)
+  %24 = Add %19, 4(0x4)
+  %25 = Add %19, 5(0x5)
+  %26 = Add %19, 6(0x6)
+  %27 = Add %19, 7(0x7)
+  %28 = Add %19, 8(0x8)
+  %29 = Add %19, 9(0x9)
+  %30 = Add %20, %19
+  %31 = Add %21, %30
+  %32 = Add %22, %31
+  %33 = Add %23, %32
+  %34 = Add %24, %33
+  %35 = Add %25, %34
+  %36 = Add %26, %35
+  %37 = Add %27, %36
+  %38 = Add %28, %37
+  %39 = Add %29, %38
+  Branch BB%11
+BB %13 - succs: %14
+  %40 = Add %2, %19
+  %41 = Add %3, %40
+  %42 = Add %4, %41
+  %43 = Add %5, %42
+  Branch BB%14
+BB %14 - succs: %15 %16
+  %44 = Phi (BB%13, %43), (BB%15, %49)
+  %45 = Add %44, 1
+  CondBranch %45, BB%15, BB%16
+BB %15 - succs: %14
+  %46 = Add %6, %45
+  %47 = Add %7, %46
+  %48 = Add %8, %47
+  %49 = Add %9, %48
+  Branch BB%14
+BB %16 - succs: %17
+  Return %45
+BB %17
+
+)";
+
+  // Count the stack slot operands and register to register copies in the
+  // loops, which are executed on every iteration.
+  auto count_loop_accesses = [](Function* func) {
+    std::pair<int, int> counts{0, 0};
+    for (BasicBlock* block : func->basicblocks()) {
+      int id = block->id();
+      if (id != 11 && id != 12 && id != 14 && id != 15) {
+        continue;
+      }
+      for (auto& instr : block->instructions()) {
+        counts.first += instr->output()->isStack();
+        instr->foreachInputOperand(
+            [&](const OperandBase* opnd) { counts.first += opnd->isStack(); });
+        if (instr->isMove() && instr->output()->isReg() &&
+            instr->getInput(0)->isReg() &&
+            instr->output()->getPhyRegister() !=
+                instr->getInput(0)->getPhyRegister()) {
+          counts.second++;
+        }
+      }
+    }
+    return counts;
+  };
+
+  std::vector<std::pair<int, int>> counts;
+  for (bool spill_costs : {false, true}) {
+    Parser parser;
+    auto lir_func = parser.parse(lir_source);
+    RegallocOptions options;
+    options.spill_costs = spill_costs;
+    LinearScanAllocator lsallocator(lir_func.get(), 0, options);
+    lsallocator.run();
+    counts.push_back(count_loop_accesses(lir_func.get()));
+  }
+
+  // Evicting the furthest next use spills %6-%9 inside the first loop, which
+  // stores and reloads them on every iteration of both loops. Weighing uses
+  // by loop depth spills %2-%5 instead, and the loop carried value no longer
+  // needs a copy on the back edge.
+  EXPECT_EQ(counts[0], std::make_pair(18, 1));
+  EXPECT_EQ(counts[1], std::make_pair(10, 0));
+}
+
 TEST_F(LinearScanAllocatorTest, InoutRegTest) {
   // OptimizeMoveSequence should not set reg operands that are also output
   auto lirfunc = std::make_unique<Function>();
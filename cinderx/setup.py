@@ -49,6 +49,9 @@
     "Jit/bitvector.cpp",
     "Jit/bytecode.cpp",
     "Jit/code_allocator.cpp",
+    "Jit/compile_arena.cpp",
+    "Jit/compile_queue.cpp",
+    "Jit/compile_stats.cpp",
     "Jit/compiler.cpp",
     "Jit/config.cpp",
     "Jit/debug_info.cpp",
@@ -62,6 +65,9 @@
     "Jit/hir/alias_class.cpp",
     "Jit/hir/analysis.cpp",
     "Jit/hir/builder.cpp",
+    "Jit/hir/escape_analysis.cpp",
+    "Jit/hir/float_unboxing.cpp",
+    "Jit/hir/int_range_analysis.cpp",
     "Jit/hir/memory_effects.cpp",
     "Jit/hir/optimization.cpp",
     "Jit/hir/parser.cpp",
@@ -89,6 +95,7 @@
     "Jit/threaded_compile.cpp",
     "Jit/type_deopt_patchers.cpp",
     "Jit/type_profiler.cpp",
+    "Jit/warm_start.cpp",
     "Jit/codegen/annotations.cpp",
     "Jit/codegen/autogen.cpp",
     "Jit/codegen/code_section.cpp",
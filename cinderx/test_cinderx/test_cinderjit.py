@@ -83,6 +83,31 @@ def firstlineno(func):
     return func.__code__.co_firstlineno
 
 
+def run_in_subprocess(code, *xoptions, args=(), cwd=None):
+    """Run code as mod.py in a new interpreter with the given -X options and
+    return its stdout. Fails the test if the interpreter exits with an error.
+
+    The script runs in a temporary directory unless cwd is given, so that
+    files it leaves behind can be read by a later run.
+    """
+    if cwd is None:
+        with tempfile.TemporaryDirectory() as tmp:
+            return run_in_subprocess(code, *xoptions, args=args, cwd=tmp)
+    (Path(cwd) / "mod.py").write_text(textwrap.dedent(code))
+    cmd = [sys.executable]
+    for xoption in xoptions:
+        cmd += ["-X", xoption]
+    proc = subprocess.run(
+        cmd + ["mod.py", *args],
+        cwd=cwd,
+        capture_output=True,
+        encoding=sys.stdout.encoding,
+    )
+    if proc.returncode != 0:
+        raise AssertionError(f"exited with {proc.returncode}:\n{proc.stderr}")
+    return proc.stdout
+
+
 class GetFrameLineNumberTests(unittest.TestCase):
     def assert_code_and_lineno(self, frame, func, line_offset):
         self.assertEqual(frame.f_code, func.__code__)
@@ -391,6 +416,76 @@ def test_inliner_dump_json(self):
                 shutil.rmtree(dumpdir)
                 self.assertEqual(proc.returncode, 0, proc.stderr)
 
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_polymorphic_method_calls_inlined(self):
+        code = """
+            import cinderjit
+
+            class Circle:
+                def area(self, r):
+                    return 3 * r * r
+
+            class Square:
+                def area(self, r):
+                    return 4 * r * r
+
+            class Point:
+                def area(self, r):
+                    return 0
+
+            def total_area(shapes, r):
+                total = 0
+                for shape in shapes:
+                    total += shape.area(r)
+                return total
+
+            shapes = [Circle(), Square()]
+            for _ in range(100):
+                total_area(shapes, 2)
+            print(
+                cinderjit.is_jit_compiled(total_area),
+                cinderjit.get_num_inlined_functions(total_area),
+            )
+            print(total_area(shapes + [Point()], 2))
+            Square.area = lambda self, r: -1
+            print(total_area(shapes, 2))
+        """
+        out = run_in_subprocess(
+            code, "jit-auto=50", "jit-auto-profile=20", "jit-enable-hir-inliner"
+        )
+        self.assertEqual(out, "True 2\n28\n11\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_kwonly_and_closure_calls_inlined(self):
+        code = """
+            import cinderjit
+
+            def scale(x, *, factor=2):
+                return x * factor
+
+            def make_adder(n):
+                def add(x):
+                    return x + n
+                return add
+
+            add3 = make_adder(3)
+
+            def compute(x):
+                return scale(x) + scale(x, factor=10) + add3(x)
+
+            for _ in range(100):
+                compute(1)
+            print(
+                cinderjit.is_jit_compiled(compute),
+                cinderjit.get_num_inlined_functions(compute),
+            )
+            print(compute(1))
+            scale.__kwdefaults__["factor"] = 5
+            print(compute(1))
+        """
+        out = run_in_subprocess(code, "jit-auto=50", "jit-enable-hir-inliner")
+        self.assertEqual(out, "True 3\n16\n19\n")
+
 
 class InlineCacheStatsTests(unittest.TestCase):
     @jit_suppress
@@ -4257,6 +4352,32 @@ def testfunc():
                 self.assertTrue(cinderjit.is_jit_compiled(testfunc))
 
 
+    def test_boxed_primitive_survives_deopt(self):
+        codestr = f"""
+            from __static__ import int64, box
+
+            def raise_value_error():
+                raise ValueError()
+
+            def testfunc(f):
+                x: int64 = 5
+                y = box(x)
+                for i in range(3):
+                    x += 1
+                try:
+                    f()
+                except ValueError:
+                    return y, box(x), i
+                return None
+        """
+        with self.in_module(codestr) as mod:
+            testfunc = mod.testfunc
+            self.assertEqual(testfunc(mod.raise_value_error), (5, 8, 2))
+
+            if cinderjit and cinderjit.auto_jit_threshold() <= 1:
+                self.assertTrue(cinderjit.is_jit_compiled(testfunc))
+
+
 @cinder_support.skipUnlessJITEnabled("Requires cinderjit module")
 class CinderJitModuleTests(StaticTestBase):
     def test_bad_disable(self):
@@ -4295,6 +4416,31 @@ def g():
             if cinderjit.auto_jit_threshold() <= 1:
                 self.assertTrue(cinderjit.is_jit_compiled(g))
 
+    def test_static_calls_to_uncompiled_function(self):
+        codestr = f"""
+            import cinderjit
+            from __static__ import int64
+
+            @cinderjit.jit_suppress
+            def f(a: int64, b: str, c: int64) -> int64:
+                return a * 10 + len(b) + c
+
+            def g() -> int64:
+                return f(1, "ab", 3)
+
+            def h(x: int64) -> int64:
+                return f(x, "", x)
+        """
+        with self.in_module(codestr) as mod:
+            self.assertEqual(mod.g(), 15)
+            self.assertEqual(mod.h(4), 44)
+            self.assertEqual(mod.g(), 15)
+
+            self.assertFalse(cinderjit.is_jit_compiled(mod.f))
+            if cinderjit.auto_jit_threshold() <= 1:
+                self.assertTrue(cinderjit.is_jit_compiled(mod.g))
+                self.assertTrue(cinderjit.is_jit_compiled(mod.h))
+
     @unittest.skipIf(
         not cinderjit or not cinderjit.is_hir_inliner_enabled(),
         "meaningless without HIR inliner enabled",
@@ -5045,6 +5191,841 @@ def test_list_to_tuple_returns_tuple(self):
         self.assertEqual(new_tup, (1, 2, 3, 4))
 
 
+class SliceTests(unittest.TestCase):
+    @cinder_support.failUnlessJITCompiled
+    def slice(self, obj, start, stop):
+        return obj[start:stop]
+
+    def test_slice_builtin_sequences(self):
+        for obj in ([1, 2, 3, 4, 5], (1, 2, 3, 4, 5), "abcde", "abሴde"):
+            for start, stop in (
+                (1, 3),
+                (None, 2),
+                (2, None),
+                (None, None),
+                (-3, -1),
+                (-100, 100),
+                (4, 1),
+                (2**100, -(2**100)),
+                (True, 3),
+            ):
+                with self.subTest(obj=obj, start=start, stop=stop):
+                    self.assertEqual(self.slice(obj, start, stop), obj[start:stop])
+
+    def test_slice_index_object(self):
+        class Index:
+            def __index__(self):
+                return 1
+
+        self.assertEqual(self.slice([1, 2, 3], Index(), None), [2, 3])
+        self.assertEqual(self.slice("abc", None, Index()), "a")
+
+    def test_slice_bad_index(self):
+        with self.assertRaises(TypeError):
+            self.slice([1, 2, 3], "a", None)
+        with self.assertRaises(TypeError):
+            self.slice((1, 2, 3), None, 1.5)
+
+    def test_slice_custom_getitem(self):
+        class C:
+            def __getitem__(self, item):
+                return item
+
+        self.assertEqual(self.slice(C(), 1, "x"), slice(1, "x"))
+
+    def test_slice_list_subclass(self):
+        class L(list):
+            def __getitem__(self, item):
+                return ("L", item)
+
+        self.assertEqual(self.slice(L([1, 2]), 0, 1), ("L", slice(0, 1)))
+
+
+class EscapeAnalysisTests(unittest.TestCase):
+    def raise_value_error(self):
+        raise ValueError()
+
+    @cinder_support.failUnlessJITCompiled
+    def unpack_built_tuple(self, x, y):
+        t = (x, y)
+        a, b = t
+        return b, a
+
+    def test_unpack_built_tuple(self):
+        self.assertEqual(self.unpack_built_tuple(1, 2), (2, 1))
+
+    @cinder_support.failUnlessJITCompiled
+    def virtual_objects_in_deopt(self, x, y, f):
+        t = (x, (y, x))
+        l = [y, x]
+        try:
+            f()
+        except ValueError:
+            return t, l, x[1:y]
+        return None
+
+    def test_virtual_objects_materialized_on_deopt(self):
+        x = [1, 2, 3]
+        t, l, s = self.virtual_objects_in_deopt(x, 2, self.raise_value_error)
+        self.assertEqual(t, (x, (2, x)))
+        self.assertIs(t[0], x)
+        self.assertEqual(l, [2, x])
+        self.assertEqual(s, [2])
+
+    @cinder_support.failUnlessJITCompiled
+    def shared_virtual_object_in_deopt(self, x, f):
+        l = [x]
+        m = l
+        t = (l, l)
+        try:
+            f()
+        except ValueError:
+            return l, m, t
+        return None
+
+    def test_shared_virtual_object_keeps_identity_on_deopt(self):
+        l, m, t = self.shared_virtual_object_in_deopt(1, self.raise_value_error)
+        self.assertIs(l, m)
+        self.assertIs(t[0], l)
+        self.assertIs(t[1], l)
+        l.append(2)
+        self.assertEqual(m, [1, 2])
+
+
+class FloatUnboxingTests(unittest.TestCase):
+    @cinder_support.failUnlessJITCompiled
+    def float_arith(self):
+        x = 1.5
+        y = 4.0
+        z = x * y - x
+        z += 2
+        return z / y
+
+    def test_float_arith(self):
+        self.assertEqual(self.float_arith(), 1.625)
+
+    @cinder_support.failUnlessJITCompiled
+    def float_divide_by_zero(self):
+        x = 1.5
+        y = 0.0
+        return x / y
+
+    def test_float_divide_by_zero_raises(self):
+        with self.assertRaises(ZeroDivisionError):
+            self.float_divide_by_zero()
+
+    @cinder_support.failUnlessJITCompiled
+    def float_compare_nan(self):
+        inf = 1e400
+        x = inf - inf
+        y = 1.0
+        z = 2.0
+        return (y < z, z <= y, y > z, z >= y, x < y, x <= y, x > y, x >= y)
+
+    def test_float_compare_nan(self):
+        self.assertEqual(
+            self.float_compare_nan(),
+            (True, False, False, True, False, False, False, False),
+        )
+
+    @cinder_support.failUnlessJITCompiled
+    def float_loop(self, n):
+        x = 1.0
+        for i in range(n):
+            x = x * 2.0
+        return x
+
+    def test_loop_carried_float(self):
+        self.assertEqual(self.float_loop(0), 1.0)
+        self.assertEqual(self.float_loop(10), 1024.0)
+
+    @cinder_support.failUnlessJITCompiled
+    def float_loop_with_deopt(self, n, f):
+        x = 1.0
+        y = 0.5
+        try:
+            for i in range(n):
+                x = x * 2.0
+                y = y + x
+                if i == 3:
+                    f()
+        except ValueError:
+            return x, y
+        return None
+
+    def test_loop_carried_float_deopt(self):
+        def raise_value_error():
+            raise ValueError()
+
+        self.assertEqual(
+            self.float_loop_with_deopt(10, raise_value_error), (16.0, 30.5)
+        )
+
+
+class IntRangeTests(unittest.TestCase):
+    @cinder_support.failUnlessJITCompiled
+    def count_up_to_len(self, x):
+        n = len(x)
+        i = 0
+        total = 0
+        while i < n:
+            total += i
+            i += 1
+        return i, total
+
+    def test_counted_loop(self):
+        self.assertEqual(self.count_up_to_len([0] * 10), (10, 45))
+        self.assertEqual(self.count_up_to_len(()), (0, 0))
+
+    @cinder_support.failUnlessJITCompiled
+    def scale_len(self, x):
+        n = len(x)
+        return n * 4611686018427387904 + 1
+
+    def test_multiply_overflow_deopts(self):
+        self.assertEqual(self.scale_len("a"), 2**62 + 1)
+        self.assertEqual(self.scale_len("ab"), 2**63 + 1)
+        self.assertEqual(self.scale_len("abcd"), 2**64 + 1)
+
+    @cinder_support.failUnlessJITCompiled
+    def powers_of_two(self):
+        i = 1
+        n = 0
+        while n < 70:
+            i = i * 2
+            n += 1
+        return i, n
+
+    def test_loop_overflow_deopts(self):
+        self.assertEqual(self.powers_of_two(), (2**70, 70))
+
+    @cinder_support.failUnlessJITCompiled
+    def loop_invariant_product(self, x, y):
+        n = len(x)
+        m = len(y)
+        i = 0
+        total = 0
+        while i < n:
+            total += n * m
+            i += 1
+        return total
+
+    def test_loop_invariant_product(self):
+        # n * m doesn't change in the loop, and neither operand is a constant.
+        self.assertEqual(self.loop_invariant_product("abc", "de"), 18)
+        self.assertEqual(self.loop_invariant_product("", "de"), 0)
+
+
+class RangeLoopTests(unittest.TestCase):
+    @cinder_support.failUnlessJITCompiled
+    def collect(self, *args):
+        out = []
+        for i in range(*args):
+            out.append(i)
+        return out
+
+    def test_range_loop(self):
+        self.assertEqual(self.collect(5), [0, 1, 2, 3, 4])
+        self.assertEqual(self.collect(0), [])
+        self.assertEqual(self.collect(10, -5, -3), [10, 7, 4, 1, -2])
+        self.assertEqual(self.collect(2**62, 2**62 + 2), [2**62, 2**62 + 1])
+        # index * step overflows a C long here, but the values don't.
+        self.assertEqual(
+            self.collect(-(2**63), 2**63 - 1, 2**62),
+            [-(2**63), -(2**62), 0, 2**62],
+        )
+
+    def test_range_loop_with_extended_arg(self):
+        # A body this long needs an EXTENDED_ARG before the FOR_ITER.
+        body = "\n".join(["        total += i"] * 80)
+        src = f"""
+def f(n):
+    total = 0
+    for i in range(n):
+{body}
+    return total
+"""
+        ns = {}
+        exec(src, ns)
+        f = cinder_support.failUnlessJITCompiled(ns["f"])
+        self.assertIn("EXTENDED_ARG", [i.opname for i in dis.get_instructions(f)])
+        self.assertEqual(f(10), 80 * 45)
+
+    def test_long_range_deopts(self):
+        self.assertEqual(self.collect(2**64, 2**64 + 2), [2**64, 2**64 + 1])
+
+    @cinder_support.failUnlessJITCompiled
+    def double_n_times(self, n):
+        total = 1
+        for i in range(n):
+            total = total + total
+        return i, total
+
+    def test_deopt_in_loop_body(self):
+        # The addition overflows part way through the loop, and the
+        # interpreter has to pick up the iteration where the JIT left off.
+        self.assertEqual(self.double_n_times(70), (69, 2**70))
+
+    @cinder_support.failUnlessJITCompiled
+    def sum_range(self, n):
+        total = 0
+        for i in range(n):
+            total += i
+        return total
+
+    def test_shadowed_range(self):
+        self.assertEqual(self.sum_range(10), 45)
+        globals()["range"] = lambda n: [100, 200]
+        try:
+            self.assertEqual(self.sum_range(10), 300)
+        finally:
+            del globals()["range"]
+        self.assertEqual(self.sum_range(10), 45)
+
+
+class OSRTests(unittest.TestCase):
+    def run_osr(self, code):
+        # A huge jit-auto threshold keeps the functions under test in the
+        # interpreter, so they can only reach JIT code through OSR.
+        return run_in_subprocess(code, "jit-auto=1000000", "jit-osr=50")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_for_loop_moves_to_jit_frame(self):
+        out = self.run_osr(
+            """
+            import sys
+
+            def main(n):
+                frames = set()
+                total = 0
+                for i in range(n):
+                    frames.add(sys._getframe())
+                    total += i
+                return total, len(frames)
+
+            print(*main(1000))
+            """
+        )
+        self.assertEqual(out, "499500 2\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_while_loop_with_cells(self):
+        out = self.run_osr(
+            """
+            def main(n):
+                seen = []
+                def add(x):
+                    seen.append(x)
+                i = 0
+                while i < n:
+                    add(i)
+                    i += 1
+                return sum(seen)
+
+            print(main(1000))
+            """
+        )
+        self.assertEqual(out, "499500\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_nested_loops(self):
+        # The inner loops get hot first, but only the outer loop's header can
+        # be entered.
+        out = self.run_osr(
+            """
+            def overlap(prefix):
+                table = [0] * len(prefix)
+                for i in range(1, len(prefix)):
+                    idx = table[i - 1]
+                    while prefix[i] != prefix[idx]:
+                        if idx == 0:
+                            table[i] = 0
+                            break
+                        idx = table[idx - 1]
+                    else:
+                        table[i] = idx + 1
+                return sum(table)
+
+            def grid(n):
+                total = 0
+                for i in range(n):
+                    j = 0
+                    while j < n:
+                        total += i * j
+                        j += 1
+                return total
+
+            print(overlap("abab" * 200), grid(100))
+            """
+        )
+        self.assertEqual(out, "318801 24502500\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_deopt_and_raise_after_osr(self):
+        out = self.run_osr(
+            """
+            import traceback
+
+            def deopts(n):
+                total = 0
+                for i in range(n):
+                    total += i if i < n // 2 else 0.5
+                return total
+
+            def raises(n):
+                for i in range(n):
+                    if i == n - 1:
+                        raise ValueError(i)
+
+            print(deopts(1000))
+            try:
+                raises(1000)
+            except ValueError as e:
+                print([f.name for f in traceback.extract_tb(e.__traceback__)])
+            """
+        )
+        self.assertEqual(out, "125000.0\n['<module>', 'raises']\n")
+
+
+class RecompileTests(unittest.TestCase):
+    # len() of a str is known to be a small int, so the multiply is done in a
+    # machine register with an overflow check that fails every time.
+    OVERFLOWING_CODE = """
+        import cinderjit
+
+        def scale(s):
+            n = len(s)
+            return n * 4611686018427387904 + 1
+
+        results = set()
+        for _ in range(1000):
+            results.add(scale("abcd"))
+        deopts = sum(
+            d["int"]["count"]
+            for d in cinderjit.get_and_clear_runtime_stats()["deopt"]
+            if d["normal"]["func_qualname"] == "scale"
+        )
+        print(results == {18446744073709551617}, deopts)
+    """
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_failing_guard_deopts_every_call(self):
+        out = run_in_subprocess(self.OVERFLOWING_CODE, "jit")
+        self.assertEqual(out, "True 1000\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_recompile_after_threshold(self):
+        out = run_in_subprocess(
+            self.OVERFLOWING_CODE, "jit", "jit-recompile=10"
+        )
+        self.assertEqual(out, "True 10\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_recompile_after_hoisted_guard_fails(self):
+        # The overflow check is loop invariant, so LICM moves it out of the
+        # loop. Its failures still have to be attributed to the multiply, or
+        # recompiling would rebuild the same failing check.
+        code = """
+        import cinderjit
+
+        def scale(s, k):
+            n = len(s)
+            total = 0
+            for _ in range(k):
+                total += n * 4611686018427387904
+            return total
+
+        results = set()
+        for _ in range(1000):
+            results.add(scale("abcd", 2))
+        deopts = sum(
+            d["int"]["count"]
+            for d in cinderjit.get_and_clear_runtime_stats()["deopt"]
+            if d["normal"]["func_qualname"] == "scale"
+        )
+        print(results == {36893488147419103232}, deopts)
+        """
+        out = run_in_subprocess(code, "jit", "jit-recompile=10")
+        self.assertEqual(out, "True 10\n")
+
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_recompiled_code_freed(self):
+        code = self.OVERFLOWING_CODE + """
+        stats = cinderjit.get_allocator_stats()
+        print(
+            stats is None
+            or (stats["reclaimed_bytes"] > 0 and stats["retired_bytes"] == 0)
+        )
+        """
+        out = run_in_subprocess(code, "jit", "jit-recompile=10")
+        self.assertEqual(out, "True 10\nTrue\n")
+
+
+class AsyncCompileTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_hot_function_compiled_in_background(self):
+        code = """
+            import cinderjit
+            import time
+
+            def inc(x):
+                return x + 1
+
+            for _ in range(100):
+                inc(1)
+            # The worker needs the GIL, which sleeping releases.
+            deadline = time.monotonic() + 60
+            while not cinderjit.is_jit_compiled(inc):
+                if time.monotonic() > deadline:
+                    break
+                time.sleep(0.01)
+            stats = cinderjit.get_compile_queue_stats()
+            print(cinderjit.is_jit_compiled(inc), inc(1))
+            print(stats["enqueued"] >= 1, stats["compiled"] >= 1)
+        """
+        out = run_in_subprocess(code, "jit-auto=50", "jit-async-compile")
+        self.assertEqual(out, "True 2\nTrue True\n")
+
+
+class WarmStartTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_functions_compiled_by_previous_run_compiled_on_first_call(self):
+        code = """
+            import cinderjit
+            import sys
+
+            def inc(x):
+                return x + 1
+
+            for _ in range(int(sys.argv[1])):
+                inc(1)
+            print(cinderjit.is_jit_compiled(inc))
+        """
+        with tempfile.TemporaryDirectory() as tmp:
+
+            def run(ncalls):
+                return run_in_subprocess(
+                    code,
+                    "jit-auto=100",
+                    f"jit-warm-start={Path(tmp) / 'warm_start'}",
+                    args=[str(ncalls)],
+                    cwd=tmp,
+                )
+
+            self.assertEqual(run(2), "False\n")
+            self.assertEqual(run(200), "True\n")
+            self.assertEqual(run(2), "True\n")
+
+
+class SealCodeBeforeForkTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_code_sealed_and_compiled_after_fork(self):
+        code = """
+            import cinderjit
+            import os
+
+            def f(x):
+                return x + 1
+
+            def g(x):
+                return x * 2
+
+            cinderjit.force_compile(f)
+            pid = os.fork()
+            if pid == 0:
+                cinderjit.force_compile(g)
+                print(f(1), g(2), flush=True)
+                os._exit(0)
+            os.waitpid(pid, 0)
+            stats = cinderjit.get_allocator_stats()
+            print(stats is None or stats["sealed_bytes"] > 0)
+        """
+        out = run_in_subprocess(code, "jit", "jit-seal-code-before-fork")
+        self.assertEqual(out, "2 4\nTrue\n")
+
+
+class CodePlacementTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_placed_code_runs(self):
+        code = """
+            import cinderjit
+
+            def callee(x):
+                total = 0
+                for i in range(x):
+                    total += i
+                return total
+
+            def caller(n):
+                total = 0
+                while n > 0:
+                    total += callee(n)
+                    n -= 1
+                return total
+
+            print(caller(10), caller(100))
+            print(
+                cinderjit.is_jit_compiled(caller),
+                cinderjit.is_jit_compiled(callee),
+            )
+        """
+        multiple_sections = [
+            "jit-multiple-code-sections",
+            "jit-hot-code-section-size=1048576",
+            "jit-cold-code-section-size=1048576",
+        ]
+        for extra in ([], multiple_sections):
+            with self.subTest(extra=extra):
+                out = run_in_subprocess(code, "jit", "jit-code-placement", *extra)
+                self.assertEqual(out, "165 166650\nTrue True\n")
+
+
+class CompilePhaseStatsTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_phases_recorded(self):
+        code = """
+            import cinderjit
+
+            def f(x):
+                return x + 1
+
+            def g(x):
+                return [f(i) for i in range(x)]
+
+            cinderjit.clear_compile_phase_stats()
+            cinderjit.force_compile(f)
+            cinderjit.force_compile(g)
+            stats = cinderjit.get_compile_phase_stats()
+            print(stats["compiles"])
+            phases = stats["phases"]
+            for name in (
+                "HIR build",
+                "SSAify",
+                "RefcountInsertion",
+                "LIR generation",
+                "Register allocation",
+                "Code generation",
+            ):
+                print(name, phases[name]["count"])
+            print(sum(stats["time_us_histogram"]))
+            print(sum(stats["arena_kib_histogram"]))
+            print(stats["max_arena_bytes"] > 0)
+            cinderjit.clear_compile_phase_stats()
+            print(cinderjit.get_compile_phase_stats()["phases"])
+        """
+        self.assertEqual(
+            run_in_subprocess(code, "jit"),
+            "2\n"
+            "HIR build 2\n"
+            "SSAify 2\n"
+            "RefcountInsertion 2\n"
+            "LIR generation 2\n"
+            "Register allocation 2\n"
+            "Code generation 2\n"
+            "2\n"
+            "2\n"
+            "True\n"
+            "{}\n",
+        )
+
+
+class TieredCompileTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_hot_function_is_fully_optimized(self):
+        code = """
+            import cinderjit
+
+            def f(x):
+                return x * 2
+
+            results = [f(0)]
+            print(cinderjit.get_function_compile_tier(f))
+            for i in range(1, 5):
+                results.append(f(i))
+            print(cinderjit.get_function_compile_tier(f))
+            results.append(f(5))
+            print(cinderjit.get_function_compile_tier(f))
+            print(results)
+        """
+        out = run_in_subprocess(code, "jit", "jit-tier2-threshold=5")
+        self.assertEqual(out, "1\nNone\n2\n[0, 2, 4, 6, 8, 10]\n")
+
+
+class PackedDeoptMetadataTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_deopt_with_packed_metadata(self):
+        code = """
+            import cinderjit
+
+            class C:
+                def __init__(self, x):
+                    self.x = x
+
+            def f(a, b, c):
+                total = 0
+                for obj in (a, b, c):
+                    total += obj.x
+                return total
+
+            cinderjit.force_compile(f)
+            packed, unpacked = cinderjit.get_compiled_deopt_metadata_size(f)
+            print(0 < packed < unpacked)
+            print(f(C(1), C(2), C(3)))
+            print(f(C(1.5), C(2), C(3)))
+            try:
+                f(C(1), C(2), object())
+            except AttributeError as e:
+                print(e)
+        """
+        self.assertEqual(
+            run_in_subprocess(code, "jit"),
+            "True\n6\n6.5\n'object' object has no attribute 'x'\n",
+        )
+
+
+class RegallocModeTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_loop_with_spills_in_every_mode(self):
+        code = """
+            import cinderjit
+
+            def g(x):
+                return x + 1
+
+            def f(n):
+                a, b, c, d, e, h = 1, 2, 3, 4, 5, 6
+                total = 0
+                for i in range(n):
+                    total += g(a) + g(b) + g(c) + g(d) + g(e) + g(h) + i
+                    a, b, c, d, e, h = b, c, d, e, h, a
+                return total
+
+            cinderjit.force_compile(f)
+            print(cinderjit.get_compiled_spill_stack_size(f) >= 0)
+            print(f(100))
+        """
+        modes = [
+            "jit-regalloc-spill-costs=0",
+            "jit-regalloc-spill-costs=1",
+            "jit-regalloc-split-outside-loops=1",
+        ]
+        for mode in modes:
+            with self.subTest(mode=mode):
+                out = run_in_subprocess(code, "jit", mode)
+                self.assertEqual(out, "True\n7650\n")
+
+
+class DirectCallTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_direct_calls(self):
+        code = """
+            import cinderjit
+
+            def g(a, b):
+                return a - b
+
+            def h(a, b, c, d, e, f, g, h):
+                return [a, b, c, d, e, f, g, h]
+
+            def raises(x):
+                raise ValueError(x)
+
+            def call_g(a, b):
+                return g(a, b)
+
+            def call_h():
+                return h(1, 2, 3, 4, 5, 6, 7, 8)
+
+            def call_raises():
+                try:
+                    raises(5)
+                except ValueError as e:
+                    return e.args
+
+            def g2(a, b):
+                return a * b
+
+            # Calls made before and after the callee is compiled, and after
+            # its code is replaced.
+            results = [call_g(5, 3) for _ in range(5)]
+            cinderjit.force_compile(g)
+            results += [call_g(5, 3) for _ in range(5)]
+            g.__code__ = g2.__code__
+            results += [call_g(5, 3) for _ in range(5)]
+            print(results)
+            print(call_h())
+            print(call_raises())
+        """
+        modes = [
+            [],
+            ["jit-tier2-threshold=2"],
+        ]
+        expected = f"{[2] * 10 + [15] * 5}\n[1, 2, 3, 4, 5, 6, 7, 8]\n(5,)\n"
+        for flags in modes:
+            with self.subTest(flags=flags):
+                out = run_in_subprocess(code, "jit", "jit-direct-calls=1", *flags)
+                self.assertEqual(out, expected)
+
+
+class TailCallTests(unittest.TestCase):
+    @cinder_support.skipUnlessJITEnabled("Runs a subprocess with the JIT enabled")
+    def test_self_tail_calls(self):
+        code = """
+            import sys
+            import traceback
+
+            import cinderjit
+
+            def total(n, acc):
+                if n == 0:
+                    return acc
+                return total(n - 1, acc + n)
+
+            def count(n, stop):
+                if n == stop:
+                    raise ValueError(n)
+                return count(n + 1, stop)
+
+            def swap(n):
+                if n == 3:
+                    swap.__code__ = done.__code__
+                if n == 0:
+                    return "old"
+                return swap(n - 1)
+
+            def done(n):
+                return "new"
+
+            for func in (total, count, swap):
+                cinderjit.force_compile(func)
+
+            # The elided frames are released on return, so repeated calls
+            # don't add up to the recursion limit.
+            print(all(total(500, 0) == 125250 for _ in range(10)))
+            # They still count towards it.
+            try:
+                total(sys.getrecursionlimit(), 0)
+            except RecursionError:
+                print("RecursionError")
+            # And they show up in the traceback, at the tail call.
+            try:
+                count(0, 50)
+            except ValueError as e:
+                frames = traceback.extract_tb(e.__traceback__)
+                lines = [f.lineno for f in frames if f.name == "count"]
+                tail_call_line = count.__code__.co_firstlineno + 3
+                print(len(lines), lines.count(tail_call_line))
+            # With tracing on, the calls are made for real.
+            sys.settrace(lambda *args: None)
+            print(total(50, 0))
+            sys.settrace(None)
+            # Once __code__ changes, the call has to run the new code.
+            print(swap(5))
+        """
+        out = run_in_subprocess(code, "jit", "jit-tail-calls=1")
+        self.assertEqual(out, "True\nRecursionError\n51 50\n1275\nnew\n")
+
+
 class CompareTests(unittest.TestCase):
     class Incomparable:
         def __lt__(self, other):